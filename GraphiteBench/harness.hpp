@@ -0,0 +1,251 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#if !defined(GRAPHITE_BENCH_HARNESS_HPP)
+#define GRAPHITE_BENCH_HARNESS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace graphite::bench {
+
+    /**
+     * A small deterministic pseudo random generator (xorshift64*), so that generated corpora are identical
+     * between runs, machines and standard library implementations.
+     */
+    class random
+    {
+    private:
+        uint64_t m_state;
+
+    public:
+        explicit random(uint64_t seed) : m_state(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+        auto next() -> uint64_t
+        {
+            m_state ^= m_state >> 12;
+            m_state ^= m_state << 25;
+            m_state ^= m_state >> 27;
+            return m_state * 0x2545F4914F6CDD1DULL;
+        }
+
+        auto next(uint64_t bound) -> uint64_t { return bound ? next() % bound : 0; }
+    };
+
+    /**
+     * Command line options of the form `--name=value`.
+     */
+    class options
+    {
+    private:
+        std::map<std::string, std::string> m_values;
+
+    public:
+        options(int argc, const char **argv)
+        {
+            for (auto i = 1; i < argc; ++i) {
+                std::string arg(argv[i]);
+                if (arg.rfind("--", 0) != 0) {
+                    continue;
+                }
+                auto eq = arg.find('=');
+                if (eq == std::string::npos) {
+                    m_values[arg.substr(2)] = "1";
+                }
+                else {
+                    m_values[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+                }
+            }
+        }
+
+        [[nodiscard]] auto has(const std::string& name) const -> bool { return m_values.find(name) != m_values.end(); }
+
+        [[nodiscard]] auto string(const std::string& name, const std::string& fallback) const -> std::string
+        {
+            auto it = m_values.find(name);
+            return it == m_values.end() ? fallback : it->second;
+        }
+
+        [[nodiscard]] auto integer(const std::string& name, int64_t fallback) const -> int64_t
+        {
+            auto it = m_values.find(name);
+            return it == m_values.end() ? fallback : std::strtoll(it->second.c_str(), nullptr, 10);
+        }
+
+        [[nodiscard]] auto list(const std::string& name, const std::vector<int64_t>& fallback) const -> std::vector<int64_t>
+        {
+            auto it = m_values.find(name);
+            if (it == m_values.end()) {
+                return fallback;
+            }
+            std::vector<int64_t> values;
+            std::stringstream ss(it->second);
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                values.emplace_back(std::strtoll(item.c_str(), nullptr, 10));
+            }
+            return values;
+        }
+    };
+
+    /**
+     * The timings collected for a single benchmark case.
+     */
+    struct measurement
+    {
+    public:
+        uint64_t iterations { 0 };
+        double best_ns { 0 };
+        double median_ns { 0 };
+        double mean_ns { 0 };
+    };
+
+    /**
+     * Run `fn` repeatedly, after a single warm up call, until both the minimum number of iterations and the
+     * minimum amount of time have been reached.
+     */
+    inline auto measure(const std::function<void()>& fn, uint64_t min_iterations = 5, double min_seconds = 0.25) -> measurement
+    {
+        using clock = std::chrono::steady_clock;
+        fn();
+
+        std::vector<double> samples;
+        auto start = clock::now();
+        while (samples.size() < min_iterations || std::chrono::duration<double>(clock::now() - start).count() < min_seconds) {
+            auto t0 = clock::now();
+            fn();
+            auto t1 = clock::now();
+            samples.emplace_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+            if (samples.size() >= 100000) {
+                break;
+            }
+        }
+
+        std::sort(samples.begin(), samples.end());
+        measurement m;
+        m.iterations = samples.size();
+        m.best_ns = samples.front();
+        m.median_ns = samples[samples.size() / 2];
+        double total = 0;
+        for (auto s : samples) {
+            total += s;
+        }
+        m.mean_ns = total / static_cast<double>(samples.size());
+        return m;
+    }
+
+    /**
+     * Collects benchmark results and writes them as a JSON document. Each result is a flat object of
+     * string and numeric fields.
+     */
+    class report
+    {
+    private:
+        struct field
+        {
+            std::string name;
+            std::string value;
+        };
+
+        std::string m_suite;
+        std::vector<field> m_config;
+        std::vector<std::vector<field>> m_results;
+        std::vector<field> *m_current { nullptr };
+
+        static auto quote(const std::string& str) -> std::string
+        {
+            std::string out = "\"";
+            for (auto c : str) {
+                if (c == '"' || c == '\\') {
+                    out.push_back('\\');
+                }
+                out.push_back(c);
+            }
+            out.push_back('"');
+            return out;
+        }
+
+        static auto number(double value) -> std::string
+        {
+            std::ostringstream ss;
+            ss.precision(12);
+            ss << value;
+            return ss.str();
+        }
+
+        static auto write_fields(std::ostream& out, const std::vector<field>& fields) -> void
+        {
+            out << "{";
+            for (std::size_t i = 0; i < fields.size(); ++i) {
+                out << (i ? ", " : "") << quote(fields[i].name) << ": " << fields[i].value;
+            }
+            out << "}";
+        }
+
+    public:
+        explicit report(std::string suite) : m_suite(std::move(suite)) {}
+
+        auto config(const std::string& name, const std::string& value) -> void { m_config.push_back({ name, quote(value) }); }
+        auto config(const std::string& name, double value) -> void { m_config.push_back({ name, number(value) }); }
+
+        auto begin_result() -> report&
+        {
+            m_results.emplace_back();
+            m_current = &m_results.back();
+            return *this;
+        }
+
+        auto set(const std::string& name, const std::string& value) -> report& { m_current->push_back({ name, quote(value) }); return *this; }
+        auto set(const std::string& name, const char *value) -> report& { return set(name, std::string(value)); }
+        auto set(const std::string& name, double value) -> report& { m_current->push_back({ name, number(value) }); return *this; }
+
+        auto set(const measurement& m) -> report&
+        {
+            set("iterations", static_cast<double>(m.iterations));
+            set("best_ns", m.best_ns);
+            set("median_ns", m.median_ns);
+            set("mean_ns", m.mean_ns);
+            return *this;
+        }
+
+        auto write(std::ostream& out) const -> void
+        {
+            out << "{\n  \"suite\": " << quote(m_suite) << ",\n  \"config\": ";
+            write_fields(out, m_config);
+            out << ",\n  \"results\": [";
+            for (std::size_t i = 0; i < m_results.size(); ++i) {
+                out << (i ? ",\n    " : "\n    ");
+                write_fields(out, m_results[i]);
+            }
+            out << "\n  ]\n}\n";
+        }
+    };
+
+}
+
+#endif //GRAPHITE_BENCH_HARNESS_HPP
@@ -0,0 +1,248 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include "GraphiteBench/harness.hpp"
+#include "libGraphite/data/writer.hpp"
+#include "libGraphite/rsrc/file.hpp"
+#include "libGraphite/rsrc/manager.hpp"
+
+using namespace graphite;
+
+// MARK: - Corpus Generation
+
+struct corpus_config
+{
+    int64_t types { 16 };
+    int64_t resources { 256 };
+    int64_t payload { 256 };
+    int64_t name_length { 16 };
+    uint64_t seed { 1 };
+};
+
+struct corpus_entry
+{
+    std::string code;
+    int64_t id;
+    std::string name;
+};
+
+static auto type_code(int64_t index) -> std::string
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    std::string code = "T";
+    for (auto i = 0; i < 3; ++i) {
+        code.push_back(alphabet[index % 36]);
+        index /= 36;
+    }
+    return code;
+}
+
+/**
+ * Build a resource file in memory. Payload sizes vary between half and one and a half times the configured
+ * size, and names are unique within each type so that name lookups resolve to a single resource.
+ */
+static auto build_corpus(const corpus_config& config, std::vector<corpus_entry>& entries) -> std::shared_ptr<rsrc::file>
+{
+    bench::random rng(config.seed);
+    auto file = std::make_shared<rsrc::file>();
+
+    for (auto t = 0; t < config.types; ++t) {
+        auto code = type_code(t);
+        for (auto r = 0; r < config.resources; ++r) {
+            auto id = static_cast<int64_t>(128 + r);
+
+            auto name = std::to_string(r) + "_";
+            while (name.size() < static_cast<std::size_t>(config.name_length)) {
+                name.push_back(static_cast<char>('a' + rng.next(26)));
+            }
+            name.resize(static_cast<std::size_t>(config.name_length));
+
+            auto size = static_cast<std::size_t>(config.payload / 2 + rng.next(static_cast<uint64_t>(config.payload) + 1));
+            auto writer = data::writer();
+            for (std::size_t i = 0; i < size; ++i) {
+                writer.write_byte(static_cast<uint8_t>(rng.next()));
+            }
+
+            file->add_resource(code, id, name, writer.data());
+            entries.push_back({ code, id, name });
+        }
+    }
+    return file;
+}
+
+static auto format_name(rsrc::file::format fmt) -> const char *
+{
+    switch (fmt) {
+        case rsrc::file::format::classic: return "classic";
+        case rsrc::file::format::extended: return "extended";
+        case rsrc::file::format::rez: return "rez";
+    }
+    return "unknown";
+}
+
+// MARK: - Benchmarks
+
+static auto record(bench::report& report, const char *format, const char *operation, const bench::measurement& m,
+                   double items, double bytes) -> void
+{
+    report.begin_result()
+        .set("format", format)
+        .set("operation", operation)
+        .set(m)
+        .set("items", items)
+        .set("bytes", bytes)
+        .set("items_per_sec", items / (m.median_ns / 1e9))
+        .set("mb_per_sec", (bytes / (1024.0 * 1024.0)) / (m.median_ns / 1e9));
+
+    std::cerr << format << " " << operation << ": " << (m.median_ns / 1e6) << " ms" << std::endl;
+}
+
+static auto run_format(bench::report& report, const std::shared_ptr<rsrc::file>& corpus, const std::vector<corpus_entry>& entries,
+                       rsrc::file::format fmt, const std::string& path, int64_t name_lookups) -> void
+{
+    auto name = format_name(fmt);
+    auto count = static_cast<double>(entries.size());
+
+    // Write / Save
+    auto write = bench::measure([&] { corpus->write(path, fmt); });
+    auto file_size = static_cast<double>(std::filesystem::file_size(path));
+    record(report, name, "write", write, count, file_size);
+
+    // Open / Parse
+    auto open = bench::measure([&] { rsrc::file file(path); });
+    record(report, name, "open_parse", open, count, file_size);
+
+    rsrc::file file(path);
+
+    // Look up every resource by id.
+    std::size_t found = 0;
+    auto by_id = bench::measure([&] {
+        for (const auto& entry : entries) {
+            found += !file.find(entry.code, entry.id, {}).expired();
+        }
+    });
+    record(report, name, "lookup_id", by_id, count, 0);
+
+    // Look up a sample of resources by name. These are linear within a type, so limit the number performed.
+    auto name_count = std::min<std::size_t>(entries.size(), static_cast<std::size_t>(name_lookups));
+    auto by_name = bench::measure([&] {
+        for (std::size_t i = 0; i < name_count; ++i) {
+            const auto& entry = entries[(i * 7919) % entries.size()];
+            found += file.find(entry.code, entry.name, {}).size();
+        }
+    });
+    record(report, name, "lookup_name", by_name, static_cast<double>(name_count), 0);
+
+    // Enumerate every type and resource, touching the size of each resource's data.
+    std::size_t enumerated = 0;
+    auto enumerate = bench::measure([&] {
+        enumerated = 0;
+        for (const auto& type : file.types()) {
+            for (const auto& resource : type->resources()) {
+                enumerated += resource->data()->size();
+            }
+        }
+    });
+    record(report, name, "enumerate", enumerate, count, static_cast<double>(enumerated));
+
+    // Look up every resource through the resource manager.
+    auto& manager = rsrc::manager::shared_manager();
+    auto shared_file = std::make_shared<rsrc::file>(path);
+    manager.import_file(shared_file);
+    auto manager_find = bench::measure([&] {
+        for (const auto& entry : entries) {
+            found += !manager.find(entry.code, entry.id).expired();
+        }
+    });
+    manager.unload_file(path);
+    record(report, name, "manager_find", manager_find, count, 0);
+
+    if (found == 0) {
+        std::cerr << "warning: no resources were found during lookups" << std::endl;
+    }
+}
+
+// MARK: - Main
+
+int main(int argc, const char **argv)
+{
+    bench::options options(argc, argv);
+    if (options.has("help")) {
+        std::cout << "usage: GraphiteBench [--types=N] [--resources=N] [--payload=BYTES] [--name-length=N]\n"
+                  << "                     [--seed=N] [--formats=classic,extended,rez] [--name-lookups=N]\n"
+                  << "                     [--workdir=PATH] [--output=PATH]\n";
+        return 0;
+    }
+
+    corpus_config config;
+    config.types = std::max<int64_t>(1, options.integer("types", config.types));
+    config.resources = std::clamp<int64_t>(options.integer("resources", config.resources), 1, 32000);
+    config.payload = std::max<int64_t>(0, options.integer("payload", config.payload));
+    config.name_length = std::clamp<int64_t>(options.integer("name-length", config.name_length), 0, 255);
+    config.seed = static_cast<uint64_t>(options.integer("seed", 1));
+    auto name_lookups = options.integer("name-lookups", 1024);
+
+    std::vector<rsrc::file::format> formats;
+    std::stringstream format_list(options.string("formats", "classic,extended,rez"));
+    std::string format;
+    while (std::getline(format_list, format, ',')) {
+        if (format == "classic") formats.emplace_back(rsrc::file::format::classic);
+        else if (format == "extended") formats.emplace_back(rsrc::file::format::extended);
+        else if (format == "rez") formats.emplace_back(rsrc::file::format::rez);
+        else {
+            std::cerr << "unknown format: " << format << std::endl;
+            return 1;
+        }
+    }
+
+    auto workdir = std::filesystem::path(options.string("workdir", std::filesystem::temp_directory_path().string()));
+    std::filesystem::create_directories(workdir);
+
+    std::vector<corpus_entry> entries;
+    auto corpus = build_corpus(config, entries);
+
+    bench::report report("rsrc");
+    report.config("types", static_cast<double>(config.types));
+    report.config("resources", static_cast<double>(config.resources));
+    report.config("payload", static_cast<double>(config.payload));
+    report.config("name_length", static_cast<double>(config.name_length));
+    report.config("seed", static_cast<double>(config.seed));
+
+    for (auto fmt : formats) {
+        auto path = (workdir / (std::string("graphite_bench.") + format_name(fmt))).string();
+        run_format(report, corpus, entries, fmt, path, name_lookups);
+        std::filesystem::remove(path);
+    }
+
+    auto output = options.string("output", "");
+    if (output.empty()) {
+        report.write(std::cout);
+    }
+    else {
+        std::ofstream out(output);
+        report.write(out);
+    }
+    return 0;
+}
@@ -0,0 +1,686 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include "GraphiteBench/harness.hpp"
+#include "libGraphite/data/reader.hpp"
+#include "libGraphite/data/writer.hpp"
+#include "libGraphite/quickdraw/cicn.hpp"
+#include "libGraphite/quickdraw/clut.hpp"
+#include "libGraphite/quickdraw/image_batch.hpp"
+#include "libGraphite/quickdraw/internal/packbits.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
+#include "libGraphite/quickdraw/pict.hpp"
+#include "libGraphite/quickdraw/ppat.hpp"
+#include "libGraphite/quickdraw/rle.hpp"
+#include "libGraphite/quicktime/imagedesc.hpp"
+
+using namespace graphite;
+
+/**
+ * Returns the four character code spelled by the string, as it is stored in a big-endian 32-bit field.
+ */
+static constexpr auto type_code(const char (&code)[5]) -> uint32_t
+{
+    return (static_cast<uint32_t>(static_cast<uint8_t>(code[0])) << 24)
+         | (static_cast<uint32_t>(static_cast<uint8_t>(code[1])) << 16)
+         | (static_cast<uint32_t>(static_cast<uint8_t>(code[2])) << 8)
+         | static_cast<uint32_t>(static_cast<uint8_t>(code[3]));
+}
+
+// MARK: - Image Synthesis
+
+/**
+ * Build a palette of the requested number of colors. The palette is derived from the seed so that images are
+ * identical between runs.
+ */
+static auto make_palette(std::size_t count, bench::random& rng) -> std::vector<qd::color>
+{
+    std::vector<qd::color> palette;
+    while (palette.size() < count) {
+        qd::color color(static_cast<uint8_t>(rng.next()), static_cast<uint8_t>(rng.next()), static_cast<uint8_t>(rng.next()));
+        if (std::find(palette.begin(), palette.end(), color) == palette.end()) {
+            palette.emplace_back(color);
+        }
+    }
+    return palette;
+}
+
+/**
+ * Synthesise an image using colors from the palette. Compressibility is the probability that a pixel repeats
+ * the pixel to its left, so 0 produces noise and values approaching 1 produce long horizontal runs.
+ */
+static auto make_indices(int width, int height, std::size_t colors, double compressibility, bench::random& rng) -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> indices(static_cast<std::size_t>(width * height));
+    auto threshold = static_cast<uint64_t>(compressibility * 1000000.0);
+    for (auto y = 0; y < height; ++y) {
+        uint8_t previous = 0;
+        for (auto x = 0; x < width; ++x) {
+            auto repeat = x > 0 && rng.next(1000000) < threshold;
+            previous = repeat ? previous : static_cast<uint8_t>(rng.next(colors));
+            indices[y * width + x] = previous;
+        }
+    }
+    return indices;
+}
+
+static auto make_surface(int width, int height, const std::vector<uint8_t>& indices, const std::vector<qd::color>& palette) -> std::shared_ptr<qd::surface>
+{
+    qd::surface::pixel_storage pixels;
+    pixels.reserve(indices.size());
+    for (auto index : indices) {
+        pixels.emplace_back(palette[index]);
+    }
+    return std::make_shared<qd::surface>(width, height, std::move(pixels));
+}
+
+// MARK: - QuickDraw Pictures
+
+/**
+ * Write a picture drawn entirely with QuickDraw primitives: filled and framed rects, and lines of varying pen size.
+ */
+static auto make_vector_pict(int width, int height, int shape_count, bench::random& rng) -> std::shared_ptr<data::data>
+{
+    auto write_rect = [] (data::writer& writer, int left, int top, int right, int bottom) {
+        writer.write_signed_short(static_cast<int16_t>(top));
+        writer.write_signed_short(static_cast<int16_t>(left));
+        writer.write_signed_short(static_cast<int16_t>(bottom));
+        writer.write_signed_short(static_cast<int16_t>(right));
+    };
+
+    data::writer writer;
+    writer.write_short(0);
+    write_rect(writer, 0, 0, width, height);
+    writer.write_long(0x001102ff);
+    writer.write_short(qd::pict::ext_header);
+    writer.write_long(0xfffe0000);
+    writer.write_long(0x00480000);
+    writer.write_long(0x00480000);
+    write_rect(writer, 0, 0, width, height);
+    writer.write_long(0);
+
+    for (auto i = 0; i < shape_count; ++i) {
+        writer.write_short(qd::pict::rgb_fg_color);
+        for (auto component = 0; component < 3; ++component) {
+            writer.write_short(static_cast<uint16_t>(rng.next(0x10000)));
+        }
+        writer.write_short(qd::pict::fill_pattern);
+        auto pattern = static_cast<uint8_t>(rng.next(256));
+        for (auto row = 0; row < 8; ++row) {
+            writer.write_byte(row & 1 ? static_cast<uint8_t>(~pattern) : pattern);
+        }
+        writer.write_short(qd::pict::pen_size);
+        auto pen = static_cast<uint16_t>(1 + rng.next(4));
+        writer.write_short(pen);
+        writer.write_short(pen);
+
+        auto x0 = static_cast<int>(rng.next(width));
+        auto y0 = static_cast<int>(rng.next(height));
+        auto x1 = static_cast<int>(rng.next(width));
+        auto y1 = static_cast<int>(rng.next(height));
+        switch (i % 3) {
+            case 0: {
+                writer.write_short(qd::pict::fill_rect);
+                write_rect(writer, std::min(x0, x1), std::min(y0, y1), std::max(x0, x1) + 1, std::max(y0, y1) + 1);
+                break;
+            }
+            case 1: {
+                writer.write_short(qd::pict::frame_rect);
+                write_rect(writer, std::min(x0, x1), std::min(y0, y1), std::max(x0, x1) + 1, std::max(y0, y1) + 1);
+                break;
+            }
+            default: {
+                writer.write_short(qd::pict::line);
+                writer.write_short(static_cast<uint16_t>(y0));
+                writer.write_short(static_cast<uint16_t>(x0));
+                writer.write_short(static_cast<uint16_t>(y1));
+                writer.write_short(static_cast<uint16_t>(x1));
+                break;
+            }
+        }
+    }
+    writer.write_short(qd::pict::eof);
+    return writer.data();
+}
+
+// MARK: - QuickTime Image Descriptions
+
+/**
+ * Write an image description header, followed by the supplied clut and atoms, and then the image data.
+ */
+static auto make_imagedesc(uint32_t compressor, uint32_t version, int width, int height, int depth,
+                           const std::shared_ptr<qd::clut>& clut, uint16_t channel_count, const std::vector<uint8_t>& image) -> std::shared_ptr<data::data>
+{
+    data::writer extra;
+    if (clut) {
+        clut->write(extra);
+    }
+    if (channel_count > 0) {
+        extra.write_long(10);
+        extra.write_long(type_code("chct"));
+        extra.write_short(channel_count);
+    }
+
+    data::writer writer;
+    writer.write_long(static_cast<uint32_t>(86 + extra.size()));
+    writer.write_long(compressor);
+    writer.write_long(0);
+    writer.write_long(0);
+    writer.write_long(version);
+    writer.write_long(0);
+    writer.write_long(0);
+    writer.write_long(0);
+    writer.write_short(static_cast<uint16_t>(width));
+    writer.write_short(static_cast<uint16_t>(height));
+    writer.write_long(0);
+    writer.write_long(0);
+    writer.write_long(static_cast<uint32_t>(image.size()));
+    for (auto i = 0; i < 34; ++i) {
+        writer.write_byte(0);
+    }
+    writer.write_short(static_cast<uint16_t>(depth));
+    writer.write_signed_short(clut ? 0 : -1);
+    writer.write_data(extra.data());
+    writer.write_bytes(image);
+    return writer.data();
+}
+
+static auto write_pixel(std::vector<uint8_t>& out, const qd::color& color, int depth, uint8_t index) -> void
+{
+    switch (depth) {
+        case 16: {
+            auto value = color.rgb555();
+            out.push_back(static_cast<uint8_t>(value >> 8));
+            out.push_back(static_cast<uint8_t>(value));
+            break;
+        }
+        case 24: {
+            out.insert(out.end(), { color.red_component(), color.green_component(), color.blue_component() });
+            break;
+        }
+        case 32: {
+            out.insert(out.end(), { color.alpha_component(), color.red_component(), color.green_component(), color.blue_component() });
+            break;
+        }
+        default: {
+            out.push_back(index);
+            break;
+        }
+    }
+}
+
+/**
+ * Encode the Apple Animation ('rle ') image data for the image. At 8 bits per pixel the codec works in
+ * groups of 4 pixels, so the width must be a multiple of 4.
+ */
+static auto encode_qt_animation(int width, int height, int depth, const std::vector<uint8_t>& indices, const std::vector<qd::color>& palette) -> std::vector<uint8_t>
+{
+    auto unit = depth == 8 ? 4 : 1;
+    std::vector<uint8_t> out { 0, 0, 0, 0, 0, 0 };
+
+    for (auto y = 0; y < height; ++y) {
+        out.push_back(1); // skip count
+        auto row = &indices[y * width];
+        auto x = 0;
+        while (x < width) {
+            // Count the run of identical units starting at x.
+            auto run = 1;
+            while (x + (run + 1) * unit <= width && run < 128 &&
+                   std::equal(row + x, row + x + unit, row + x + run * unit)) {
+                ++run;
+            }
+
+            if (run >= 2) {
+                out.push_back(static_cast<uint8_t>(-run));
+                for (auto i = 0; i < unit; ++i) {
+                    write_pixel(out, palette[row[x + i]], depth, row[x + i]);
+                }
+                x += run * unit;
+            }
+            else {
+                auto count = std::min(127, (width - x) / unit);
+                out.push_back(static_cast<uint8_t>(count));
+                for (auto i = 0; i < count * unit; ++i) {
+                    write_pixel(out, palette[row[x + i]], depth, row[x + i]);
+                }
+                x += count * unit;
+            }
+        }
+        out.push_back(0xFF); // next line
+    }
+    out.push_back(0); // end of data
+
+    auto size = static_cast<uint32_t>(out.size());
+    out[0] = static_cast<uint8_t>(size >> 24);
+    out[1] = static_cast<uint8_t>(size >> 16);
+    out[2] = static_cast<uint8_t>(size >> 8);
+    out[3] = static_cast<uint8_t>(size);
+    return out;
+}
+
+/**
+ * Encode planar ('8BPS') image data, either raw (version 0) or with packbits compressed rows (version 1).
+ */
+static auto encode_qt_planar(int width, int height, int depth, bool packed, const std::vector<uint8_t>& indices,
+                             const std::vector<qd::color>& palette, uint16_t& channel_count) -> std::vector<uint8_t>
+{
+    channel_count = depth == 8 ? 1 : 3;
+    std::vector<std::vector<uint8_t>> rows;
+    for (auto c = 0; c < channel_count; ++c) {
+        for (auto y = 0; y < height; ++y) {
+            std::vector<uint8_t> row(static_cast<std::size_t>(width));
+            for (auto x = 0; x < width; ++x) {
+                auto index = indices[y * width + x];
+                const auto& color = palette[index];
+                row[x] = depth == 8 ? index : (c == 0 ? color.red_component() : c == 1 ? color.green_component() : color.blue_component());
+            }
+            rows.emplace_back(packed ? qd::packbits::encode(row) : row);
+        }
+    }
+
+    std::vector<uint8_t> out;
+    if (packed) {
+        for (const auto& row : rows) {
+            out.push_back(static_cast<uint8_t>(row.size() >> 8));
+            out.push_back(static_cast<uint8_t>(row.size()));
+        }
+    }
+    for (const auto& row : rows) {
+        out.insert(out.end(), row.begin(), row.end());
+    }
+    return out;
+}
+
+static auto make_clut(const std::vector<qd::color>& palette) -> std::shared_ptr<qd::clut>
+{
+    auto clut = std::make_shared<qd::clut>();
+    for (const auto& color : palette) {
+        clut->set(color);
+    }
+    return clut;
+}
+
+// MARK: - Benchmarks
+
+struct image_case
+{
+    int width;
+    int height;
+    double compressibility;
+};
+
+static auto record(bench::report& report, const std::string& codec, int depth, const image_case& image, const char *operation,
+                   const bench::measurement& m, double pixels, double bytes) -> void
+{
+    auto mps = (pixels / 1e6) / (m.median_ns / 1e9);
+    report.begin_result()
+        .set("codec", codec)
+        .set("depth", depth)
+        .set("width", image.width)
+        .set("height", image.height)
+        .set("compressibility", image.compressibility)
+        .set("operation", operation)
+        .set(m)
+        .set("encoded_bytes", bytes)
+        .set("megapixels_per_sec", mps);
+
+    std::cerr << codec << " " << depth << "bpp " << image.width << "x" << image.height << " c=" << image.compressibility
+              << " " << operation << ": " << mps << " MP/s" << std::endl;
+}
+
+static auto run_quickdraw(bench::report& report, const image_case& image, int rle_frames, bench::random& rng) -> void
+{
+    auto pixels = static_cast<double>(image.width * image.height);
+
+    // PICT, 16-bit and 24-bit direct pixels.
+    {
+        auto palette = make_palette(4096, rng);
+        auto indices = make_indices(image.width, image.height, 256, image.compressibility, rng);
+        auto surface = make_surface(image.width, image.height, indices, palette);
+        for (auto rgb555 : { true, false }) {
+            auto depth = rgb555 ? 16 : 24;
+            qd::pict_encode_options direct;
+            direct.pixel_layout = qd::pict_encode_options::layout::direct;
+            direct.rgb555 = rgb555;
+            std::shared_ptr<data::data> encoded;
+            auto encode = bench::measure([&] { encoded = qd::pict(surface).data(direct); });
+            record(report, "pict", depth, image, "encode", encode, pixels, static_cast<double>(encoded->size()));
+            auto parallel_encode = direct;
+            parallel_encode.parallel = true;
+            auto encode_parallel = bench::measure([&] { encoded = qd::pict(surface).data(parallel_encode); });
+            record(report, "pict", depth, image, "encode_parallel", encode_parallel, pixels, static_cast<double>(encoded->size()));
+            auto decode = bench::measure([&] { qd::pict picture(encoded); });
+            record(report, "pict", depth, image, "decode", decode, pixels, static_cast<double>(encoded->size()));
+
+            qd::pict_decode_options parallel;
+            parallel.parallel = true;
+            auto parallel_decode = bench::measure([&] { qd::pict picture(encoded, 0, "", parallel); });
+            record(report, "pict", depth, image, "decode_parallel", parallel_decode, pixels, static_cast<double>(encoded->size()));
+
+            auto stream = bench::measure([&] { qd::pict::stream(encoded, qd::pixel_format::rgba8888, [] (const qd::scanline&) {}); });
+            record(report, "pict", depth, image, "stream", stream, pixels, static_cast<double>(encoded->size()));
+
+            std::vector<uint8_t> staging(image.width * image.height * sizeof(qd::color));
+            qd::pixel_buffer buffer;
+            buffer.data = staging.data();
+            buffer.stride = image.width * sizeof(qd::color);
+            buffer.width = image.width;
+            buffer.height = image.height;
+            auto decode_into = bench::measure([&] { qd::pict::decode_into(encoded, buffer); });
+            record(report, "pict", depth, image, "decode_into", decode_into, pixels, static_cast<double>(encoded->size()));
+
+            auto probe = bench::measure([&] { qd::pict::probe(encoded); });
+            record(report, "pict", depth, image, "probe", probe, pixels, static_cast<double>(encoded->size()));
+        }
+
+        // The image has at most 256 colors, so the automatic layout stores it as indexed pixels.
+        std::shared_ptr<data::data> indexed;
+        auto encode = bench::measure([&] { indexed = qd::pict(surface).data(qd::pict_encode_options()); });
+        auto depth = static_cast<int>(qd::pict(indexed).format());
+        record(report, "pict", depth, image, "encode_auto", encode, pixels, static_cast<double>(indexed->size()));
+        auto decode = bench::measure([&] { qd::pict picture(indexed); });
+        record(report, "pict", depth, image, "decode", decode, pixels, static_cast<double>(indexed->size()));
+
+        // Pictures drawn with QuickDraw primitives, such as interface elements, are rasterized as they are decoded.
+        auto vector = make_vector_pict(image.width, image.height, 64, rng);
+        auto decode_vector = bench::measure([&] { qd::pict picture(vector); });
+        record(report, "pict", 0, image, "decode_vector", decode_vector, pixels, static_cast<double>(vector->size()));
+    }
+
+    // rlëD, 16-bit sprites.
+    {
+        auto palette = make_palette(256, rng);
+        qd::rle sprite(qd::size(static_cast<int16_t>(image.width), static_cast<int16_t>(image.height)), static_cast<uint16_t>(rle_frames));
+        for (auto f = 0; f < rle_frames; ++f) {
+            auto indices = make_indices(image.width, image.height, 256, image.compressibility, rng);
+            auto frame = make_surface(image.width, image.height, indices, palette);
+            sprite.write_frame(f, frame);
+        }
+        std::shared_ptr<data::data> encoded;
+        auto encode = bench::measure([&] { encoded = sprite.data(); });
+        record(report, "rle", 16, image, "encode", encode, pixels * rle_frames, static_cast<double>(encoded->size()));
+        qd::rle_encode_options parallel_encode;
+        parallel_encode.parallel = true;
+        auto encode_parallel = bench::measure([&] { encoded = sprite.data(parallel_encode); });
+        record(report, "rle", 16, image, "encode_parallel", encode_parallel, pixels * rle_frames, static_cast<double>(encoded->size()));
+        auto decode = bench::measure([&] { qd::rle decoded(encoded); });
+        record(report, "rle", 16, image, "decode", decode, pixels * rle_frames, static_cast<double>(encoded->size()));
+        qd::rle_decode_options parallel_decode;
+        parallel_decode.parallel = true;
+        auto decode_parallel = bench::measure([&] { qd::rle decoded(encoded, 0, "", parallel_decode); });
+        record(report, "rle", 16, image, "decode_parallel", decode_parallel, pixels * rle_frames, static_cast<double>(encoded->size()));
+
+        // Atlas decoding trims each frame to its opaque pixels, so also report the memory held by each layout.
+        qd::rle_decode_options atlas_decode;
+        atlas_decode.atlas = true;
+        auto decode_atlas = bench::measure([&] { qd::rle decoded(encoded, 0, "", atlas_decode); });
+        record(report, "rle", 16, image, "decode_atlas", decode_atlas, pixels * rle_frames, static_cast<double>(encoded->size()));
+        report.set("decoded_bytes", static_cast<double>(qd::rle(encoded, 0, "", atlas_decode).surface().lock()->decoded_bytes()));
+        report.set("grid_decoded_bytes", static_cast<double>(qd::rle(encoded).surface().lock()->decoded_bytes()));
+
+        auto probe = bench::measure([&] { qd::rle::probe(encoded); });
+        record(report, "rle", 16, image, "probe", probe, pixels * rle_frames, static_cast<double>(encoded->size()));
+
+        // Lazily decoded sprites only locate their frames up front, and then decode a single frame on request.
+        qd::rle_decode_options lazy;
+        lazy.lazy = true;
+        auto lazy_decode = bench::measure([&] { qd::rle decoded(encoded, 0, "", lazy); });
+        record(report, "rle", 16, image, "decode_lazy", lazy_decode, pixels * rle_frames, static_cast<double>(encoded->size()));
+        auto lazy_frame = bench::measure([&] {
+            qd::rle decoded(encoded, 0, "", lazy);
+            auto frame = decoded.frame_surface(rle_frames - 1);
+        });
+        record(report, "rle", 16, image, "decode_lazy_frame", lazy_frame, pixels, static_cast<double>(encoded->size()));
+
+        qd::rle decoded(encoded);
+        auto frames = bench::measure([&] {
+            for (auto f = 0; f < rle_frames; ++f) {
+                auto frame = decoded.frame_surface(f);
+            }
+        });
+        record(report, "rle", 16, image, "frame_surface", frames, pixels * rle_frames, static_cast<double>(encoded->size()));
+        volatile std::size_t view_strides = 0;
+        auto views = bench::measure([&] {
+            for (auto f = 0; f < rle_frames; ++f) {
+                view_strides = view_strides + decoded.frame_view(f).stride();
+            }
+        });
+        record(report, "rle", 16, image, "frame_view", views, pixels * rle_frames, static_cast<double>(encoded->size()));
+    }
+
+    // rlëD, 8-bit sprites, which are decoded to palette indices.
+    {
+        auto palette = make_palette(256, rng);
+        auto clut = make_clut(palette);
+        qd::rle sprite(qd::size(static_cast<int16_t>(image.width), static_cast<int16_t>(image.height)), static_cast<uint16_t>(rle_frames), 0, clut);
+        for (auto f = 0; f < rle_frames; ++f) {
+            auto indices = make_indices(image.width, image.height, 256, image.compressibility, rng);
+            auto frame = make_surface(image.width, image.height, indices, palette);
+            sprite.write_frame(f, frame);
+        }
+        std::shared_ptr<data::data> encoded;
+        auto encode = bench::measure([&] { encoded = sprite.data(); });
+        record(report, "rle", 8, image, "encode", encode, pixels * rle_frames, static_cast<double>(encoded->size()));
+        qd::rle_decode_options options;
+        options.palette = clut;
+        auto decode = bench::measure([&] { qd::rle decoded(encoded, 0, "", options); });
+        record(report, "rle", 8, image, "decode", decode, pixels * rle_frames, static_cast<double>(encoded->size()));
+        report.set("decoded_bytes", static_cast<double>(qd::rle(encoded, 0, "", options).indexed_surface().lock()->decoded_bytes()));
+        auto expand = bench::measure([&] {
+            qd::rle decoded(encoded, 0, "", options);
+            auto surface = decoded.surface().lock();
+        });
+        record(report, "rle", 8, image, "decode_expand", expand, pixels * rle_frames, static_cast<double>(encoded->size()));
+    }
+
+    // cicn and ppat, indexed at 1, 2, 4 and 8 bits.
+    for (auto depth : { 1, 2, 4, 8 }) {
+        auto palette = make_palette(std::size_t(1) << depth, rng);
+        auto indices = make_indices(image.width, image.height, palette.size(), image.compressibility, rng);
+        auto surface = make_surface(image.width, image.height, indices, palette);
+
+        std::shared_ptr<data::data> encoded;
+        auto cicn_encode = bench::measure([&] { encoded = qd::cicn(surface).data(); });
+        record(report, "cicn", depth, image, "encode", cicn_encode, pixels, static_cast<double>(encoded->size()));
+        auto cicn_decode = bench::measure([&] { qd::cicn icon(encoded); });
+        record(report, "cicn", depth, image, "decode", cicn_decode, pixels, static_cast<double>(encoded->size()));
+        report.set("decoded_bytes", static_cast<double>(qd::cicn(encoded).indexed_surface().lock()->decoded_bytes()));
+        auto cicn_expand = bench::measure([&] {
+            qd::cicn icon(encoded);
+            auto surface = icon.surface().lock();
+        });
+        record(report, "cicn", depth, image, "decode_expand", cicn_expand, pixels, static_cast<double>(encoded->size()));
+
+        auto ppat_encode = bench::measure([&] { encoded = qd::ppat(surface).data(); });
+        record(report, "ppat", depth, image, "encode", ppat_encode, pixels, static_cast<double>(encoded->size()));
+        auto ppat_decode = bench::measure([&] { qd::ppat pattern(encoded); });
+        record(report, "ppat", depth, image, "decode", ppat_decode, pixels, static_cast<double>(encoded->size()));
+        report.set("decoded_bytes", static_cast<double>(qd::ppat(encoded).indexed_surface().lock()->decoded_bytes()));
+        auto ppat_expand = bench::measure([&] {
+            qd::ppat pattern(encoded);
+            auto surface = pattern.surface().lock();
+        });
+        record(report, "ppat", depth, image, "decode_expand", ppat_expand, pixels, static_cast<double>(encoded->size()));
+
+        // A resource build encoding many icons and patterns at once.
+        std::vector<qd::image_batch::entry> entries(16);
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            entries[i].format = (i % 2) ? qd::image_batch::format::ppat : qd::image_batch::format::cicn;
+            entries[i].id = static_cast<int64_t>(128 + i);
+            entries[i].surface = surface;
+        }
+        std::size_t batch_size = 0;
+        auto batch_encode = bench::measure([&] {
+            batch_size = 0;
+            for (const auto& data : qd::image_batch::encode(entries)) {
+                batch_size += data->size();
+            }
+        });
+        record(report, "batch", depth, image, "encode_parallel", batch_encode, pixels * entries.size(), static_cast<double>(batch_size));
+    }
+}
+
+static auto run_quicktime(bench::report& report, const image_case& image, bench::random& rng) -> void
+{
+    auto pixels = static_cast<double>(image.width * image.height);
+    auto palette = make_palette(256, rng);
+    auto clut = make_clut(palette);
+    auto indices = make_indices(image.width, image.height, palette.size(), image.compressibility, rng);
+
+    auto bench_decode = [&] (const std::string& codec, int depth, const std::shared_ptr<data::data>& desc) {
+        // Check that the hand built image data decodes to the source image before timing it.
+        data::reader check_reader(desc);
+        auto surface = qt::imagedesc(check_reader).surface();
+        for (auto i = 0; i < image.width * image.height; ++i) {
+            auto expected = depth == 16 ? qd::color(palette[indices[i]].rgb555()) : palette[indices[i]];
+            if (!(surface->at(i % image.width, i / image.width) == expected)) {
+                std::cerr << "warning: " << codec << " " << depth << "bpp image did not decode to the source image" << std::endl;
+                break;
+            }
+        }
+
+        auto decode = bench::measure([&] {
+            data::reader reader(desc);
+            qt::imagedesc decoded(reader);
+        });
+        record(report, codec, depth, image, "decode", decode, pixels, static_cast<double>(desc->size()));
+
+        // Check that streaming delivers the same rows as the surface before timing it.
+        data::reader stream_reader(desc);
+        auto streamed_rows = 0;
+        auto error = qt::imagedesc::stream(stream_reader, qd::pixel_format::rgba8888, [&] (const qd::scanline& row) {
+            if (row.y == streamed_rows && std::memcmp(row.pixels, surface->row(row.y), row.width * sizeof(qd::color)) == 0) {
+                ++streamed_rows;
+            }
+        });
+        if (error || streamed_rows != image.height) {
+            std::cerr << "warning: " << codec << " " << depth << "bpp image did not stream the decoded rows" << std::endl;
+        }
+
+        auto stream = bench::measure([&] {
+            data::reader reader(desc);
+            qt::imagedesc::stream(reader, qd::pixel_format::rgba8888, [] (const qd::scanline&) {});
+        });
+        record(report, codec, depth, image, "stream", stream, pixels, static_cast<double>(desc->size()));
+
+        std::vector<uint8_t> staging(image.width * image.height * sizeof(qd::color));
+        qd::pixel_buffer buffer;
+        buffer.data = staging.data();
+        buffer.stride = image.width * sizeof(qd::color);
+        buffer.width = image.width;
+        buffer.height = image.height;
+        auto decode_into = bench::measure([&] {
+            data::reader reader(desc);
+            qt::imagedesc::decode_into(reader, buffer);
+        });
+        if (std::memcmp(staging.data(), surface->row(0), staging.size()) != 0) {
+            std::cerr << "warning: " << codec << " " << depth << "bpp image did not decode into the pixel buffer" << std::endl;
+        }
+        record(report, codec, depth, image, "decode_into", decode_into, pixels, static_cast<double>(desc->size()));
+    };
+
+    // Apple Animation. The 8-bit variant works in groups of 4 pixels, so is only run for suitable widths.
+    for (auto depth : { 8, 16, 24, 32 }) {
+        if (depth == 8 && image.width % 4 != 0) {
+            continue;
+        }
+        auto data = encode_qt_animation(image.width, image.height, depth, indices, palette);
+        bench_decode("qt_rle", depth, make_imagedesc(type_code("rle "), 0, image.width, image.height, depth, depth == 8 ? clut : nullptr, 0, data));
+    }
+
+    // Planar, raw and packbits compressed.
+    for (auto depth : { 8, 24 }) {
+        for (auto packed : { false, true }) {
+            uint16_t channel_count = 0;
+            auto data = encode_qt_planar(image.width, image.height, depth, packed, indices, palette, channel_count);
+            auto desc = make_imagedesc(type_code("8BPS"), packed ? 1 : 0, image.width, image.height, depth, depth == 8 ? clut : nullptr, channel_count, data);
+            bench_decode(packed ? "qt_8bps_packbits" : "qt_8bps", depth, desc);
+        }
+    }
+
+    // Raw 8-bit indexed.
+    {
+        auto desc = make_imagedesc(type_code("raw "), 0, image.width, image.height, 8, clut, 0, indices);
+        bench_decode("qt_raw", 8, desc);
+    }
+}
+
+// MARK: - Main
+
+int main(int argc, const char **argv)
+{
+    bench::options options(argc, argv);
+    if (options.has("help")) {
+        std::cout << "usage: GraphiteCodecBench [--sizes=WxH,...] [--compressibility=PERCENT,...] [--rle-frames=N]\n"
+                  << "                          [--seed=N] [--codecs=quickdraw,quicktime] [--output=PATH]\n";
+        return 0;
+    }
+
+    std::vector<std::pair<int, int>> sizes;
+    std::stringstream size_list(options.string("sizes", "64x64,640x480"));
+    std::string size;
+    while (std::getline(size_list, size, ',')) {
+        auto x = size.find('x');
+        if (x == std::string::npos) {
+            std::cerr << "invalid size: " << size << std::endl;
+            return 1;
+        }
+        sizes.emplace_back(std::stoi(size.substr(0, x)), std::stoi(size.substr(x + 1)));
+    }
+
+    auto compressibility = options.list("compressibility", { 0, 50, 90 });
+    auto rle_frames = static_cast<int>(std::clamp<int64_t>(options.integer("rle-frames", 6), 1, 256));
+    auto seed = static_cast<uint64_t>(options.integer("seed", 1));
+    auto codecs = options.string("codecs", "quickdraw,quicktime");
+
+    bench::report report("codecs");
+    report.config("seed", static_cast<double>(seed));
+    report.config("rle_frames", rle_frames);
+    report.config("codecs", codecs);
+    report.config("pixel_conversion", graphite::qd::pixel_conversion::implementation());
+
+    for (const auto& dimensions : sizes) {
+        for (auto percent : compressibility) {
+            image_case image { dimensions.first, dimensions.second, std::clamp(static_cast<double>(percent) / 100.0, 0.0, 1.0) };
+            bench::random rng(seed);
+            if (codecs.find("quickdraw") != std::string::npos) {
+                run_quickdraw(report, image, rle_frames, rng);
+            }
+            if (codecs.find("quicktime") != std::string::npos) {
+                run_quicktime(report, image, rng);
+            }
+        }
+    }
+
+    auto output = options.string("output", "");
+    if (output.empty()) {
+        report.write(std::cout);
+    }
+    else {
+        std::ofstream out(output);
+        report.write(out);
+    }
+    return 0;
+}
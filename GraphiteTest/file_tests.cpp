@@ -0,0 +1,59 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "GraphiteTest/tests.hpp"
+#include "libGraphite/rsrc/file.hpp"
+#include "libGraphite/data/writer.hpp"
+
+auto graphite::test::file_try_read_truncated() -> bool
+{
+    auto source = std::make_shared<graphite::rsrc::file>();
+    for (auto id = 128; id < 160; ++id) {
+        auto writer = std::make_shared<graphite::data::writer>();
+        writer->write_cstr("Resource " + std::to_string(id));
+        source->add_resource("test", id, "test resource", writer->data());
+    }
+    source->write("try_read.cdat", graphite::rsrc::file::format::extended);
+
+    // Keep the first half of the file, which loses the resource map.
+    std::ifstream in("try_read.cdat", std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream("try_read_truncated.cdat", std::ios::binary).write(bytes.data(), static_cast<std::streamsize>(bytes.size() / 2));
+
+    auto passed = true;
+    try {
+        auto rf = std::make_shared<graphite::rsrc::file>();
+        passed &= expect(!rf->try_read("try_read.cdat"), "try_read reads a complete file");
+        passed &= expect(rf->types().size() == 1, "try_read finds the resource type of a complete file");
+
+        auto error = rf->try_read("try_read_truncated.cdat");
+        passed &= expect(static_cast<bool>(error), "try_read reports a truncated file");
+        passed &= expect(rf->path() == "try_read.cdat", "try_read keeps the path after a failed read");
+        passed &= expect(rf->types().size() == 1, "try_read keeps the resources after a failed read");
+        passed &= expect(static_cast<bool>(rf->try_read("try_read_missing.cdat")), "try_read reports a missing file");
+    }
+    catch (const std::exception& e) {
+        passed = expect(false, std::string("try_read threw: ") + e.what());
+    }
+    return passed;
+}
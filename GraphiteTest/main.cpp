@@ -20,6 +20,7 @@
 
 #include "libGraphite/rsrc/file.hpp"
 #include "libGraphite/data/writer.hpp"
+#include "GraphiteTest/tests.hpp"
 #include <iostream>
 
 int main(int argc, char const *argv[])
@@ -46,5 +47,10 @@ int main(int argc, char const *argv[])
     for (const auto& type : in_rf->types()) {
         std::cout << "reading type: " << type->code() << type->attributes_string() << std::endl;
     }
-	return 0;
+
+    auto passed = true;
+    passed &= graphite::test::file_try_read_truncated();
+    passed &= graphite::test::rle_parallel_decode();
+    passed &= graphite::test::pict_data_baseline();
+	return passed ? 0 : 1;
 }
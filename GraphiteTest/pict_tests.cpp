@@ -0,0 +1,88 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <vector>
+#include "GraphiteTest/tests.hpp"
+#include "libGraphite/data/reader.hpp"
+#include "libGraphite/quickdraw/pict.hpp"
+
+namespace
+{
+    /**
+     * A 6x4 image whose left half is a single color and whose right half is a gradient, so that its rows contain
+     * both repeated and literal runs of packed bytes.
+     */
+    auto make_surface() -> std::shared_ptr<graphite::qd::surface>
+    {
+        auto surface = std::make_shared<graphite::qd::surface>(6, 4);
+        for (auto y = 0; y < 4; ++y) {
+            for (auto x = 0; x < 6; ++x) {
+                surface->set(x, y, x < 3 ? graphite::qd::color(200, 100, 50) : graphite::qd::color(x * 40, y * 60, (x + y) * 20));
+            }
+        }
+        return surface;
+    }
+
+    auto bytes(const std::shared_ptr<graphite::data::data>& data) -> std::vector<uint8_t>
+    {
+        graphite::data::reader reader(data);
+        auto contents = reader.read_bytes(data->size());
+        return std::vector<uint8_t>(contents.begin(), contents.end());
+    }
+}
+
+auto graphite::test::pict_data_baseline() -> bool
+{
+    // The output of `pict::data` before encoding layouts were introduced, with 32-bit and 16-bit direct pixels.
+    const std::vector<uint8_t> direct {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x06, 0x00, 0x11, 0x02, 0xff, 0x0c, 0x00,
+        0xff, 0xfe, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x04, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x04, 0x00, 0x06, 0x00, 0x9a, 0x00, 0x00, 0x00, 0xff, 0x80, 0x18, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x04, 0x00, 0x06, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00,
+        0x00, 0x48, 0x00, 0x00, 0x00, 0x10, 0x00, 0x20, 0x00, 0x03, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x06,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x06, 0x00, 0x00, 0x10, 0xfe, 0xc8, 0x02, 0x78, 0xa0,
+        0xc8, 0xfe, 0x64, 0xfe, 0x00, 0xfe, 0x32, 0x02, 0x3c, 0x50, 0x64, 0x10, 0xfe, 0xc8, 0x02, 0x78,
+        0xa0, 0xc8, 0xfe, 0x64, 0xfe, 0x3c, 0xfe, 0x32, 0x02, 0x50, 0x64, 0x78, 0x10, 0xfe, 0xc8, 0x02,
+        0x78, 0xa0, 0xc8, 0xfe, 0x64, 0xfe, 0x78, 0xfe, 0x32, 0x02, 0x64, 0x78, 0x8c, 0x10, 0xfe, 0xc8,
+        0x02, 0x78, 0xa0, 0xc8, 0xfe, 0x64, 0xfe, 0xb4, 0xfe, 0x32, 0x02, 0x78, 0x8c, 0xa0, 0x00, 0xff
+    };
+    const std::vector<uint8_t> rgb555 {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x06, 0x00, 0x11, 0x02, 0xff, 0x0c, 0x00,
+        0xff, 0xfe, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x04, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x04, 0x00, 0x06, 0x00, 0x9a, 0x00, 0x00, 0x00, 0xff, 0x80, 0x0c, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x04, 0x00, 0x06, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00,
+        0x00, 0x48, 0x00, 0x00, 0x00, 0x10, 0x00, 0x10, 0x00, 0x03, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x06,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x06, 0x00, 0x00, 0x0a, 0xfe, 0x65, 0x86, 0x02, 0x3c,
+        0x07, 0x50, 0x0a, 0x64, 0x0c, 0x0a, 0xfe, 0x65, 0x86, 0x02, 0x3c, 0xea, 0x50, 0xec, 0x64, 0xef,
+        0x0a, 0xfe, 0x65, 0x86, 0x02, 0x3d, 0xec, 0x51, 0xef, 0x65, 0xf1, 0x0a, 0xfe, 0x65, 0x86, 0x02,
+        0x3e, 0xcf, 0x52, 0xd1, 0x66, 0xd4, 0x00, 0xff
+    };
+
+    auto passed = true;
+    passed &= expect(bytes(graphite::qd::pict::from_surface(make_surface())->data()) == direct,
+                     "pict::data encodes 32-bit direct pixels as it always has");
+    passed &= expect(bytes(graphite::qd::pict::from_surface(make_surface())->data(true)) == rgb555,
+                     "pict::data encodes 16-bit direct pixels as it always has");
+    return passed;
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "GraphiteTest/tests.hpp"
+#include "libGraphite/concurrency/thread_pool.hpp"
+#include "libGraphite/quickdraw/rle.hpp"
+
+namespace
+{
+    auto same_surface(const graphite::qd::surface& a, const graphite::qd::surface& b) -> bool
+    {
+        if (a.size().width() != b.size().width() || a.size().height() != b.size().height()) {
+            return false;
+        }
+        for (auto y = 0; y < a.size().height(); ++y) {
+            for (auto x = 0; x < a.size().width(); ++x) {
+                if (!(a.at(x, y) == b.at(x, y))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    auto same_indices(const graphite::qd::indexed_surface& a, const graphite::qd::indexed_surface& b) -> bool
+    {
+        if (a.size().width() != b.size().width() || a.size().height() != b.size().height()) {
+            return false;
+        }
+        for (auto y = 0; y < a.size().height(); ++y) {
+            for (auto x = 0; x < a.size().width(); ++x) {
+                if (a.opaque(x, y) != b.opaque(x, y) || (a.opaque(x, y) && a.index(x, y) != b.index(x, y))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Encode a sprite whose frames are broken up by diagonal lines of transparent pixels, so that the opacity of
+     * adjacent frames changes within the bytes of the sprite mask that they share.
+     */
+    auto make_sprite(int depth, const graphite::qd::size& frame_size, uint16_t frame_count, const std::shared_ptr<graphite::qd::clut>& palette) -> std::shared_ptr<graphite::data::data>
+    {
+        auto sprite = depth == 8
+            ? std::make_shared<graphite::qd::rle>(frame_size, frame_count, 128, palette)
+            : std::make_shared<graphite::qd::rle>(frame_size, frame_count);
+        for (auto frame = 0; frame < frame_count; ++frame) {
+            auto surface = std::make_shared<graphite::qd::surface>(frame_size.width(), frame_size.height());
+            for (auto y = 0; y < frame_size.height(); ++y) {
+                for (auto x = 0; x < frame_size.width(); ++x) {
+                    if ((x + y + frame) % 3 != 0) {
+                        surface->set(x, y, palette->at((x + y * 3 + frame * 11) & 0xFF));
+                    }
+                }
+            }
+            sprite->write_frame(frame, surface);
+        }
+        return sprite->data();
+    }
+}
+
+auto graphite::test::rle_parallel_decode() -> bool
+{
+    graphite::concurrency::thread_pool pool(4);
+    auto palette = std::make_shared<graphite::qd::clut>();
+    for (auto i = 0; i < 256; ++i) {
+        palette->set(graphite::qd::color(i, 255 - i, (i * 7) & 0xFF));
+    }
+
+    graphite::qd::rle_decode_options options;
+    options.palette = palette;
+    auto parallel = options;
+    parallel.parallel = true;
+    parallel.pool = &pool;
+
+    // Neither frame width starts each frame on a byte of the mask, and 12 frames of either size are enough pixels
+    // to decode in parallel. Frames 5 pixels wide share bytes of the mask with the frames on both sides.
+    auto passed = true;
+    for (auto frame_size : { graphite::qd::size(121, 72), graphite::qd::size(5, 1100) }) {
+        for (auto depth : { 8, 16 }) {
+            auto data = make_sprite(depth, frame_size, 12, palette);
+            graphite::qd::rle sequential(data, 0, "", options);
+            auto label = std::to_string(depth) + "-bit " + std::to_string(frame_size.width()) + " pixel wide rlëD";
+
+            // Decode repeatedly, as frames that race on shared bytes only differ some of the time.
+            for (auto attempt = 0; attempt < 8; ++attempt) {
+                graphite::qd::rle decoded(data, 0, "", parallel);
+                if (depth == 8) {
+                    passed &= expect(same_indices(*sequential.indexed_surface().lock(), *decoded.indexed_surface().lock()),
+                                     label + " parallel decode matches the sequential indices");
+                }
+                passed &= expect(same_surface(*sequential.surface().lock(), *decoded.surface().lock()),
+                                 label + " parallel decode matches the sequential surface");
+            }
+        }
+    }
+    return passed;
+}
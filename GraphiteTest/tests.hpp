@@ -0,0 +1,60 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#if !defined(GRAPHITE_TEST_TESTS_HPP)
+#define GRAPHITE_TEST_TESTS_HPP
+
+#include <iostream>
+#include <string>
+
+namespace graphite::test {
+
+    /**
+     * Report a failed check to the standard error stream. Returns whether the check passed, so that a test can
+     * combine the results of its checks.
+     */
+    inline auto expect(bool condition, const std::string& description) -> bool
+    {
+        if (!condition) {
+            std::cerr << "FAILED: " << description << std::endl;
+        }
+        return condition;
+    }
+
+    /**
+     * Read a resource file that has been cut short, which must be reported as an error without throwing and
+     * without changing the file that was read into.
+     */
+    auto file_try_read_truncated() -> bool;
+
+    /**
+     * Decode 8 and 16-bit rlëD sprites, whose frame width is not a multiple of 8, both in parallel and sequentially,
+     * which must produce identical frames.
+     */
+    auto rle_parallel_decode() -> bool;
+
+    /**
+     * Encode a picture through the legacy `pict::data` overload, whose output must not change byte for byte.
+     */
+    auto pict_data_baseline() -> bool;
+
+}
+
+#endif //GRAPHITE_TEST_TESTS_HPP
@@ -0,0 +1,154 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include "libGraphite/concurrency/thread_pool.hpp"
+
+// MARK: - Construction
+
+graphite::concurrency::thread_pool::thread_pool(std::size_t worker_count)
+{
+    m_workers.reserve(worker_count);
+    for (std::size_t i = 0; i < worker_count; ++i) {
+        m_workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+graphite::concurrency::thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+auto graphite::concurrency::thread_pool::default_worker_count() -> std::size_t
+{
+    auto hardware_threads = static_cast<std::size_t>(std::thread::hardware_concurrency());
+    return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+auto graphite::concurrency::thread_pool::shared_pool() -> thread_pool&
+{
+    static thread_pool pool;
+    return pool;
+}
+
+// MARK: - Accessors
+
+auto graphite::concurrency::thread_pool::concurrency() const -> std::size_t
+{
+    return m_workers.size() + 1;
+}
+
+// MARK: - Scheduling
+
+auto graphite::concurrency::thread_pool::worker_loop() -> void
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+auto graphite::concurrency::thread_pool::submit(std::function<void()> task) -> void
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_tasks.emplace_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+auto graphite::concurrency::thread_pool::parallel_for(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body) -> void
+{
+    grain = std::max<std::size_t>(grain, 1);
+    auto bands = (count + grain - 1) / grain;
+    auto helpers = std::min(bands > 0 ? bands - 1 : 0, m_workers.size());
+    if (helpers == 0) {
+        if (count > 0) {
+            body(0, count);
+        }
+        return;
+    }
+
+    // Bands are claimed from a shared counter, so helpers that only start once every band has been claimed
+    // simply return. The state is shared with the helpers as they may outlive this call.
+    struct band_state
+    {
+        std::atomic<std::size_t> next { 0 };
+        std::atomic<std::size_t> remaining { 0 };
+        std::mutex lock;
+        std::condition_variable finished;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<band_state>();
+    state->remaining = bands;
+
+    auto run_bands = [state, count, grain, bands, &body] {
+        for (;;) {
+            auto band = state->next.fetch_add(1);
+            if (band >= bands) {
+                return;
+            }
+            try {
+                body(band * grain, std::min(count, (band + 1) * grain));
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(state->lock);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+            if (state->remaining.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(state->lock);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    for (std::size_t i = 0; i < helpers; ++i) {
+        submit(run_bands);
+    }
+    run_bands();
+
+    std::unique_lock<std::mutex> lock(state->lock);
+    state->finished.wait(lock, [&state] { return state->remaining == 0; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_CONCURRENCY_THREAD_POOL_HPP)
+#define GRAPHITE_CONCURRENCY_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace graphite::concurrency {
+
+    /**
+     * The `graphite::concurrency::thread_pool` class owns a fixed set of worker threads that are used to run
+     * independent pieces of decoding work, such as bands of image rows, in parallel.
+     */
+    class thread_pool
+    {
+    private:
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_lock;
+        std::condition_variable m_condition;
+        bool m_stopping { false };
+
+        auto worker_loop() -> void;
+
+    public:
+        /**
+         * Construct a new thread pool.
+         * @param worker_count  The number of worker threads to create. Threads calling `parallel_for` also take
+         *                      part in the work, so a pool with no workers runs everything on the calling thread.
+         */
+        explicit thread_pool(std::size_t worker_count = default_worker_count());
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        auto operator=(const thread_pool&) -> thread_pool& = delete;
+
+        /**
+         * The number of workers used by default: one fewer than the number of hardware threads.
+         */
+        static auto default_worker_count() -> std::size_t;
+
+        /**
+         * Returns the pool shared by Graphite's parallel decoders.
+         */
+        static auto shared_pool() -> thread_pool&;
+
+        /**
+         * Returns the number of threads that can take part in a `parallel_for`, including the caller.
+         */
+        [[nodiscard]] auto concurrency() const -> std::size_t;
+
+        /**
+         * Queue a task to be run by one of the worker threads.
+         */
+        auto submit(std::function<void()> task) -> void;
+
+        /**
+         * Split the range [0, count) into bands of `grain` items and call `body(begin, end)` for each band,
+         * spreading the bands across the workers and the calling thread. Returns once every band has completed.
+         * If any band throws, the first exception is rethrown on the calling thread.
+         */
+        auto parallel_for(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body) -> void;
+    };
+
+}
+
+#endif //GRAPHITE_CONCURRENCY_THREAD_POOL_HPP
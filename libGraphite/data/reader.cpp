@@ -21,6 +21,7 @@
 #include "libGraphite/data/reader.hpp"
 #include "libGraphite/data/data.hpp"
 #include "libGraphite/encoding/macroman/macroman.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
@@ -121,6 +122,40 @@ auto graphite::data::reader::move(int64_t delta) -> void
     m_pos += delta;
 }
 
+auto graphite::data::reader::set_throws(bool throws) -> void
+{
+    m_throws = throws;
+}
+
+auto graphite::data::reader::throws() const -> bool
+{
+    return m_throws;
+}
+
+auto graphite::data::reader::truncated() const -> bool
+{
+    return m_truncated;
+}
+
+auto graphite::data::reader::truncated_position() const -> uint64_t
+{
+    return m_truncated_pos;
+}
+
+auto graphite::data::reader::in_bounds(int64_t offset, uint64_t size) -> bool
+{
+    // A throwing reader leaves the bounds check to the underlying data, which throws when the bytes are read.
+    auto start = static_cast<int64_t>(m_pos) + offset;
+    if (m_throws || (start >= 0 && static_cast<uint64_t>(start) + size <= m_data->size())) {
+        return true;
+    }
+    if (!m_truncated) {
+        m_truncated = true;
+        m_truncated_pos = m_pos;
+    }
+    return false;
+}
+
 auto graphite::data::reader::save_position() -> void
 {
     m_pos_stack.push_back(m_pos);
@@ -149,6 +184,13 @@ auto graphite::data::reader::read_integer(int64_t offset, graphite::data::reader
     if (m_data->get() == nullptr) {
         throw std::runtime_error("Invalid data being read from.");
     }
+
+    if (!in_bounds(offset, size)) {
+        if (mode == graphite::data::reader::mode::advance) {
+            move(offset + size);
+        }
+        return 0;
+    }
     
     for (decltype(size) i = 0; i < size; ++i) {
         auto b = static_cast<uint8_t>(m_data->at(m_pos + offset + i));
@@ -222,7 +264,7 @@ auto graphite::data::reader::read_cstr(int64_t size, int64_t offset, graphite::d
         // read, and will required stepping through bytes one by one.
         auto vec = std::vector<uint8_t>(0);
         auto i = 0;
-        while (m_data->at(m_pos + offset + i)) {
+        while (in_bounds(offset + i, 1) && m_data->at(m_pos + offset + i)) {
             vec.push_back(static_cast<uint8_t>(m_data->at(m_pos + offset + i++)));
         }
         
@@ -266,6 +308,17 @@ auto graphite::data::reader::read_pstr(int64_t offset, graphite::data::reader::m
 
 auto graphite::data::reader::read_data(int64_t size, int64_t offset, graphite::data::reader::mode mode) -> std::shared_ptr<graphite::data::data>
 {
+    if (!in_bounds(offset, size)) {
+        // Only the bytes that exist are sliced.
+        auto start = std::min(static_cast<uint64_t>(std::max<int64_t>(static_cast<int64_t>(m_pos) + offset, 0)), m_data->size());
+        auto available = m_data->size() - start;
+        move(offset + size);
+        if (available == 0) {
+            return std::make_shared<graphite::data::data>();
+        }
+        return std::make_shared<graphite::data::data>(m_data->get(), available, m_data->start() + start);
+    }
+
     auto data = std::make_shared<graphite::data::data>(m_data->get(), size, m_data->start() + m_pos + offset);
     move(offset + size);
     return data;
@@ -273,6 +326,18 @@ auto graphite::data::reader::read_data(int64_t size, int64_t offset, graphite::d
 
 auto graphite::data::reader::read_bytes(int64_t size, int64_t offset, graphite::data::reader::mode mode) -> std::vector<char>
 {
+    if (!in_bounds(offset, size)) {
+        // The bytes that exist are followed by zeros, so that callers always receive as many bytes as they asked for.
+        std::vector<char> bytes(std::max<int64_t>(size, 0), 0);
+        for (int64_t i = 0; i < size && in_bounds(offset + i, 1); ++i) {
+            bytes[i] = m_data->at(m_pos + offset + i);
+        }
+        if (mode == graphite::data::reader::mode::advance) {
+            m_pos += offset + size;
+        }
+        return bytes;
+    }
+
     char *start = &(*m_data->get())[m_data->relative_offset(m_pos + offset)];
     char *end = &(*m_data->get())[m_data->relative_offset(m_pos + offset + size)];
     
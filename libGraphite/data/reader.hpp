@@ -48,6 +48,15 @@ namespace graphite::data {
         std::shared_ptr<data> m_data { nullptr };
         std::vector<uint64_t> m_pos_stack;
         uint64_t m_pos { 0 };
+        bool m_throws { true };
+        bool m_truncated { false };
+        uint64_t m_truncated_pos { 0 };
+
+        /**
+         * Check that `size` bytes starting `offset` bytes from the current position lie within the data. When
+         * they do not and the receiver is not throwing, the receiver is marked as truncated.
+         */
+        auto in_bounds(int64_t offset, uint64_t size) -> bool;
 
         template<typename T, typename std::enable_if<std::is_arithmetic<T>::value>::type* = nullptr>
         auto read_integer(int64_t offset, reader::mode mode = advance, uint64_t size = -1) -> T;
@@ -115,6 +124,28 @@ namespace graphite::data {
          */
         auto move(int64_t delta = 1) -> void;
 
+        /**
+         * Set whether reads beyond the end of the data throw `std::out_of_range`, which they do by default. When
+         * they do not, such a read produces zeros, or only the bytes that exist, and marks the receiver as
+         * truncated.
+         */
+        auto set_throws(bool throws) -> void;
+
+        /**
+         * Reports if reads beyond the end of the data throw.
+         */
+        [[nodiscard]] auto throws() const -> bool;
+
+        /**
+         * Reports if a read has gone beyond the end of the data while the receiver was not throwing.
+         */
+        [[nodiscard]] auto truncated() const -> bool;
+
+        /**
+         * Returns the position of the first read that went beyond the end of the data.
+         */
+        [[nodiscard]] auto truncated_position() const -> uint64_t;
+
         /**
          * Read a single unsigned byte from data.
          */
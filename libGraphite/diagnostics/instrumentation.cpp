@@ -0,0 +1,304 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include "libGraphite/diagnostics/instrumentation.hpp"
+
+// MARK: - Registry
+
+namespace {
+
+    struct trace_event
+    {
+        const graphite::diagnostics::probe *probe;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+    };
+
+    struct thread_trace
+    {
+        std::mutex lock;
+        std::vector<trace_event> events;
+        uint32_t tid { 0 };
+    };
+
+    struct registry
+    {
+        std::mutex lock;
+        std::map<std::string, std::unique_ptr<graphite::diagnostics::probe>> probes;
+        std::vector<std::shared_ptr<thread_trace>> threads;
+        std::atomic<bool> trace_enabled { true };
+        std::chrono::steady_clock::time_point epoch { std::chrono::steady_clock::now() };
+    };
+
+    auto shared_registry() -> registry&
+    {
+        static registry instance;
+        return instance;
+    }
+
+    auto local_trace() -> thread_trace&
+    {
+        thread_local std::shared_ptr<thread_trace> trace = [] {
+            auto& reg = shared_registry();
+            auto trace = std::make_shared<thread_trace>();
+            std::lock_guard<std::mutex> guard(reg.lock);
+            trace->tid = static_cast<uint32_t>(reg.threads.size() + 1);
+            reg.threads.emplace_back(trace);
+            return trace;
+        }();
+        return *trace;
+    }
+
+    auto latency_bucket(uint64_t duration_ns) -> std::size_t
+    {
+        std::size_t bucket = 0;
+        while (duration_ns > 1 && bucket < graphite::diagnostics::latency_bucket_count - 1) {
+            duration_ns >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    auto escape_json(const std::string& str) -> std::string
+    {
+        std::string out;
+        out.reserve(str.size());
+        for (auto c : str) {
+            if (c == '"' || c == '\\') {
+                out.push_back('\\');
+                out.push_back(c);
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                out.push_back(' ');
+            }
+            else {
+                out.push_back(c);
+            }
+        }
+        return out;
+    }
+
+}
+
+// MARK: - Probe
+
+graphite::diagnostics::probe::probe(std::string name)
+    : m_name(std::move(name))
+{
+
+}
+
+auto graphite::diagnostics::probe::named(const std::string &name) -> probe&
+{
+    auto& reg = shared_registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    auto it = reg.probes.find(name);
+    if (it == reg.probes.end()) {
+        it = reg.probes.emplace(name, std::make_unique<probe>(name)).first;
+    }
+    return *it->second;
+}
+
+auto graphite::diagnostics::probe::name() const -> const std::string&
+{
+    return m_name;
+}
+
+auto graphite::diagnostics::probe::record_call(uint64_t duration_ns) -> void
+{
+    m_calls.fetch_add(1, std::memory_order_relaxed);
+    m_total_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+    m_latency_histogram[latency_bucket(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+
+    auto min = m_min_ns.load(std::memory_order_relaxed);
+    while (duration_ns < min && !m_min_ns.compare_exchange_weak(min, duration_ns, std::memory_order_relaxed));
+    auto max = m_max_ns.load(std::memory_order_relaxed);
+    while (duration_ns > max && !m_max_ns.compare_exchange_weak(max, duration_ns, std::memory_order_relaxed));
+}
+
+auto graphite::diagnostics::probe::record_bytes(uint64_t bytes) -> void
+{
+    m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+auto graphite::diagnostics::probe::record_hit() -> void
+{
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+}
+
+auto graphite::diagnostics::probe::record_miss() -> void
+{
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+}
+
+// MARK: - Scoped Timer
+
+graphite::diagnostics::scoped_timer::scoped_timer(probe &probe)
+    : m_probe(probe), m_start(std::chrono::steady_clock::now())
+{
+
+}
+
+graphite::diagnostics::scoped_timer::~scoped_timer()
+{
+    auto end = std::chrono::steady_clock::now();
+    auto duration_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start).count());
+    m_probe.record_call(duration_ns);
+
+    auto& reg = shared_registry();
+    if (reg.trace_enabled.load(std::memory_order_relaxed)) {
+        auto start_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(m_start - reg.epoch).count());
+        auto& trace = local_trace();
+        std::lock_guard<std::mutex> guard(trace.lock);
+        if (trace.events.size() < trace_event_limit) {
+            trace.events.push_back({ &m_probe, start_ns, duration_ns });
+        }
+    }
+}
+
+auto graphite::diagnostics::scoped_timer::add_bytes(uint64_t bytes) -> void
+{
+    m_probe.record_bytes(bytes);
+}
+
+// MARK: - Statistics
+
+auto graphite::diagnostics::probe_stats::percentile_ns(double percentile) const -> uint64_t
+{
+    uint64_t total = 0;
+    for (auto count : latency_histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    auto target = static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 1.0) * static_cast<double>(total)));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < latency_bucket_count; ++i) {
+        seen += latency_histogram[i];
+        if (seen >= target && seen > 0) {
+            return std::min(uint64_t(2) << i, max_ns);
+        }
+    }
+    return max_ns;
+}
+
+auto graphite::diagnostics::snapshot() -> std::vector<probe_stats>
+{
+    auto& reg = shared_registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+
+    std::vector<probe_stats> stats;
+    stats.reserve(reg.probes.size());
+    for (const auto& it : reg.probes) {
+        const auto& p = *it.second;
+        probe_stats s;
+        s.name = p.m_name;
+        s.calls = p.m_calls.load(std::memory_order_relaxed);
+        s.bytes = p.m_bytes.load(std::memory_order_relaxed);
+        s.hits = p.m_hits.load(std::memory_order_relaxed);
+        s.misses = p.m_misses.load(std::memory_order_relaxed);
+        s.total_ns = p.m_total_ns.load(std::memory_order_relaxed);
+        s.min_ns = s.calls > 0 ? p.m_min_ns.load(std::memory_order_relaxed) : 0;
+        s.max_ns = p.m_max_ns.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < latency_bucket_count; ++i) {
+            s.latency_histogram[i] = p.m_latency_histogram[i].load(std::memory_order_relaxed);
+        }
+        stats.emplace_back(std::move(s));
+    }
+    return stats;
+}
+
+auto graphite::diagnostics::reset() -> void
+{
+    auto& reg = shared_registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+
+    for (auto& it : reg.probes) {
+        auto& p = *it.second;
+        p.m_calls = 0;
+        p.m_bytes = 0;
+        p.m_hits = 0;
+        p.m_misses = 0;
+        p.m_total_ns = 0;
+        p.m_min_ns = UINT64_MAX;
+        p.m_max_ns = 0;
+        for (auto& bucket : p.m_latency_histogram) {
+            bucket = 0;
+        }
+    }
+
+    for (auto& trace : reg.threads) {
+        std::lock_guard<std::mutex> trace_guard(trace->lock);
+        trace->events.clear();
+    }
+}
+
+// MARK: - Trace Export
+
+auto graphite::diagnostics::set_trace_enabled(bool enabled) -> void
+{
+    shared_registry().trace_enabled = enabled;
+}
+
+auto graphite::diagnostics::chrome_trace_json() -> std::string
+{
+    auto& reg = shared_registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+
+    std::ostringstream json;
+    json.setf(std::ios::fixed);
+    json.precision(3);
+    json << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    auto first = true;
+    for (auto& trace : reg.threads) {
+        std::lock_guard<std::mutex> trace_guard(trace->lock);
+        for (const auto& event : trace->events) {
+            json << (first ? "" : ",") << "\n"
+                 << "{\"name\":\"" << escape_json(event.probe->name()) << "\",\"cat\":\"graphite\",\"ph\":\"X\""
+                 << ",\"ts\":" << static_cast<double>(event.start_ns) / 1000.0
+                 << ",\"dur\":" << static_cast<double>(event.duration_ns) / 1000.0
+                 << ",\"pid\":1,\"tid\":" << trace->tid << "}";
+            first = false;
+        }
+    }
+
+    json << "\n]}\n";
+    return json.str();
+}
+
+auto graphite::diagnostics::write_chrome_trace(const std::string &path) -> void
+{
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open trace file for writing: " + path);
+    }
+    out << chrome_trace_json();
+}
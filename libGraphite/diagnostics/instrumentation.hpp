@@ -0,0 +1,192 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#if !defined(GRAPHITE_DIAGNOSTICS_INSTRUMENTATION_HPP)
+#define GRAPHITE_DIAGNOSTICS_INSTRUMENTATION_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if !defined(GRAPHITE_INSTRUMENTATION)
+#   define GRAPHITE_INSTRUMENTATION 0
+#endif
+
+namespace graphite::diagnostics {
+
+    /**
+     * Reports if instrumentation was compiled into the library. When it was not, the probes below expand to
+     * nothing and the snapshot and trace APIs always return empty results.
+     */
+    constexpr auto enabled() -> bool { return GRAPHITE_INSTRUMENTATION != 0; }
+
+    /**
+     * The number of latency buckets recorded for each probe. Bucket `n` counts calls that took between 2^n and
+     * 2^(n+1) nanoseconds, with the final bucket also counting anything slower.
+     */
+    constexpr std::size_t latency_bucket_count = 40;
+
+    /**
+     * A point in time copy of the statistics recorded against a single named probe.
+     */
+    struct probe_stats
+    {
+    public:
+        std::string name;
+        uint64_t calls { 0 };
+        uint64_t bytes { 0 };
+        uint64_t hits { 0 };
+        uint64_t misses { 0 };
+        uint64_t total_ns { 0 };
+        uint64_t min_ns { 0 };
+        uint64_t max_ns { 0 };
+        std::array<uint64_t, latency_bucket_count> latency_histogram {};
+
+        /**
+         * Estimate the latency at the given percentile (0.0 - 1.0) from the histogram. The result is the upper
+         * bound of the bucket containing the percentile.
+         */
+        [[nodiscard]] auto percentile_ns(double percentile) const -> uint64_t;
+    };
+
+    /**
+     * A probe is a named set of counters. Probes are created on first use and live for the lifetime of the
+     * process, so call sites hold on to a reference rather than looking them up each time.
+     */
+    class probe
+    {
+    private:
+        std::string m_name;
+        std::atomic<uint64_t> m_calls { 0 };
+        std::atomic<uint64_t> m_bytes { 0 };
+        std::atomic<uint64_t> m_hits { 0 };
+        std::atomic<uint64_t> m_misses { 0 };
+        std::atomic<uint64_t> m_total_ns { 0 };
+        std::atomic<uint64_t> m_min_ns { UINT64_MAX };
+        std::atomic<uint64_t> m_max_ns { 0 };
+        std::array<std::atomic<uint64_t>, latency_bucket_count> m_latency_histogram {};
+
+        friend auto snapshot() -> std::vector<probe_stats>;
+        friend auto reset() -> void;
+
+    public:
+        explicit probe(std::string name);
+
+        /**
+         * Returns the probe with the specified name, creating it if required.
+         */
+        static auto named(const std::string& name) -> probe&;
+
+        [[nodiscard]] auto name() const -> const std::string&;
+
+        auto record_call(uint64_t duration_ns) -> void;
+        auto record_bytes(uint64_t bytes) -> void;
+        auto record_hit() -> void;
+        auto record_miss() -> void;
+    };
+
+    /**
+     * Times the enclosing scope against a probe, and emits a trace event for it when it ends.
+     */
+    class scoped_timer
+    {
+    private:
+        probe& m_probe;
+        std::chrono::steady_clock::time_point m_start;
+
+    public:
+        explicit scoped_timer(probe& probe);
+        ~scoped_timer();
+
+        scoped_timer(const scoped_timer&) = delete;
+        scoped_timer& operator=(const scoped_timer&) = delete;
+
+        auto add_bytes(uint64_t bytes) -> void;
+    };
+
+    /**
+     * Take a copy of the statistics of every probe that has been used, sorted by name.
+     */
+    auto snapshot() -> std::vector<probe_stats>;
+
+    /**
+     * Reset the statistics of every probe, and discard any recorded trace events.
+     */
+    auto reset() -> void;
+
+    /**
+     * Enable or disable the recording of trace events. Statistics are recorded regardless. Trace events are
+     * recorded by default, up to `trace_event_limit` events per thread, after which further events are dropped.
+     */
+    auto set_trace_enabled(bool enabled) -> void;
+    constexpr std::size_t trace_event_limit = 1 << 20;
+
+    /**
+     * Produce the recorded trace events in the Chrome trace-event JSON format, suitable for loading into
+     * chrome://tracing, Perfetto or Speedscope.
+     */
+    auto chrome_trace_json() -> std::string;
+
+    /**
+     * Write the recorded trace events to the specified path in the Chrome trace-event JSON format.
+     */
+    auto write_chrome_trace(const std::string& path) -> void;
+
+}
+
+#define GRAPHITE_DIAGNOSTICS_CONCAT_(a, b) a##b
+#define GRAPHITE_DIAGNOSTICS_CONCAT(a, b) GRAPHITE_DIAGNOSTICS_CONCAT_(a, b)
+
+#if GRAPHITE_INSTRUMENTATION
+    /**
+     * Time the remainder of the enclosing scope against the named probe. Only one may appear per scope.
+     */
+#   define GRAPHITE_TRACE_SCOPE(name) \
+        static auto& graphite_trace_probe_ = graphite::diagnostics::probe::named(name); \
+        graphite::diagnostics::scoped_timer graphite_trace_scope_(graphite_trace_probe_)
+
+    /**
+     * Add to the number of bytes processed by the probe of the enclosing GRAPHITE_TRACE_SCOPE.
+     */
+#   define GRAPHITE_TRACE_BYTES(count) \
+        graphite_trace_scope_.add_bytes(static_cast<uint64_t>(count))
+
+    /**
+     * Record a cache hit or miss against the named probe.
+     */
+#   define GRAPHITE_TRACE_HIT(name) do { \
+        static auto& GRAPHITE_DIAGNOSTICS_CONCAT(graphite_trace_hit_, __LINE__) = graphite::diagnostics::probe::named(name); \
+        GRAPHITE_DIAGNOSTICS_CONCAT(graphite_trace_hit_, __LINE__).record_hit(); \
+    } while (0)
+#   define GRAPHITE_TRACE_MISS(name) do { \
+        static auto& GRAPHITE_DIAGNOSTICS_CONCAT(graphite_trace_miss_, __LINE__) = graphite::diagnostics::probe::named(name); \
+        GRAPHITE_DIAGNOSTICS_CONCAT(graphite_trace_miss_, __LINE__).record_miss(); \
+    } while (0)
+#else
+#   define GRAPHITE_TRACE_SCOPE(name) ((void)0)
+#   define GRAPHITE_TRACE_BYTES(count) ((void)0)
+#   define GRAPHITE_TRACE_HIT(name) ((void)0)
+#   define GRAPHITE_TRACE_MISS(name) ((void)0)
+#endif
+
+#endif //GRAPHITE_DIAGNOSTICS_INSTRUMENTATION_HPP
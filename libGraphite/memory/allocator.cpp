@@ -0,0 +1,178 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "libGraphite/memory/allocator.hpp"
+
+// MARK: - State
+
+namespace {
+
+    struct category_counters
+    {
+        std::atomic<uint64_t> current_bytes { 0 };
+        std::atomic<uint64_t> peak_bytes { 0 };
+        std::atomic<uint64_t> allocations { 0 };
+        std::atomic<uint64_t> live_allocations { 0 };
+    };
+
+    auto default_allocate(std::size_t bytes, graphite::memory::category, void *) -> void *
+    {
+        return ::operator new(bytes);
+    }
+
+    auto default_deallocate(void *ptr, std::size_t, graphite::memory::category, void *) -> void
+    {
+        ::operator delete(ptr);
+    }
+
+    const graphite::memory::allocator_hooks default_hooks { default_allocate, default_deallocate, nullptr };
+
+    struct state
+    {
+        // Allocations read the installed hooks without locking. Every set of hooks that has been installed is
+        // kept, so that a snapshot remains valid for as long as an allocation may be using it.
+        std::atomic<const graphite::memory::allocator_hooks *> hooks { &default_hooks };
+        std::mutex installed_lock;
+        std::vector<std::unique_ptr<graphite::memory::allocator_hooks>> installed;
+        category_counters counters[graphite::memory::category_count];
+
+        // The usage of every category combined, so that the combined peak is a real high-water mark rather than
+        // the sum of peaks reached at different times.
+        std::atomic<uint64_t> total_bytes { 0 };
+        std::atomic<uint64_t> total_peak_bytes { 0 };
+    };
+
+    auto record_peak(std::atomic<uint64_t>& peak_bytes, uint64_t current) -> void
+    {
+        auto peak = peak_bytes.load(std::memory_order_relaxed);
+        while (current > peak && !peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+    }
+
+    auto shared_state() -> state&
+    {
+        static state instance;
+        return instance;
+    }
+
+    auto snapshot_hooks() -> const graphite::memory::allocator_hooks&
+    {
+        return *shared_state().hooks.load(std::memory_order_acquire);
+    }
+
+}
+
+// MARK: - Hooks
+
+auto graphite::memory::set_allocator_hooks(const allocator_hooks &hooks) -> void
+{
+    auto& s = shared_state();
+    std::lock_guard<std::mutex> guard(s.installed_lock);
+    if (total_usage().live_allocations > 0) {
+        throw std::logic_error("Attempted to change the allocator hooks while tracked storage is allocated.");
+    }
+
+    if (hooks.allocate && hooks.deallocate) {
+        s.installed.emplace_back(std::make_unique<allocator_hooks>(hooks));
+        s.hooks.store(s.installed.back().get(), std::memory_order_release);
+    }
+    else {
+        s.hooks.store(&default_hooks, std::memory_order_release);
+    }
+}
+
+auto graphite::memory::current_allocator_hooks() -> allocator_hooks
+{
+    return snapshot_hooks();
+}
+
+// MARK: - Allocation
+
+auto graphite::memory::allocate(std::size_t bytes, enum category category) -> void *
+{
+    const auto& hooks = snapshot_hooks();
+    auto ptr = hooks.allocate(bytes, category, hooks.context);
+    if (!ptr && bytes > 0) {
+        throw std::bad_alloc();
+    }
+
+    auto& s = shared_state();
+    auto& counters = s.counters[static_cast<std::size_t>(category)];
+    record_peak(counters.peak_bytes, counters.current_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    record_peak(s.total_peak_bytes, s.total_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.live_allocations.fetch_add(1, std::memory_order_relaxed);
+    return ptr;
+}
+
+auto graphite::memory::deallocate(void *ptr, std::size_t bytes, enum category category) -> void
+{
+    if (!ptr) {
+        return;
+    }
+    const auto& hooks = snapshot_hooks();
+    hooks.deallocate(ptr, bytes, category, hooks.context);
+
+    auto& s = shared_state();
+    auto& counters = s.counters[static_cast<std::size_t>(category)];
+    counters.current_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    s.total_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    counters.live_allocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// MARK: - Usage
+
+auto graphite::memory::category_usage(enum category category) -> struct usage
+{
+    const auto& counters = shared_state().counters[static_cast<std::size_t>(category)];
+    struct usage u;
+    u.current_bytes = counters.current_bytes.load(std::memory_order_relaxed);
+    u.peak_bytes = counters.peak_bytes.load(std::memory_order_relaxed);
+    u.allocations = counters.allocations.load(std::memory_order_relaxed);
+    u.live_allocations = counters.live_allocations.load(std::memory_order_relaxed);
+    return u;
+}
+
+auto graphite::memory::total_usage() -> struct usage
+{
+    struct usage total;
+    for (std::size_t i = 0; i < category_count; ++i) {
+        auto u = category_usage(static_cast<enum category>(i));
+        total.current_bytes += u.current_bytes;
+        total.allocations += u.allocations;
+        total.live_allocations += u.live_allocations;
+    }
+    total.peak_bytes = shared_state().total_peak_bytes.load(std::memory_order_relaxed);
+    return total;
+}
+
+auto graphite::memory::reset_peak_usage() -> void
+{
+    auto& s = shared_state();
+    for (auto& counters : s.counters) {
+        counters.peak_bytes = counters.current_bytes.load(std::memory_order_relaxed);
+        counters.allocations = counters.live_allocations.load(std::memory_order_relaxed);
+    }
+    s.total_peak_bytes = s.total_bytes.load(std::memory_order_relaxed);
+}
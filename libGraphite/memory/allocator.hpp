@@ -0,0 +1,136 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#if !defined(GRAPHITE_MEMORY_ALLOCATOR_HPP)
+#define GRAPHITE_MEMORY_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+namespace graphite::memory {
+
+    /**
+     * The kinds of storage that Graphite tracks allocations for.
+     */
+    enum class category : uint8_t
+    {
+        surface = 0,        // Decoded image pixels.
+        sound,              // Decoded sound samples.
+        other,
+    };
+    constexpr std::size_t category_count = 3;
+
+    /**
+     * A set of functions that Graphite will use to allocate and free tracked storage. Both functions must be
+     * provided. The context pointer is passed back to each call unchanged.
+     *
+     * Hooks can only be changed while no tracked storage is allocated, so that storage is always released through
+     * the hooks that allocated it.
+     */
+    struct allocator_hooks
+    {
+    public:
+        void *(*allocate)(std::size_t bytes, enum category category, void *context) { nullptr };
+        void (*deallocate)(void *ptr, std::size_t bytes, enum category category, void *context) { nullptr };
+        void *context { nullptr };
+    };
+
+    /**
+     * Install a custom set of allocator hooks. Passing hooks without both functions restores the default
+     * allocator, which uses the global operator new and delete. Throws `std::logic_error` if any tracked storage
+     * is still allocated.
+     */
+    auto set_allocator_hooks(const allocator_hooks& hooks) -> void;
+
+    /**
+     * Returns the allocator hooks that are currently installed.
+     */
+    auto current_allocator_hooks() -> allocator_hooks;
+
+    /**
+     * Allocate or free tracked storage through the installed hooks, updating the usage of the category.
+     */
+    auto allocate(std::size_t bytes, enum category category) -> void *;
+    auto deallocate(void *ptr, std::size_t bytes, enum category category) -> void;
+
+    /**
+     * The amount of tracked storage in use for a category.
+     */
+    struct usage
+    {
+    public:
+        uint64_t current_bytes { 0 };
+        uint64_t peak_bytes { 0 };
+        uint64_t allocations { 0 };
+        uint64_t live_allocations { 0 };
+    };
+
+    /**
+     * Returns the usage of the specified category, or of all categories combined. The combined peak is the most
+     * storage that has been in use across every category at once.
+     */
+    auto category_usage(enum category category) -> struct usage;
+    auto total_usage() -> struct usage;
+
+    /**
+     * Reset the peak and allocation counts of every category to their current values.
+     */
+    auto reset_peak_usage() -> void;
+
+    /**
+     * A standard library compatible allocator that routes storage through the Graphite allocator hooks.
+     */
+    template<typename T, enum category C>
+    class allocator
+    {
+    public:
+        typedef T value_type;
+
+        template<typename U>
+        struct rebind { typedef allocator<U, C> other; };
+
+        allocator() noexcept = default;
+        template<typename U>
+        allocator(const allocator<U, C>&) noexcept {}
+
+        auto allocate(std::size_t n) -> T *
+        {
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T *>(memory::allocate(n * sizeof(T), C));
+        }
+
+        auto deallocate(T *ptr, std::size_t n) noexcept -> void
+        {
+            memory::deallocate(ptr, n * sizeof(T), C);
+        }
+
+        template<typename U>
+        auto operator==(const allocator<U, C>&) const noexcept -> bool { return true; }
+        template<typename U>
+        auto operator!=(const allocator<U, C>&) const noexcept -> bool { return false; }
+    };
+
+}
+
+#endif //GRAPHITE_MEMORY_ALLOCATOR_HPP
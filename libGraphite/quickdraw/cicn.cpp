@@ -3,8 +3,11 @@
 //
 
 #include "libGraphite/quickdraw/cicn.hpp"
+#include "libGraphite/quickdraw/internal/quantizer.hpp"
 #include "libGraphite/rsrc/manager.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 #include <tuple>
+#include <algorithm>
 #include <stdexcept>
 
 // MARK: - Constructor
@@ -13,7 +16,15 @@ graphite::qd::cicn::cicn(std::shared_ptr<graphite::data::data> data, int64_t id,
     : m_id(id), m_name(std::move(name))
 {
     data::reader reader(std::move(data));
-    parse(reader);
+    if (auto error = parse(reader)) {
+        error.raise();
+    }
+}
+
+graphite::qd::cicn::cicn(int64_t id, std::string name)
+    : m_id(id), m_name(std::move(name))
+{
+
 }
 
 graphite::qd::cicn::cicn(std::shared_ptr<qd::surface> surface)
@@ -24,24 +35,70 @@ graphite::qd::cicn::cicn(std::shared_ptr<qd::surface> surface)
 
 auto graphite::qd::cicn::load_resource(int64_t id) -> std::shared_ptr<graphite::qd::cicn>
 {
+    GRAPHITE_TRACE_SCOPE("qd::cicn::load_resource");
     if (auto res = graphite::rsrc::manager::shared_manager().find("cicn", id).lock()) {
         return std::make_shared<graphite::qd::cicn>(res->data(), id, res->name());
     }
     return nullptr;
 }
 
+auto graphite::qd::cicn::try_parse(std::shared_ptr<graphite::data::data> data, int64_t id, std::string name) -> graphite::result<std::shared_ptr<cicn>>
+{
+    auto icon = std::shared_ptr<graphite::qd::cicn>(new graphite::qd::cicn(id, std::move(name)));
+    data::reader reader(std::move(data));
+    if (auto error = graphite::guarded_decode(reader, [&] { return icon->parse(reader); })) {
+        return error;
+    }
+    return icon;
+}
+
+auto graphite::qd::cicn::probe(std::shared_ptr<graphite::data::data> data) -> graphite::result<qd::image_info>
+{
+    GRAPHITE_TRACE_SCOPE("qd::cicn::probe");
+    qd::image_info info;
+    data::reader reader(std::move(data));
+    auto error = graphite::guarded_decode(reader, [&] {
+        if (reader.size() < qd::pixmap::length) {
+            return graphite::decode_error(graphite::error_code::truncated_data, 0, "Insufficient pixmap data in cicn.");
+        }
+        qd::pixmap pm(reader.read_data(qd::pixmap::length));
+        info.frame = pm.bounds();
+        info.depth = pm.pixel_size();
+        info.pack_type = pm.pack_type();
+        return graphite::decode_error();
+    });
+    if (error) {
+        return error;
+    }
+    return info;
+}
 
 // MARK: - Accessors
 
 auto graphite::qd::cicn::surface() const -> std::weak_ptr<graphite::qd::surface>
 {
+    if (m_indexed) {
+        return m_indexed->expanded();
+    }
     return m_surface;
 }
 
+auto graphite::qd::cicn::indexed_surface() const -> std::weak_ptr<qd::indexed_surface>
+{
+    return m_indexed;
+}
+
 // MARK: - Parser
 
-auto graphite::qd::cicn::parse(graphite::data::reader& reader) -> void
+auto graphite::qd::cicn::parse(graphite::data::reader& reader) -> graphite::decode_error
 {
+    GRAPHITE_TRACE_SCOPE("qd::cicn::decode");
+    GRAPHITE_TRACE_BYTES(reader.size());
+    
+    if (reader.position() + qd::pixmap::length > reader.size()) {
+        return graphite::decode_error(graphite::error_code::truncated_data, reader.position(),
+                                      "Insufficient pixmap data in cicn: " + std::to_string(m_id) + ", " + m_name);
+    }
     m_pixmap = graphite::qd::pixmap(reader.read_data(qd::pixmap::length));
     m_mask_base_addr = reader.read_long();
     m_mask_row_bytes = reader.read_short();
@@ -55,101 +112,49 @@ auto graphite::qd::cicn::parse(graphite::data::reader& reader) -> void
     auto mask_data_size = m_mask_row_bytes * m_mask_bounds.height();
     auto bmap_data_size = m_bmap_row_bytes * m_bmap_bounds.height();
     auto pmap_data_size = m_pixmap.row_bytes() * m_pixmap.bounds().height();
+    if (mask_data_size < 0 || bmap_data_size < 0 || pmap_data_size < 0 || m_pixmap.bounds().width() < 0) {
+        return graphite::decode_error(graphite::error_code::invalid_structure, reader.position(),
+                                      "Invalid cicn bounds: " + std::to_string(m_id) + ", " + m_name);
+    }
+    if (reader.position() + mask_data_size + bmap_data_size > reader.size()) {
+        return graphite::decode_error(graphite::error_code::truncated_data, reader.position(),
+                                      "Insufficient mask and bitmap data in cicn: " + std::to_string(m_id) + ", " + m_name);
+    }
 
-    auto mask_data = reader.read_data(mask_data_size);
+    auto mask_data = reader.read_bytes(mask_data_size);
     auto bmap_data = reader.read_data(bmap_data_size);
     m_clut = qd::clut(reader);
-    auto pmap_data = reader.read_data(pmap_data_size);
-
-    // Now that all information has been extracted from the resource, proceed and attempt to render it.
-    m_surface = std::make_shared<graphite::qd::surface>(m_pixmap.bounds().width(), m_pixmap.bounds().height());
-
-    if (m_pixmap.cmp_size() == 1 && m_pixmap.cmp_count() == 1) {
-
-        for (auto y = 0; y < m_pixmap.bounds().height(); ++y) {
-            auto y_offset = (y * m_pixmap.row_bytes());
-            auto mask_y_offset = (y * m_mask_row_bytes);
-
-            for (auto x = 0; x < m_pixmap.bounds().width(); ++x) {
-                auto byte_offset = 7 - (x % 8);
-
-                auto byte = pmap_data->at(y_offset + (x / 8));
-                auto mask = mask_data->at(mask_y_offset + (x / 8));
-                auto v = (byte >> byte_offset) & 0x1;
-
-                if ((mask >> byte_offset) & 0x1) {
-                    m_surface->set(x, y, m_clut.get(v));
-                }
-            }
-        }
-
+    if (reader.position() + pmap_data_size > reader.size()) {
+        return graphite::decode_error(graphite::error_code::truncated_data, reader.position(),
+                                      "Insufficient pixel data in cicn: " + std::to_string(m_id) + ", " + m_name);
     }
-    else if ((m_pixmap.cmp_size() == 1 && m_pixmap.cmp_count() == 2) || (m_pixmap.cmp_size() == 2 && m_pixmap.cmp_count() == 1)) {
-
-        for (auto y = 0; y < m_pixmap.bounds().height(); ++y) {
-            auto y_offset = (y * m_pixmap.row_bytes());
-            auto mask_y_offset = (y * m_mask_row_bytes);
-
-            for (auto x = 0; x < m_pixmap.bounds().width(); ++x) {
-                auto byte_offset = (3 - (x % 4)) << 1;
-                auto mask_offset = (7 - (x % 8));
-
-                auto byte = pmap_data->at(y_offset + (x / 4));
-                auto mask = mask_data->at(mask_y_offset + (x / 8));
-                auto v = (byte >> byte_offset) & 0x3;
-
-                if ((mask >> mask_offset) & 0x1) {
-                    m_surface->set(x, y, m_clut.get(v));
-                }
-            }
-        }
-
+    auto pmap_data = reader.read_bytes(pmap_data_size);
+
+    auto cmp_size = m_pixmap.cmp_size();
+    auto cmp_count = m_pixmap.cmp_count();
+    auto pixel_size = cmp_size * cmp_count;
+    if ((cmp_size != 1 && cmp_count != 1) || (pixel_size != 1 && pixel_size != 2 && pixel_size != 4 && pixel_size != 8)) {
+        return graphite::decode_error(graphite::error_code::unsupported_depth, reader.position(),
+                                      "Currently unsupported cicn configuration: cmp_size=" +
+                                      std::to_string(m_pixmap.cmp_size()) +
+                                      ", cmp_count=" + std::to_string(m_pixmap.cmp_count()));
     }
-    else if ((m_pixmap.cmp_size() == 1 && m_pixmap.cmp_count() == 4) || (m_pixmap.cmp_size() == 4 && m_pixmap.cmp_count() == 1)) {
-
-        for (auto y = 0; y < m_pixmap.bounds().height(); ++y) {
-            auto y_offset = (y * m_pixmap.row_bytes());
-            auto mask_y_offset = (y * m_mask_row_bytes);
-
-            for (auto x = 0; x < m_pixmap.bounds().width(); ++x) {
-                auto byte_offset = (1 - (x % 2)) << 2;
-                auto mask_offset = (7 - (x % 8));
-
-                auto byte = pmap_data->at(y_offset + (x / 2));
-                auto mask = mask_data->at(mask_y_offset + (x / 8));
-                auto v = (byte >> byte_offset) & 0xF;
-
-                if ((mask >> mask_offset) & 0x1) {
-                    m_surface->set(x, y, m_clut.get(v));
-                }
-            }
-        }
-
+    if (m_pixmap.bounds().width() * pixel_size > m_pixmap.row_bytes() * 8
+        || (m_pixmap.bounds().width() > 0 && m_pixmap.bounds().height() > 0
+            && (m_pixmap.bounds().width() > m_mask_row_bytes * 8 || m_pixmap.bounds().height() > m_mask_bounds.height()))) {
+        return graphite::decode_error(graphite::error_code::invalid_structure, reader.position(),
+                                      "Invalid pixmap bounds in cicn: " + std::to_string(m_id) + ", " + m_name);
     }
-    else if ((m_pixmap.cmp_size() == 1 && m_pixmap.cmp_count() == 8) || (m_pixmap.cmp_size() == 8 && m_pixmap.cmp_count() == 1)) {
-
-        for (auto y = 0; y < m_pixmap.bounds().height(); ++y) {
-            auto y_offset = (y * m_pixmap.row_bytes());
-            auto mask_y_offset = (y * m_mask_row_bytes);
-
-            for (auto x = 0; x < m_pixmap.bounds().width(); ++x) {
-                auto mask_offset = (7 - (x % 8));
-
-                auto byte = static_cast<uint8_t>(pmap_data->at(y_offset + x));
-                auto mask = mask_data->at(mask_y_offset + (x / 8));
-
-                if ((mask >> mask_offset) & 0x1) {
-                    m_surface->set(x, y, m_clut.get(byte));
-                }
-            }
-        }
 
+    // Keep the indices of the icon and its mask as they are. Colors are only expanded once the surface is requested.
+    m_indexed = m_pixmap.build_indexed_surface(std::vector<uint8_t>(pmap_data.begin(), pmap_data.end()),
+                                               std::make_shared<qd::clut>(m_clut), true);
+    auto mask_bytes = (m_indexed->size().width() + 7) / 8;
+    for (auto y = 0; y < m_indexed->size().height(); ++y) {
+        auto mask_row = mask_data.begin() + static_cast<std::size_t>(y) * m_mask_row_bytes;
+        std::copy_n(mask_row, mask_bytes, m_indexed->mask_row(y));
     }
-    else {
-        throw std::runtime_error("Currently unsupported cicn configuration: cmp_size=" +
-                                 std::to_string(m_pixmap.cmp_size()) +
-                                 ", cmp_count=" + std::to_string(m_pixmap.cmp_count()));
-    }
+    return {};
 }
 
 // MARK: - Encoder
@@ -158,46 +163,25 @@ auto graphite::qd::cicn::data() -> std::shared_ptr<graphite::data::data>
 {
     auto data = std::make_shared<graphite::data::data>();
     auto writer = graphite::data::writer(data);
-    auto width = m_surface->size().width();
-    auto height = m_surface->size().height();
-
-    // TODO: This is a brute force method of bringing down the color depth/number of colors required,
-    // for a cicn image. It doesn't optimise for image quality at all, and should be replaced at somepoint.
-    std::vector<uint16_t> color_values;
+    auto surface = this->surface().lock();
+    auto width = surface->size().width();
+    auto height = surface->size().height();
+
+    // Reduce the opaque pixels of the surface to at most 256 colors, leaving the surface itself untouched.
+    auto quantized = qd::quantizer::quantize(*surface, 256, true);
+    m_clut = std::move(quantized.clut);
+    const auto& color_values = quantized.indices;
     std::vector<bool> mask_values;
-    uint8_t pass = 0;
-    do {
-        if (pass++ > 0) {
-            for (auto y = 0; y < height; ++y) {
-                for (auto x = 0; x < width; ++x) {
-                    auto color = m_surface->at(x, y);
-                    m_surface->set(x, y, qd::color(
-                            color.red_component() & ~(1 << pass),
-                            color.green_component() & ~(1 << pass),
-                            color.blue_component() & ~(1 << pass),
-                            color.alpha_component()
-                    ));
-                }
-            }
-        }
-
-        // Rebuild the Color Table for the surface. To do this we want to create an empty table, and populate it.
-        m_clut = qd::clut();
-        color_values.clear();
-        mask_values.clear();
-        for (auto y = 0; y < height; ++y) {
-            for (auto x = 0; x < width; ++x) {
-                auto color = m_surface->at(x, y);
-                mask_values.emplace_back((color.alpha_component() & 0x80) != 0);
-                color_values.emplace_back(m_clut.set(color));
-            }
+    for (auto y = 0; y < height; ++y) {
+        for (auto x = 0; x < width; ++x) {
+            mask_values.emplace_back((surface->at(x, y).alpha_component() & 0x80) != 0);
         }
-    } while(m_clut.size() > 256);
+    }
 
 
     // Determine what component configuration we need.
     m_pixmap = qd::pixmap();
-    m_pixmap.set_bounds(qd::rect(point::zero(), m_surface->size()));
+    m_pixmap.set_bounds(qd::rect(point::zero(), surface->size()));
     graphite::data::writer mask_data(std::make_shared<graphite::data::data>());
     graphite::data::writer bmap_data(std::make_shared<graphite::data::data>());
     std::shared_ptr<graphite::data::data> pmap_data;
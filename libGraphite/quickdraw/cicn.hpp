@@ -7,9 +7,12 @@
 
 #include <string>
 #include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/internal/indexed_surface.hpp"
 #include "libGraphite/quickdraw/geometry.hpp"
 #include "libGraphite/quickdraw/pixmap.hpp"
+#include "libGraphite/quickdraw/image_info.hpp"
 #include "libGraphite/quickdraw/clut.hpp"
+#include "libGraphite/result.hpp"
 
 namespace graphite::qd {
 
@@ -27,9 +30,12 @@ namespace graphite::qd {
         qd::rect m_bmap_bounds;
         uint32_t m_icon_data{};
         std::shared_ptr<qd::surface> m_surface;
+        std::shared_ptr<qd::indexed_surface> m_indexed;
         qd::clut m_clut;
 
-        auto parse(data::reader& reader) -> void;
+        cicn(int64_t id, std::string name);
+
+        auto parse(data::reader& reader) -> graphite::decode_error;
 
     public:
         explicit cicn(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "");
@@ -37,7 +43,24 @@ namespace graphite::qd {
 
         static auto load_resource(int64_t id) -> std::shared_ptr<cicn>;
 
+        /**
+         * Parse cicn data without throwing. On failure the result describes the reason and the offset within the
+         * data at which decoding stopped.
+         */
+        static auto try_parse(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "") -> graphite::result<std::shared_ptr<cicn>>;
+
+        /**
+         * Read the pixel map of cicn data, reporting its bounds and depth without decoding any pixels.
+         */
+        static auto probe(std::shared_ptr<graphite::data::data> data) -> graphite::result<qd::image_info>;
+
         [[nodiscard]] auto surface() const -> std::weak_ptr<graphite::qd::surface>;
+
+        /**
+         * Returns the palette indices of a decoded icon, along with its mask, or null if it was constructed from
+         * a surface. The colors of a decoded icon are only expanded once `surface` is first called.
+         */
+        [[nodiscard]] auto indexed_surface() const -> std::weak_ptr<qd::indexed_surface>;
         auto data() -> std::shared_ptr<graphite::data::data>;
     };
 
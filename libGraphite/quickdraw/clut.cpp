@@ -2,10 +2,13 @@
 // Created by Tom Hancocks on 25/03/2020.
 //
 
+#include <algorithm>
 #include <limits>
 #include <stdexcept>
 #include "libGraphite/quickdraw/clut.hpp"
+#include "libGraphite/quickdraw/internal/surface.hpp"
 #include "libGraphite/rsrc/manager.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Constructors
 
@@ -25,6 +28,7 @@ graphite::qd::clut::clut(graphite::data::reader& reader)
 
 auto graphite::qd::clut::load_resource(int64_t id) -> std::shared_ptr<graphite::qd::clut>
 {
+    GRAPHITE_TRACE_SCOPE("qd::clut::load_resource");
     if (id > 32 && id <= 40) {
         // Standard grayscale tables - subtract 32 from id to get bit-depth
         auto clut = qd::clut();
@@ -34,6 +38,7 @@ auto graphite::qd::clut::load_resource(int64_t id) -> std::shared_ptr<graphite::
         for (auto v = 0; v < 256; v += step) {
             clut.m_entries.emplace_back(qd::color(v, v, v));
         }
+        clut.rebuild_index();
         return std::make_shared<graphite::qd::clut>(clut);
     }
     if (id == 4 || id == 8) {
@@ -49,6 +54,8 @@ auto graphite::qd::clut::load_resource(int64_t id) -> std::shared_ptr<graphite::
                 clut.m_entries.emplace_back(qd::color(v[0], v[1], v[2]));
             }
         }
+        clut.m_size = static_cast<uint16_t>(clut.m_entries.size());
+        clut.rebuild_index();
         return std::make_shared<graphite::qd::clut>(clut);
     }
     if (auto res = graphite::rsrc::manager::shared_manager().find("clut", id).lock()) {
@@ -76,13 +83,56 @@ auto graphite::qd::clut::get(int value) const -> graphite::qd::color
 
 auto graphite::qd::clut::set(const qd::color& color) -> uint16_t
 {
-    for (auto i = 0; i < m_size; ++i) {
-        if (m_entries[i] == color) {
-            return i;
+    auto it = m_index.try_emplace(key(color), m_size).first;
+    if (it->second == m_size) {
+        m_entries.emplace_back(color);
+        ++m_size;
+    }
+    return it->second;
+}
+
+auto graphite::qd::clut::set(const qd::surface& surface, std::size_t limit) -> std::vector<uint16_t>
+{
+    auto width = surface.size().width();
+    auto height = surface.size().height();
+    std::vector<uint16_t> indices(static_cast<std::size_t>(width) * height);
+    auto index = indices.data();
+
+    // Neighbouring pixels are often the same color, so the last match is kept to avoid looking every pixel up.
+    uint32_t last_key = 0;
+    uint16_t last_index = 0;
+    auto has_last = false;
+    for (auto y = 0; y < height; ++y) {
+        auto row = surface.row(y);
+        for (auto x = 0; x < width; ++x) {
+            auto color_key = key(row[x]);
+            if (!has_last || color_key != last_key) {
+                last_index = set(row[x]);
+                last_key = color_key;
+                has_last = true;
+                if (m_size > limit) {
+                    return {};
+                }
+            }
+            *index++ = last_index;
         }
     }
-    m_entries.emplace_back(color);
-    return m_size++;
+    return indices;
+}
+
+auto graphite::qd::clut::key(const qd::color& color) -> uint32_t
+{
+    return (static_cast<uint32_t>(color.red_component()) << 24U) | (color.green_component() << 16U)
+         | (color.blue_component() << 8U) | color.alpha_component();
+}
+
+auto graphite::qd::clut::rebuild_index() -> void
+{
+    // When a color appears more than once, the first entry holding it is the one that is found.
+    m_index.clear();
+    for (auto i = 0; i < std::min(static_cast<int>(m_size), static_cast<int>(m_entries.size())); ++i) {
+        m_index.try_emplace(key(m_entries[i]), static_cast<uint16_t>(i));
+    }
 }
 
 // MARK: - Parser
@@ -109,6 +159,10 @@ auto graphite::qd::clut::parse(graphite::data::reader& reader) -> void
             m_entries.resize(value+1, color);
         }
     }
+
+    // Any gaps in the table are now filled, so every entry up to the highest value is addressable.
+    m_size = static_cast<uint16_t>(m_entries.size());
+    rebuild_index();
 }
 
 // MARK: - Writer
@@ -5,7 +5,9 @@
 #if !defined(GRAPHITE_CLUT_HPP)
 #define GRAPHITE_CLUT_HPP
 
+#include <limits>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "libGraphite/quickdraw/internal/color.hpp"
 #include "libGraphite/data/reader.hpp"
@@ -13,6 +15,8 @@
 
 namespace graphite::qd {
 
+    class surface;
+
     struct clut
     {
     public:
@@ -26,8 +30,15 @@ namespace graphite::qd {
         enum flags m_flags { pixmap };
         uint16_t m_size { 0 };
         std::vector<qd::color> m_entries;
+        std::unordered_map<uint32_t, uint16_t> m_index;
 
         auto parse(data::reader& reader) -> void;
+        auto rebuild_index() -> void;
+
+        /**
+         * Pack the components of a color, including alpha, into a single key for the color index.
+         */
+        static auto key(const qd::color& color) -> uint32_t;
 
     public:
         clut() = default;
@@ -42,6 +53,13 @@ namespace graphite::qd {
         [[nodiscard]] auto get(int value) const -> qd::color;
         auto set(const qd::color& color) -> uint16_t;
 
+        /**
+         * Returns the index of the color of every pixel of a surface in row order, adding any colors that are not
+         * yet in the table. Returns an empty vector, leaving the colors added so far in the table, if the table
+         * would grow beyond `limit` entries.
+         */
+        auto set(const qd::surface& surface, std::size_t limit = std::numeric_limits<uint16_t>::max()) -> std::vector<uint16_t>;
+
         auto write(graphite::data::writer& writer) -> void;
 
     private:
@@ -354,7 +354,7 @@ auto graphite::qd::rect::read(graphite::data::reader& reader, enum coding_type t
     }
 }
 
-auto graphite::qd::rect::write(graphite::data::writer& writer, enum coding_type type) -> void
+auto graphite::qd::rect::write(graphite::data::writer& writer, enum coding_type type) const -> void
 {
     switch (type) {
         case coding_type::qd: {
@@ -158,7 +158,7 @@ namespace graphite::qd {
         auto set_size(const struct qd::size& size) -> void;
 
         static auto read(graphite::data::reader& reader, enum coding_type type = qd) -> qd::rect;
-        auto write(graphite::data::writer& writer, enum coding_type type = qd) -> void;
+        auto write(graphite::data::writer& writer, enum coding_type type = qd) const -> void;
     };
 
     // MARK: - Fixed Rect
@@ -0,0 +1,95 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <stdexcept>
+#include "libGraphite/quickdraw/image_batch.hpp"
+#include "libGraphite/quickdraw/cicn.hpp"
+#include "libGraphite/quickdraw/ppat.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
+
+// MARK: - Encoding
+
+auto graphite::qd::image_batch::type_code(enum format format) -> std::string
+{
+    switch (format) {
+        case format::pict: return "PICT";
+        case format::cicn: return "cicn";
+        case format::ppat: return "ppat";
+    }
+    throw std::runtime_error("Unrecognised image batch format.");
+}
+
+auto graphite::qd::image_batch::encode(const std::vector<entry>& entries, const image_batch_options& options) -> std::vector<std::shared_ptr<graphite::data::data>>
+{
+    GRAPHITE_TRACE_SCOPE("qd::image_batch::encode");
+
+    std::vector<std::shared_ptr<graphite::data::data>> encoded(entries.size());
+    auto encode_entry = [&] (std::size_t i) {
+        const auto& entry = entries[i];
+        if (!entry.surface) {
+            throw std::runtime_error("Missing surface for image batch entry: " + std::to_string(entry.id) + ", " + entry.name);
+        }
+
+        switch (entry.format) {
+            case format::pict: {
+                qd::pict picture(entry.surface);
+                encoded[i] = picture.data(options.pict);
+                break;
+            }
+            case format::cicn: {
+                qd::cicn icon(entry.surface);
+                encoded[i] = icon.data();
+                break;
+            }
+            case format::ppat: {
+                qd::ppat pattern(entry.surface);
+                encoded[i] = pattern.data();
+                break;
+            }
+        }
+    };
+
+    auto pool = options.pool ? options.pool : &graphite::concurrency::thread_pool::shared_pool();
+    if (options.parallel && entries.size() > 1 && pool->concurrency() > 1) {
+        // Images vary greatly in size, so hand them out one at a time to keep every thread busy.
+        pool->parallel_for(entries.size(), 1, [&] (std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                encode_entry(i);
+            }
+        });
+    }
+    else {
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            encode_entry(i);
+        }
+    }
+
+    return encoded;
+}
+
+auto graphite::qd::image_batch::add_resources(graphite::rsrc::file& file, const std::vector<entry>& entries, const image_batch_options& options) -> void
+{
+    auto encoded = encode(entries, options);
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const auto& entry = entries[i];
+        file.add_resource(type_code(entry.format), entry.id, entry.name, encoded[i], entry.attributes);
+    }
+}
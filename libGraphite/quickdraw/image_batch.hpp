@@ -0,0 +1,104 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QUICKDRAW_IMAGE_BATCH_HPP)
+#define GRAPHITE_QUICKDRAW_IMAGE_BATCH_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "libGraphite/data/data.hpp"
+#include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/pict.hpp"
+#include "libGraphite/rsrc/file.hpp"
+#include "libGraphite/concurrency/thread_pool.hpp"
+
+namespace graphite::qd {
+
+    /**
+     * Options that control how a batch of images is encoded.
+     */
+    struct image_batch_options
+    {
+    public:
+        /**
+         * Encode the images of the batch in parallel. The encoded data is identical to a sequential encode.
+         */
+        bool parallel { true };
+
+        /**
+         * The thread pool to encode on when encoding in parallel. The shared pool is used when this is null.
+         */
+        graphite::concurrency::thread_pool *pool { nullptr };
+
+        /**
+         * The options used for every `PICT` in the batch.
+         */
+        pict_encode_options pict;
+    };
+
+    /**
+     * The `graphite::qd::image_batch` structure encodes many surfaces as image resources at once, such as when
+     * building a resource file from a directory of images. Each image is independent of the others, so they are
+     * encoded across a thread pool. Resources are added to a file in the order of the batch, so the file written is
+     * the same however the batch was encoded.
+     */
+    struct image_batch
+    {
+    public:
+        /**
+         * The type of resource an image is encoded as.
+         */
+        enum class format { pict, cicn, ppat };
+
+        /**
+         * An image to encode, along with the resource it becomes.
+         */
+        struct entry
+        {
+            enum format format { format::pict };
+            int64_t id { 0 };
+            std::string name;
+            std::shared_ptr<qd::surface> surface;
+            std::map<std::string, std::string> attributes;
+        };
+
+        /**
+         * Returns the type code of the resources of the specified format.
+         */
+        static auto type_code(enum format format) -> std::string;
+
+        /**
+         * Encode the surface of every entry, returning the data of each in the order of the entries.
+         */
+        static auto encode(const std::vector<entry>& entries, const image_batch_options& options = {}) -> std::vector<std::shared_ptr<graphite::data::data>>;
+
+        /**
+         * Encode the surface of every entry and add each as a resource of the file, in the order of the entries.
+         */
+        static auto add_resources(graphite::rsrc::file& file, const std::vector<entry>& entries, const image_batch_options& options = {}) -> void;
+    };
+
+}
+
+#endif //GRAPHITE_QUICKDRAW_IMAGE_BATCH_HPP
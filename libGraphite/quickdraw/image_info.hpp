@@ -0,0 +1,66 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QUICKDRAW_IMAGE_INFO_HPP)
+#define GRAPHITE_QUICKDRAW_IMAGE_INFO_HPP
+
+#include <cstdint>
+#include "libGraphite/quickdraw/geometry.hpp"
+#include "libGraphite/quickdraw/pixmap.hpp"
+
+namespace graphite::qd {
+
+    /**
+     * The `graphite::qd::image_info` structure describes an image resource, as reported by the `probe` functions
+     * of the image types. Probing reads only the header of the resource and never decodes any pixel data.
+     */
+    struct image_info
+    {
+    public:
+        /**
+         * The frame of the image. For sprite sheets this is the frame of a single sprite.
+         */
+        qd::rect frame { qd::rect::zero() };
+
+        /**
+         * The color depth of the image in bits, matching the value reported by `pict::format()` for QuickDraw data.
+         */
+        int16_t depth { 0 };
+
+        /**
+         * The pack type declared by the pixel map of the image, where one exists.
+         */
+        enum qd::pack_type pack_type { qd::none };
+
+        /**
+         * The QuickTime compressor of the image, such as 'rle ' or '8BPS', or zero for QuickDraw pixel data.
+         */
+        uint32_t compressor { 0 };
+
+        /**
+         * The number of frames in the image.
+         */
+        int frame_count { 1 };
+    };
+
+}
+
+#endif //GRAPHITE_QUICKDRAW_IMAGE_INFO_HPP
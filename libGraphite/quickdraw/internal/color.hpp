@@ -28,14 +28,29 @@ namespace graphite::qd {
          * @param green     The green component of the color
          * @param blue      The blue component of the color
          * @param alpha     The alpha component of the color
+         *
+         * @note            Defined inline as colors are constructed per pixel by every decoder.
          */
-        color(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255);
+        color(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255)
+            : m_red(red), m_green(green), m_blue(blue), m_alpha(alpha)
+        {
+        }
         
         /**
          * Construct a new color from a 16-bit rgb555 value.
          * @param rgb555    The full 16-bit color value
          */
-        color(uint16_t rgb555);
+        color(uint16_t rgb555)
+            : m_red(static_cast<uint8_t>((rgb555 & 0x7c00) >> 7)),
+              m_green(static_cast<uint8_t>((rgb555 & 0x03e0) >> 2)),
+              m_blue(static_cast<uint8_t>((rgb555 & 0x001f) << 3)),
+              m_alpha(255)
+        {
+            // Copy the upper 3 bits to the empty lower 3 bits
+            m_red |= m_red >> 5;
+            m_green |= m_green >> 5;
+            m_blue |= m_blue >> 5;
+        }
 
         [[nodiscard]] auto red_component() const -> uint8_t;
         [[nodiscard]] auto green_component() const -> uint8_t;
@@ -0,0 +1,242 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "libGraphite/quickdraw/internal/indexed_surface.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
+
+// MARK: - Constructor
+
+graphite::qd::indexed_surface::indexed_surface(int width, int height, std::shared_ptr<qd::clut> palette, bool masked, int depth)
+    : m_width(width), m_height(height), m_depth(depth), m_row_bytes((width * depth + 7) / 8),
+      m_mask_stride(masked ? (width + 7) / 8 : 0),
+      m_indices(static_cast<std::size_t>(m_row_bytes) * height, 0),
+      m_mask(static_cast<std::size_t>(m_mask_stride) * height, 0),
+      m_palette(std::move(palette))
+{
+    if (depth != 1 && depth != 2 && depth != 4 && depth != 8) {
+        throw std::runtime_error("Unsupported indexed surface depth: " + std::to_string(depth));
+    }
+}
+
+// MARK: - Accessors
+
+auto graphite::qd::indexed_surface::size() const -> graphite::qd::size
+{
+    return graphite::qd::size(m_width, m_height);
+}
+
+auto graphite::qd::indexed_surface::depth() const -> int
+{
+    return m_depth;
+}
+
+auto graphite::qd::indexed_surface::row_bytes() const -> int
+{
+    return m_row_bytes;
+}
+
+auto graphite::qd::indexed_surface::palette() const -> std::shared_ptr<qd::clut>
+{
+    return m_palette;
+}
+
+auto graphite::qd::indexed_surface::masked() const -> bool
+{
+    return m_mask_stride > 0;
+}
+
+auto graphite::qd::indexed_surface::decoded_bytes() const -> std::size_t
+{
+    return m_indices.capacity() + m_mask.capacity();
+}
+
+auto graphite::qd::indexed_surface::row(int y) -> uint8_t *
+{
+    return m_indices.data() + (static_cast<std::size_t>(y) * m_row_bytes);
+}
+
+auto graphite::qd::indexed_surface::row(int y) const -> const uint8_t *
+{
+    return m_indices.data() + (static_cast<std::size_t>(y) * m_row_bytes);
+}
+
+auto graphite::qd::indexed_surface::mask_row(int y) -> uint8_t *
+{
+    return masked() ? m_mask.data() + (static_cast<std::size_t>(y) * m_mask_stride) : nullptr;
+}
+
+auto graphite::qd::indexed_surface::mask_row(int y) const -> const uint8_t *
+{
+    return masked() ? m_mask.data() + (static_cast<std::size_t>(y) * m_mask_stride) : nullptr;
+}
+
+// MARK: - Pixel Access
+
+auto graphite::qd::indexed_surface::index(int x, int y) const -> uint8_t
+{
+    if (m_depth == 8) {
+        return row(y)[x];
+    }
+    auto bit = x * m_depth;
+    return (row(y)[bit >> 3] >> (8 - m_depth - (bit & 7))) & ((1 << m_depth) - 1);
+}
+
+auto graphite::qd::indexed_surface::opaque(int x, int y) const -> bool
+{
+    auto mask = mask_row(y);
+    return !mask || (mask[x >> 3] & (0x80 >> (x & 7)));
+}
+
+auto graphite::qd::indexed_surface::at(int x, int y) const -> graphite::qd::color
+{
+    if (!opaque(x, y)) {
+        return qd::color::clear();
+    }
+    auto index = this->index(x, y);
+    if (!m_palette || index >= m_palette->size()) {
+        return qd::color::black();
+    }
+    return m_palette->at(index);
+}
+
+auto graphite::qd::indexed_surface::set(int x, int y, uint8_t index) -> void
+{
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+        throw std::runtime_error("Attempted to set pixel beyond bounds of indexed surface.");
+    }
+    if (m_depth == 8) {
+        row(y)[x] = index;
+    }
+    else {
+        auto bit = x * m_depth;
+        auto shift = 8 - m_depth - (bit & 7);
+        auto mask = ((1 << m_depth) - 1) << shift;
+        auto& byte = row(y)[bit >> 3];
+        byte = static_cast<uint8_t>((byte & ~mask) | ((index << shift) & mask));
+    }
+    set_opaque(x, y, 1);
+}
+
+auto graphite::qd::indexed_surface::set_opaque(int x, int y, int count, bool opaque) -> void
+{
+    auto mask = mask_row(y);
+    if (!mask) {
+        return;
+    }
+
+    // Update the partial bytes at either end of the run a bit at a time, and whole bytes in between.
+    auto end = x + count;
+    while (x < end && (x & 7)) {
+        mask[x >> 3] = opaque ? (mask[x >> 3] | (0x80 >> (x & 7))) : (mask[x >> 3] & ~(0x80 >> (x & 7)));
+        ++x;
+    }
+    auto whole = (end - x) >> 3;
+    std::fill_n(mask + (x >> 3), whole, opaque ? 0xFF : 0x00);
+    x += whole << 3;
+    while (x < end) {
+        mask[x >> 3] = opaque ? (mask[x >> 3] | (0x80 >> (x & 7))) : (mask[x >> 3] & ~(0x80 >> (x & 7)));
+        ++x;
+    }
+}
+
+auto graphite::qd::indexed_surface::copy_rect(const indexed_surface& source, const qd::rect& source_rect, const qd::point& destination) -> void
+{
+    if (source.m_depth != m_depth) {
+        throw std::runtime_error("Attempted to copy between indexed surfaces of different depths.");
+    }
+
+    for (auto y = 0; y < source_rect.height(); ++y) {
+        auto sy = source_rect.y() + y;
+        auto dy = destination.y() + y;
+        if (m_depth == 8) {
+            std::copy_n(source.row(sy) + source_rect.x(), source_rect.width(), row(dy) + destination.x());
+        }
+        else {
+            for (auto x = 0; x < source_rect.width(); ++x) {
+                auto bit = (destination.x() + x) * m_depth;
+                auto shift = 8 - m_depth - (bit & 7);
+                auto mask = ((1 << m_depth) - 1) << shift;
+                auto& byte = row(dy)[bit >> 3];
+                byte = static_cast<uint8_t>((byte & ~mask) | ((source.index(source_rect.x() + x, sy) << shift) & mask));
+            }
+        }
+
+        // Copy the opacity of the row a run at a time.
+        if (!masked()) {
+            continue;
+        }
+        auto x = 0;
+        while (x < source_rect.width()) {
+            auto opaque = source.opaque(source_rect.x() + x, sy);
+            auto run = 1;
+            while (x + run < source_rect.width() && source.opaque(source_rect.x() + x + run, sy) == opaque) {
+                ++run;
+            }
+            set_opaque(destination.x() + x, dy, run, opaque);
+            x += run;
+        }
+    }
+}
+
+// MARK: - Expansion
+
+auto graphite::qd::indexed_surface::expansion_table(const std::shared_ptr<qd::clut>& palette, int depth) -> std::vector<qd::color>
+{
+    std::vector<qd::color> colors;
+    auto size = palette ? std::min(palette->size(), 256) : 0;
+    for (auto i = 0; i < size; ++i) {
+        colors.emplace_back(palette->at(i));
+    }
+    return qd::pixel_conversion::index_table(colors.data(), colors.size(), depth);
+}
+
+auto graphite::qd::indexed_surface::expand(const qd::rect& rect, const qd::surface_view& destination) const -> void
+{
+    auto table = expansion_table(m_palette, m_depth);
+    for (auto y = 0; y < rect.height(); ++y) {
+        qd::pixel_conversion::indices_to_color(row(rect.y() + y), rect.x(), m_depth, table, destination.row(y), rect.width(), mask_row(rect.y() + y));
+    }
+}
+
+auto graphite::qd::indexed_surface::expand() const -> std::shared_ptr<qd::surface>
+{
+    auto surface = std::make_shared<qd::surface>(m_width, m_height);
+    expand(qd::rect(0, 0, m_width, m_height), surface->view());
+    return surface;
+}
+
+auto graphite::qd::indexed_surface::expanded() const -> std::shared_ptr<qd::surface>
+{
+    std::lock_guard<std::mutex> lock(m_expansion_lock);
+    if (!m_expansion) {
+        m_expansion = expand();
+    }
+    return m_expansion;
+}
+
+auto graphite::qd::indexed_surface::is_expanded() const -> bool
+{
+    std::lock_guard<std::mutex> lock(m_expansion_lock);
+    return m_expansion != nullptr;
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QD_INDEXED_SURFACE)
+#define GRAPHITE_QD_INDEXED_SURFACE
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <libGraphite/quickdraw/geometry.hpp>
+#include "libGraphite/quickdraw/clut.hpp"
+#include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/memory/allocator.hpp"
+
+namespace graphite::qd
+{
+
+    /**
+     * The `graphite::qd::indexed_surface` class holds an image as one palette index per pixel, along with the
+     * color table that the indices refer to, rather than expanding every pixel to a 4-byte color. Indices are
+     * packed into rows at a depth of 1, 2, 4 or 8 bits, most significant bits first, as in a QuickDraw pixel map.
+     * An optional mask records which pixels are opaque, one bit per pixel, for images that have transparency.
+     */
+    class indexed_surface
+    {
+    private:
+        typedef std::vector<uint8_t, memory::allocator<uint8_t, memory::category::surface>> byte_storage;
+
+        int m_width;
+        int m_height;
+        int m_depth;
+        int m_row_bytes;
+        int m_mask_stride;
+        byte_storage m_indices;
+        byte_storage m_mask;
+        std::shared_ptr<qd::clut> m_palette;
+        mutable std::mutex m_expansion_lock;
+        mutable std::shared_ptr<qd::surface> m_expansion;
+
+    public:
+
+        /**
+         * Construct a new indexed surface with the specified dimensions. Every index is initially zero, and
+         * every pixel of a masked surface is initially transparent.
+         * @param width     The width of the surface in pixels.
+         * @param height    The height of the surface in pixels.
+         * @param palette   The color table that the indices of the surface refer to.
+         * @param masked    Whether the surface records which pixels are opaque.
+         * @param depth     The number of bits per index, which must be 1, 2, 4 or 8.
+         */
+        indexed_surface(int width, int height, std::shared_ptr<qd::clut> palette, bool masked = false, int depth = 8);
+
+        /**
+         * Returns the size of the surface
+         */
+        [[nodiscard]] auto size() const -> qd::size;
+
+        /**
+         * Returns the number of bits per index.
+         */
+        [[nodiscard]] auto depth() const -> int;
+
+        /**
+         * Returns the number of bytes in each row of indices.
+         */
+        [[nodiscard]] auto row_bytes() const -> int;
+
+        /**
+         * Returns the color table that the indices of the surface refer to.
+         */
+        [[nodiscard]] auto palette() const -> std::shared_ptr<qd::clut>;
+
+        /**
+         * Returns whether the surface records which pixels are opaque.
+         */
+        [[nodiscard]] auto masked() const -> bool;
+
+        /**
+         * Returns the number of bytes of memory held by the indices and mask of the surface.
+         */
+        [[nodiscard]] auto decoded_bytes() const -> std::size_t;
+
+        /**
+         * Returns a pointer to the packed indices of the specified row of the surface. At a depth of 8 bits each
+         * byte holds the index of a single pixel.
+         *
+         * @note            No bounds checking is performed. The caller must ensure `y` lies within the surface.
+         */
+        [[nodiscard]] auto row(int y) -> uint8_t *;
+        [[nodiscard]] auto row(int y) const -> const uint8_t *;
+
+        /**
+         * Returns a pointer to the mask of the specified row of the surface, or null if the surface is not masked.
+         * Each byte holds the mask of 8 pixels, most significant bit first, with set bits marking opaque pixels.
+         *
+         * @note            No bounds checking is performed. The caller must ensure `y` lies within the surface.
+         */
+        [[nodiscard]] auto mask_row(int y) -> uint8_t *;
+        [[nodiscard]] auto mask_row(int y) const -> const uint8_t *;
+
+        /**
+         * Returns the palette index at the specified coordinate within the surface.
+         */
+        [[nodiscard]] auto index(int x, int y) const -> uint8_t;
+
+        /**
+         * Returns whether the pixel at the specified coordinate is opaque. Every pixel of an unmasked surface
+         * is opaque.
+         */
+        [[nodiscard]] auto opaque(int x, int y) const -> bool;
+
+        /**
+         * Returns the color at the specified coordinate within the surface, which is clear for transparent pixels.
+         *
+         * @note            This method of getting colors is _slow_. Use only for single point lookup.
+         */
+        [[nodiscard]] auto at(int x, int y) const -> graphite::qd::color;
+
+        /**
+         * Set the palette index at the specified coordinate within the surface, marking the pixel as opaque.
+         */
+        auto set(int x, int y, uint8_t index) -> void;
+
+        /**
+         * Mark a run of pixels within a row as opaque or transparent. The run must lie within the surface.
+         * @param x         The first pixel of the run.
+         * @param y         The row of the run.
+         * @param count     The number of pixels in the run.
+         * @param opaque    Whether the pixels are opaque.
+         */
+        auto set_opaque(int x, int y, int count, bool opaque = true) -> void;
+
+        /**
+         * Copy the indices and opacity of an area of another indexed surface of the same depth into this surface.
+         * @param source        The surface to copy from.
+         * @param source_rect   The area of the source surface to copy, which must lie within the source.
+         * @param destination   The position in this surface that the top left corner of the area is copied to. The
+         *                      copied area must lie within this surface.
+         */
+        auto copy_rect(const indexed_surface& source, const qd::rect& source_rect, const qd::point& destination) -> void;
+
+        /**
+         * Build a table for expanding indices of the specified depth into the colors of a palette, for use with
+         * `pixel_conversion::indices_to_color`. Indices beyond the end of the palette expand to black.
+         */
+        static auto expansion_table(const std::shared_ptr<qd::clut>& palette, int depth) -> std::vector<qd::color>;
+
+        /**
+         * Expand a rectangle of the surface into colors, writing them to a view of the same size. Transparent
+         * pixels are written as clear.
+         * @param rect          The area of the surface to expand, which must lie within the surface.
+         * @param destination   The pixels to write the colors to.
+         */
+        auto expand(const qd::rect& rect, const qd::surface_view& destination) const -> void;
+
+        /**
+         * Returns a new surface holding the colors of every pixel of this surface.
+         */
+        [[nodiscard]] auto expand() const -> std::shared_ptr<qd::surface>;
+
+        /**
+         * Returns a surface holding the colors of every pixel of this surface, which is expanded the first time
+         * it is requested and then shared by every caller. Later changes to the indices are not reflected in it.
+         */
+        [[nodiscard]] auto expanded() const -> std::shared_ptr<qd::surface>;
+
+        /**
+         * Returns whether `expanded` has been called, and so the surface holds its pixels as colors as well.
+         */
+        [[nodiscard]] auto is_expanded() const -> bool;
+    };
+
+}
+
+#endif //GRAPHITE_QD_INDEXED_SURFACE
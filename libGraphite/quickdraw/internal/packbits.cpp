@@ -2,95 +2,385 @@
 // Created by Tom Hancocks on 20/02/2020.
 //
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include "libGraphite/quickdraw/internal/packbits.hpp"
 
-auto graphite::qd::packbits::decode(std::vector<uint8_t> &out_data, const std::vector<uint8_t>& pack_data, std::size_t value_size) -> std::size_t
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#   define GRAPHITE_PACKBITS_SSE2 1
+#elif defined(__ARM_NEON)
+#   include <arm_neon.h>
+#   define GRAPHITE_PACKBITS_NEON 1
+#endif
+
+// MARK: - Vector Helpers
+
+namespace {
+
+    /**
+     * Vector helpers operate on 16 bytes at a time. Comparisons produce a mask in which each lane occupies
+     * `lane_bits` bits, so that the index of the first set lane can be found by counting trailing zeros.
+     */
+    template<typename T>
+    constexpr std::size_t lane_count = 16 / sizeof(T);
+
+#if defined(GRAPHITE_PACKBITS_SSE2)
+    template<typename T>
+    constexpr unsigned lane_bits = 1;
+
+    template<typename T>
+    constexpr uint64_t lane_mask = (1ULL << lane_count<T>) - 1;
+
+    inline auto equal_lanes(const uint8_t *lhs, const uint8_t *rhs) -> uint64_t
+    {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+    }
+
+    inline auto equal_lanes(const uint16_t *lhs, const uint16_t *rhs) -> uint64_t
+    {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16(a, b), _mm_setzero_si128())));
+    }
+
+    inline auto equal_lanes(const uint32_t *lhs, const uint32_t *rhs) -> uint64_t
+    {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs));
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))));
+    }
+
+    inline auto store_pattern(uint8_t *out, const uint8_t *pattern) -> void
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern)));
+    }
+
+    inline auto expand_short_bytes(uint8_t *out, const uint8_t *in, bool literal) -> void
+    {
+        auto select = _mm_set1_epi8(literal ? -1 : 0);
+        auto copied = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        auto repeated = _mm_set1_epi8(static_cast<char>(*in));
+        auto bytes = _mm_or_si128(_mm_and_si128(select, copied), _mm_andnot_si128(select, repeated));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+    }
+#elif defined(GRAPHITE_PACKBITS_NEON)
+    template<typename T>
+    constexpr unsigned lane_bits = sizeof(T) * 4;
+
+    template<typename T>
+    constexpr uint64_t lane_mask = ~0ULL;
+
+    inline auto equal_lanes(const uint8_t *lhs, const uint8_t *rhs) -> uint64_t
+    {
+        auto eq = vceqq_u8(vld1q_u8(lhs), vld1q_u8(rhs));
+        return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    }
+
+    inline auto equal_lanes(const uint16_t *lhs, const uint16_t *rhs) -> uint64_t
+    {
+        auto eq = vceqq_u16(vld1q_u16(lhs), vld1q_u16(rhs));
+        return vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(eq)), 0);
+    }
+
+    inline auto equal_lanes(const uint32_t *lhs, const uint32_t *rhs) -> uint64_t
+    {
+        auto eq = vceqq_u32(vld1q_u32(lhs), vld1q_u32(rhs));
+        return vget_lane_u64(vreinterpret_u64_u16(vmovn_u32(eq)), 0);
+    }
+
+    inline auto store_pattern(uint8_t *out, const uint8_t *pattern) -> void
+    {
+        vst1q_u8(out, vld1q_u8(pattern));
+    }
+
+    inline auto expand_short_bytes(uint8_t *out, const uint8_t *in, bool literal) -> void
+    {
+        auto select = vdupq_n_u8(literal ? 0xFF : 0);
+        vst1q_u8(out, vbslq_u8(select, vld1q_u8(in), vdupq_n_u8(*in)));
+    }
+#else
+    inline auto store_pattern(uint8_t *out, const uint8_t *pattern) -> void
+    {
+        std::memcpy(out, pattern, 16);
+    }
+
+    inline auto expand_short_bytes(uint8_t *out, const uint8_t *in, bool literal) -> void
+    {
+        if (literal) {
+            std::memcpy(out, in, 16);
+        }
+        else {
+            std::memset(out, *in, 16);
+        }
+    }
+#endif
+
+#if defined(GRAPHITE_PACKBITS_SSE2) || defined(GRAPHITE_PACKBITS_NEON)
+    template<typename T>
+    inline auto first_lane(uint64_t mask) -> std::size_t
+    {
+        return static_cast<std::size_t>(__builtin_ctzll(mask)) / lane_bits<T>;
+    }
+#endif
+
+    /**
+     * Find the end of a run of `replicate` starting at `offset`, searching no further than `limit`.
+     */
+    template<typename T>
+    auto find_run_end(const T *values, std::size_t offset, std::size_t limit, T replicate) -> std::size_t
+    {
+#if defined(GRAPHITE_PACKBITS_SSE2) || defined(GRAPHITE_PACKBITS_NEON)
+        T pattern[lane_count<T>];
+        for (auto& v : pattern) {
+            v = replicate;
+        }
+        while (offset + lane_count<T> <= limit) {
+            auto mismatch = ~equal_lanes(values + offset, pattern) & lane_mask<T>;
+            if (mismatch) {
+                return offset + first_lane<T>(mismatch);
+            }
+            offset += lane_count<T>;
+        }
+#endif
+        while (offset < limit && values[offset] == replicate) {
+            ++offset;
+        }
+        return offset;
+    }
+
+    /**
+     * Find the end of a literal starting at `offset`, searching no further than `limit`. A literal ends where
+     * a run begins: two equal values for wide values, or three for bytes (except at the very end of the data)
+     * as breaking a literal for a run of two bytes is generally less efficient.
+     */
+    template<typename T>
+    auto find_literal_end(const T *values, std::size_t count, std::size_t offset, std::size_t limit) -> std::size_t
+    {
+        constexpr bool bytes = sizeof(T) == 1;
+        const std::size_t max = count - 1;
+
+#if defined(GRAPHITE_PACKBITS_SSE2) || defined(GRAPHITE_PACKBITS_NEON)
+        constexpr std::size_t lookahead = bytes ? 2 : 1;
+        while (offset + lane_count<T> <= limit && offset + lane_count<T> + lookahead <= count) {
+            auto repeats = equal_lanes(values + offset, values + offset + 1);
+            if (bytes) {
+                repeats &= equal_lanes(values + offset, values + offset + 2);
+            }
+            repeats &= lane_mask<T>;
+            if (repeats) {
+                return offset + first_lane<T>(repeats);
+            }
+            offset += lane_count<T>;
+        }
+#endif
+        while (offset < limit) {
+            auto continues = (offset == max)
+                          || (offset < max && values[offset] != values[offset + 1])
+                          || (bytes && offset + 1 < max && values[offset] != values[offset + 2]);
+            if (!continues) {
+                break;
+            }
+            ++offset;
+        }
+        return offset;
+    }
+
+    template<typename T>
+    inline auto write_value(uint8_t *out, T value) -> void
+    {
+        for (int i = sizeof(T) - 1; i >= 0; --i) {
+            *out++ = static_cast<uint8_t>(value >> (i * 8));
+        }
+    }
+
+    /**
+     * Fill `size` bytes with repeated copies of a value, using 16-byte stores for 1, 2 and 4 byte values. Stores
+     * may extend beyond `size` while they remain within `capacity`.
+     */
+    inline auto fill_run(uint8_t *out, std::size_t size, std::size_t capacity, const uint8_t *value, std::size_t value_size) -> void
+    {
+        if (value_size == 1) {
+            std::memset(out, *value, (size <= 16 && capacity >= 16) ? 16 : size);
+        }
+        else if (value_size == 2 || value_size == 4) {
+            uint8_t pattern[16];
+            for (auto i = 0; i < 16; ++i) {
+                pattern[i] = value[i & (value_size - 1)];
+            }
+            auto end = out + size;
+            while (out < end && capacity >= 16) {
+                store_pattern(out, pattern);
+                out += 16;
+                capacity -= 16;
+            }
+            if (out < end) {
+                std::memcpy(out, pattern, end - out);
+            }
+        }
+        else {
+            for (auto end = out + size; out < end; out += value_size) {
+                std::memcpy(out, value, value_size);
+            }
+        }
+    }
+
+}
+
+// MARK: - Decoding
+
+auto graphite::qd::packbits::decoded_size(const uint8_t *pack_data, std::size_t pack_size, std::size_t value_size) -> std::size_t
 {
     std::size_t pos = 0;
+    std::size_t size = 0;
 
-    while (pos < pack_data.size()) {
+    while (pos < pack_size) {
+        // Literals and runs are counted without branching, as they are typically interleaved unpredictably.
         auto count = pack_data[pos++];
-        if (count < 128) {
-            // Literal run
-            uint16_t run = (1 + count) * value_size;
-            if ((pos + run) > pack_data.size()) {
-                throw std::runtime_error("Unable to decode packbits.");
+        std::size_t literal = (1 + count) * value_size;
+        std::size_t run = count == 128 ? 0 : value_size;
+        pos += count < 128 ? literal : run;
+        size += count < 128 ? literal : run * (257 - count);
+    }
+
+    if (pos > pack_size) {
+        throw std::runtime_error("Unable to decode packbits.");
+    }
+    return size;
+}
+
+auto graphite::qd::packbits::decode(uint8_t *out_data, std::size_t out_size, const uint8_t *pack_data, std::size_t pack_size, std::size_t value_size) -> std::size_t
+{
+    std::size_t pos = 0;
+    std::size_t out = 0;
+
+    while (pos < pack_size) {
+        if (value_size == 1 && pos + 17 <= pack_size && out + 16 <= out_size) {
+            // Short literals and runs of bytes are typically interleaved unpredictably. When both buffers have room,
+            // expand either with a single 16-byte store, selecting the source without branching.
+            auto count = pack_data[pos];
+            auto literal = count < 128;
+            std::size_t length = literal ? count + 1 : 257 - count;
+            if (length <= 16) {
+                expand_short_bytes(out_data + out, pack_data + pos + 1, literal);
+                pos += 1 + (literal ? length : 1);
+                out += length;
+                continue;
             }
-            out_data.insert(out_data.end(), std::make_move_iterator(pack_data.begin() + pos), std::make_move_iterator(pack_data.begin() + pos + run));
-            pos += run;
         }
-        else if (count == 128) {
+
+        auto count = pack_data[pos++];
+        if (count == 128) {
             // No-op
+            continue;
+        }
+
+        std::size_t in_bytes = value_size;
+        std::size_t out_bytes = (256 - count + 1) * value_size;
+        if (count < 128) {
+            // Literal run
+            in_bytes = out_bytes = (1 + count) * value_size;
+        }
+
+        if (pos + in_bytes > pack_size) {
+            throw std::runtime_error("Unable to decode packbits.");
+        }
+        if (out + out_bytes > out_size) {
+            throw std::runtime_error("Decoded packbits data exceeds the destination buffer.");
         }
-        else if (value_size == 1) {
-            // Run of single bytes (fast)
-            uint8_t run = 256 - count + 1;
-            out_data.resize(out_data.size() + run, pack_data[pos++]);
+
+        if (count < 128) {
+            // Short literals are copied with a single 16-byte move when both buffers have room for it.
+            auto wide = out_bytes <= 16 && pos + 16 <= pack_size && out + 16 <= out_size;
+            std::memcpy(out_data + out, pack_data + pos, wide ? 16 : out_bytes);
         }
         else {
-            // Run of multiple bytes
-            uint8_t run = 256 - count + 1;
-            for (uint8_t i = 0; i < run; ++i) {
-                for (uint8_t j = 0; j < value_size; ++j) {
-                    out_data.push_back(pack_data[pos + j]);
-                }
-            }
-            pos += value_size;
+            fill_run(out_data + out, out_bytes, out_size - out, pack_data + pos, value_size);
         }
+        pos += in_bytes;
+        out += out_bytes;
     }
 
+    return out;
+}
+
+auto graphite::qd::packbits::decode(std::vector<uint8_t> &out_data, const std::vector<uint8_t>& pack_data, std::size_t value_size) -> std::size_t
+{
+    auto offset = out_data.size();
+    auto size = decoded_size(pack_data.data(), pack_data.size(), value_size);
+    out_data.resize(offset + size);
+    decode(out_data.data() + offset, size, pack_data.data(), pack_data.size(), value_size);
     return out_data.size();
 }
 
+// MARK: - Encoding
+
 template
-auto graphite::qd::packbits::encode(const std::vector<uint8_t>& scanline_bytes) -> std::vector<uint8_t>;
+auto graphite::qd::packbits::encode(const uint8_t *, std::size_t, uint8_t *, std::size_t) -> std::size_t;
 template
-auto graphite::qd::packbits::encode(const std::vector<uint16_t>& scanline_bytes) -> std::vector<uint8_t>;
+auto graphite::qd::packbits::encode(const uint16_t *, std::size_t, uint8_t *, std::size_t) -> std::size_t;
+template
+auto graphite::qd::packbits::encode(const uint32_t *, std::size_t, uint8_t *, std::size_t) -> std::size_t;
 template<typename T>
-auto graphite::qd::packbits::encode(const std::vector<T>& scanline_bytes) -> std::vector<uint8_t>
+auto graphite::qd::packbits::encode(const T *values, std::size_t count, uint8_t *out_data, std::size_t out_size) -> std::size_t
 {
-    unsigned int bits = (sizeof(T) - 1) * 8;
-    std::vector<uint8_t> result;
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4, "packbits only supports 8, 16 and 32-bit values.");
 
-    int offset = 0;
-    const unsigned long max = scanline_bytes.size() - 1;
-    // For 8-bit we want to avoid breaking a literal to make a run of 2, as it would generally be less efficient
-    // For 16-bit we should always use runs where possible
-    const unsigned long max_minus_1 = bits ? 0 : max - 1;
+    std::size_t offset = 0;
+    std::size_t out = 0;
 
-    while (offset <= max) {
+    while (offset < count) {
         // Compressed run
-        int run = 1;
-        auto replicate = scanline_bytes[offset++];
-        while (run < 128 && offset <= max && scanline_bytes[offset] == replicate) {
-            offset++;
-            run++;
-        }
+        auto start = offset;
+        auto replicate = values[offset++];
+        offset = find_run_end(values, offset, std::min(count, start + 128), replicate);
 
+        auto run = offset - start;
         if (run > 1) {
-            result.emplace_back(static_cast<uint8_t>(-(run - 1)));
-            for (int b = bits; b >= 0; b -= 8) {
-                result.emplace_back((replicate >> b) & 0xFF);
+            if (out + 1 + sizeof(T) > out_size) {
+                throw std::runtime_error("Encoded packbits data exceeds the destination buffer.");
             }
+            out_data[out++] = static_cast<uint8_t>(-static_cast<int>(run - 1));
+            write_value(out_data + out, replicate);
+            out += sizeof(T);
             continue;
         }
 
         // Literal run
-        while (run < 128 && (offset == max
-                            || (offset < max && scanline_bytes[offset] != scanline_bytes[offset + 1])
-                            || (offset < max_minus_1 && scanline_bytes[offset] != scanline_bytes[offset + 2]))) {
-            offset++;
-            run++;
+        offset = find_literal_end(values, count, offset, start + 128);
+        run = offset - start;
+        if (out + 1 + run * sizeof(T) > out_size) {
+            throw std::runtime_error("Encoded packbits data exceeds the destination buffer.");
         }
-
-        result.emplace_back(run - 1);
-        for (int i = offset-run; i < offset; ++i) {
-            for (int b = bits; b >= 0; b -= 8) {
-                result.emplace_back((scanline_bytes[i] >> b) & 0xFF);
+        out_data[out++] = static_cast<uint8_t>(run - 1);
+        if (sizeof(T) == 1) {
+            std::memcpy(out_data + out, values + start, run);
+            out += run;
+        }
+        else {
+            for (auto i = start; i < offset; ++i) {
+                write_value(out_data + out, values[i]);
+                out += sizeof(T);
             }
         }
     }
 
+    return out;
+}
+
+template
+auto graphite::qd::packbits::encode(const std::vector<uint8_t>& scanline_bytes) -> std::vector<uint8_t>;
+template
+auto graphite::qd::packbits::encode(const std::vector<uint16_t>& scanline_bytes) -> std::vector<uint8_t>;
+template
+auto graphite::qd::packbits::encode(const std::vector<uint32_t>& scanline_bytes) -> std::vector<uint8_t>;
+template<typename T>
+auto graphite::qd::packbits::encode(const std::vector<T>& scanline_bytes) -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> result(encode_bound<T>(scanline_bytes.size()));
+    result.resize(encode(scanline_bytes.data(), scanline_bytes.size(), result.data(), result.size()));
     return result;
 }
@@ -14,7 +14,55 @@ namespace graphite::qd {
     struct packbits
     {
     public:
+        /**
+         * Calculate the number of bytes that the specified packed data will expand to, without decoding it.
+         * @param pack_data     The packed data.
+         * @param pack_size     The number of bytes of packed data.
+         * @param value_size    The size of each value in bytes.
+         * @return The number of bytes produced by decoding the packed data.
+         */
+        static auto decoded_size(const uint8_t *pack_data, std::size_t pack_size, std::size_t value_size) -> std::size_t;
+
+        /**
+         * Decode packed data into a preallocated destination buffer.
+         * @param out_data      The destination buffer.
+         * @param out_size      The capacity of the destination buffer in bytes.
+         * @param pack_data     The packed data.
+         * @param pack_size     The number of bytes of packed data.
+         * @param value_size    The size of each value in bytes.
+         * @return The number of bytes written to the destination buffer.
+         *
+         * @note Bytes beyond the returned length, up to `out_size`, may be overwritten.
+         */
+        static auto decode(uint8_t *out_data, std::size_t out_size, const uint8_t *pack_data, std::size_t pack_size, std::size_t value_size) -> std::size_t;
+
+        /**
+         * Decode packed data, appending the result to the specified vector.
+         * @return The size of the output vector.
+         */
         static auto decode(std::vector<uint8_t> &out_data, const std::vector<uint8_t>& pack_data, std::size_t value_size) -> std::size_t;
+
+        /**
+         * The maximum number of bytes that encoding the specified number of values can produce.
+         */
+        template<typename T>
+        static constexpr auto encode_bound(std::size_t count) -> std::size_t
+        {
+            return count * (sizeof(T) + 1);
+        }
+
+        /**
+         * Encode values into a preallocated destination buffer. Values are written in big endian order.
+         * @param values        The values to encode. 8, 16 and 32-bit values are supported.
+         * @param count         The number of values to encode.
+         * @param out_data      The destination buffer.
+         * @param out_size      The capacity of the destination buffer in bytes. Providing at least
+         *                      `encode_bound<T>(count)` bytes guarantees the encoded data will fit.
+         * @return The number of bytes written to the destination buffer.
+         */
+        template<typename T>
+        static auto encode(const T *values, std::size_t count, uint8_t *out_data, std::size_t out_size) -> std::size_t;
+
         template<typename T>
         static auto encode(const std::vector<T>& scanline_bytes) -> std::vector<uint8_t>;
     };
@@ -0,0 +1,702 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#   include <arm_neon.h>
+#endif
+
+// Byte shuffles are selected at runtime on x86, where SSSE3 is not part of the baseline instruction set.
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#   define GRAPHITE_SSSE3_DISPATCH 1
+#   define GRAPHITE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#   include <tmmintrin.h>
+#endif
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+#   define GRAPHITE_LITTLE_ENDIAN 1
+#endif
+
+static_assert(sizeof(graphite::qd::color) == 4, "Pixel conversions expect colors to be stored as 4 packed bytes.");
+
+namespace
+{
+    using graphite::qd::color;
+
+    // MARK: - Scalar Conversions
+
+    auto scalar_rgb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        for (std::size_t x = 0; x < count; ++x, src += 3) {
+            dst[x] = color(src[0], src[1], src[2]);
+        }
+    }
+
+    auto scalar_color_to_rgb(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        for (std::size_t x = 0; x < count; ++x, bytes += 4, dst += 3) {
+            dst[0] = bytes[0];
+            dst[1] = bytes[1];
+            dst[2] = bytes[2];
+        }
+    }
+
+    auto scalar_argb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        for (std::size_t x = 0; x < count; ++x, src += 4) {
+            dst[x] = color(src[1], src[2], src[3], src[0]);
+        }
+    }
+
+    auto scalar_xrgb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        for (std::size_t x = 0; x < count; ++x, src += 4) {
+            dst[x] = color(src[1], src[2], src[3]);
+        }
+    }
+
+    auto scalar_color_to_argb(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        for (std::size_t x = 0; x < count; ++x, bytes += 4, dst += 4) {
+            dst[0] = bytes[3];
+            dst[1] = bytes[0];
+            dst[2] = bytes[1];
+            dst[3] = bytes[2];
+        }
+    }
+
+    auto scalar_swap_red_blue(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        for (std::size_t x = 0; x < count; ++x, bytes += 4, dst += 4) {
+            dst[0] = bytes[2];
+            dst[1] = bytes[1];
+            dst[2] = bytes[0];
+            dst[3] = bytes[3];
+        }
+    }
+
+    auto scalar_color_to_planar(const color *__restrict src, uint8_t *__restrict red, uint8_t *__restrict green, uint8_t *__restrict blue, std::size_t count) -> void
+    {
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        for (std::size_t x = 0; x < count; ++x, bytes += 4) {
+            red[x] = bytes[0];
+            green[x] = bytes[1];
+            blue[x] = bytes[2];
+        }
+    }
+
+    /**
+     * Multiply a color component by alpha, rounding to the nearest value.
+     */
+    inline auto premultiply(uint8_t component, uint8_t alpha) -> uint8_t
+    {
+        uint32_t v = component * alpha + 128;
+        return static_cast<uint8_t>((v + (v >> 8)) >> 8);
+    }
+
+    // MARK: - SSSE3 Conversions
+
+#if defined(GRAPHITE_SSSE3_DISPATCH)
+    /**
+     * Apply a byte shuffle to each group of 4 pixels, setting the bytes in `fill` afterwards.
+     */
+    GRAPHITE_TARGET_SSSE3 inline auto ssse3_shuffle_pixels(const uint8_t *src, uint8_t *dst, std::size_t count, __m128i shuffle, __m128i fill) -> std::size_t
+    {
+        std::size_t x = 0;
+        for (; x + 8 <= count; x += 8) {
+            auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * x));
+            auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * x + 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4 * x), _mm_or_si128(_mm_shuffle_epi8(a, shuffle), fill));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4 * x + 16), _mm_or_si128(_mm_shuffle_epi8(b, shuffle), fill));
+        }
+        return x;
+    }
+
+    GRAPHITE_TARGET_SSSE3 auto ssse3_argb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        auto shuffle = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+        auto x = ssse3_shuffle_pixels(src, reinterpret_cast<uint8_t *>(dst), count, shuffle, _mm_setzero_si128());
+        scalar_argb_to_color(src + 4 * x, dst + x, count - x);
+    }
+
+    GRAPHITE_TARGET_SSSE3 auto ssse3_xrgb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        auto shuffle = _mm_setr_epi8(1, 2, 3, -1, 5, 6, 7, -1, 9, 10, 11, -1, 13, 14, 15, -1);
+        auto x = ssse3_shuffle_pixels(src, reinterpret_cast<uint8_t *>(dst), count, shuffle, _mm_set1_epi32(static_cast<int>(0xff000000)));
+        scalar_xrgb_to_color(src + 4 * x, dst + x, count - x);
+    }
+
+    GRAPHITE_TARGET_SSSE3 auto ssse3_color_to_argb(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        auto shuffle = _mm_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+        auto x = ssse3_shuffle_pixels(reinterpret_cast<const uint8_t *>(src), dst, count, shuffle, _mm_setzero_si128());
+        scalar_color_to_argb(src + x, dst + 4 * x, count - x);
+    }
+
+    GRAPHITE_TARGET_SSSE3 auto ssse3_swap_red_blue(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        auto shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        auto x = ssse3_shuffle_pixels(reinterpret_cast<const uint8_t *>(src), dst, count, shuffle, _mm_setzero_si128());
+        scalar_swap_red_blue(src + x, dst + 4 * x, count - x);
+    }
+
+    GRAPHITE_TARGET_SSSE3 auto ssse3_rgb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        // Each 16 byte load covers 4 pixels and a partial fifth, so stop while a whole load remains in bounds.
+        auto out = reinterpret_cast<uint8_t *>(dst);
+        auto shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        auto alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+        std::size_t x = 0;
+        for (; x + 6 <= count; x += 4) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * x));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+        }
+        scalar_rgb_to_color(src + 3 * x, dst + x, count - x);
+    }
+
+    GRAPHITE_TARGET_SSSE3 auto ssse3_color_to_rgb(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        // Each 16 byte store holds 4 pixels followed by 4 bytes that the next store overwrites.
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        auto shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        std::size_t x = 0;
+        for (; x + 6 <= count; x += 4) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 4 * x));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * x), _mm_shuffle_epi8(v, shuffle));
+        }
+        scalar_color_to_rgb(src + x, dst + 3 * x, count - x);
+    }
+
+    GRAPHITE_TARGET_SSSE3 auto ssse3_color_to_planar(const color *__restrict src, uint8_t *__restrict red, uint8_t *__restrict green, uint8_t *__restrict blue, std::size_t count) -> void
+    {
+        // Group the components of each 4 pixels together, and then transpose the groups of 16 pixels.
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        auto shuffle = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto v0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 4 * x)), shuffle);
+            auto v1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 4 * x + 16)), shuffle);
+            auto v2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 4 * x + 32)), shuffle);
+            auto v3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 4 * x + 48)), shuffle);
+            auto rg_lo = _mm_unpacklo_epi32(v0, v1);
+            auto rg_hi = _mm_unpacklo_epi32(v2, v3);
+            auto ba_lo = _mm_unpackhi_epi32(v0, v1);
+            auto ba_hi = _mm_unpackhi_epi32(v2, v3);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(red + x), _mm_unpacklo_epi64(rg_lo, rg_hi));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(green + x), _mm_unpackhi_epi64(rg_lo, rg_hi));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(blue + x), _mm_unpacklo_epi64(ba_lo, ba_hi));
+        }
+        scalar_color_to_planar(src + x, red + x, green + x, blue + x, count - x);
+    }
+#endif
+
+    // MARK: - NEON Conversions
+
+#if defined(__ARM_NEON)
+    auto neon_rgb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        auto out = reinterpret_cast<uint8_t *>(dst);
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto rgb = vld3q_u8(src + 3 * x);
+            uint8x16x4_t pixels = { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255) };
+            vst4q_u8(out + 4 * x, pixels);
+        }
+        scalar_rgb_to_color(src + 3 * x, dst + x, count - x);
+    }
+
+    auto neon_color_to_rgb(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto rgba = vld4q_u8(bytes + 4 * x);
+            uint8x16x3_t pixels = { rgba.val[0], rgba.val[1], rgba.val[2] };
+            vst3q_u8(dst + 3 * x, pixels);
+        }
+        scalar_color_to_rgb(src + x, dst + 3 * x, count - x);
+    }
+
+    auto neon_argb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        auto out = reinterpret_cast<uint8_t *>(dst);
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto argb = vld4q_u8(src + 4 * x);
+            uint8x16x4_t pixels = { argb.val[1], argb.val[2], argb.val[3], argb.val[0] };
+            vst4q_u8(out + 4 * x, pixels);
+        }
+        scalar_argb_to_color(src + 4 * x, dst + x, count - x);
+    }
+
+    auto neon_xrgb_to_color(const uint8_t *__restrict src, color *__restrict dst, std::size_t count) -> void
+    {
+        auto out = reinterpret_cast<uint8_t *>(dst);
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto argb = vld4q_u8(src + 4 * x);
+            uint8x16x4_t pixels = { argb.val[1], argb.val[2], argb.val[3], vdupq_n_u8(255) };
+            vst4q_u8(out + 4 * x, pixels);
+        }
+        scalar_xrgb_to_color(src + 4 * x, dst + x, count - x);
+    }
+
+    auto neon_color_to_argb(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto rgba = vld4q_u8(bytes + 4 * x);
+            uint8x16x4_t pixels = { rgba.val[3], rgba.val[0], rgba.val[1], rgba.val[2] };
+            vst4q_u8(dst + 4 * x, pixels);
+        }
+        scalar_color_to_argb(src + x, dst + 4 * x, count - x);
+    }
+
+    auto neon_swap_red_blue(const color *__restrict src, uint8_t *__restrict dst, std::size_t count) -> void
+    {
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto rgba = vld4q_u8(bytes + 4 * x);
+            uint8x16x4_t pixels = { rgba.val[2], rgba.val[1], rgba.val[0], rgba.val[3] };
+            vst4q_u8(dst + 4 * x, pixels);
+        }
+        scalar_swap_red_blue(src + x, dst + 4 * x, count - x);
+    }
+
+    auto neon_color_to_planar(const color *__restrict src, uint8_t *__restrict red, uint8_t *__restrict green, uint8_t *__restrict blue, std::size_t count) -> void
+    {
+        auto bytes = reinterpret_cast<const uint8_t *>(src);
+        std::size_t x = 0;
+        for (; x + 16 <= count; x += 16) {
+            auto rgba = vld4q_u8(bytes + 4 * x);
+            vst1q_u8(red + x, rgba.val[0]);
+            vst1q_u8(green + x, rgba.val[1]);
+            vst1q_u8(blue + x, rgba.val[2]);
+        }
+        scalar_color_to_planar(src + x, red + x, green + x, blue + x, count - x);
+    }
+#endif
+
+    // MARK: - Dispatch
+
+    /**
+     * The conversions that have implementations selected at runtime.
+     */
+    struct conversion_kernels
+    {
+        const char *name;
+        void (*rgb_to_color)(const uint8_t *, color *, std::size_t);
+        void (*color_to_rgb)(const color *, uint8_t *, std::size_t);
+        void (*argb_to_color)(const uint8_t *, color *, std::size_t);
+        void (*xrgb_to_color)(const uint8_t *, color *, std::size_t);
+        void (*color_to_argb)(const color *, uint8_t *, std::size_t);
+        void (*swap_red_blue)(const color *, uint8_t *, std::size_t);
+        void (*color_to_planar)(const color *, uint8_t *, uint8_t *, uint8_t *, std::size_t);
+    };
+
+    auto select_kernels() -> conversion_kernels
+    {
+#if defined(__ARM_NEON)
+        return {
+            "neon", neon_rgb_to_color, neon_color_to_rgb, neon_argb_to_color, neon_xrgb_to_color,
+            neon_color_to_argb, neon_swap_red_blue, neon_color_to_planar
+        };
+#else
+#   if defined(GRAPHITE_SSSE3_DISPATCH)
+        if (__builtin_cpu_supports("ssse3")) {
+            return {
+                "ssse3", ssse3_rgb_to_color, ssse3_color_to_rgb, ssse3_argb_to_color, ssse3_xrgb_to_color,
+                ssse3_color_to_argb, ssse3_swap_red_blue, ssse3_color_to_planar
+            };
+        }
+#   endif
+        return {
+#   if defined(__SSE2__)
+            "sse2",
+#   else
+            "scalar",
+#   endif
+            scalar_rgb_to_color, scalar_color_to_rgb, scalar_argb_to_color, scalar_xrgb_to_color,
+            scalar_color_to_argb, scalar_swap_red_blue, scalar_color_to_planar
+        };
+#endif
+    }
+
+    auto kernels() -> const conversion_kernels&
+    {
+        static const conversion_kernels selected = select_kernels();
+        return selected;
+    }
+
+    // MARK: - Index Expansion
+
+    /**
+     * Expand packed indices of a fixed depth. Whole source bytes are copied from the table as a fixed size block,
+     * leaving only the partial bytes at either end of the run to be expanded a pixel at a time.
+     */
+    template<int Depth>
+    auto expand_indices(const uint8_t *__restrict src, std::size_t first, const color *__restrict table, color *__restrict dst, std::size_t count) -> void
+    {
+        constexpr std::size_t per_byte = 8 / Depth;
+        auto byte = src + first / per_byte;
+        std::size_t x = 0;
+
+        if (auto offset = first % per_byte) {
+            for (; offset < per_byte && x < count; ++offset) {
+                dst[x++] = table[*byte * per_byte + offset];
+            }
+            ++byte;
+        }
+        for (; x + per_byte <= count; x += per_byte, ++byte) {
+            std::memcpy(dst + x, table + *byte * per_byte, per_byte * sizeof(color));
+        }
+        for (std::size_t offset = 0; x < count; ++offset) {
+            dst[x++] = table[*byte * per_byte + offset];
+        }
+    }
+
+    /**
+     * A word for each pixel of every possible mask byte, which keeps the color when its bit is set and clears it
+     * otherwise.
+     */
+    auto mask_words() -> const std::vector<uint32_t>&
+    {
+        static const std::vector<uint32_t> words = [] {
+            std::vector<uint32_t> words(256 * 8);
+            for (auto byte = 0; byte < 256; ++byte) {
+                for (auto bit = 0; bit < 8; ++bit) {
+                    words[byte * 8 + bit] = (byte & (0x80 >> bit)) ? 0xFFFFFFFF : 0;
+                }
+            }
+            return words;
+        }();
+        return words;
+    }
+
+    /**
+     * Clear the colors whose mask bit is unset. A clear color is all zero, so this is a mask of each color word.
+     */
+    auto apply_mask(const uint8_t *__restrict mask, std::size_t first, color *__restrict dst, std::size_t count) -> void
+    {
+        const auto& words = mask_words();
+        auto out = reinterpret_cast<uint8_t *>(dst);
+        auto apply = [&] (std::size_t x, uint8_t byte, std::size_t bit) {
+            uint32_t value;
+            std::memcpy(&value, out + 4 * x, sizeof(value));
+            value &= words[byte * 8 + bit];
+            std::memcpy(out + 4 * x, &value, sizeof(value));
+        };
+
+        auto byte = mask + first / 8;
+        std::size_t x = 0;
+        if (auto bit = first % 8) {
+            for (; bit < 8 && x < count; ++bit) {
+                apply(x++, *byte, bit);
+            }
+            ++byte;
+        }
+        for (; x + 8 <= count; x += 8, ++byte) {
+            if (*byte == 0xFF) {
+                continue;
+            }
+            for (std::size_t bit = 0; bit < 8; ++bit) {
+                apply(x + bit, *byte, bit);
+            }
+        }
+        for (std::size_t bit = 0; x < count; ++bit) {
+            apply(x++, *byte, bit);
+        }
+    }
+}
+
+// MARK: - Public Interface
+
+auto graphite::qd::pixel_conversion::implementation() -> const char *
+{
+    return kernels().name;
+}
+
+auto graphite::qd::pixel_conversion::rgb555_to_color(const uint8_t *__restrict src, qd::color *__restrict dst, std::size_t count) -> void
+{
+    auto out = reinterpret_cast<uint8_t *>(dst);
+    std::size_t x = 0;
+
+    // Expand 8 big endian words at a time, replicating the upper bits of each component into the lower bits.
+#if defined(__SSE2__)
+    auto mask = _mm_set1_epi16(0x1f);
+    auto zero = _mm_setzero_si128();
+    auto alpha = _mm_set1_epi8(-1);
+    for (; x + 8 <= count; x += 8) {
+        auto words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * x));
+        words = _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+        auto r = _mm_and_si128(_mm_srli_epi16(words, 10), mask);
+        auto g = _mm_and_si128(_mm_srli_epi16(words, 5), mask);
+        auto b = _mm_and_si128(words, mask);
+        r = _mm_packus_epi16(_mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2)), zero);
+        g = _mm_packus_epi16(_mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2)), zero);
+        b = _mm_packus_epi16(_mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2)), zero);
+        auto rg = _mm_unpacklo_epi8(r, g);
+        auto ba = _mm_unpacklo_epi8(b, alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+#elif defined(__ARM_NEON)
+    auto mask = vdupq_n_u16(0x1f);
+    for (; x + 8 <= count; x += 8) {
+        auto words = vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(src + 2 * x)));
+        auto r = vandq_u16(vshrq_n_u16(words, 10), mask);
+        auto g = vandq_u16(vshrq_n_u16(words, 5), mask);
+        auto b = vandq_u16(words, mask);
+        uint8x8x4_t pixels = {
+            vmovn_u16(vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2))),
+            vmovn_u16(vorrq_u16(vshlq_n_u16(g, 3), vshrq_n_u16(g, 2))),
+            vmovn_u16(vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2))),
+            vdup_n_u8(255)
+        };
+        vst4_u8(out + 4 * x, pixels);
+    }
+#endif
+
+    for (; x < count; ++x) {
+        dst[x] = qd::color(static_cast<uint16_t>((src[2 * x] << 8) | src[2 * x + 1]));
+    }
+}
+
+auto graphite::qd::pixel_conversion::color_to_rgb555(const qd::color *__restrict src, uint16_t *__restrict dst, std::size_t count) -> void
+{
+    auto bytes = reinterpret_cast<const uint8_t *>(src);
+    std::size_t x = 0;
+
+    // Reduce 8 pixels at a time. Each pixel is loaded as a little endian word, with red in the lowest byte.
+#if defined(__SSE2__)
+    auto mask = _mm_set1_epi32(0x1f);
+    auto reduce = [&] (__m128i v) {
+        auto r = _mm_and_si128(_mm_srli_epi32(v, 3), mask);
+        auto g = _mm_and_si128(_mm_srli_epi32(v, 11), mask);
+        auto b = _mm_and_si128(_mm_srli_epi32(v, 19), mask);
+        return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 10), _mm_slli_epi32(g, 5)), b);
+    };
+    for (; x + 8 <= count; x += 8) {
+        auto lo = reduce(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 4 * x)));
+        auto hi = reduce(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 4 * x + 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packs_epi32(lo, hi));
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 8 <= count; x += 8) {
+        auto rgba = vld4_u8(bytes + 4 * x);
+        auto r = vshlq_n_u16(vmovl_u8(vshr_n_u8(rgba.val[0], 3)), 10);
+        auto g = vshlq_n_u16(vmovl_u8(vshr_n_u8(rgba.val[1], 3)), 5);
+        auto b = vmovl_u8(vshr_n_u8(rgba.val[2], 3));
+        vst1q_u16(dst + x, vorrq_u16(vorrq_u16(r, g), b));
+    }
+#endif
+
+    for (; x < count; ++x) {
+        dst[x] = src[x].rgb555();
+    }
+}
+
+auto graphite::qd::pixel_conversion::rgb_to_color(const uint8_t *src, qd::color *dst, std::size_t count) -> void
+{
+    kernels().rgb_to_color(src, dst, count);
+}
+
+auto graphite::qd::pixel_conversion::color_to_rgb(const qd::color *src, uint8_t *dst, std::size_t count) -> void
+{
+    kernels().color_to_rgb(src, dst, count);
+}
+
+auto graphite::qd::pixel_conversion::argb_to_color(const uint8_t *src, qd::color *dst, std::size_t count) -> void
+{
+    kernels().argb_to_color(src, dst, count);
+}
+
+auto graphite::qd::pixel_conversion::xrgb_to_color(const uint8_t *src, qd::color *dst, std::size_t count) -> void
+{
+    kernels().xrgb_to_color(src, dst, count);
+}
+
+auto graphite::qd::pixel_conversion::color_to_argb(const qd::color *src, uint8_t *dst, std::size_t count) -> void
+{
+    kernels().color_to_argb(src, dst, count);
+}
+
+auto graphite::qd::pixel_conversion::planar_to_color(const uint8_t *__restrict red, const uint8_t *__restrict green, const uint8_t *__restrict blue, qd::color *__restrict dst, std::size_t count) -> void
+{
+    auto out = reinterpret_cast<uint8_t *>(dst);
+    std::size_t x = 0;
+
+    // Interleave 16 pixels at a time from the component planes into RGBA.
+#if defined(__SSE2__)
+    auto alpha = _mm_set1_epi8(-1);
+    for (; x + 16 <= count; x += 16) {
+        auto r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(red + x));
+        auto g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(green + x));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blue + x));
+        auto rg_lo = _mm_unpacklo_epi8(r, g);
+        auto rg_hi = _mm_unpackhi_epi8(r, g);
+        auto ba_lo = _mm_unpacklo_epi8(b, alpha);
+        auto ba_hi = _mm_unpackhi_epi8(b, alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x), _mm_unpacklo_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 16 <= count; x += 16) {
+        uint8x16x4_t pixels = { vld1q_u8(red + x), vld1q_u8(green + x), vld1q_u8(blue + x), vdupq_n_u8(255) };
+        vst4q_u8(out + 4 * x, pixels);
+    }
+#endif
+
+    for (; x < count; ++x) {
+        dst[x] = qd::color(red[x], green[x], blue[x]);
+    }
+}
+
+auto graphite::qd::pixel_conversion::color_to_planar(const qd::color *src, uint8_t *red, uint8_t *green, uint8_t *blue, std::size_t count) -> void
+{
+    kernels().color_to_planar(src, red, green, blue, count);
+}
+
+auto graphite::qd::pixel_conversion::color_to_format(const qd::color *src, uint8_t *dst, std::size_t count, enum pixel_format format) -> void
+{
+    auto bytes = reinterpret_cast<const uint8_t *>(src);
+    switch (format) {
+        case pixel_format::rgba8888: {
+            std::memcpy(dst, src, count * sizeof(qd::color));
+            break;
+        }
+        case pixel_format::bgra8888: {
+            kernels().swap_red_blue(src, dst, count);
+            break;
+        }
+        case pixel_format::rgba8888_premultiplied: {
+            for (std::size_t i = 0; i < count; ++i, bytes += 4, dst += 4) {
+                dst[0] = premultiply(bytes[0], bytes[3]);
+                dst[1] = premultiply(bytes[1], bytes[3]);
+                dst[2] = premultiply(bytes[2], bytes[3]);
+                dst[3] = bytes[3];
+            }
+            break;
+        }
+        case pixel_format::bgra8888_premultiplied: {
+            for (std::size_t i = 0; i < count; ++i, bytes += 4, dst += 4) {
+                dst[0] = premultiply(bytes[2], bytes[3]);
+                dst[1] = premultiply(bytes[1], bytes[3]);
+                dst[2] = premultiply(bytes[0], bytes[3]);
+                dst[3] = bytes[3];
+            }
+            break;
+        }
+        case pixel_format::rgb565: {
+            for (std::size_t i = 0; i < count; ++i, bytes += 4, dst += 2) {
+                uint16_t value = (bytes[0] >> 3) << 11 | (bytes[1] >> 2) << 5 | (bytes[2] >> 3);
+                std::memcpy(dst, &value, sizeof(value));
+            }
+            break;
+        }
+        case pixel_format::rgb555: {
+            // The destination may not be aligned for 16-bit values, so reduce in blocks and copy them out.
+            uint16_t block[256];
+            for (std::size_t i = 0; i < count; i += 256) {
+                auto n = std::min<std::size_t>(256, count - i);
+                color_to_rgb555(src + i, block, n);
+                std::memcpy(dst + 2 * i, block, n * sizeof(uint16_t));
+            }
+            break;
+        }
+    }
+}
+
+auto graphite::qd::pixel_conversion::color_to_rgba_words(const qd::color *src, uint32_t *dst, std::size_t count) -> void
+{
+#if defined(GRAPHITE_LITTLE_ENDIAN)
+    std::memcpy(dst, src, count * sizeof(qd::color));
+#else
+    auto bytes = reinterpret_cast<const uint8_t *>(src);
+    for (std::size_t i = 0; i < count; ++i, bytes += 4) {
+        dst[i] = bytes[0] | (bytes[1] << 8UL) | (bytes[2] << 16UL) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+#endif
+}
+
+auto graphite::qd::pixel_conversion::index_table(const qd::color *palette, std::size_t palette_size, int depth) -> std::vector<qd::color>
+{
+    if (depth != 1 && depth != 2 && depth != 4 && depth != 8) {
+        throw std::runtime_error("Unsupported index depth: " + std::to_string(depth));
+    }
+
+    std::size_t per_byte = 8 / depth;
+    auto value_mask = (1 << depth) - 1;
+    std::vector<qd::color> table(256 * per_byte, qd::color::black());
+    for (std::size_t byte = 0; byte < 256; ++byte) {
+        for (std::size_t i = 0; i < per_byte; ++i) {
+            auto index = static_cast<std::size_t>((byte >> (8 - depth * (i + 1))) & value_mask);
+            if (index < palette_size) {
+                table[byte * per_byte + i] = palette[index];
+            }
+        }
+    }
+    return table;
+}
+
+auto graphite::qd::pixel_conversion::indices_to_color(const uint8_t *src, std::size_t first, int depth, const std::vector<qd::color>& table, qd::color *dst, std::size_t count, const uint8_t *mask) -> void
+{
+    if ((depth != 1 && depth != 2 && depth != 4 && depth != 8) || table.size() != static_cast<std::size_t>(256 * (8 / depth))) {
+        throw std::runtime_error("Index table does not match the index depth: " + std::to_string(depth));
+    }
+
+    switch (depth) {
+        case 1: {
+            expand_indices<1>(src, first, table.data(), dst, count);
+            break;
+        }
+        case 2: {
+            expand_indices<2>(src, first, table.data(), dst, count);
+            break;
+        }
+        case 4: {
+            expand_indices<4>(src, first, table.data(), dst, count);
+            break;
+        }
+        case 8: {
+            expand_indices<8>(src, first, table.data(), dst, count);
+            break;
+        }
+    }
+
+    if (mask) {
+        apply_mask(mask, first, dst, count);
+    }
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QUICKDRAW_PIXEL_CONVERSION_HPP)
+#define GRAPHITE_QUICKDRAW_PIXEL_CONVERSION_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "libGraphite/quickdraw/internal/color.hpp"
+#include "libGraphite/quickdraw/scanline.hpp"
+
+namespace graphite::qd {
+
+    /**
+     * The `graphite::qd::pixel_conversion` structure converts runs of pixels between `qd::color` and the pixel layouts
+     * used by QuickDraw and QuickTime data. Each conversion is vectorised where the target supports it, selecting the
+     * best implementation for the host CPU at runtime, and falls back to scalar code otherwise.
+     *
+     * Unless stated otherwise the source and destination of a conversion must not overlap.
+     */
+    struct pixel_conversion
+    {
+    public:
+        /**
+         * Returns the name of the instruction set the conversions are using, such as "ssse3", "neon" or "scalar".
+         */
+        static auto implementation() -> const char *;
+
+        /**
+         * Expand big endian rgb555 words, as stored in QuickDraw data, into opaque colors.
+         */
+        static auto rgb555_to_color(const uint8_t *src, qd::color *dst, std::size_t count) -> void;
+
+        /**
+         * Reduce colors to rgb555 values. The top bit of each value is zero.
+         */
+        static auto color_to_rgb555(const qd::color *src, uint16_t *dst, std::size_t count) -> void;
+
+        /**
+         * Expand packed 24-bit RGB into opaque colors.
+         */
+        static auto rgb_to_color(const uint8_t *src, qd::color *dst, std::size_t count) -> void;
+
+        /**
+         * Reduce colors to packed 24-bit RGB, discarding alpha.
+         */
+        static auto color_to_rgb(const qd::color *src, uint8_t *dst, std::size_t count) -> void;
+
+        /**
+         * Convert 32-bit ARGB into colors, preserving alpha.
+         */
+        static auto argb_to_color(const uint8_t *src, qd::color *dst, std::size_t count) -> void;
+
+        /**
+         * Convert 32-bit ARGB into opaque colors, ignoring the alpha byte of the source.
+         */
+        static auto xrgb_to_color(const uint8_t *src, qd::color *dst, std::size_t count) -> void;
+
+        /**
+         * Convert colors into 32-bit ARGB.
+         */
+        static auto color_to_argb(const qd::color *src, uint8_t *dst, std::size_t count) -> void;
+
+        /**
+         * Interleave separate red, green and blue planes into opaque colors.
+         */
+        static auto planar_to_color(const uint8_t *red, const uint8_t *green, const uint8_t *blue, qd::color *dst, std::size_t count) -> void;
+
+        /**
+         * Separate colors into red, green and blue planes, discarding alpha.
+         */
+        static auto color_to_planar(const qd::color *src, uint8_t *red, uint8_t *green, uint8_t *blue, std::size_t count) -> void;
+
+        /**
+         * Convert colors into one of the caller facing pixel formats.
+         */
+        static auto color_to_format(const qd::color *src, uint8_t *dst, std::size_t count, enum pixel_format format) -> void;
+
+        /**
+         * Convert colors into 32-bit words with red in the least significant byte and alpha in the most
+         * significant byte.
+         */
+        static auto color_to_rgba_words(const qd::color *src, uint32_t *dst, std::size_t count) -> void;
+
+        /**
+         * Build the table used by `indices_to_color` to expand palette indices of the specified depth, which must be
+         * 1, 2, 4 or 8 bits. The table holds the colors of every pixel of every possible source byte, so that each
+         * byte expands with a single copy. Indices beyond the end of the palette expand to black.
+         */
+        static auto index_table(const qd::color *palette, std::size_t palette_size, int depth) -> std::vector<qd::color>;
+
+        /**
+         * Expand a row of packed palette indices, most significant bits first, into colors using a table built by
+         * `index_table` for the same depth. `first` is the position of the first pixel within the source row. When a
+         * 1-bit mask is given, using the same positions as the indices, pixels whose mask bit is unset are cleared.
+         */
+        static auto indices_to_color(const uint8_t *src, std::size_t first, int depth, const std::vector<qd::color>& table, qd::color *dst, std::size_t count, const uint8_t *mask = nullptr) -> void;
+    };
+
+}
+
+#endif //GRAPHITE_QUICKDRAW_PIXEL_CONVERSION_HPP
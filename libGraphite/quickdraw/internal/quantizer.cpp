@@ -0,0 +1,214 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include "libGraphite/quickdraw/internal/quantizer.hpp"
+
+namespace
+{
+    /**
+     * A distinct color of the surface, and the number of pixels that use it.
+     */
+    struct histogram_entry
+    {
+        std::array<uint8_t, 3> components;
+        uint64_t count;
+    };
+
+    /**
+     * A group of histogram entries, referenced by the range of the ordering that holds them, which will be
+     * represented by a single color.
+     */
+    struct color_box
+    {
+        std::size_t begin;
+        std::size_t end;
+        double error { 0 };
+        int axis { 0 };
+    };
+
+    /**
+     * Measure a box, recording the component with the widest spread of colors and the total squared error of
+     * representing every color of the box by their mean.
+     */
+    auto measure(color_box& box, const std::vector<histogram_entry>& entries, const std::vector<uint32_t>& order) -> void
+    {
+        double weight = 0;
+        double sum[3] = { 0, 0, 0 };
+        double squares[3] = { 0, 0, 0 };
+        for (auto i = box.begin; i < box.end; ++i) {
+            const auto& entry = entries[order[i]];
+            weight += static_cast<double>(entry.count);
+            for (auto c = 0; c < 3; ++c) {
+                auto value = static_cast<double>(entry.components[c]);
+                sum[c] += value * entry.count;
+                squares[c] += value * value * entry.count;
+            }
+        }
+
+        box.error = 0;
+        auto widest = -1.0;
+        for (auto c = 0; c < 3; ++c) {
+            auto error = squares[c] - (sum[c] * sum[c]) / weight;
+            box.error += error;
+            if (error > widest) {
+                widest = error;
+                box.axis = c;
+            }
+        }
+    }
+
+    /**
+     * Split a box at the weighted median of its widest component, returning the upper half.
+     */
+    auto split(color_box& box, const std::vector<histogram_entry>& entries, std::vector<uint32_t>& order) -> color_box
+    {
+        auto axis = box.axis;
+        std::sort(order.begin() + box.begin, order.begin() + box.end, [&] (uint32_t lhs, uint32_t rhs) {
+            return entries[lhs].components[axis] < entries[rhs].components[axis];
+        });
+
+        uint64_t weight = 0;
+        for (auto i = box.begin; i < box.end; ++i) {
+            weight += entries[order[i]].count;
+        }
+
+        // Both halves must hold at least one color.
+        auto middle = box.begin + 1;
+        uint64_t lower = entries[order[box.begin]].count;
+        while (middle < box.end - 1 && lower * 2 < weight) {
+            lower += entries[order[middle++]].count;
+        }
+
+        color_box upper { middle, box.end };
+        box.end = middle;
+        measure(box, entries, order);
+        measure(upper, entries, order);
+        return upper;
+    }
+}
+
+// MARK: - Quantization
+
+auto graphite::qd::quantizer::quantize(const qd::surface& surface, std::size_t max_colors, bool masked) -> result
+{
+    if (max_colors < 1 || max_colors > 256) {
+        throw std::runtime_error("Unable to quantize to " + std::to_string(max_colors) + " colors.");
+    }
+
+    // Count the distinct colors of the surface, recording the histogram entry of each pixel so that the colors do
+    // not need to be looked up a second time.
+    constexpr auto transparent = std::numeric_limits<uint32_t>::max();
+    auto width = surface.size().width();
+    auto height = surface.size().height();
+    std::vector<histogram_entry> entries;
+    std::unordered_map<uint32_t, uint32_t> lookup;
+    std::vector<uint32_t> pixels(static_cast<std::size_t>(width) * height, transparent);
+    for (auto y = 0; y < height; ++y) {
+        auto row = surface.row(y);
+        auto pixel = pixels.data() + static_cast<std::size_t>(y) * width;
+        for (auto x = 0; x < width; ++x) {
+            const auto& color = row[x];
+            if (masked && !(color.alpha_component() & 0x80)) {
+                continue;
+            }
+            auto key = (color.red_component() << 16U) | (color.green_component() << 8U) | color.blue_component();
+            auto it = lookup.try_emplace(key, static_cast<uint32_t>(entries.size())).first;
+            if (it->second == entries.size()) {
+                entries.push_back({ { color.red_component(), color.green_component(), color.blue_component() }, 0 });
+            }
+            ++entries[it->second].count;
+            pixel[x] = it->second;
+        }
+    }
+    if (entries.empty()) {
+        entries.push_back({ { 0, 0, 0 }, 1 });
+    }
+
+    // Assign every histogram entry to a color of the palette.
+    std::vector<qd::color> palette;
+    std::vector<uint32_t> assignment(entries.size());
+    if (entries.size() <= max_colors) {
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            const auto& components = entries[i].components;
+            palette.emplace_back(components[0], components[1], components[2]);
+            assignment[i] = static_cast<uint32_t>(i);
+        }
+    }
+    else {
+        std::vector<uint32_t> order(entries.size());
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<uint32_t>(i);
+        }
+
+        std::vector<color_box> boxes { color_box { 0, order.size() } };
+        measure(boxes.front(), entries, order);
+        while (boxes.size() < max_colors) {
+            auto largest = std::max_element(boxes.begin(), boxes.end(), [] (const color_box& lhs, const color_box& rhs) {
+                return (lhs.end - lhs.begin < 2 ? -1.0 : lhs.error) < (rhs.end - rhs.begin < 2 ? -1.0 : rhs.error);
+            });
+            if (largest->end - largest->begin < 2) {
+                break;
+            }
+            auto upper = split(*largest, entries, order);
+            boxes.push_back(upper);
+        }
+
+        // Each box is represented by the weighted mean of its colors.
+        for (const auto& box : boxes) {
+            double weight = 0;
+            double sum[3] = { 0, 0, 0 };
+            for (auto i = box.begin; i < box.end; ++i) {
+                const auto& entry = entries[order[i]];
+                weight += static_cast<double>(entry.count);
+                for (auto c = 0; c < 3; ++c) {
+                    sum[c] += static_cast<double>(entry.components[c]) * entry.count;
+                }
+                assignment[order[i]] = static_cast<uint32_t>(palette.size());
+            }
+            palette.emplace_back(
+                static_cast<uint8_t>(sum[0] / weight + 0.5),
+                static_cast<uint8_t>(sum[1] / weight + 0.5),
+                static_cast<uint8_t>(sum[2] / weight + 0.5)
+            );
+        }
+    }
+
+    // Build the color table. Distinct boxes may round to the same color, in which case they share an entry.
+    result quantized;
+    std::vector<uint16_t> table_index(palette.size());
+    for (std::size_t i = 0; i < palette.size(); ++i) {
+        table_index[i] = quantized.clut.set(palette[i]);
+    }
+
+    quantized.indices.resize(pixels.size(), 0);
+    for (std::size_t i = 0; i < pixels.size(); ++i) {
+        if (pixels[i] != transparent) {
+            quantized.indices[i] = table_index[assignment[pixels[i]]];
+        }
+    }
+    return quantized;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QD_QUANTIZER)
+#define GRAPHITE_QD_QUANTIZER
+
+#include <cstdint>
+#include <vector>
+#include "libGraphite/quickdraw/clut.hpp"
+#include "libGraphite/quickdraw/internal/surface.hpp"
+
+namespace graphite::qd
+{
+
+    /**
+     * The `graphite::qd::quantizer` structure reduces the colors of a surface to a color table of limited size, for
+     * encoding as an indexed image. The distinct colors of the surface are counted in a single pass. If there are few
+     * enough of them they are used as they are, in the order they first appear. Otherwise the histogram of colors is
+     * divided by median cut, repeatedly splitting the group of colors with the largest error.
+     */
+    struct quantizer
+    {
+    public:
+        /**
+         * A color table produced by quantizing a surface, along with the index of every pixel of the surface in row
+         * order.
+         */
+        struct result
+        {
+            qd::clut clut;
+            std::vector<uint16_t> indices;
+        };
+
+        /**
+         * Quantize the colors of a surface, without modifying it. Alpha is ignored, as color tables are opaque.
+         * @param surface       The surface to quantize.
+         * @param max_colors    The maximum number of entries in the color table, from 1 to 256.
+         * @param masked        Whether to ignore the colors of transparent pixels, whose alpha is below 128. Such
+         *                      pixels are given index 0.
+         */
+        static auto quantize(const qd::surface& surface, std::size_t max_colors = 256, bool masked = false) -> result;
+    };
+
+}
+
+#endif //GRAPHITE_QD_QUANTIZER
@@ -0,0 +1,477 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <iterator>
+#include "libGraphite/quickdraw/internal/rasterizer.hpp"
+
+namespace
+{
+    /**
+     * Visit each point of a line from (x0, y0) to (x1, y1), in the same order and at the same points as
+     * `surface::draw_line`.
+     */
+    template<typename F>
+    auto trace_line(int x0, int y0, int x1, int y1, F&& visit) -> void
+    {
+        int delta_x = std::abs(x1 - x0);
+        int delta_y = std::abs(y1 - y0);
+        int sx = (x0 < x1) ? 1 : -1;
+        int sy = (y0 < y1) ? 1 : -1;
+        int err = delta_x - delta_y;
+
+        for (;;) {
+            visit(x0, y0);
+            if (x0 == x1 && y0 == y1) {
+                break;
+            }
+            int e2 = 2 * err;
+            if (e2 > -delta_y) {
+                err -= delta_y;
+                x0 += sx;
+            }
+            if (e2 < delta_x) {
+                err += delta_x;
+                y0 += sy;
+            }
+        }
+    }
+
+    auto uniform(const graphite::qd::pattern& pattern, uint8_t bits) -> bool
+    {
+        return std::all_of(pattern.rows.begin(), pattern.rows.end(), [bits] (uint8_t row) { return row == bits; });
+    }
+
+    auto inverted(const graphite::qd::color& color) -> graphite::qd::color
+    {
+        return graphite::qd::color(255 - color.red_component(), 255 - color.green_component(), 255 - color.blue_component());
+    }
+}
+
+// MARK: - Patterns
+
+auto graphite::qd::pattern::black() -> qd::pattern
+{
+    qd::pattern pattern;
+    pattern.rows.fill(0xFF);
+    return pattern;
+}
+
+auto graphite::qd::pattern::white() -> qd::pattern
+{
+    return {};
+}
+
+auto graphite::qd::pattern::read(graphite::data::reader& reader) -> qd::pattern
+{
+    qd::pattern pattern;
+    for (auto& row : pattern.rows) {
+        row = reader.read_byte();
+    }
+    return pattern;
+}
+
+// MARK: - Regions
+
+graphite::qd::region::region(const qd::rect& rect)
+    : m_bounds(rect)
+{
+    if (rect.width() > 0 && rect.height() > 0) {
+        m_bands.push_back({ rect.y(), rect.y() + rect.height(), { rect.x(), rect.x() + rect.width() } });
+    }
+}
+
+auto graphite::qd::region::read(graphite::data::reader& reader) -> qd::region
+{
+    auto start = reader.position();
+    auto size = std::max<uint16_t>(reader.read_short(), 10);
+    qd::region region(qd::rect::read(reader, qd::rect::qd));
+
+    if (size > 10) {
+        // Each line lists the points at which the region is inverted, starting at that row. The spans of a band
+        // are the points that have been inverted an odd number of times.
+        auto end = start + size;
+        region.m_bands.clear();
+        std::vector<int> edges;
+        std::vector<int> inversions;
+        std::vector<int> next;
+        while (reader.position() + sizeof(int16_t) <= end) {
+            auto y = reader.read_signed_short();
+            if (y == 0x7FFF || (!region.m_bands.empty() && y <= region.m_bands.back().top)) {
+                break;
+            }
+
+            inversions.clear();
+            while (reader.position() + sizeof(int16_t) <= end) {
+                auto x = reader.read_signed_short();
+                if (x == 0x7FFF) {
+                    break;
+                }
+                inversions.emplace_back(x);
+            }
+            std::sort(inversions.begin(), inversions.end());
+            next.clear();
+            std::set_symmetric_difference(edges.begin(), edges.end(), inversions.begin(), inversions.end(), std::back_inserter(next));
+            edges.swap(next);
+
+            if (!region.m_bands.empty()) {
+                region.m_bands.back().bottom = y;
+            }
+            region.m_bands.push_back({ y, region.m_bounds.y() + region.m_bounds.height(), edges });
+        }
+    }
+
+    reader.set_position(start + size);
+    return region;
+}
+
+auto graphite::qd::region::bounds() const -> qd::rect
+{
+    return m_bounds;
+}
+
+auto graphite::qd::region::for_each_span(int top, int bottom, const std::function<void(int, int, int)>& body) const -> void
+{
+    // Bands are ordered from top to bottom, so start from the last band that begins at or above the first row.
+    auto band_it = std::upper_bound(m_bands.begin(), m_bands.end(), top, [] (int y, const band& band) { return y < band.top; });
+    if (band_it != m_bands.begin()) {
+        --band_it;
+    }
+    for (; band_it != m_bands.end() && band_it->top < bottom; ++band_it) {
+        const auto& band = *band_it;
+        auto first = std::max(band.top, top);
+        auto last = std::min(band.bottom, bottom);
+        for (auto y = first; y < last; ++y) {
+            for (std::size_t i = 0; i + 1 < band.edges.size(); i += 2) {
+                body(y, band.edges[i], band.edges[i + 1]);
+            }
+        }
+    }
+}
+
+// MARK: - Construction
+
+graphite::qd::rasterizer::rasterizer(qd::surface *surface, const qd::point& origin)
+    : m_surface(surface), m_origin(origin)
+{
+
+}
+
+// MARK: - Drawing State
+
+auto graphite::qd::rasterizer::set_origin(const qd::point& origin) -> void
+{
+    m_origin = origin;
+}
+
+auto graphite::qd::rasterizer::pen_location() const -> qd::point
+{
+    return m_pen_location;
+}
+
+auto graphite::qd::rasterizer::set_pen_size(const qd::size& size) -> void
+{
+    m_pen_size = size;
+}
+
+auto graphite::qd::rasterizer::set_pen_mode(uint16_t mode) -> void
+{
+    // Source transfer modes behave as the matching pattern modes, and any other mode as a plain copy.
+    if (mode < pat_copy) {
+        mode += pat_copy;
+    }
+    m_pen_mode = mode <= not_pat_bic ? mode : static_cast<uint16_t>(pat_copy);
+}
+
+auto graphite::qd::rasterizer::set_pen_pattern(const qd::pattern& pattern) -> void
+{
+    m_pen_pattern = pattern;
+}
+
+auto graphite::qd::rasterizer::set_fill_pattern(const qd::pattern& pattern) -> void
+{
+    m_fill_pattern = pattern;
+}
+
+auto graphite::qd::rasterizer::set_background_pattern(const qd::pattern& pattern) -> void
+{
+    m_background_pattern = pattern;
+}
+
+auto graphite::qd::rasterizer::set_foreground_color(const qd::color& color) -> void
+{
+    m_foreground_color = color;
+}
+
+auto graphite::qd::rasterizer::set_background_color(const qd::color& color) -> void
+{
+    m_background_color = color;
+}
+
+// MARK: - Spans
+
+auto graphite::qd::rasterizer::fill_span(int y, int left, int right, const qd::pattern& pattern, uint16_t mode) -> void
+{
+    left = std::max(left, 0);
+    right = std::min<int>(right, m_surface->size().width());
+    if (y < 0 || y >= m_surface->size().height() || left >= right) {
+        return;
+    }
+
+    // Patterns are aligned to the coordinate system of the picture rather than to the surface.
+    auto row = m_surface->row(y);
+    auto bits = pattern.rows[(y + m_origin.y()) & 7];
+    if (mode >= not_pat_copy) {
+        bits = ~bits;
+        mode -= (not_pat_copy - pat_copy);
+    }
+
+    // Solid spans are the common case, and are filled without looking at each bit.
+    if (mode == pat_copy && (bits == 0xFF || bits == 0x00)) {
+        std::fill(row + left, row + right, bits ? m_foreground_color : m_background_color);
+        return;
+    }
+
+    for (auto x = left; x < right; ++x) {
+        auto set = ((bits >> (7 - ((x + m_origin.x()) & 7))) & 1) != 0;
+        switch (mode) {
+            case pat_copy: {
+                row[x] = set ? m_foreground_color : m_background_color;
+                break;
+            }
+            case pat_or: {
+                if (set) {
+                    row[x] = m_foreground_color;
+                }
+                break;
+            }
+            case pat_xor: {
+                if (set) {
+                    row[x] = inverted(row[x]);
+                }
+                break;
+            }
+            default: {
+                if (set) {
+                    row[x] = m_background_color;
+                }
+                break;
+            }
+        }
+    }
+}
+
+auto graphite::qd::rasterizer::draw_spans(verb verb, const std::function<void(const std::function<void(int, int, int)>&)>& spans) -> void
+{
+    const qd::pattern *pattern = &m_pen_pattern;
+    uint16_t mode = m_pen_mode;
+    static const auto black = qd::pattern::black();
+    switch (verb) {
+        case verb::frame:
+        case verb::paint: {
+            break;
+        }
+        case verb::erase: {
+            pattern = &m_background_pattern;
+            mode = pat_copy;
+            break;
+        }
+        case verb::invert: {
+            pattern = &black;
+            mode = pat_xor;
+            break;
+        }
+        case verb::fill: {
+            pattern = &m_fill_pattern;
+            mode = pat_copy;
+            break;
+        }
+    }
+
+    spans([&] (int y, int left, int right) {
+        fill_span(y - m_origin.y(), left - m_origin.x(), right - m_origin.x(), *pattern, mode);
+    });
+}
+
+// MARK: - Lines
+
+auto graphite::qd::rasterizer::move_to(const qd::point& point) -> void
+{
+    m_pen_location = point;
+}
+
+auto graphite::qd::rasterizer::line_to(const qd::point& point) -> void
+{
+    auto from = m_pen_location;
+    m_pen_location = point;
+
+    int pen_width = m_pen_size.width();
+    int pen_height = m_pen_size.height();
+    if (!m_surface || pen_width <= 0 || pen_height <= 0) {
+        return;
+    }
+
+    int x0 = from.x() - m_origin.x();
+    int y0 = from.y() - m_origin.y();
+    int x1 = point.x() - m_origin.x();
+    int y1 = point.y() - m_origin.y();
+
+    // A single pixel pen drawing a solid color needs nothing more than a plain line.
+    if (pen_width == 1 && pen_height == 1 && m_pen_mode == pat_copy) {
+        if (uniform(m_pen_pattern, 0xFF) || uniform(m_pen_pattern, 0x00)) {
+            m_surface->draw_line(x0, y0, x1, y1, m_pen_pattern.rows[0] ? m_foreground_color : m_background_color);
+            return;
+        }
+    }
+
+    // Find the pixels of the line on each row. The pen covers a rect at each of them, so a row of the stroke spans
+    // the pixels of the rows that lie within the height of the pen above it, widened by the pen width. Both ends of
+    // a row move in the same direction along a line, so the extent of those rows is found from the first and last.
+    auto top = std::min(y0, y1);
+    auto rows = std::abs(y1 - y0) + 1;
+    std::vector<std::pair<int, int>> extents(rows, { INT_MAX, INT_MIN });
+    trace_line(x0, y0, x1, y1, [&] (int x, int y) {
+        auto& extent = extents[y - top];
+        extent.first = std::min(extent.first, x);
+        extent.second = std::max(extent.second, x);
+    });
+
+    auto first = std::max(top, 0);
+    auto last = std::min(top + rows + pen_height - 1, static_cast<int>(m_surface->size().height()));
+    for (auto y = first; y < last; ++y) {
+        const auto& upper = extents[std::max(y - pen_height + 1, top) - top];
+        const auto& lower = extents[std::min(y, top + rows - 1) - top];
+        auto left = std::min(upper.first, lower.first);
+        auto right = std::max(upper.second, lower.second) + pen_width;
+        fill_span(y, left, right, m_pen_pattern, m_pen_mode);
+    }
+}
+
+// MARK: - Shapes
+
+auto graphite::qd::rasterizer::draw_rect(verb verb, const qd::rect& rect) -> void
+{
+    if (!m_surface || rect.width() <= 0 || rect.height() <= 0) {
+        return;
+    }
+
+    int left = rect.x();
+    int top = rect.y();
+    int right = left + rect.width();
+    int bottom = top + rect.height();
+    int pen_width = m_pen_size.width();
+    int pen_height = m_pen_size.height();
+    if (verb == verb::frame && (pen_width <= 0 || pen_height <= 0)) {
+        return;
+    }
+
+    auto first = std::max(top, static_cast<int>(m_origin.y()));
+    auto last = std::min(bottom, m_origin.y() + m_surface->size().height());
+    draw_spans(verb, [&] (const std::function<void(int, int, int)>& span) {
+        for (auto y = first; y < last; ++y) {
+            // A frame covers the edges of the rect to the depth of the pen, or all of it if the rect is too small
+            // to have an inside.
+            if (verb != verb::frame || y < top + pen_height || y >= bottom - pen_height || 2 * pen_width >= right - left) {
+                span(y, left, right);
+            }
+            else {
+                span(y, left, left + pen_width);
+                span(y, right - pen_width, right);
+            }
+        }
+    });
+}
+
+auto graphite::qd::rasterizer::draw_region(verb verb, const qd::region& region) -> void
+{
+    if (!m_surface) {
+        return;
+    }
+
+    int top = m_origin.y();
+    int bottom = top + m_surface->size().height();
+    if (verb != verb::frame) {
+        draw_spans(verb, [&] (const std::function<void(int, int, int)>& span) {
+            region.for_each_span(top, bottom, span);
+        });
+        return;
+    }
+
+    int pen_width = m_pen_size.width();
+    int pen_height = m_pen_size.height();
+    if (pen_width <= 0 || pen_height <= 0) {
+        return;
+    }
+
+    // A pixel of the region survives being inset by the pen if every pixel within the pen width of it horizontally,
+    // and within the pen height of it vertically, lies within the region. The frame is the part of the region that
+    // does not survive. Each span is inset horizontally as it is read, and the number of consecutive rows in which
+    // each column survives is counted, so only a single row is held at a time.
+    auto bounds = region.bounds();
+    int left = m_origin.x();
+    int width = m_surface->size().width();
+    int first = std::max<int>(bounds.y(), top - pen_height);
+    int last = std::min<int>(bounds.y() + bounds.height(), bottom + pen_height);
+    int end = std::min(last, bottom) + pen_height;
+    std::vector<int> runs(width, 0);
+    std::vector<uint8_t> inset(width, 0);
+
+    draw_spans(verb, [&] (const std::function<void(int, int, int)>& span) {
+        for (auto y = first; y < end; ++y) {
+            std::fill(inset.begin(), inset.end(), 0);
+            if (y < last) {
+                region.for_each_span(y, y + 1, [&] (int, int span_left, int span_right) {
+                    span_left = std::max(span_left + pen_width - left, 0);
+                    span_right = std::min(span_right - pen_width - left, width);
+                    if (span_left < span_right) {
+                        std::fill(inset.begin() + span_left, inset.begin() + span_right, 1);
+                    }
+                });
+            }
+            for (auto x = 0; x < width; ++x) {
+                runs[x] = inset[x] ? runs[x] + 1 : 0;
+            }
+
+            // The rows that a pixel depends on have all been counted once the row a pen height below it is.
+            auto frame_y = y - pen_height;
+            if (frame_y < top || frame_y >= bottom) {
+                continue;
+            }
+            region.for_each_span(frame_y, frame_y + 1, [&] (int, int span_left, int span_right) {
+                span_left = std::max(span_left - left, 0);
+                span_right = std::min(span_right - left, width);
+                for (auto x = span_left; x < span_right;) {
+                    if (runs[x] > 2 * pen_height) {
+                        ++x;
+                        continue;
+                    }
+                    auto start = x;
+                    while (x < span_right && runs[x] <= 2 * pen_height) {
+                        ++x;
+                    }
+                    span(frame_y, left + start, left + x);
+                }
+            });
+        }
+    });
+}
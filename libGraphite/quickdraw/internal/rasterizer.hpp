@@ -0,0 +1,183 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QD_RASTERIZER)
+#define GRAPHITE_QD_RASTERIZER
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "libGraphite/data/reader.hpp"
+#include "libGraphite/quickdraw/geometry.hpp"
+#include "libGraphite/quickdraw/internal/color.hpp"
+#include "libGraphite/quickdraw/internal/surface.hpp"
+
+namespace graphite::qd
+{
+
+    /**
+     * The `graphite::qd::pattern` structure is a QuickDraw bit pattern: an 8x8 tile of bits, where set bits are
+     * drawn in the foreground color and clear bits in the background color.
+     */
+    struct pattern
+    {
+    public:
+        std::array<uint8_t, 8> rows {};
+
+        /**
+         * Returns a pattern with every bit set, which draws in the foreground color.
+         */
+        static auto black() -> pattern;
+
+        /**
+         * Returns a pattern with every bit clear, which draws in the background color.
+         */
+        static auto white() -> pattern;
+
+        static auto read(graphite::data::reader& reader) -> pattern;
+    };
+
+    /**
+     * The `graphite::qd::region` class is a QuickDraw region, an arbitrary set of pixels described by the points
+     * along each row at which the set is inverted. It is held as horizontal bands, each of which covers a run of
+     * rows sharing the same spans.
+     */
+    class region
+    {
+    private:
+        struct band
+        {
+            int top;
+            int bottom;
+            std::vector<int> edges;
+        };
+
+        qd::rect m_bounds;
+        std::vector<band> m_bands;
+
+    public:
+        /**
+         * Construct a rectangular region.
+         */
+        explicit region(const qd::rect& rect);
+
+        /**
+         * Read a region, including its leading size, leaving the reader at the end of the region.
+         */
+        static auto read(graphite::data::reader& reader) -> region;
+
+        [[nodiscard]] auto bounds() const -> qd::rect;
+
+        /**
+         * Call `body(y, left, right)` for every span of the region between rows `top` and `bottom`, where each
+         * span covers the pixels from `left` up to, but not including, `right`.
+         */
+        auto for_each_span(int top, int bottom, const std::function<void(int, int, int)>& body) const -> void;
+    };
+
+    /**
+     * The `graphite::qd::rasterizer` class draws the QuickDraw primitives of a picture onto a surface. It tracks
+     * the pen, the foreground and background colors, and the pen, fill and background patterns as the drawing
+     * opcodes of a picture change them. Shapes are drawn as horizontal spans, each clipped to the surface once.
+     * Coordinates are given in the coordinate system of the picture, whose top left corner is the origin of the
+     * rasterizer.
+     */
+    class rasterizer
+    {
+    public:
+        /**
+         * The ways in which a pattern is combined with the pixels beneath it.
+         */
+        enum transfer_mode : uint16_t
+        {
+            pat_copy = 8,
+            pat_or = 9,
+            pat_xor = 10,
+            pat_bic = 11,
+            not_pat_copy = 12,
+            not_pat_or = 13,
+            not_pat_xor = 14,
+            not_pat_bic = 15,
+        };
+
+        /**
+         * The operations that can be applied to a shape.
+         */
+        enum class verb { frame, paint, erase, invert, fill };
+
+    private:
+        qd::surface *m_surface { nullptr };
+        qd::point m_origin { qd::point::zero() };
+        qd::point m_pen_location { qd::point::zero() };
+        qd::size m_pen_size { 1, 1 };
+        uint16_t m_pen_mode { pat_copy };
+        qd::pattern m_pen_pattern { qd::pattern::black() };
+        qd::pattern m_fill_pattern { qd::pattern::black() };
+        qd::pattern m_background_pattern { qd::pattern::white() };
+        qd::color m_foreground_color { qd::color::black() };
+        qd::color m_background_color { qd::color::white() };
+
+        auto fill_span(int y, int left, int right, const qd::pattern& pattern, uint16_t mode) -> void;
+        auto draw_spans(verb verb, const std::function<void(const std::function<void(int, int, int)>&)>& spans) -> void;
+
+    public:
+        /**
+         * Construct a rasterizer drawing onto the specified surface. A rasterizer without a surface only tracks the
+         * drawing state.
+         * @param surface   The surface to draw onto.
+         * @param origin    The point in the picture that lies at the top left corner of the surface.
+         */
+        explicit rasterizer(qd::surface *surface, const qd::point& origin = qd::point::zero());
+
+        auto set_origin(const qd::point& origin) -> void;
+
+        [[nodiscard]] auto pen_location() const -> qd::point;
+        auto set_pen_size(const qd::size& size) -> void;
+        auto set_pen_mode(uint16_t mode) -> void;
+        auto set_pen_pattern(const qd::pattern& pattern) -> void;
+        auto set_fill_pattern(const qd::pattern& pattern) -> void;
+        auto set_background_pattern(const qd::pattern& pattern) -> void;
+        auto set_foreground_color(const qd::color& color) -> void;
+        auto set_background_color(const qd::color& color) -> void;
+
+        /**
+         * Move the pen to the specified point without drawing.
+         */
+        auto move_to(const qd::point& point) -> void;
+
+        /**
+         * Draw a line from the pen location to the specified point, and move the pen to it. The top left corner of
+         * the pen follows the line, so each point of the line covers a rect the size of the pen.
+         */
+        auto line_to(const qd::point& point) -> void;
+
+        auto draw_rect(verb verb, const qd::rect& rect) -> void;
+
+        /**
+         * Draw a region. Framing a region draws the pixels of the region that lie within the pen size of its edge.
+         */
+        auto draw_region(verb verb, const qd::region& region) -> void;
+    };
+
+}
+
+#endif //GRAPHITE_QD_RASTERIZER
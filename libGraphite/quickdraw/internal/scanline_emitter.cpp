@@ -0,0 +1,186 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <string>
+#include "libGraphite/quickdraw/internal/scanline_emitter.hpp"
+
+// MARK: - Construction
+
+graphite::qd::scanline_emitter::scanline_emitter(enum pixel_format format, const qd::scanline_callback& callback)
+    : m_format(format), m_callback(&callback)
+{
+
+}
+
+graphite::qd::scanline_emitter::scanline_emitter(const qd::pixel_buffer& buffer)
+    : m_format(buffer.format), m_buffer(&buffer)
+{
+
+}
+
+graphite::qd::scanline_emitter::scanline_emitter(std::shared_ptr<qd::clut> palette, int depth)
+    : m_palette(std::move(palette)), m_depth(depth)
+{
+
+}
+
+auto graphite::qd::scanline_emitter::begin(int width, int height) -> void
+{
+    m_width = std::max(width, 0);
+    m_height = std::max(height, 0);
+    m_line = 0;
+    if (m_depth > 0) {
+        m_indexed = std::make_shared<qd::indexed_surface>(m_width, m_height, m_palette, false, m_depth);
+        return;
+    }
+    if (!m_callback && !m_buffer) {
+        m_surface = std::make_shared<qd::surface>(m_width, m_height);
+        return;
+    }
+    if (m_buffer && !m_buffer->can_hold(m_width, m_height)) {
+        graphite::decode_error(graphite::error_code::invalid_structure, 0,
+                               "The destination pixel buffer is too small for a " + std::to_string(m_width) + "x" + std::to_string(m_height) + " image.").raise();
+    }
+
+    if (writes_in_place()) {
+        clear_line();
+        return;
+    }
+    m_row.assign(m_width, qd::color::clear());
+    if (m_callback && m_format != pixel_format::rgba8888) {
+        m_converted.resize(m_width * bytes_per_pixel(m_format));
+    }
+}
+
+auto graphite::qd::scanline_emitter::writes_in_place() const -> bool
+{
+    return m_buffer && m_format == pixel_format::rgba8888;
+}
+
+auto graphite::qd::scanline_emitter::clear_line() -> void
+{
+    if (m_line < m_height) {
+        std::fill_n(pixels(), m_width, qd::color::clear());
+    }
+}
+
+// MARK: - Accessors
+
+auto graphite::qd::scanline_emitter::width() const -> int
+{
+    return m_width;
+}
+
+auto graphite::qd::scanline_emitter::height() const -> int
+{
+    return m_height;
+}
+
+auto graphite::qd::scanline_emitter::surface() const -> std::shared_ptr<qd::surface>
+{
+    return m_surface;
+}
+
+auto graphite::qd::scanline_emitter::indexed_surface() const -> std::shared_ptr<qd::indexed_surface>
+{
+    return m_indexed;
+}
+
+auto graphite::qd::scanline_emitter::indexed() const -> bool
+{
+    return m_depth > 0;
+}
+
+auto graphite::qd::scanline_emitter::depth() const -> int
+{
+    return m_depth;
+}
+
+auto graphite::qd::scanline_emitter::line() const -> int
+{
+    return m_line;
+}
+
+auto graphite::qd::scanline_emitter::pixels() -> qd::color *
+{
+    if (m_surface) {
+        return m_surface->row(m_line);
+    }
+    else if (writes_in_place()) {
+        return reinterpret_cast<qd::color *>(m_buffer->row(m_line));
+    }
+    return m_row.data();
+}
+
+auto graphite::qd::scanline_emitter::indices() -> uint8_t *
+{
+    return m_indexed->row(m_line);
+}
+
+// MARK: - Row Completion
+
+auto graphite::qd::scanline_emitter::advance() -> void
+{
+    if (m_line >= m_height) {
+        return;
+    }
+
+    if (m_buffer) {
+        if (!writes_in_place()) {
+            convert_pixels(m_row.data(), m_buffer->row(m_line), m_width, m_format);
+            std::fill(m_row.begin(), m_row.end(), qd::color::clear());
+        }
+    }
+    else if (m_callback) {
+        qd::scanline row;
+        row.y = m_line;
+        row.width = m_width;
+        row.format = m_format;
+        if (m_format == pixel_format::rgba8888) {
+            row.pixels = reinterpret_cast<const uint8_t *>(m_row.data());
+        }
+        else {
+            convert_pixels(m_row.data(), m_converted.data(), m_width, m_format);
+            row.pixels = m_converted.data();
+        }
+        (*m_callback)(row);
+        std::fill(m_row.begin(), m_row.end(), qd::color::clear());
+    }
+    ++m_line;
+
+    if (writes_in_place()) {
+        clear_line();
+    }
+}
+
+auto graphite::qd::scanline_emitter::advance_to(int line) -> void
+{
+    line = std::min(line, m_height);
+    while (m_line < line) {
+        advance();
+    }
+}
+
+auto graphite::qd::scanline_emitter::finish() -> void
+{
+    advance_to(m_height);
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QUICKDRAW_SCANLINE_EMITTER_HPP)
+#define GRAPHITE_QUICKDRAW_SCANLINE_EMITTER_HPP
+
+#include <vector>
+#include "libGraphite/quickdraw/scanline.hpp"
+#include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/internal/indexed_surface.hpp"
+#include "libGraphite/result.hpp"
+
+namespace graphite::qd {
+
+    /**
+     * The `graphite::qd::scanline_emitter` class is an internal component of the image decoders. Decoders write
+     * the rows of an image through it from top to bottom, and it either stores them in a surface, writes them into
+     * a caller provided pixel buffer, or holds a single row at a time and hands each completed row to a
+     * `scanline_callback`. This allows a decoder to be written once and used for all three. Decoders of indexed
+     * images may also support building an indexed surface, writing palette indices rather than colors.
+     */
+    class scanline_emitter
+    {
+    private:
+        std::shared_ptr<qd::surface> m_surface;
+        std::shared_ptr<qd::indexed_surface> m_indexed;
+        std::shared_ptr<qd::clut> m_palette;
+        int m_depth { 0 };
+        int m_width { 0 };
+        int m_height { 0 };
+        int m_line { 0 };
+        enum pixel_format m_format { pixel_format::rgba8888 };
+        const qd::scanline_callback *m_callback { nullptr };
+        const qd::pixel_buffer *m_buffer { nullptr };
+        std::vector<qd::color> m_row;
+        std::vector<uint8_t> m_converted;
+
+    public:
+        /**
+         * Construct an emitter that builds a surface from the rows that are written to it.
+         */
+        scanline_emitter() = default;
+
+        /**
+         * Construct an emitter that delivers each row to the specified callback in the requested pixel format.
+         * The callback must outlive the emitter.
+         */
+        scanline_emitter(enum pixel_format format, const qd::scanline_callback& callback);
+
+        /**
+         * Construct an emitter that writes each row into the specified pixel buffer. Rows in the rgba8888 format
+         * are decoded in place. The buffer must outlive the emitter.
+         */
+        explicit scanline_emitter(const qd::pixel_buffer& buffer);
+
+        /**
+         * Construct an emitter that builds an indexed surface, holding indices into the specified color table at
+         * the specified depth. Only decoders that check `indexed` may write through such an emitter.
+         */
+        scanline_emitter(std::shared_ptr<qd::clut> palette, int depth);
+
+        /**
+         * Set the dimensions of the image and start writing its first row. Decoders call this once they have
+         * validated the dimensions, and before writing any rows.
+         *
+         * @note            Raises a decode error if the image does not fit in the destination pixel buffer.
+         */
+        auto begin(int width, int height) -> void;
+
+        /**
+         * Returns the surface built by the emitter, or null when rows are being delivered to a callback.
+         */
+        [[nodiscard]] auto surface() const -> std::shared_ptr<qd::surface>;
+
+        /**
+         * Returns the indexed surface built by the emitter, or null when the emitter does not build one.
+         */
+        [[nodiscard]] auto indexed_surface() const -> std::shared_ptr<qd::indexed_surface>;
+
+        /**
+         * Returns whether the rows of the image must be written as packed palette indices through `indices`,
+         * rather than as colors through `pixels`.
+         */
+        [[nodiscard]] auto indexed() const -> bool;
+
+        /**
+         * Returns the number of bits per index of an emitter that builds an indexed surface.
+         */
+        [[nodiscard]] auto depth() const -> int;
+
+        [[nodiscard]] auto width() const -> int;
+        [[nodiscard]] auto height() const -> int;
+
+        /**
+         * Returns the row that is currently being written.
+         */
+        [[nodiscard]] auto line() const -> int;
+
+        /**
+         * Returns the pixels of the current row. Each row starts out clear.
+         *
+         * @note            The caller must ensure that `line()` is less than `height()`.
+         */
+        auto pixels() -> qd::color *;
+
+        /**
+         * Returns the packed palette indices of the current row of an indexed surface. Each row starts out zero.
+         *
+         * @note            The caller must ensure that `line()` is less than `height()`, and that the emitter
+         *                  builds an indexed surface.
+         */
+        auto indices() -> uint8_t *;
+
+        /**
+         * Complete the current row and move on to the next.
+         */
+        auto advance() -> void;
+
+        /**
+         * Complete rows until the specified row becomes the current row. Rows that were never written are
+         * delivered clear.
+         */
+        auto advance_to(int line) -> void;
+
+        /**
+         * Complete every remaining row of the image.
+         */
+        auto finish() -> void;
+
+    private:
+        [[nodiscard]] auto writes_in_place() const -> bool;
+        auto clear_line() -> void;
+    };
+
+}
+
+#endif //GRAPHITE_QUICKDRAW_SCANLINE_EMITTER_HPP
@@ -2,7 +2,10 @@
 // Created by Tom Hancocks on 20/02/2020.
 //
 
+#include <algorithm>
+#include <utility>
 #include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
 
 // MARK: - Constructor
 
@@ -12,35 +15,67 @@ graphite::qd::surface::surface(int width, int height)
 }
 
 graphite::qd::surface::surface(int width, int height, std::vector<graphite::qd::color> rgb)
-: m_width(width), m_height(height), m_data(std::move(rgb))
+: m_width(width), m_height(height), m_data(rgb.begin(), rgb.end())
 {
 }
 
+graphite::qd::surface::surface(int width, int height, pixel_storage rgb)
+    : m_width(width), m_height(height), m_data(std::move(rgb))
+{
+}
+
+graphite::qd::surface::surface(const qd::surface_view& view)
+    : m_width(view.size().width()), m_height(view.size().height()), m_data(m_width * m_height, graphite::qd::color::clear())
+{
+    for (auto y = 0; y < m_height; ++y) {
+        std::copy_n(view.row(y), m_width, row(y));
+    }
+}
+
 // MARK: - Surface Access
 
 auto graphite::qd::surface::raw() const -> std::vector<uint32_t>
 {
-    auto out = std::vector<uint32_t>();
-    for (const auto& i : m_data) {
-        uint32_t color = (i.alpha_component() << 24)
-                | i.red_component()
-                | (i.green_component() << 8UL)
-                | (i.blue_component() << 16UL);
-        out.push_back(color);
-    }
+    auto out = std::vector<uint32_t>(m_data.size());
+    qd::pixel_conversion::color_to_rgba_words(m_data.data(), out.data(), out.size());
     return out;
 }
 
+auto graphite::qd::surface::copy_to(const qd::pixel_buffer& buffer) const -> void
+{
+    if (!buffer.can_hold(m_width, m_height)) {
+        throw std::runtime_error("The destination pixel buffer is too small for the surface.");
+    }
+    for (auto y = 0; y < m_height; ++y) {
+        convert_pixels(row(y), buffer.row(y), m_width, buffer.format);
+    }
+}
+
 auto graphite::qd::surface::size() const -> graphite::qd::size
 {
     return graphite::qd::size(m_width, m_height);
 }
 
+auto graphite::qd::surface::decoded_bytes() const -> std::size_t
+{
+    return m_data.capacity() * sizeof(graphite::qd::color);
+}
+
 auto graphite::qd::surface::at(int x, int y) const -> graphite::qd::color
 {
     return m_data[(y * m_width) + x];
 }
 
+auto graphite::qd::surface::row(int y) -> graphite::qd::color *
+{
+    return m_data.data() + (y * m_width);
+}
+
+auto graphite::qd::surface::row(int y) const -> const graphite::qd::color *
+{
+    return m_data.data() + (y * m_width);
+}
+
 auto graphite::qd::surface::set(int x, int y, graphite::qd::color color) -> void
 {
     if (x >= m_width) {
@@ -88,3 +123,42 @@ auto graphite::qd::surface::draw_line(int x0, int y0, int x1, int y1, graphite::
         }
     }
 }
+
+// MARK: - Rectangle Operations
+
+auto graphite::qd::surface::view() -> qd::surface_view
+{
+    return { m_data.data(), m_width, m_height, static_cast<std::size_t>(m_width) };
+}
+
+auto graphite::qd::surface::view(const qd::rect& rect) -> qd::surface_view
+{
+    return view().subview(rect);
+}
+
+auto graphite::qd::surface::fill_rect(const qd::rect& rect, graphite::qd::color color) -> void
+{
+    view().fill_rect(rect, color);
+}
+
+auto graphite::qd::surface::copy_rect(const qd::surface& source, const qd::rect& source_rect, const qd::point& destination) -> void
+{
+    // The source is only read from.
+    view().copy_rect(const_cast<qd::surface&>(source).view(), source_rect, destination);
+}
+
+auto graphite::qd::surface::copy_rect(const qd::surface_view& source, const qd::rect& source_rect, const qd::point& destination) -> void
+{
+    view().copy_rect(source, source_rect, destination);
+}
+
+auto graphite::qd::surface::blit(const qd::surface& source, const qd::rect& source_rect, const qd::point& destination, enum blend_mode mode) -> void
+{
+    // The source is only read from.
+    view().blit(const_cast<qd::surface&>(source).view(), source_rect, destination, mode);
+}
+
+auto graphite::qd::surface::blit(const qd::surface_view& source, const qd::rect& source_rect, const qd::point& destination, enum blend_mode mode) -> void
+{
+    view().blit(source, source_rect, destination, mode);
+}
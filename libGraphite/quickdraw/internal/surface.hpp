@@ -9,6 +9,9 @@
 #include <vector>
 #include <libGraphite/quickdraw/geometry.hpp>
 #include "libGraphite/quickdraw/internal/color.hpp"
+#include "libGraphite/quickdraw/scanline.hpp"
+#include "libGraphite/quickdraw/internal/surface_view.hpp"
+#include "libGraphite/memory/allocator.hpp"
 
 namespace graphite::qd
 {
@@ -20,10 +23,16 @@ namespace graphite::qd
      */
     class surface
     {
+    public:
+        /**
+         * The storage of the pixels of a surface, which is accounted for as surface memory.
+         */
+        typedef std::vector<graphite::qd::color, memory::allocator<graphite::qd::color, memory::category::surface>> pixel_storage;
+
     private:
         int m_width;
         int m_height;
-        std::vector<graphite::qd::color> m_data;
+        pixel_storage m_data;
 
     public:
 
@@ -42,16 +51,41 @@ namespace graphite::qd
          */
         surface(int width, int height, std::vector<graphite::qd::color> rgb);
 
+        /**
+         * Construct a new surface with the specified dimensions, taking ownership of the rgb data without copying it.
+         * @param width     The width of the surface in pixels.
+         * @param height    The height of the surface in pixels.
+         * @param rgb       The rgb data of the surface.
+         */
+        surface(int width, int height, pixel_storage rgb);
+
+        /**
+         * Construct a new surface containing a copy of the pixels referenced by a view.
+         * @param view      The pixels to copy.
+         */
+        explicit surface(const qd::surface_view& view);
+
         /**
          * Export the raw surface data.
          */
         [[nodiscard]] auto raw() const -> std::vector<uint32_t>;
 
+        /**
+         * Copy the surface into a caller provided pixel buffer, converting it to the pixel format of the buffer.
+         * @param buffer    The destination, which must be large enough to hold the surface.
+         */
+        auto copy_to(const qd::pixel_buffer& buffer) const -> void;
+
         /**
          * Returns the size of the surface
          */
         [[nodiscard]] auto size() const -> qd::size;
 
+        /**
+         * Returns the number of bytes of memory held by the decoded pixels of the surface.
+         */
+        [[nodiscard]] auto decoded_bytes() const -> std::size_t;
+
         /**
          * Returns the color at the specified coordinate within the surface.
          * @param x         The x position in the surface
@@ -62,6 +96,17 @@ namespace graphite::qd
          */
         [[nodiscard]] auto at(int x, int y) const -> graphite::qd::color;
 
+        /**
+         * Returns a pointer to the first pixel of the specified row of the surface. Pixels within a row are
+         * contiguous, allowing whole rows to be read or written without per-pixel bounds checks.
+         * @param y         The row in the surface
+         * @return          The pixels of the row
+         *
+         * @note            No bounds checking is performed. The caller must ensure `y` lies within the surface.
+         */
+        [[nodiscard]] auto row(int y) -> graphite::qd::color *;
+        [[nodiscard]] auto row(int y) const -> const graphite::qd::color *;
+
         /**
          * Set the color at the specified coordinate within the surface.
          * @param x         The x position in the surface
@@ -91,6 +136,45 @@ namespace graphite::qd
          */
         auto draw_line(int x0, int y0, int x1, int y1, graphite::qd::color color) -> void;
 
+        /**
+         * Returns a view of the entire surface. The view is invalidated if the surface is destroyed.
+         */
+        [[nodiscard]] auto view() -> qd::surface_view;
+
+        /**
+         * Returns a view of a rectangle of the surface. The rectangle is clipped to the surface.
+         */
+        [[nodiscard]] auto view(const qd::rect& rect) -> qd::surface_view;
+
+        /**
+         * Fill a rectangle of the surface with the color specified. The rectangle is clipped to the surface.
+         * @param rect      The area of the surface to fill.
+         * @param color     The color to fill with.
+         */
+        auto fill_rect(const qd::rect& rect, graphite::qd::color color) -> void;
+
+        /**
+         * Copy a rectangle of pixels from a source surface into this surface, replacing the existing pixels.
+         * The source and destination areas are clipped to their respective surfaces. The source may be this
+         * surface, in which case the areas may overlap.
+         * @param source        The surface to copy pixels from.
+         * @param source_rect   The area of the source surface to copy.
+         * @param destination   The position in this surface that the top left corner of the area is copied to.
+         */
+        auto copy_rect(const qd::surface& source, const qd::rect& source_rect, const qd::point& destination) -> void;
+        auto copy_rect(const qd::surface_view& source, const qd::rect& source_rect, const qd::point& destination) -> void;
+
+        /**
+         * Blit a rectangle of pixels from a source surface into this surface, combining them with the existing
+         * pixels using the blend mode specified. Clipping is performed as for `copy_rect`.
+         * @param source        The surface to blit pixels from.
+         * @param source_rect   The area of the source surface to blit.
+         * @param destination   The position in this surface that the top left corner of the area is blitted to.
+         * @param mode          How source pixels are combined with the existing pixels.
+         */
+        auto blit(const qd::surface& source, const qd::rect& source_rect, const qd::point& destination, enum blend_mode mode = blend_mode::copy) -> void;
+        auto blit(const qd::surface_view& source, const qd::rect& source_rect, const qd::point& destination, enum blend_mode mode = blend_mode::copy) -> void;
+
     };
 
 }
@@ -0,0 +1,284 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "libGraphite/quickdraw/internal/surface_view.hpp"
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#   include <arm_neon.h>
+#endif
+
+// MARK: - Constructor
+
+graphite::qd::surface_view::surface_view(graphite::qd::color *data, int width, int height, std::size_t stride)
+    : m_data(data), m_width(width), m_height(height), m_stride(stride)
+{
+}
+
+// MARK: - Accessors
+
+auto graphite::qd::surface_view::size() const -> qd::size
+{
+    return qd::size(static_cast<int16_t>(m_width), static_cast<int16_t>(m_height));
+}
+
+auto graphite::qd::surface_view::stride() const -> std::size_t
+{
+    return m_stride;
+}
+
+auto graphite::qd::surface_view::empty() const -> bool
+{
+    return m_width <= 0 || m_height <= 0;
+}
+
+auto graphite::qd::surface_view::at(int x, int y) const -> graphite::qd::color
+{
+    return row(y)[x];
+}
+
+auto graphite::qd::surface_view::set(int x, int y, graphite::qd::color color) const -> void
+{
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+        throw std::runtime_error("Attempted to set pixel beyond bounds of surface view.");
+    }
+    row(y)[x] = color;
+}
+
+auto graphite::qd::surface_view::subview(const qd::rect& rect) const -> surface_view
+{
+    auto x0 = std::max(0, static_cast<int>(rect.x()));
+    auto y0 = std::max(0, static_cast<int>(rect.y()));
+    auto x1 = std::min(m_width, rect.x() + rect.width());
+    auto y1 = std::min(m_height, rect.y() + rect.height());
+    if (x0 >= x1 || y0 >= y1) {
+        return {};
+    }
+    return { row(y0) + x0, x1 - x0, y1 - y0, m_stride };
+}
+
+auto graphite::qd::surface_view::buffer() const -> qd::pixel_buffer
+{
+    qd::pixel_buffer buffer;
+    buffer.data = reinterpret_cast<uint8_t *>(m_data);
+    buffer.stride = m_stride * sizeof(graphite::qd::color);
+    buffer.width = m_width;
+    buffer.height = m_height;
+    buffer.format = pixel_format::rgba8888;
+    return buffer;
+}
+
+// MARK: - Rectangle Operations
+
+namespace
+{
+    /**
+     * An area of pixels to transfer between two surfaces, clipped against the bounds of both.
+     */
+    struct surface_area
+    {
+        int src_x { 0 };
+        int src_y { 0 };
+        int dst_x { 0 };
+        int dst_y { 0 };
+        int width { 0 };
+        int height { 0 };
+
+        [[nodiscard]] auto empty() const -> bool
+        {
+            return width <= 0 || height <= 0;
+        }
+    };
+}
+
+static auto clip_area(const graphite::qd::size& source, const graphite::qd::size& destination,
+                      const graphite::qd::rect& source_rect, const graphite::qd::point& origin) -> surface_area
+{
+    surface_area area;
+    area.src_x = source_rect.x();
+    area.src_y = source_rect.y();
+    area.dst_x = origin.x();
+    area.dst_y = origin.y();
+    area.width = source_rect.width();
+    area.height = source_rect.height();
+
+    // Trim the leading edges against both surfaces, moving the opposite origin by the same amount.
+    auto trim = [] (int& a, int& b, int& extent) {
+        if (a < 0) {
+            b -= a;
+            extent += a;
+            a = 0;
+        }
+    };
+    trim(area.src_x, area.dst_x, area.width);
+    trim(area.dst_x, area.src_x, area.width);
+    trim(area.src_y, area.dst_y, area.height);
+    trim(area.dst_y, area.src_y, area.height);
+
+    // Trim the trailing edges.
+    area.width = std::min({ area.width, source.width() - area.src_x, destination.width() - area.dst_x });
+    area.height = std::min({ area.height, source.height() - area.src_y, destination.height() - area.dst_y });
+    return area;
+}
+
+/**
+ * Copy the source pixels that are not fully transparent.
+ */
+static auto mask_row(const graphite::qd::color *src, graphite::qd::color *dst, int count) -> void
+{
+    auto x = 0;
+
+    // Select between source and destination 4 pixels at a time, based on whether the source alpha is zero.
+#if defined(__SSE2__)
+    auto alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+    auto zero = _mm_setzero_si128();
+    for (; x + 4 <= count; x += 4) {
+        auto s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+        auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + x));
+        auto transparent = _mm_cmpeq_epi32(_mm_and_si128(s, alpha), zero);
+        d = _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), d);
+    }
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+    auto alpha = vdupq_n_u32(0xff000000);
+    for (; x + 4 <= count; x += 4) {
+        auto s = vld1q_u32(reinterpret_cast<const uint32_t *>(src + x));
+        auto d = vld1q_u32(reinterpret_cast<const uint32_t *>(dst + x));
+        vst1q_u32(reinterpret_cast<uint32_t *>(dst + x), vbslq_u32(vtstq_u32(s, alpha), s, d));
+    }
+#endif
+
+    auto bytes = reinterpret_cast<const uint8_t *>(src);
+    for (; x < count; ++x) {
+        if (bytes[4 * x + 3] != 0) {
+            dst[x] = src[x];
+        }
+    }
+}
+
+/**
+ * Divide by 255, rounding to the nearest value.
+ */
+static inline auto div255(uint32_t v) -> uint32_t
+{
+    v += 128;
+    return (v + (v >> 8)) >> 8;
+}
+
+/**
+ * Composite the source pixels over the destination pixels. Colors are not premultiplied, so the result is
+ * normalised by the combined alpha.
+ */
+static auto blend_row(const graphite::qd::color *src, graphite::qd::color *dst, int count) -> void
+{
+    auto s = reinterpret_cast<const uint8_t *>(src);
+    auto d = reinterpret_cast<uint8_t *>(dst);
+    for (auto x = 0; x < count; ++x, s += 4, d += 4) {
+        uint32_t sa = s[3];
+        if (sa == 255) {
+            std::memcpy(d, s, 4);
+            continue;
+        }
+        else if (sa == 0) {
+            continue;
+        }
+
+        auto da = div255(d[3] * (255 - sa));
+        auto a = sa + da;
+        d[0] = static_cast<uint8_t>((s[0] * sa + d[0] * da + a / 2) / a);
+        d[1] = static_cast<uint8_t>((s[1] * sa + d[1] * da + a / 2) / a);
+        d[2] = static_cast<uint8_t>((s[2] * sa + d[2] * da + a / 2) / a);
+        d[3] = static_cast<uint8_t>(a);
+    }
+}
+
+auto graphite::qd::surface_view::fill_rect(const qd::rect& rect, graphite::qd::color color) const -> void
+{
+    auto x0 = std::max(0, static_cast<int>(rect.x()));
+    auto y0 = std::max(0, static_cast<int>(rect.y()));
+    auto x1 = std::min(m_width, rect.x() + rect.width());
+    auto y1 = std::min(m_height, rect.y() + rect.height());
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    for (auto y = y0; y < y1; ++y) {
+        std::fill_n(row(y) + x0, x1 - x0, color);
+    }
+}
+
+auto graphite::qd::surface_view::copy_rect(const surface_view& source, const qd::rect& source_rect, const qd::point& destination) const -> void
+{
+    auto area = clip_area(source.size(), size(), source_rect, destination);
+    if (area.empty()) {
+        return;
+    }
+
+    // When the destination follows the source in memory, visit rows from the bottom so that overlapping rows are
+    // read before they are overwritten.
+    auto bytes = static_cast<std::size_t>(area.width) * sizeof(graphite::qd::color);
+    if (row(area.dst_y) + area.dst_x > source.row(area.src_y) + area.src_x) {
+        for (auto y = area.height - 1; y >= 0; --y) {
+            std::memmove(row(area.dst_y + y) + area.dst_x, source.row(area.src_y + y) + area.src_x, bytes);
+        }
+    }
+    else {
+        for (auto y = 0; y < area.height; ++y) {
+            std::memmove(row(area.dst_y + y) + area.dst_x, source.row(area.src_y + y) + area.src_x, bytes);
+        }
+    }
+}
+
+auto graphite::qd::surface_view::blit(const surface_view& source, const qd::rect& source_rect, const qd::point& destination, enum blend_mode mode) const -> void
+{
+    if (mode == blend_mode::copy) {
+        copy_rect(source, source_rect, destination);
+        return;
+    }
+
+    auto area = clip_area(source.size(), size(), source_rect, destination);
+    if (area.empty()) {
+        return;
+    }
+
+    // Blending reads the destination as it is written, so overlapping blits go through a copy of the source.
+    auto src_first = source.row(area.src_y) + area.src_x;
+    auto src_last = source.row(area.src_y + area.height - 1) + area.src_x + area.width;
+    auto dst_first = row(area.dst_y) + area.dst_x;
+    auto dst_last = row(area.dst_y + area.height - 1) + area.dst_x + area.width;
+    if (src_first < dst_last && dst_first < src_last) {
+        std::vector<graphite::qd::color> pixels(static_cast<std::size_t>(area.width) * area.height, graphite::qd::color::clear());
+        surface_view copy(pixels.data(), area.width, area.height, area.width);
+        copy.copy_rect(source, qd::rect(area.src_x, area.src_y, area.width, area.height), qd::point(0, 0));
+        blit(copy, qd::rect(0, 0, area.width, area.height), qd::point(area.dst_x, area.dst_y), mode);
+        return;
+    }
+
+    auto row_fn = (mode == blend_mode::mask) ? mask_row : blend_row;
+    for (auto y = 0; y < area.height; ++y) {
+        row_fn(source.row(area.src_y + y) + area.src_x, row(area.dst_y + y) + area.dst_x, area.width);
+    }
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QD_SURFACE_VIEW)
+#define GRAPHITE_QD_SURFACE_VIEW
+
+#include <cstddef>
+#include <libGraphite/quickdraw/geometry.hpp>
+#include "libGraphite/quickdraw/internal/color.hpp"
+#include "libGraphite/quickdraw/scanline.hpp"
+
+namespace graphite::qd
+{
+
+    /**
+     * The method used to combine source pixels with destination pixels when blitting between surfaces.
+     */
+    enum class blend_mode : uint8_t
+    {
+        copy,           // Source pixels replace destination pixels.
+        mask,           // Source pixels replace destination pixels, except where the source is fully transparent.
+        alpha,          // Source pixels are composited over destination pixels using the source alpha.
+    };
+
+    /**
+     * The `graphite::qd::surface_view` class references a rectangle of pixels within a surface, without owning
+     * or copying them. Rows of the view are `stride` pixels apart, allowing a view to describe a single frame of
+     * a sprite sheet or any other area of a larger surface.
+     *
+     * A view is only valid for as long as the pixels it references. Views are cheap to copy, and all operations
+     * upon a view read and write the pixels of the surface it references.
+     */
+    class surface_view
+    {
+    private:
+        graphite::qd::color *m_data { nullptr };
+        int m_width { 0 };
+        int m_height { 0 };
+        std::size_t m_stride { 0 };
+
+    public:
+        surface_view() = default;
+
+        /**
+         * Construct a view of the specified pixels.
+         * @param data      The first pixel of the view.
+         * @param width     The width of the view in pixels.
+         * @param height    The height of the view in pixels.
+         * @param stride    The number of pixels from the start of one row to the start of the next.
+         */
+        surface_view(graphite::qd::color *data, int width, int height, std::size_t stride);
+
+        /**
+         * Returns the size of the view.
+         */
+        [[nodiscard]] auto size() const -> qd::size;
+
+        /**
+         * Returns the number of pixels from the start of one row to the start of the next.
+         */
+        [[nodiscard]] auto stride() const -> std::size_t;
+
+        /**
+         * Returns true if the view contains no pixels.
+         */
+        [[nodiscard]] auto empty() const -> bool;
+
+        /**
+         * Returns a pointer to the first pixel of the specified row of the view.
+         *
+         * @note            No bounds checking is performed. The caller must ensure `y` lies within the view.
+         */
+        [[nodiscard]] auto row(int y) const -> graphite::qd::color *
+        {
+            return m_data + static_cast<std::size_t>(y) * m_stride;
+        }
+
+        /**
+         * Returns the color at the specified coordinate within the view.
+         */
+        [[nodiscard]] auto at(int x, int y) const -> graphite::qd::color;
+
+        /**
+         * Set the color at the specified coordinate within the view.
+         */
+        auto set(int x, int y, graphite::qd::color color) const -> void;
+
+        /**
+         * Returns a view of a rectangle within this view. The rectangle is clipped to this view.
+         */
+        [[nodiscard]] auto subview(const qd::rect& rect) const -> surface_view;
+
+        /**
+         * Returns a pixel buffer describing the pixels of the view, allowing decoders to write directly into it.
+         */
+        [[nodiscard]] auto buffer() const -> qd::pixel_buffer;
+
+        /**
+         * Fill a rectangle of the view with the color specified. The rectangle is clipped to the view.
+         * @param rect      The area of the view to fill.
+         * @param color     The color to fill with.
+         */
+        auto fill_rect(const qd::rect& rect, graphite::qd::color color) const -> void;
+
+        /**
+         * Copy a rectangle of pixels from a source view into this view, replacing the existing pixels.
+         * The source and destination areas are clipped to their respective views. The source and destination
+         * may reference the same pixels, in which case the areas may overlap.
+         * @param source        The view to copy pixels from.
+         * @param source_rect   The area of the source view to copy.
+         * @param destination   The position in this view that the top left corner of the area is copied to.
+         */
+        auto copy_rect(const surface_view& source, const qd::rect& source_rect, const qd::point& destination) const -> void;
+
+        /**
+         * Blit a rectangle of pixels from a source view into this view, combining them with the existing pixels
+         * using the blend mode specified. Clipping is performed as for `copy_rect`.
+         * @param source        The view to blit pixels from.
+         * @param source_rect   The area of the source view to blit.
+         * @param destination   The position in this view that the top left corner of the area is blitted to.
+         * @param mode          How source pixels are combined with the existing pixels.
+         */
+        auto blit(const surface_view& source, const qd::rect& source_rect, const qd::point& destination, enum blend_mode mode = blend_mode::copy) const -> void;
+    };
+
+}
+
+#endif //GRAPHITE_QD_SURFACE_VIEW
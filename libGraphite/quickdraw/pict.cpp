@@ -2,12 +2,20 @@
 // Created by Tom Hancocks on 20/02/2020.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <stdexcept>
 #include <libGraphite/rsrc/manager.hpp>
 #include "libGraphite/quickdraw/pict.hpp"
 #include "libGraphite/quickdraw/internal/packbits.hpp"
+#include "libGraphite/quickdraw/internal/scanline_emitter.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
+#include "libGraphite/quickdraw/internal/rasterizer.hpp"
 #include "libGraphite/quickdraw/clut.hpp"
 #include "libGraphite/quicktime/imagedesc.hpp"
+#include "libGraphite/concurrency/thread_pool.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Constants
 
@@ -16,12 +24,20 @@
 
 // MARK: - Constructors
 
-graphite::qd::pict::pict(std::shared_ptr<graphite::data::data> data, int64_t id, std::string name)
-    : m_surface(nullptr), m_frame(0, 0, 100, 100), m_id(id), m_name(std::move(name))
+graphite::qd::pict::pict(std::shared_ptr<graphite::data::data> data, int64_t id, std::string name, graphite::qd::pict_decode_options options)
+    : m_surface(nullptr), m_frame(0, 0, 100, 100), m_id(id), m_name(std::move(name)), m_options(options)
 {
     // Setup a reader for the PICT data, and then parse it.
     data::reader pict_reader(std::move(data));
-    parse(pict_reader);
+    if (auto error = parse(pict_reader)) {
+        error.raise();
+    }
+}
+
+graphite::qd::pict::pict(int64_t id, std::string name, graphite::qd::pict_decode_options options)
+    : m_surface(nullptr), m_frame(0, 0, 100, 100), m_id(id), m_name(std::move(name)), m_options(options)
+{
+
 }
 
 graphite::qd::pict::pict(std::shared_ptr<graphite::qd::surface> surface)
@@ -30,14 +46,37 @@ graphite::qd::pict::pict(std::shared_ptr<graphite::qd::surface> surface)
 
 }
 
-auto graphite::qd::pict::load_resource(int64_t id) -> std::shared_ptr<graphite::qd::pict>
+auto graphite::qd::pict::load_resource(int64_t id, graphite::qd::pict_decode_options options) -> std::shared_ptr<graphite::qd::pict>
 {
+    GRAPHITE_TRACE_SCOPE("qd::pict::load_resource");
     if (auto pict_res = graphite::rsrc::manager::shared_manager().find("PICT", id).lock()) {
-        return std::make_shared<graphite::qd::pict>(pict_res->data(), id, pict_res->name());
+        return std::make_shared<graphite::qd::pict>(pict_res->data(), id, pict_res->name(), options);
     }
     return nullptr;
 }
 
+auto graphite::qd::pict::try_parse(std::shared_ptr<graphite::data::data> data, int64_t id, std::string name, graphite::qd::pict_decode_options options) -> graphite::result<std::shared_ptr<graphite::qd::pict>>
+{
+    auto picture = std::shared_ptr<graphite::qd::pict>(new graphite::qd::pict(id, std::move(name), options));
+    data::reader pict_reader(std::move(data));
+    if (auto error = graphite::guarded_decode(pict_reader, [&] { return picture->parse(pict_reader); })) {
+        return error;
+    }
+    return picture;
+}
+
+auto graphite::qd::pict::probe(std::shared_ptr<graphite::data::data> data) -> graphite::result<graphite::qd::image_info>
+{
+    GRAPHITE_TRACE_SCOPE("qd::pict::probe");
+    pict picture(0, "", {});
+    graphite::qd::image_info info;
+    data::reader reader(std::move(data));
+    if (auto error = graphite::guarded_decode(reader, [&] { return picture.read_picture(reader, &info); })) {
+        return error;
+    }
+    return info;
+}
+
 auto graphite::qd::pict::from_surface(std::shared_ptr<graphite::qd::surface> surface) -> std::shared_ptr<graphite::qd::pict>
 {
     return std::make_shared<graphite::qd::pict>(surface);
@@ -55,16 +94,371 @@ auto graphite::qd::pict::format() const -> uint32_t
     return m_format;
 }
 
+auto graphite::qd::pict::decode_pool() const -> graphite::concurrency::thread_pool *
+{
+    if (!m_options.parallel) {
+        return nullptr;
+    }
+    return m_options.pool ? m_options.pool : &graphite::concurrency::thread_pool::shared_pool();
+}
+
 // MARK: - Helper Functions
 
-static inline auto read_bytes(graphite::data::reader& pict_reader, std::size_t size) -> std::vector<uint8_t>
+static inline auto remaining(const graphite::data::reader& pict_reader) -> std::size_t
+{
+    return pict_reader.position() < pict_reader.size() ? pict_reader.size() - pict_reader.position() : 0;
+}
+
+static inline auto truncated(const graphite::data::reader& pict_reader) -> graphite::decode_error
 {
-    auto out = std::vector<uint8_t>(size);
-    auto in = pict_reader.read_bytes(size);
-    for (auto i = 0; i < in.size(); ++i) {
-        out[i] = in[i];
+    return graphite::decode_error(graphite::error_code::truncated_data, pict_reader.position(), "PICT image data is truncated.");
+}
+
+static inline auto truncated(uint64_t offset) -> graphite::decode_error
+{
+    return graphite::decode_error(graphite::error_code::truncated_data, offset, "PICT image data is truncated.");
+}
+
+static inline auto current_bytes(graphite::data::reader& pict_reader) -> const uint8_t *
+{
+    auto data = pict_reader.get();
+    return reinterpret_cast<const uint8_t *>(data->get()->data()) + data->relative_offset(pict_reader.position());
+}
+
+static inline auto unpack_row(std::vector<uint8_t>& row_buffer, const uint8_t *packed_data, std::size_t packed_size, std::size_t value_size) -> std::size_t
+{
+    // Leave some slack at the end of the buffer so that short runs can be expanded using whole vector stores.
+    auto row_size = graphite::qd::packbits::decoded_size(packed_data, packed_size, value_size);
+    if (row_size + 16 > row_buffer.size()) {
+        row_buffer.resize(row_size + 16);
     }
-    return out;
+    return graphite::qd::packbits::decode(row_buffer.data(), row_buffer.size(), packed_data, packed_size, value_size);
+}
+
+/**
+ * Read an RGB color, whose components are each 16 bits.
+ */
+static inline auto read_rgb_color(graphite::data::reader& pict_reader) -> graphite::qd::color
+{
+    auto red = pict_reader.read_short();
+    auto green = pict_reader.read_short();
+    auto blue = pict_reader.read_short();
+    return graphite::qd::color(red >> 8, green >> 8, blue >> 8);
+}
+
+/**
+ * Convert one of the eight colors of the original QuickDraw, as used by the `fg_color` and `bg_color` opcodes.
+ */
+static inline auto classic_color(uint32_t color) -> graphite::qd::color
+{
+    switch (color) {
+        case 30: return graphite::qd::color::white();
+        case 69: return graphite::qd::color(255, 255, 0);
+        case 137: return graphite::qd::color(255, 0, 255);
+        case 205: return graphite::qd::color(255, 0, 0);
+        case 273: return graphite::qd::color(0, 255, 255);
+        case 341: return graphite::qd::color(0, 255, 0);
+        case 409: return graphite::qd::color(0, 0, 255);
+        default: return graphite::qd::color::black();
+    }
+}
+
+/**
+ * Returns the operation applied to the shape of a rect or region drawing opcode. The opcodes of each shape are
+ * ordered frame, paint, erase, invert and fill.
+ */
+static inline auto drawing_verb(graphite::qd::pict::opcode op) -> graphite::qd::rasterizer::verb
+{
+    switch (op & 0x7) {
+        case 0: return graphite::qd::rasterizer::verb::frame;
+        case 1: return graphite::qd::rasterizer::verb::paint;
+        case 2: return graphite::qd::rasterizer::verb::erase;
+        case 3: return graphite::qd::rasterizer::verb::invert;
+        default: return graphite::qd::rasterizer::verb::fill;
+    }
+}
+
+// MARK: - Row Kernels
+
+static_assert(sizeof(graphite::qd::color) == 4, "Vectorised row kernels expect surface colors to be packed RGBA bytes.");
+
+/**
+ * Row kernels convert a single row of unpacked pixel data into surface pixels. A kernel is selected once per
+ * bits rect based upon the pack type and component layout of the pixmap.
+ */
+typedef void (*pict_row_kernel)(const uint8_t *src, graphite::qd::color *dst, int count, std::size_t plane_bytes);
+
+static auto unpack_rgb_row(const uint8_t *__restrict src, graphite::qd::color *__restrict dst, int count, std::size_t) -> void
+{
+    graphite::qd::pixel_conversion::rgb_to_color(src, dst, count);
+}
+
+static auto unpack_argb_row(const uint8_t *__restrict src, graphite::qd::color *__restrict dst, int count, std::size_t) -> void
+{
+    // The alpha channel of direct pixmaps is unused by QuickDraw, so is always treated as opaque.
+    graphite::qd::pixel_conversion::xrgb_to_color(src, dst, count);
+}
+
+static auto unpack_rgb555_row(const uint8_t *__restrict src, graphite::qd::color *__restrict dst, int count, std::size_t) -> void
+{
+    graphite::qd::pixel_conversion::rgb555_to_color(src, dst, count);
+}
+
+static auto unpack_component_row(const uint8_t *__restrict src, graphite::qd::color *__restrict dst, int count, std::size_t plane_bytes) -> void
+{
+    graphite::qd::pixel_conversion::planar_to_color(src, src + plane_bytes, src + 2 * plane_bytes, dst, count);
+}
+
+// MARK: - Scanlines
+
+/**
+ * The number of pixels a bits rect must cover before its rows are decoded in parallel.
+ */
+static constexpr std::size_t parallel_decode_threshold = 256 * 256;
+
+/**
+ * The number of rows of a picture containing drawing opcodes that are drawn at a time while streaming.
+ */
+static constexpr int stream_band_rows = 64;
+
+/**
+ * The location of a single row of bits rect data within the picture.
+ */
+struct pict_scanline
+{
+    const uint8_t *data;
+    std::size_t size;
+    uint64_t end;
+};
+
+/**
+ * Locate each row of a bits rect. Packed rows are prefixed by their length, so this only reads the row headers,
+ * leaving the reader positioned after the final row. Returns false if the picture data is truncated.
+ */
+static auto locate_scanlines(graphite::data::reader& pict_reader, int height, std::size_t row_bytes, bool packed, std::vector<pict_scanline>& rows) -> bool
+{
+    rows.clear();
+    rows.reserve(std::max(height, 0));
+    for (auto y = 0; y < height; ++y) {
+        std::size_t size = row_bytes;
+        if (packed) {
+            if (remaining(pict_reader) < (row_bytes > 250 ? 2 : 1)) {
+                return false;
+            }
+            size = row_bytes > 250 ? pict_reader.read_short() : pict_reader.read_byte();
+        }
+        if (size > remaining(pict_reader)) {
+            return false;
+        }
+        auto data = current_bytes(pict_reader);
+        pict_reader.move(size);
+        rows.push_back({ data, size, pict_reader.position() });
+    }
+    return true;
+}
+
+/**
+ * Decode `row_count` rows using `decode_row`, which is given a scratch buffer for unpacking and returns false if
+ * the row has insufficient data. When a thread pool is provided and the rows cover enough pixels, bands of rows
+ * are decoded in parallel. Returns the index of the first row that failed to decode, or `row_count` if every row
+ * was decoded.
+ */
+static auto decode_scanlines(
+    std::size_t row_count,
+    std::size_t pixel_count,
+    graphite::concurrency::thread_pool *pool,
+    const std::function<bool(std::size_t, std::vector<uint8_t>&)>& decode_row
+) -> std::size_t
+{
+    std::atomic<std::size_t> first_failure { row_count };
+    auto decode_band = [&] (std::size_t begin, std::size_t end) {
+        std::vector<uint8_t> row_buffer;
+        for (auto y = begin; y < end; ++y) {
+            if (!decode_row(y, row_buffer)) {
+                auto failure = first_failure.load();
+                while (y < failure && !first_failure.compare_exchange_weak(failure, y)) {}
+                return;
+            }
+        }
+    };
+
+    if (pool && pool->concurrency() > 1 && pixel_count >= parallel_decode_threshold) {
+        auto bands = pool->concurrency() * 4;
+        pool->parallel_for(row_count, (row_count + bands - 1) / bands, decode_band);
+    }
+    else {
+        decode_band(0, row_count);
+    }
+    return first_failure;
+}
+
+// MARK: - Bits Rects
+
+/**
+ * A bits rect whose rows have been located, along with everything needed to decode any one of its rows into
+ * the picture frame.
+ */
+struct graphite::qd::pict::bits_layout
+{
+    pict_row_kernel kernel { nullptr };
+    std::size_t kernel_offset { 0 };
+    std::size_t plane_bytes { 0 };
+    std::vector<qd::color> palette;
+    int pixel_size { 0 };
+    std::size_t required_bytes { 0 };
+    bool packed { false };
+    std::size_t value_size { sizeof(uint8_t) };
+    int x { 0 };
+    int y { 0 };
+    int width { 0 };
+    std::size_t row_count { 0 };
+    std::vector<pict_scanline> rows;
+};
+
+/**
+ * The state of a streaming decode. Bits rects are collected while the opcodes are read, and composited a row at a
+ * time once the whole picture has been read. Drawing operations are recorded in order alongside the bits rects, so
+ * that a picture containing them can be replayed onto one band of rows at a time.
+ */
+struct graphite::qd::pict::stream_state
+{
+    /**
+     * A step of the picture, which is either the bits rect at index `bits` or, when `draw` is set, a drawing operation.
+     */
+    struct step
+    {
+        std::size_t bits { 0 };
+        std::function<void(qd::rasterizer&)> draw;
+    };
+
+    graphite::qd::scanline_emitter *rows { nullptr };
+    std::vector<bits_layout> bits;
+    std::vector<step> steps;
+    graphite::qd::point origin { graphite::qd::point::zero() };
+    int band_top { 0 };
+    bool delegated { false };
+    bool drawn { false };
+};
+
+auto graphite::qd::pict::decode_bits_row(const bits_layout& bits, std::size_t y, std::vector<uint8_t>& row_buffer, qd::color *dst) -> bool
+{
+    const auto& scanline = bits.rows[y];
+    auto row = scanline.data;
+    auto row_size = scanline.size;
+    if (bits.packed) {
+        row_size = unpack_row(row_buffer, scanline.data, scanline.size, bits.value_size);
+        row = row_buffer.data();
+    }
+    if (row_size < bits.required_bytes) {
+        return false;
+    }
+    if (bits.kernel) {
+        bits.kernel(row + bits.kernel_offset, dst, bits.width, bits.plane_bytes);
+    }
+    else {
+        graphite::qd::pixel_conversion::indices_to_color(row, 0, bits.pixel_size, bits.palette, dst, bits.width);
+    }
+    return true;
+}
+
+auto graphite::qd::pict::draw_bits_rect(bits_layout& bits) -> graphite::decode_error
+{
+    if (m_stream) {
+        m_stream->bits.emplace_back(std::move(bits));
+        m_stream->steps.push_back({ m_stream->bits.size() - 1, {} });
+        return {};
+    }
+
+    auto failed_row = decode_scanlines(bits.row_count, bits.row_count * bits.width, decode_pool(), [&] (std::size_t y, std::vector<uint8_t>& row_buffer) {
+        return decode_bits_row(bits, y, row_buffer, m_surface->row(bits.y + y) + bits.x);
+    });
+    if (failed_row < bits.row_count) {
+        return truncated(bits.rows[failed_row].end);
+    }
+    return {};
+}
+
+// MARK: - Streaming
+
+auto graphite::qd::pict::emit_stream() -> graphite::decode_error
+{
+    auto& emitter = *m_stream->rows;
+    emitter.begin(m_frame.width(), m_frame.height());
+
+    std::vector<uint8_t> row_buffer;
+    if (!m_stream->drawn) {
+        for (auto y = 0; y < emitter.height(); ++y, emitter.advance()) {
+            for (const auto& bits : m_stream->bits) {
+                if (y < bits.y || y >= bits.y + static_cast<int>(bits.row_count)) {
+                    continue;
+                }
+                if (!decode_bits_row(bits, y - bits.y, row_buffer, emitter.pixels() + bits.x)) {
+                    return truncated(bits.rows[y - bits.y].end);
+                }
+            }
+        }
+        return {};
+    }
+
+    // Drawing may cover any part of the picture, so every step of the picture is replayed onto each band of rows in
+    // turn, with the rasterizer clipping what it draws to the band.
+    graphite::qd::surface band(emitter.width(), std::min(stream_band_rows, emitter.height()));
+    for (auto top = 0; top < emitter.height(); top += band.size().height()) {
+        auto band_rows = std::min<int>(band.size().height(), emitter.height() - top);
+        for (auto y = 0; y < band.size().height(); ++y) {
+            std::fill_n(band.row(y), band.size().width(), graphite::qd::color::clear());
+        }
+
+        m_stream->band_top = top;
+        qd::rasterizer raster(&band, qd::point(m_stream->origin.x(), static_cast<int16_t>(m_stream->origin.y() + top)));
+        for (const auto& step : m_stream->steps) {
+            if (step.draw) {
+                step.draw(raster);
+                continue;
+            }
+            const auto& bits = m_stream->bits[step.bits];
+            auto first = std::max(bits.y, top);
+            auto last = std::min(bits.y + static_cast<int>(bits.row_count), top + band_rows);
+            for (auto y = first; y < last; ++y) {
+                if (!decode_bits_row(bits, y - bits.y, row_buffer, band.row(y - top) + bits.x)) {
+                    return truncated(bits.rows[y - bits.y].end);
+                }
+            }
+        }
+
+        for (auto y = 0; y < band_rows; ++y, emitter.advance()) {
+            std::copy_n(band.row(y), emitter.width(), emitter.pixels());
+        }
+    }
+    return {};
+}
+
+auto graphite::qd::pict::stream(std::shared_ptr<graphite::data::data> data, enum pixel_format format, const qd::scanline_callback& callback) -> graphite::decode_error
+{
+    graphite::qd::scanline_emitter rows(format, callback);
+    return decode_rows(std::move(data), rows);
+}
+
+auto graphite::qd::pict::decode_into(std::shared_ptr<graphite::data::data> data, const qd::pixel_buffer& buffer) -> graphite::decode_error
+{
+    graphite::qd::scanline_emitter rows(buffer);
+    return decode_rows(std::move(data), rows);
+}
+
+auto graphite::qd::pict::decode_rows(std::shared_ptr<graphite::data::data> data, graphite::qd::scanline_emitter& rows) -> graphite::decode_error
+{
+    GRAPHITE_TRACE_SCOPE("qd::pict::decode_rows");
+    pict picture(0, "", {});
+    stream_state state;
+    state.rows = &rows;
+    picture.m_stream = &state;
+    data::reader reader(std::move(data));
+    return graphite::guarded_decode(reader, [&] () -> graphite::decode_error {
+        if (auto error = picture.read_picture(reader, nullptr)) {
+            return error;
+        }
+        return state.delegated ? graphite::decode_error() : picture.emit_stream();
+    });
 }
 
 // MARK: - Parsing / Reading
@@ -91,7 +485,7 @@ auto graphite::qd::pict::read_long_comment(graphite::data::reader& pict_reader)
     pict_reader.move(length);
 }
 
-auto graphite::qd::pict::read_indirect_bits_rect(graphite::data::reader& pict_reader, bool packed, bool region) -> void
+auto graphite::qd::pict::read_indirect_bits_rect(graphite::data::reader& pict_reader, bool packed, bool region) -> graphite::decode_error
 {
     qd::pixmap pm;
     qd::clut color_table;
@@ -99,6 +493,9 @@ auto graphite::qd::pict::read_indirect_bits_rect(graphite::data::reader& pict_re
     bool is_pixmap = pict_reader.read_short(0, data::reader::peek) & 0x8000;
     if (is_pixmap) {
         // The pixmap base address is omitted here, step back when reading
+        if (remaining(pict_reader) + sizeof(uint32_t) < qd::pixmap::length) {
+            return truncated(pict_reader);
+        }
         pm = qd::pixmap(pict_reader.read_data(qd::pixmap::length, -sizeof(uint32_t)));
         // Color Table
         color_table = qd::clut(pict_reader);
@@ -117,63 +514,80 @@ auto graphite::qd::pict::read_indirect_bits_rect(graphite::data::reader& pict_re
 
     m_format = pm.pixel_size();
 
-    // Read the source and destination bounds
-    auto source_rect = qd::rect::read(pict_reader, qd::rect::qd);
+    // Read the destination bounds. The source bounds and transfer mode are not needed to place the bits.
+    pict_reader.move(8);
     auto destination_rect = qd::rect::read(pict_reader, qd::rect::qd);
-
-    auto transfer_mode = pict_reader.read_short();
+    pict_reader.move(2);
     
     if (region) {
         read_region(pict_reader);
     }
 
-    // Setup pixel buffer for raw values
-    std::vector<uint8_t> raw;
     auto row_bytes = pm.row_bytes();
-    auto width = pm.bounds().width();
     auto height = pm.bounds().height();
     
-    if (packed && row_bytes >= 8) {
-        uint16_t packed_bytes_count = 0;
-        for (auto y = 0; y < height; ++y) {
-            if (row_bytes > 250) {
-                packed_bytes_count = pict_reader.read_short();
-            }
-            else {
-                packed_bytes_count = pict_reader.read_byte();
-            }
+    destination_rect.set_x(destination_rect.x() - m_frame.x());
+    destination_rect.set_y(destination_rect.y() - m_frame.y());
+    auto pixel_size = pm.cmp_size() * pm.cmp_count();
+    if (pixel_size != 1 && pixel_size != 2 && pixel_size != 4 && pixel_size != 8) {
+        return graphite::decode_error(graphite::error_code::unsupported_depth, pict_reader.position(),
+                                      "Unsupported PICT pixmap depth " + std::to_string(pixel_size) + ": " + std::to_string(m_id) + ", " + m_name);
+    }
+    if (destination_rect.width() > row_bytes * (8 / pixel_size)) {
+        return graphite::decode_error(graphite::error_code::invalid_structure, pict_reader.position(),
+                                      "PICT bits destination is wider than its rows: " + std::to_string(m_id) + ", " + m_name);
+    }
+    if (destination_rect.x() < 0 || destination_rect.y() < 0 || destination_rect.y() + destination_rect.height() > m_frame.height()) {
+        return graphite::decode_error(graphite::error_code::invalid_structure, pict_reader.position(),
+                                      "PICT bits destination lies outside of the picture frame: " + std::to_string(m_id) + ", " + m_name);
+    }
 
-            auto packed_data = read_bytes(pict_reader, packed_bytes_count);
-            qd::packbits::decode(raw, packed_data, sizeof(uint8_t));
-        }
+    // Expand the color table once, so that each byte of a row can be unpacked with a single lookup.
+    bits_layout bits;
+    std::vector<qd::color> colors;
+    for (auto i = 0; i < std::min(color_table.size(), 256); ++i) {
+        colors.emplace_back(color_table.get(i));
     }
-    else {
-        raw = read_bytes(pict_reader, row_bytes * height);
+    bits.palette = qd::pixel_conversion::index_table(colors.data(), colors.size(), pixel_size);
+    bits.pixel_size = pixel_size;
+
+    // Pixels beyond the right hand edge of the frame are clipped.
+    bits.x = destination_rect.x();
+    bits.y = destination_rect.y();
+    bits.width = std::min(static_cast<int>(destination_rect.width()), m_frame.width() - destination_rect.x());
+    bits.required_bytes = (destination_rect.width() * pixel_size + 7) / 8;
+
+    // Locate every row before decoding, so that the rows can be decoded independently of one another.
+    bits.packed = packed && row_bytes >= 8;
+    if (!locate_scanlines(pict_reader, height, row_bytes, bits.packed, bits.rows) || height < destination_rect.height()) {
+        return truncated(pict_reader);
     }
-    
-    destination_rect.set_x(destination_rect.x() - m_frame.x());
-    destination_rect.set_y(destination_rect.y() - m_frame.y());
-    pm.build_surface(m_surface, raw, color_table, destination_rect);
+    if (bits.width <= 0 || destination_rect.height() <= 0) {
+        return {};
+    }
+
+    bits.row_count = static_cast<std::size_t>(destination_rect.height());
+    return draw_bits_rect(bits);
 }
 
-auto graphite::qd::pict::read_direct_bits_rect(graphite::data::reader &pict_reader, bool region) -> void
+auto graphite::qd::pict::read_direct_bits_rect(graphite::data::reader &pict_reader, bool region) -> graphite::decode_error
 {
+    if (remaining(pict_reader) < qd::pixmap::length) {
+        return truncated(pict_reader);
+    }
     graphite::qd::pixmap pm = graphite::qd::pixmap(pict_reader.read_data(qd::pixmap::length));
 
     m_format = pm.pixel_size() == 16 ? 16 : pm.cmp_size() * pm.cmp_count();
 
-    // Read the source and destination bounds
-    auto source_rect = qd::rect::read(pict_reader, qd::rect::qd);
+    // Read the destination bounds. The source bounds and transfer mode are not needed to place the bits.
+    pict_reader.move(8);
     auto destination_rect = qd::rect::read(pict_reader, qd::rect::qd);
-
-    auto transfer_mode = pict_reader.read_short();
+    pict_reader.move(2);
     
     if (region) {
         read_region(pict_reader);
     }
     
-    // Setup pixel buffer for raw values
-    std::vector<uint8_t> raw;
     auto row_bytes = pm.row_bytes();
     auto width = pm.bounds().width();
     auto height = pm.bounds().height();
@@ -185,6 +599,10 @@ auto graphite::qd::pict::read_direct_bits_rect(graphite::data::reader &pict_read
     auto copy_y = destination_rect.y() - m_frame.y();
     auto copy_w = std::min(destination_rect.width(), static_cast<int16_t>(m_frame.width() - copy_x));
     auto copy_h = std::min(destination_rect.height(), static_cast<int16_t>(m_frame.height() - copy_y));
+    if (copy_x < 0 || copy_y < 0) {
+        return graphite::decode_error(graphite::error_code::invalid_structure, pict_reader.position(),
+                                      "PICT bits destination lies outside of the picture frame: " + std::to_string(m_id) + ", " + m_name);
+    }
 
     // When row bytes < 8, data is never packed. Raw format will instead match the pixel size, either 16-bit words or 32-bit argb.
     auto packed = row_bytes >= 8 && pack_type >= packbits_word;
@@ -195,71 +613,55 @@ auto graphite::qd::pict::read_direct_bits_rect(graphite::data::reader &pict_read
         row_bytes = width * 3;
     }
 
-    for (auto y = 0; y < height; ++y) {
-        if (packed) {
-            raw.clear();
-            uint16_t packed_bytes_count;
-            if (row_bytes > 250) {
-                packed_bytes_count = pict_reader.read_short();
-            }
-            else {
-                packed_bytes_count = pict_reader.read_byte();
-            }
-
-            // Create a temporary buffer to read the packed data into, on the stack.
-            auto packed_data = read_bytes(pict_reader, packed_bytes_count);
-            qd::packbits::decode(raw, packed_data, pack_type == packbits_word ? sizeof(uint16_t) : sizeof(uint8_t));
+    // Select the row kernel for the rect once, along with the number of bytes it needs from each row.
+    bits_layout bits;
+    bits.plane_bytes = width;
+    switch (pack_type) {
+        case none:
+        case rgb: {
+            bits.kernel = unpack_rgb_row;
+            bits.required_bytes = copy_w * 3;
+            break;
         }
-        else {
-            raw = read_bytes(pict_reader, row_bytes);
+        case argb: {
+            bits.kernel = unpack_argb_row;
+            bits.required_bytes = copy_w * 4;
+            break;
         }
-
-        if (y >= copy_h) {
-            continue;
+        case packbits_word: {
+            bits.kernel = unpack_rgb555_row;
+            bits.required_bytes = copy_w * 2;
+            break;
         }
-
-        for (auto x = 0; x < copy_w; ++x) {
-            switch (pack_type) {
-                case none:
-                case rgb: {
-                    graphite::qd::color color(raw[3 * x],
-                                              raw[3 * x + 1],
-                                              raw[3 * x + 2]);
-                    m_surface->set(x + copy_x, y + copy_y, color);
-                    break;
-                }
-                case argb: {
-                    graphite::qd::color color(raw[4 * x + 1],
-                                              raw[4 * x + 2],
-                                              raw[4 * x + 3]);
-                    m_surface->set(x + copy_x, y + copy_y, color);
-                    break;
-                }
-                case packbits_word: {
-                    graphite::qd::color color((raw[2 * x] << 8) | (raw[2 * x + 1]));
-                    m_surface->set(x + copy_x, y + copy_y, color);
-                    break;
-                }
-                case packbits_component: {
-                    if (cmp_count == 3) {
-                        graphite::qd::color color(raw[x],
-                                                  raw[width + x],
-                                                  raw[2 * width + x]);
-                        m_surface->set(x + copy_x, y + copy_y, color);
-                    } else if (cmp_count == 4) {
-                        graphite::qd::color color(raw[width + x],
-                                                  raw[2 * width + x],
-                                                  raw[3 * width + x]);
-                        m_surface->set(x + copy_x, y + copy_y, color);
-                    }
-                    break;
-                }
+        case packbits_component: {
+            // Components are stored as consecutive planes, with the alpha plane first when present.
+            if (cmp_count == 3 || cmp_count == 4) {
+                bits.kernel = unpack_component_row;
+                bits.kernel_offset = (cmp_count - 3) * width;
             }
+            bits.required_bytes = std::max<std::size_t>(width * cmp_count, bits.kernel_offset + 2 * width + copy_w);
+            break;
         }
     }
+
+    // Locate every row before decoding, so that the rows can be decoded independently of one another.
+    bits.packed = packed;
+    if (!locate_scanlines(pict_reader, height, row_bytes, packed, bits.rows) || height < copy_h) {
+        return truncated(pict_reader);
+    }
+    if (copy_w <= 0 || copy_h <= 0 || !bits.kernel) {
+        return {};
+    }
+
+    bits.value_size = pack_type == packbits_word ? sizeof(uint16_t) : sizeof(uint8_t);
+    bits.x = copy_x;
+    bits.y = copy_y;
+    bits.width = copy_w;
+    bits.row_count = std::min(static_cast<std::size_t>(copy_h), bits.rows.size());
+    return draw_bits_rect(bits);
 }
 
-auto graphite::qd::pict::read_compressed_quicktime(graphite::data::reader &pict_reader) -> void
+auto graphite::qd::pict::read_compressed_quicktime(graphite::data::reader &pict_reader) -> graphite::decode_error
 {
     // http://mirror.informatimago.com/next/developer.apple.com/documentation/QuickTime/INMAC/QT/iqImageCompMgr.a.htm
     auto length = pict_reader.read_long();
@@ -272,19 +674,96 @@ auto graphite::qd::pict::read_compressed_quicktime(graphite::data::reader &pict_
     auto mask_size = pict_reader.read_long();
     
     if (matte_size > 0) {
-        auto matte = qt::imagedesc(pict_reader);
+        auto matte = qt::imagedesc::try_parse(pict_reader);
+        if (!matte) {
+            return matte.error();
+        }
     }
     
     if (mask_size > 0) {
         pict_reader.move(mask_size);
     }
     
-    auto imagedesc = qt::imagedesc(pict_reader);
-    m_surface = imagedesc.surface();
-    m_format = imagedesc.compressor();
+    if (m_stream) {
+        // The image description replaces the picture entirely, so it can stream its rows directly.
+        m_stream->delegated = true;
+        return qt::imagedesc::decode_rows(pict_reader, *m_stream->rows);
+    }
+
+    auto imagedesc = qt::imagedesc::try_parse(pict_reader);
+    if (!imagedesc) {
+        return imagedesc.error();
+    }
+    m_surface = imagedesc.value().surface();
+    m_format = imagedesc.value().compressor();
+    return {};
+}
+
+auto graphite::qd::pict::probe_indirect_bits_rect(graphite::data::reader& pict_reader, graphite::qd::image_info& info) const -> graphite::decode_error
+{
+    if (pict_reader.read_short(0, data::reader::peek) & 0x8000) {
+        // The pixmap base address is omitted here, step back when reading
+        if (remaining(pict_reader) + sizeof(uint32_t) < qd::pixmap::length) {
+            return truncated(pict_reader);
+        }
+        qd::pixmap pm(pict_reader.read_data(qd::pixmap::length, -sizeof(uint32_t)));
+        info.depth = pm.pixel_size();
+        info.pack_type = pm.pack_type();
+    }
+    else {
+        info.depth = 1;
+    }
+    info.frame = m_frame;
+    return {};
+}
+
+auto graphite::qd::pict::probe_direct_bits_rect(graphite::data::reader& pict_reader, graphite::qd::image_info& info) const -> graphite::decode_error
+{
+    if (remaining(pict_reader) < qd::pixmap::length) {
+        return truncated(pict_reader);
+    }
+    qd::pixmap pm(pict_reader.read_data(qd::pixmap::length));
+    info.depth = pm.pixel_size() == 16 ? 16 : pm.cmp_size() * pm.cmp_count();
+    info.pack_type = pm.pack_type();
+    info.frame = m_frame;
+    return {};
+}
+
+auto graphite::qd::pict::probe_compressed_quicktime(graphite::data::reader& pict_reader, graphite::qd::image_info& info) const -> graphite::decode_error
+{
+    // Mirrors read_compressed_quicktime(), but only reads the image descriptions.
+    pict_reader.move(42);
+    auto matte_size = pict_reader.read_long();
+    pict_reader.move(22);
+    auto mask_size = pict_reader.read_long();
+
+    if (matte_size > 0) {
+        auto matte = qt::imagedesc::probe(pict_reader);
+        if (!matte) {
+            return matte.error();
+        }
+    }
+
+    if (mask_size > 0) {
+        pict_reader.move(mask_size);
+    }
+
+    auto imagedesc = qt::imagedesc::probe(pict_reader);
+    if (!imagedesc) {
+        return imagedesc.error();
+    }
+    info = imagedesc.value();
+    return {};
 }
 
-auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
+auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> graphite::decode_error
+{
+    GRAPHITE_TRACE_SCOPE("qd::pict::decode");
+    GRAPHITE_TRACE_BYTES(pict_reader.size());
+    return read_picture(pict_reader, nullptr);
+}
+
+auto graphite::qd::pict::read_picture(graphite::data::reader& pict_reader, graphite::qd::image_info *info) -> graphite::decode_error
 {
     pict_reader.move(2);
 
@@ -297,13 +776,14 @@ auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
         v1 = true;
     } else {
         if (pict_reader.read_long() != kPICT_V2_MAGIC) {
-            throw std::runtime_error("Invalid PICT resource. Incorrect header: " + std::to_string(m_id) + ", " + m_name);
+            return graphite::decode_error(graphite::error_code::invalid_header, pict_reader.position(),
+                                          "Invalid PICT resource. Incorrect header: " + std::to_string(m_id) + ", " + m_name);
         }
         
         // The very first thing we should find is an extended header opcode. Read this
         // outside of the main opcode loop as it should only appear once.
         if (static_cast<opcode>(pict_reader.read_short()) != opcode::ext_header) {
-            throw std::runtime_error("Expected to find PICT Extended Header.");
+            return graphite::decode_error(graphite::error_code::invalid_header, pict_reader.position(), "Expected to find PICT Extended Header.");
         }
 
         if ((pict_reader.read_long() >> 16) != 0xFFFE) {
@@ -325,7 +805,8 @@ auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
         }
 
         if (m_x_ratio <= 0 || m_y_ratio <= 0) {
-            throw std::runtime_error("Invalid PICT resource. Content aspect ratio is not valid: " + std::to_string(m_id) + ", " + m_name);
+            return graphite::decode_error(graphite::error_code::invalid_header, pict_reader.position(),
+                                          "Invalid PICT resource. Content aspect ratio is not valid: " + std::to_string(m_id) + ", " + m_name);
         }
         
         pict_reader.move(4);
@@ -334,7 +815,31 @@ auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
     // Begin parsing PICT opcodes.
     qd::rect clip_rect(0, 0, 0, 0);
 
-    m_surface = std::make_shared<graphite::qd::surface>(m_frame.width(), m_frame.height());
+    if (m_frame.width() < 0 || m_frame.height() < 0) {
+        return graphite::decode_error(graphite::error_code::invalid_header, pict_reader.position(),
+                                      "Invalid PICT resource. Frame size is not valid: " + std::to_string(m_id) + ", " + m_name);
+    }
+    if (!info && !m_stream) {
+        m_surface = std::make_shared<graphite::qd::surface>(m_frame.width(), m_frame.height());
+    }
+
+    // Drawing opcodes are rendered onto the surface, while probing and streaming only track the drawing state.
+    qd::rasterizer raster(m_surface.get(), m_frame.origin());
+    qd::rect last_rect = qd::rect::zero();
+    bool drawn = false;
+    if (m_stream) {
+        m_stream->origin = m_frame.origin();
+    }
+
+    // Drawing operations are applied as they are read, and recorded when streaming so that they can be replayed
+    // onto each band of rows.
+    auto stream = m_stream;
+    auto draw = [&] (const std::function<void(qd::rasterizer&)>& operation) {
+        operation(raster);
+        if (stream) {
+            stream->steps.push_back({ 0, operation });
+        }
+    };
 
     opcode op;
     while (!pict_reader.eof()) {
@@ -350,6 +855,28 @@ auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
             break;
         }
 
+        // When probing, stop at the first opcode that carries pixel data.
+        if (info) {
+            switch (op) {
+                case opcode::bits_rect:
+                case opcode::bits_region:
+                case opcode::pack_bits_rect:
+                case opcode::pack_bits_region: {
+                    return probe_indirect_bits_rect(pict_reader, *info);
+                }
+                case opcode::direct_bits_rect:
+                case opcode::direct_bits_region: {
+                    return probe_direct_bits_rect(pict_reader, *info);
+                }
+                case opcode::compressed_quicktime: {
+                    return probe_compressed_quicktime(pict_reader, *info);
+                }
+                default: {
+                    break;
+                }
+            }
+        }
+
         switch (op) {
             case opcode::clip_region: {
                 clip_rect = read_region(pict_reader);
@@ -358,69 +885,152 @@ auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
             case opcode::origin: {
                 auto origin = graphite::qd::point::read(pict_reader, qd::point::pict);
                 m_frame.set_origin(origin);
+                draw([stream, origin] (qd::rasterizer& r) {
+                    r.set_origin(stream ? qd::point(origin.x(), static_cast<int16_t>(origin.y() + stream->band_top)) : origin);
+                });
                 break;
             }
             case opcode::bits_rect: {
-                read_indirect_bits_rect(pict_reader, false, false);
+                if (auto error = read_indirect_bits_rect(pict_reader, false, false)) {
+                    return error;
+                }
                 break;
             }
             case opcode::bits_region: {
-                read_indirect_bits_rect(pict_reader, false, true);
+                if (auto error = read_indirect_bits_rect(pict_reader, false, true)) {
+                    return error;
+                }
                 break;
             }
             case opcode::pack_bits_rect: {
-                read_indirect_bits_rect(pict_reader, true, false);
+                if (auto error = read_indirect_bits_rect(pict_reader, true, false)) {
+                    return error;
+                }
                 break;
             }
             case opcode::pack_bits_region: {
-                read_indirect_bits_rect(pict_reader, true, true);
+                if (auto error = read_indirect_bits_rect(pict_reader, true, true)) {
+                    return error;
+                }
                 break;
             }
             case opcode::direct_bits_rect: {
-                read_direct_bits_rect(pict_reader, false);
+                if (auto error = read_direct_bits_rect(pict_reader, false)) {
+                    return error;
+                }
                 break;
             }
             case opcode::direct_bits_region: {
-                read_direct_bits_rect(pict_reader, true);
+                if (auto error = read_direct_bits_rect(pict_reader, true)) {
+                    return error;
+                }
                 break;
             }
             case opcode::long_comment: {
                 read_long_comment(pict_reader);
                 break;
             }
-            case opcode::pen_mode:
-            case opcode::short_line_from:
             case opcode::short_comment: {
                 pict_reader.move(2);
                 break;
             }
-            case opcode::pen_size:
-            case opcode::line_from: {
-                pict_reader.move(4);
-                break;
-            }
-            case opcode::short_line:
-            case opcode::rgb_fg_color:
-            case opcode::rgb_bg_color:
             case opcode::hilite_color:
             case opcode::op_color: {
                 pict_reader.move(6);
                 break;
             }
-            case opcode::pen_pattern:
-            case opcode::fill_pattern:
-            case opcode::line:
+            case opcode::pen_size: {
+                auto size = qd::point::read(pict_reader);
+                draw([size] (qd::rasterizer& r) { r.set_pen_size(qd::size(size.x(), size.y())); });
+                break;
+            }
+            case opcode::pen_mode: {
+                auto mode = pict_reader.read_short();
+                draw([mode] (qd::rasterizer& r) { r.set_pen_mode(mode); });
+                break;
+            }
+            case opcode::bk_pattern: {
+                auto pattern = qd::pattern::read(pict_reader);
+                draw([pattern] (qd::rasterizer& r) { r.set_background_pattern(pattern); });
+                break;
+            }
+            case opcode::pen_pattern: {
+                auto pattern = qd::pattern::read(pict_reader);
+                draw([pattern] (qd::rasterizer& r) { r.set_pen_pattern(pattern); });
+                break;
+            }
+            case opcode::fill_pattern: {
+                auto pattern = qd::pattern::read(pict_reader);
+                draw([pattern] (qd::rasterizer& r) { r.set_fill_pattern(pattern); });
+                break;
+            }
+            case opcode::fg_color: {
+                auto color = classic_color(pict_reader.read_long());
+                draw([color] (qd::rasterizer& r) { r.set_foreground_color(color); });
+                break;
+            }
+            case opcode::bg_color: {
+                auto color = classic_color(pict_reader.read_long());
+                draw([color] (qd::rasterizer& r) { r.set_background_color(color); });
+                break;
+            }
+            case opcode::rgb_fg_color: {
+                auto color = read_rgb_color(pict_reader);
+                draw([color] (qd::rasterizer& r) { r.set_foreground_color(color); });
+                break;
+            }
+            case opcode::rgb_bg_color: {
+                auto color = read_rgb_color(pict_reader);
+                draw([color] (qd::rasterizer& r) { r.set_background_color(color); });
+                break;
+            }
+            case opcode::line: {
+                auto from = qd::point::read(pict_reader);
+                auto to = qd::point::read(pict_reader);
+                draw([from, to] (qd::rasterizer& r) {
+                    r.move_to(from);
+                    r.line_to(to);
+                });
+                drawn = true;
+                break;
+            }
+            case opcode::line_from: {
+                auto to = qd::point::read(pict_reader);
+                draw([to] (qd::rasterizer& r) { r.line_to(to); });
+                drawn = true;
+                break;
+            }
+            case opcode::short_line: {
+                auto from = qd::point::read(pict_reader);
+                draw([from] (qd::rasterizer& r) { r.move_to(from); });
+                [[fallthrough]];
+            }
+            case opcode::short_line_from: {
+                auto dh = pict_reader.read_signed_byte();
+                auto dv = pict_reader.read_signed_byte();
+                auto from = raster.pen_location();
+                qd::point to(from.x() + dh, from.y() + dv);
+                draw([to] (qd::rasterizer& r) { r.line_to(to); });
+                drawn = true;
+                break;
+            }
             case opcode::frame_rect:
             case opcode::paint_rect:
             case opcode::erase_rect:
             case opcode::invert_rect:
-            case opcode::fill_rect:
+            case opcode::fill_rect: {
+                last_rect = qd::rect::read(pict_reader, qd::rect::qd);
+                draw([verb = drawing_verb(op), rect = last_rect] (qd::rasterizer& r) { r.draw_rect(verb, rect); });
+                drawn = true;
+                break;
+            }
             case opcode::frame_same_rect:
             case opcode::paint_same_rect:
             case opcode::erase_same_rect:
             case opcode::invert_same_rect:
             case opcode::fill_same_rect: {
-                pict_reader.move(8);
+                draw([verb = drawing_verb(op), rect = last_rect] (qd::rasterizer& r) { r.draw_rect(verb, rect); });
+                drawn = true;
                 break;
             }
             case opcode::frame_region:
@@ -428,7 +1038,9 @@ auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
             case opcode::erase_region:
             case opcode::invert_region:
             case opcode::fill_region: {
-                read_region(pict_reader);
+                auto region = qd::region::read(pict_reader);
+                draw([verb = drawing_verb(op), region] (qd::rasterizer& r) { r.draw_region(verb, region); });
+                drawn = true;
                 break;
             }
             case opcode::nop:
@@ -439,10 +1051,9 @@ auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
                 break;
             }
             case opcode::compressed_quicktime: {
-                read_compressed_quicktime(pict_reader);
                 // Compressed quicktime data is often followed by drawing routines telling you that you need
                 // quicktime to decode the image. We should skip these and just return after a successful decode.
-                return;
+                return read_compressed_quicktime(pict_reader);
             }
             case opcode::uncompressed_quicktime: {
                 // Uncompressed QuickTime contains a matte which we can skip over. Actual image data should follow.
@@ -451,26 +1062,133 @@ auto graphite::qd::pict::parse(graphite::data::reader& pict_reader) -> void
                 break;
             }
             default: {
-                throw std::runtime_error("Encountered an unsupported opcode " + std::to_string(op) + " in PICT: " + std::to_string(m_id) + ", " + m_name);
+                return graphite::decode_error(graphite::error_code::unsupported_opcode, pict_reader.position(),
+                                              "Encountered an unsupported opcode " + std::to_string(op) + " in PICT: " + std::to_string(m_id) + ", " + m_name);
             }
         }
     }
     
-    // Ensure we actually did decode some image data, seeing as we skip over many unsupported opcodes.
-    if (!m_format) {
-        throw std::runtime_error("Encountered an incompatible PICT: " + std::to_string(m_id) + ", " + m_name);
+    if (m_stream && drawn) {
+        m_stream->drawn = true;
+    }
+    if (info && drawn) {
+        info->frame = m_frame;
+        return {};
+    }
+
+    // Ensure we actually did decode some image data or drawing, seeing as we skip over many unsupported opcodes.
+    if (!m_format && !drawn) {
+        return graphite::decode_error(graphite::error_code::unsupported_format, pict_reader.position(),
+                                      "Encountered an incompatible PICT: " + std::to_string(m_id) + ", " + m_name);
     }
+    return {};
 }
 
 // MARK: - Encoder / Writing
 
-auto graphite::qd::pict::encode(graphite::data::writer& pict_encoder, bool rgb555) -> void
+/**
+ * The number of pixels a picture must cover before its rows are packed in parallel.
+ */
+static constexpr std::size_t parallel_encode_threshold = 256 * 256;
+
+/**
+ * Pack rows of pixel data and write each with its length prefix, where `fill` produces the values of a single row.
+ * Rows are independent, so with a pool they are packed in parallel into separate buffers, which are then written in
+ * order. The data written is the same either way.
+ */
+template<typename T>
+static auto write_packed_rows(graphite::data::writer& pict_encoder, std::size_t row_count, std::size_t row_bytes, graphite::concurrency::thread_pool *pool, const std::function<void(std::size_t, std::vector<T>&)>& fill) -> void
+{
+    auto write_row = [&] (const std::vector<uint8_t>& packed) {
+        if (row_bytes > 250) {
+            pict_encoder.write_short(packed.size());
+        }
+        else {
+            pict_encoder.write_byte(packed.size());
+        }
+        pict_encoder.write_bytes(packed);
+    };
+
+    if (!pool) {
+        std::vector<T> row;
+        for (std::size_t y = 0; y < row_count; ++y) {
+            fill(y, row);
+            write_row(graphite::qd::packbits::encode(row));
+        }
+        return;
+    }
+
+    std::vector<std::vector<uint8_t>> packed_rows(row_count);
+    auto grain = std::max<std::size_t>(1, row_count / (pool->concurrency() * 4));
+    pool->parallel_for(row_count, grain, [&] (std::size_t begin, std::size_t end) {
+        std::vector<T> row;
+        for (auto y = begin; y < end; ++y) {
+            fill(y, row);
+            packed_rows[y] = graphite::qd::packbits::encode(row);
+        }
+    });
+    for (const auto& packed : packed_rows) {
+        write_row(packed);
+    }
+}
+
+auto graphite::qd::pict::encode(graphite::data::writer& pict_encoder, const pict_encode_options& options) -> void
 {
     // Ensure origin is zero before starting
     m_frame.set_origin(qd::point::zero());
     encode_header(pict_encoder);
     encode_clip_region(pict_encoder);
-    encode_direct_bits_rect(pict_encoder, rgb555);
+
+    // Rows are only packed in parallel when the picture is large enough to benefit.
+    graphite::concurrency::thread_pool *pool = nullptr;
+    if (options.parallel && static_cast<std::size_t>(m_frame.width()) * m_frame.height() >= parallel_encode_threshold) {
+        pool = options.pool ? options.pool : &graphite::concurrency::thread_pool::shared_pool();
+        pool = pool->concurrency() > 1 ? pool : nullptr;
+    }
+
+    switch (options.pixel_layout) {
+        case pict_encode_options::layout::direct: {
+            m_format = encode_direct_bits_rect(pict_encoder, options.rgb555, pool);
+            break;
+        }
+        case pict_encode_options::layout::automatic: {
+            // The indexed encoder gives up before writing anything if there are more than 256 colors.
+            m_format = encode_indirect_bits_rect(pict_encoder, options.rgb555, pool);
+            if (!m_format) {
+                m_format = encode_direct_bits_rect(pict_encoder, options.rgb555, pool);
+            }
+            break;
+        }
+        case pict_encode_options::layout::smallest: {
+            // Encode both layouts into their own buffers, and keep the smaller of the two. The two encodes only run
+            // alongside one another when encoding in parallel.
+            graphite::data::writer indexed(std::make_shared<graphite::data::data>());
+            graphite::data::writer direct(std::make_shared<graphite::data::data>());
+            uint32_t formats[2] = { 0, 0 };
+            auto encode_trials = [&] (std::size_t begin, std::size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    if (i == 0) {
+                        formats[i] = encode_indirect_bits_rect(indexed, options.rgb555, pool);
+                    }
+                    else {
+                        formats[i] = encode_direct_bits_rect(direct, options.rgb555, pool);
+                    }
+                }
+            };
+            if (options.parallel) {
+                auto trial_pool = options.pool ? options.pool : &graphite::concurrency::thread_pool::shared_pool();
+                trial_pool->parallel_for(2, 1, encode_trials);
+            }
+            else {
+                encode_trials(0, 2);
+            }
+
+            auto use_indexed = formats[0] && indexed.size() <= direct.size();
+            pict_encoder.write_data(use_indexed ? indexed.data() : direct.data());
+            m_format = use_indexed ? formats[0] : formats[1];
+            break;
+        }
+    }
 
     // Make sure we're word aligned and put out the end of picture opcode.
     auto align_adjust = pict_encoder.position() % sizeof(uint16_t);
@@ -515,7 +1233,7 @@ auto graphite::qd::pict::encode_clip_region(graphite::data::writer& pict_encoder
     m_frame.write(pict_encoder, rect::qd);
 }
 
-auto graphite::qd::pict::encode_direct_bits_rect(graphite::data::writer& pict_encoder, bool rgb555) -> void
+auto graphite::qd::pict::encode_direct_bits_rect(graphite::data::writer& pict_encoder, bool rgb555, graphite::concurrency::thread_pool *pool) const -> uint32_t
 {
     pict_encoder.write_short(static_cast<uint16_t>(opcode::direct_bits_rect));
 
@@ -531,80 +1249,77 @@ auto graphite::qd::pict::encode_direct_bits_rect(graphite::data::writer& pict_en
 
     // Prepare to write out the actual image data.
     auto row_bytes = pm.row_bytes();
-    if (rgb555) {
-        std::vector<uint16_t> scanline_bytes(m_frame.width());
+    auto width = m_frame.width();
+    auto height = static_cast<std::size_t>(std::max(0, static_cast<int>(m_frame.height())));
+    if (rgb555 && row_bytes >= 8) {
+        write_packed_rows<uint16_t>(pict_encoder, height, row_bytes, pool, [&] (std::size_t y, std::vector<uint16_t>& row) {
+            row.resize(width);
+            qd::pixel_conversion::color_to_rgb555(m_surface->row(static_cast<int>(y)), row.data(), width);
+        });
+    }
+    else if (rgb555) {
+        std::vector<uint16_t> scanline_bytes(width);
         for (auto scanline = 0; scanline < m_frame.height(); ++scanline) {
-            for (auto x = 0; x < m_frame.width(); ++x) {
-                auto pixel = m_surface->at(x, scanline).rgb555();
-                if (row_bytes >= 8) {
-                    scanline_bytes[x] = pixel;
-                } else {
-                    pict_encoder.write_short(pixel);
-                }
-            }
-
-            if (row_bytes >= 8) {
-                auto packed = packbits::encode(scanline_bytes);
-                if (row_bytes > 250) {
-                    pict_encoder.write_short(packed.size());
-                }
-                else {
-                    pict_encoder.write_byte(packed.size());
-                }
-                pict_encoder.write_bytes(packed);
+            qd::pixel_conversion::color_to_rgb555(m_surface->row(scanline), scanline_bytes.data(), width);
+            for (auto pixel : scanline_bytes) {
+                pict_encoder.write_short(pixel);
             }
         }
     }
+    else if (row_bytes >= 8) {
+        auto component_bytes = width * pm.cmp_count();
+        write_packed_rows<uint8_t>(pict_encoder, height, row_bytes, pool, [&] (std::size_t y, std::vector<uint8_t>& row) {
+            row.resize(component_bytes);
+            auto red = row.data();
+            qd::pixel_conversion::color_to_planar(m_surface->row(static_cast<int>(y)), red, red + width, red + 2 * width, width);
+        });
+    }
     else {
-        std::vector<uint8_t> scanline_bytes(m_frame.width() * pm.cmp_count());
+        std::vector<uint8_t> scanline_bytes(width * pm.cmp_count());
+        auto red = scanline_bytes.data();
+        auto green = red + width;
+        auto blue = green + width;
         for (auto scanline = 0; scanline < m_frame.height(); ++scanline) {
-            for (auto x = 0; x < m_frame.width(); ++x) {
-                auto pixel = m_surface->at(x, scanline);
-                if (row_bytes >= 8) {
-                    scanline_bytes[x] = pixel.red_component();
-                    scanline_bytes[x + m_frame.width()] = pixel.green_component();
-                    scanline_bytes[x + m_frame.width() * 2] = pixel.blue_component();
-                } else {
-                    pict_encoder.write_byte(0);
-                    pict_encoder.write_byte(pixel.red_component());
-                    pict_encoder.write_byte(pixel.green_component());
-                    pict_encoder.write_byte(pixel.blue_component());
-                }
-            }
+            qd::pixel_conversion::color_to_planar(m_surface->row(scanline), red, green, blue, width);
 
-            if (row_bytes >= 8) {
-                auto packed = packbits::encode(scanline_bytes);
-                if (row_bytes > 250) {
-                    pict_encoder.write_short(packed.size());
-                }
-                else {
-                    pict_encoder.write_byte(packed.size());
+            {
+                for (auto x = 0; x < width; ++x) {
+                    pict_encoder.write_byte(0);
+                    pict_encoder.write_byte(red[x]);
+                    pict_encoder.write_byte(green[x]);
+                    pict_encoder.write_byte(blue[x]);
                 }
-                pict_encoder.write_bytes(packed);
             }
         }
     }
 
-    m_format = rgb555 ? 16 : 24;
+    return rgb555 ? 16 : 24;
 }
 
-auto graphite::qd::pict::encode_indirect_bits_rect(graphite::data::writer& pict_encoder, bool rgb555) -> bool
+auto graphite::qd::pict::encode_indirect_bits_rect(graphite::data::writer& pict_encoder, bool rgb555, graphite::concurrency::thread_pool *pool) const -> uint32_t
 {
-    // Build color table and return false if we exceed the maximum size.
+    // Build color table and return zero, having written nothing, if we exceed the maximum size.
     qd::clut clut;
     std::vector<uint16_t> index_values;
-    for (auto scanline = 0; scanline < m_frame.height(); ++scanline) {
-        for (auto x = 0; x < m_frame.width(); ++x) {
-            auto pixel = m_surface->at(x, scanline);
-            if (rgb555) {
-                pixel = qd::color(pixel.rgb555());
-            }
-            index_values.emplace_back(clut.set(pixel));
-            if (clut.size() > 256) {
-                return false;
+    auto frame_surface = m_surface->size().width() == m_frame.width() && m_surface->size().height() == m_frame.height();
+    if (rgb555 || !frame_surface) {
+        for (auto scanline = 0; scanline < m_frame.height(); ++scanline) {
+            for (auto x = 0; x < m_frame.width(); ++x) {
+                auto pixel = m_surface->at(x, scanline);
+                index_values.emplace_back(clut.set(rgb555 ? qd::color(pixel.rgb555()) : pixel));
+                if (clut.size() > 256) {
+                    return 0;
+                }
             }
         }
     }
+    else {
+        // The whole surface is indexed in one pass when it covers the frame exactly.
+        index_values = clut.set(*m_surface, 256);
+        if (index_values.empty() && m_frame.width() * m_frame.height() > 0) {
+            return 0;
+        }
+    }
 
     pict_encoder.write_short(static_cast<uint16_t>(opcode::pack_bits_rect));
 
@@ -625,30 +1340,30 @@ auto graphite::qd::pict::encode_indirect_bits_rect(graphite::data::writer& pict_
     auto row_bytes = pm.row_bytes();
     if (row_bytes >= 8) {
         auto bytes = pmap_data->get();
-        for (auto y = 0; y < m_frame.height(); ++y) {
-            auto raw = std::vector<uint8_t>(bytes->begin() + row_bytes * y, bytes->begin() + row_bytes * (y + 1));
-            auto packed = packbits::encode(raw);
-            if (row_bytes > 250) {
-                pict_encoder.write_short(packed.size());
-            }
-            else {
-                pict_encoder.write_byte(packed.size());
-            }
-            pict_encoder.write_bytes(packed);
-        }
+        auto height = static_cast<std::size_t>(std::max(0, static_cast<int>(m_frame.height())));
+        write_packed_rows<uint8_t>(pict_encoder, height, row_bytes, pool, [&] (std::size_t y, std::vector<uint8_t>& row) {
+            row.assign(bytes->begin() + row_bytes * y, bytes->begin() + row_bytes * (y + 1));
+        });
     }
     else {
         pict_encoder.write_data(pmap_data);
     }
 
-    m_format = pm.pixel_size();
-    return true;
+    return pm.pixel_size();
 }
 
 auto graphite::qd::pict::data(bool rgb555) -> std::shared_ptr<graphite::data::data>
+{
+    pict_encode_options options;
+    options.pixel_layout = pict_encode_options::layout::direct;
+    options.rgb555 = rgb555;
+    return data(options);
+}
+
+auto graphite::qd::pict::data(const pict_encode_options& options) -> std::shared_ptr<graphite::data::data>
 {
     auto data = std::make_shared<graphite::data::data>();
     graphite::data::writer writer(data);
-    encode(writer, rgb555);
+    encode(writer, options);
     return data;
 }
@@ -8,10 +8,84 @@
 #include <libGraphite/data/writer.hpp>
 #include "libGraphite/quickdraw/internal/surface.hpp"
 #include "libGraphite/quickdraw/pixmap.hpp"
+#include "libGraphite/quickdraw/image_info.hpp"
+#include "libGraphite/quickdraw/scanline.hpp"
+#include "libGraphite/quickdraw/internal/scanline_emitter.hpp"
 #include "libGraphite/data/reader.hpp"
+#include "libGraphite/result.hpp"
+
+namespace graphite::concurrency {
+    class thread_pool;
+}
 
 namespace graphite::qd {
 
+    /**
+     * Options that control how a QuickDraw Picture is decoded.
+     */
+    struct pict_decode_options
+    {
+    public:
+        /**
+         * Decode the rows of large pixel maps in parallel. The decoded image is identical to a sequential decode.
+         */
+        bool parallel { false };
+
+        /**
+         * The thread pool to decode on when decoding in parallel. The shared pool is used when this is null.
+         */
+        graphite::concurrency::thread_pool *pool { nullptr };
+    };
+
+    /**
+     * Options that control how a QuickDraw Picture is encoded.
+     */
+    struct pict_encode_options
+    {
+    public:
+        enum class layout
+        {
+            /**
+             * Store pictures of at most 256 colors as indexed pixels with a color table, and any other picture as
+             * direct pixels. The colors are counted in a single pass before any pixel data is written.
+             */
+            automatic,
+
+            /**
+             * Always store direct pixels, as pictures have always been encoded.
+             */
+            direct,
+
+            /**
+             * Encode pictures of at most 256 colors both as indexed and as direct pixels, and keep whichever is
+             * smaller. The two encodes run in parallel when `parallel` is set.
+             */
+            smallest,
+        };
+
+        /**
+         * How the pixels of the picture are stored. Choosing indexed pixels must be requested explicitly.
+         */
+        layout pixel_layout { layout::direct };
+
+        /**
+         * Reduce colors to 16-bit rgb555 values before they are stored.
+         */
+        bool rgb555 { false };
+
+        /**
+         * Pack the rows of large pictures in parallel, and run the trial encodes of the smallest layout alongside one
+         * another. The encoded data is identical to a sequential encode.
+         */
+        bool parallel { false };
+
+        /**
+         * The thread pool to encode on when encoding in parallel or trial encoding both layouts. The shared pool is
+         * used when this is null.
+         */
+        graphite::concurrency::thread_pool *pool { nullptr };
+    };
+
     /**
      * The `graphite::qd::pict` class represents a QuickDraw Picture.
      */
@@ -22,11 +96,14 @@ namespace graphite::qd {
         {
             nop = 0x0000,
             clip_region = 0x0001,
+            bk_pattern = 0x0002,
             pen_size = 0x0007,
             pen_mode = 0x0008,
             pen_pattern = 0x0009,
             fill_pattern = 0x000a,
             origin = 0x000c,
+            fg_color = 0x000e,
+            bg_color = 0x000f,
             rgb_fg_color = 0x001a,
             rgb_bg_color = 0x001b,
             hilite_mode = 0x001c,
@@ -67,6 +144,9 @@ namespace graphite::qd {
         };
 
     private:
+        struct bits_layout;
+        struct stream_state;
+
         int64_t m_id {};
         std::string m_name;
         std::shared_ptr<graphite::qd::surface> m_surface;
@@ -74,31 +154,79 @@ namespace graphite::qd {
         uint32_t m_format {};
         double m_x_ratio {};
         double m_y_ratio {};
+        pict_decode_options m_options;
+        stream_state *m_stream { nullptr };
 
-        auto parse(graphite::data::reader& pict_reader) -> void;
+        pict(int64_t id, std::string name, pict_decode_options options);
+
+        [[nodiscard]] auto decode_pool() const -> graphite::concurrency::thread_pool *;
+
+        auto parse(graphite::data::reader& pict_reader) -> graphite::decode_error;
+        auto read_picture(graphite::data::reader& pict_reader, graphite::qd::image_info *info) -> graphite::decode_error;
         auto read_region(graphite::data::reader& pict_reader) const -> graphite::qd::rect;
         auto read_long_comment(graphite::data::reader& pict_reader) -> void;
-        auto read_direct_bits_rect(graphite::data::reader& pict_reader, bool region) -> void;
-        auto read_indirect_bits_rect(graphite::data::reader& pict_reader, bool packed, bool region) -> void;
-        auto read_compressed_quicktime(graphite::data::reader & pict_reader) -> void;
+        auto read_direct_bits_rect(graphite::data::reader& pict_reader, bool region) -> graphite::decode_error;
+        auto read_indirect_bits_rect(graphite::data::reader& pict_reader, bool packed, bool region) -> graphite::decode_error;
+        auto read_compressed_quicktime(graphite::data::reader & pict_reader) -> graphite::decode_error;
+        auto draw_bits_rect(bits_layout& bits) -> graphite::decode_error;
+        auto emit_stream() -> graphite::decode_error;
+        static auto decode_bits_row(const bits_layout& bits, std::size_t y, std::vector<uint8_t>& row_buffer, graphite::qd::color *dst) -> bool;
+        auto probe_indirect_bits_rect(graphite::data::reader& pict_reader, graphite::qd::image_info& info) const -> graphite::decode_error;
+        auto probe_direct_bits_rect(graphite::data::reader& pict_reader, graphite::qd::image_info& info) const -> graphite::decode_error;
+        auto probe_compressed_quicktime(graphite::data::reader& pict_reader, graphite::qd::image_info& info) const -> graphite::decode_error;
 
-        auto encode(graphite::data::writer& pict_encoder, bool rgb555) -> void;
+        auto encode(graphite::data::writer& pict_encoder, const pict_encode_options& options) -> void;
         auto encode_header(graphite::data::writer& pict_encoder) -> void;
         auto encode_clip_region(graphite::data::writer& pict_encoder) -> void;
-        auto encode_direct_bits_rect(graphite::data::writer& pict_encoder, bool rgb555) -> void;
-        auto encode_indirect_bits_rect(graphite::data::writer& pict_encoder, bool rgb555) -> bool;
+        auto encode_direct_bits_rect(graphite::data::writer& pict_encoder, bool rgb555, graphite::concurrency::thread_pool *pool) const -> uint32_t;
+        auto encode_indirect_bits_rect(graphite::data::writer& pict_encoder, bool rgb555, graphite::concurrency::thread_pool *pool) const -> uint32_t;
 
     public:
-        explicit pict(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "");
+        explicit pict(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "", pict_decode_options options = {});
         explicit pict(std::shared_ptr<graphite::qd::surface> surface);
 
-        static auto load_resource(int64_t id) -> std::shared_ptr<pict>;
+        static auto load_resource(int64_t id, pict_decode_options options = {}) -> std::shared_ptr<pict>;
+        static auto try_parse(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "", pict_decode_options options = {}) -> graphite::result<std::shared_ptr<pict>>;
+
+        /**
+         * Read the header and opcodes of a picture up to its first pixel data, without decoding any pixels.
+         */
+        static auto probe(std::shared_ptr<graphite::data::data> data) -> graphite::result<graphite::qd::image_info>;
+
+        /**
+         * Decode a picture one row at a time, delivering each row to the callback in the requested pixel format.
+         * Rather than holding the whole image, only the location of each row of pixel data is retained, so memory
+         * use is proportional to the width of the picture. Pictures that contain drawing opcodes are drawn onto a band
+         * of rows at a time, so their memory use is bounded by the height of a band. Exceptions thrown by the callback
+         * are reported as decode errors.
+         */
+        static auto stream(std::shared_ptr<graphite::data::data> data, enum pixel_format format, const qd::scanline_callback& callback) -> graphite::decode_error;
+
+        /**
+         * Decode a picture directly into a caller provided pixel buffer, which must be large enough to hold the
+         * picture frame. Use `probe` to determine the size of the picture beforehand.
+         */
+        static auto decode_into(std::shared_ptr<graphite::data::data> data, const qd::pixel_buffer& buffer) -> graphite::decode_error;
+
+        /**
+         * Decode a picture without throwing, writing each row of the picture through the specified emitter.
+         */
+        static auto decode_rows(std::shared_ptr<graphite::data::data> data, graphite::qd::scanline_emitter& rows) -> graphite::decode_error;
+
         static auto from_surface(std::shared_ptr<graphite::qd::surface> surface) -> std::shared_ptr<pict>;
 
         [[nodiscard]] auto image_surface() const -> std::weak_ptr<graphite::qd::surface>;
         [[nodiscard]] auto format() const -> uint32_t;
 
+        /**
+         * Encode the picture using direct pixels.
+         */
         auto data(bool rgb555 = false) -> std::shared_ptr<graphite::data::data>;
+
+        /**
+         * Encode the picture, choosing how its pixels are stored according to the specified options.
+         */
+        auto data(const pict_encode_options& options) -> std::shared_ptr<graphite::data::data>;
     };
 
 }
@@ -2,6 +2,8 @@
 // Created by Tom Hancocks on 19/03/2020.
 //
 
+#include <algorithm>
+#include <stdexcept>
 #include "libGraphite/quickdraw/pixmap.hpp"
 #include "libGraphite/quickdraw/clut.hpp"
 #include "libGraphite/quickdraw/internal/surface.hpp"
@@ -166,32 +168,34 @@ auto graphite::qd::pixmap::build_surface(
     if (pixel_data.size() < destination.height() * m_row_bytes) {
         throw std::runtime_error("Insufficent data to build surface from pixmap.");
     }
+
+    // Expand the indices into the destination, clipped to the surface.
+    auto indexed = build_indexed_surface(pixel_data, std::make_shared<qd::clut>(clut));
+    auto view = surface->view(destination);
+    auto width = std::min(indexed->size().width(), view.size().width());
+    auto height = std::min(indexed->size().height(), view.size().height());
+    indexed->expand(qd::rect(0, 0, width, height), view);
+}
+
+auto graphite::qd::pixmap::build_indexed_surface(const std::vector<uint8_t>& pixel_data, std::shared_ptr<qd::clut> clut, bool masked) const -> std::shared_ptr<qd::indexed_surface>
+{
     auto pixel_size = m_cmp_size * m_cmp_count;
-    
-    if (pixel_size == 8) {
-        for (auto y = 0; y < destination.height(); ++y) {
-            auto y_offset = (y * m_row_bytes);
-            for (auto x = 0; x < destination.width(); ++x) {
-                auto byte = pixel_data[y_offset + x];
-                surface->set(destination.x() + x, destination.y() + y, clut.get(byte));
-            }
-        }
+    if (pixel_size != 1 && pixel_size != 2 && pixel_size != 4 && pixel_size != 8) {
+        throw std::runtime_error("Unsupported indexed pixmap depth: " + std::to_string(pixel_size));
     }
-    else {
-        auto mod = 8 / pixel_size;
-        auto mask = (1 << pixel_size) - 1;
-        auto diff = 8 - pixel_size;
-
-        for (auto y = 0; y < destination.height(); ++y) {
-            auto y_offset = (y * m_row_bytes);
-            for (auto x = 0; x < destination.width(); ++x) {
-                auto byte = pixel_data[y_offset + (x / mod)];
-                auto byte_offset = diff - ((x % mod) * pixel_size);
-                auto v = (byte >> byte_offset) & mask;
-                surface->set(destination.x() + x, destination.y() + y, clut.get(v));
-            }
-        }
+
+    // Rows are copied as they are, as a pixel map packs its indices in the same way as an indexed surface.
+    auto width = std::max(0, static_cast<int>(m_bounds.width()));
+    auto height = std::max(0, static_cast<int>(m_bounds.height()));
+    auto surface = std::make_shared<qd::indexed_surface>(width, height, std::move(clut), masked, pixel_size);
+    auto count = std::min(static_cast<int>(m_row_bytes), surface->row_bytes());
+    if (pixel_data.size() < static_cast<std::size_t>(height) * m_row_bytes || count < surface->row_bytes()) {
+        throw std::runtime_error("Insufficent data to build surface from pixmap.");
+    }
+    for (auto y = 0; y < height; ++y) {
+        std::copy_n(pixel_data.begin() + static_cast<std::size_t>(y) * m_row_bytes, count, surface->row(y));
     }
+    return surface;
 }
 
 // MARK: -
@@ -10,6 +10,7 @@
 #include "libGraphite/quickdraw/clut.hpp"
 #include "libGraphite/quickdraw/geometry.hpp"
 #include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/internal/indexed_surface.hpp"
 #include "libGraphite/data/data.hpp"
 
 namespace graphite::qd {
@@ -81,6 +82,20 @@ namespace graphite::qd {
             const qd::clut& clut,
             qd::rect destination
         ) -> void;
+
+        /**
+         * Build an indexed surface from the pixel data of an indexed pixel map, keeping its indices at the depth of
+         * the pixel map rather than expanding them to colors.
+         * @param pixel_data    The rows of the pixel map, each `row_bytes` long.
+         * @param clut          The color table of the pixel map.
+         * @param masked        Whether the surface should record which pixels are opaque.
+         */
+        [[nodiscard]] auto build_indexed_surface(
+            const std::vector<uint8_t>& pixel_data,
+            std::shared_ptr<qd::clut> clut,
+            bool masked = false
+        ) const -> std::shared_ptr<qd::indexed_surface>;
+
         auto build_pixel_data(const std::vector<uint16_t>& color_values, uint16_t clut_size) -> std::shared_ptr<graphite::data::data>;
         auto write(graphite::data::writer& writer, bool with_base_address = true) -> void;
     };
@@ -3,7 +3,9 @@
 //
 
 #include "libGraphite/quickdraw/ppat.hpp"
+#include "libGraphite/quickdraw/internal/quantizer.hpp"
 #include "libGraphite/rsrc/manager.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 #include <tuple>
 #include <stdexcept>
 
@@ -13,7 +15,15 @@ graphite::qd::ppat::ppat(std::shared_ptr<graphite::data::data> data, int64_t id,
     : m_id(id), m_name(std::move(name))
 {
     data::reader reader(std::move(data));
-    parse(reader);
+    if (auto error = parse(reader)) {
+        error.raise();
+    }
+}
+
+graphite::qd::ppat::ppat(int64_t id, std::string name)
+    : m_id(id), m_name(std::move(name))
+{
+
 }
 
 graphite::qd::ppat::ppat(std::shared_ptr<qd::surface> surface)
@@ -24,47 +34,109 @@ graphite::qd::ppat::ppat(std::shared_ptr<qd::surface> surface)
 
 auto graphite::qd::ppat::load_resource(int64_t id) -> std::shared_ptr<graphite::qd::ppat>
 {
+    GRAPHITE_TRACE_SCOPE("qd::ppat::load_resource");
     if (auto res = graphite::rsrc::manager::shared_manager().find("ppat", id).lock()) {
         return std::make_shared<graphite::qd::ppat>(res->data(), id, res->name());
     }
     return nullptr;
 }
 
+auto graphite::qd::ppat::try_parse(std::shared_ptr<graphite::data::data> data, int64_t id, std::string name) -> graphite::result<std::shared_ptr<ppat>>
+{
+    auto pattern = std::shared_ptr<graphite::qd::ppat>(new graphite::qd::ppat(id, std::move(name)));
+    data::reader reader(std::move(data));
+    if (auto error = graphite::guarded_decode(reader, [&] { return pattern->parse(reader); })) {
+        return error;
+    }
+    return pattern;
+}
+
+auto graphite::qd::ppat::probe(std::shared_ptr<graphite::data::data> data) -> graphite::result<qd::image_info>
+{
+    GRAPHITE_TRACE_SCOPE("qd::ppat::probe");
+    ppat pattern(0, "");
+    data::reader reader(std::move(data));
+    if (auto error = graphite::guarded_decode(reader, [&] { return pattern.read_pixmap(reader); })) {
+        return error;
+    }
+
+    qd::image_info info;
+    info.frame = pattern.m_pixmap.bounds();
+    info.depth = pattern.m_pixmap.pixel_size();
+    info.pack_type = pattern.m_pixmap.pack_type();
+    return info;
+}
 
 // MARK: - Accessors
 
 auto graphite::qd::ppat::surface() const -> std::weak_ptr<graphite::qd::surface>
 {
+    if (m_indexed) {
+        return m_indexed->expanded();
+    }
     return m_surface;
 }
 
+auto graphite::qd::ppat::indexed_surface() const -> std::weak_ptr<qd::indexed_surface>
+{
+    return m_indexed;
+}
+
 // MARK: - Parser
 
-auto graphite::qd::ppat::parse(graphite::data::reader& reader) -> void
+auto graphite::qd::ppat::parse(graphite::data::reader& reader) -> graphite::decode_error
 {
-    m_pat_type = reader.read_short();
-    if (m_pat_type != 1) {
-        throw std::runtime_error("Currently unsupported ppat configuration: pat_type=" +
-                                 std::to_string(m_pat_type));
-    }
-
-    m_pmap_base_addr = reader.read_long();
-    m_pat_base_addr = reader.read_long();
+    GRAPHITE_TRACE_SCOPE("qd::ppat::decode");
+    GRAPHITE_TRACE_BYTES(reader.size());
 
-    reader.set_position(m_pmap_base_addr);
-    m_pixmap = graphite::qd::pixmap(reader.read_data(qd::pixmap::length));
+    if (auto error = read_pixmap(reader)) {
+        return error;
+    }
 
     reader.set_position(m_pat_base_addr);
     auto pmap_data_size = m_pixmap.row_bytes() * m_pixmap.bounds().height();
+    auto pixel_size = m_pixmap.cmp_size() * m_pixmap.cmp_count();
+    if (pixel_size != 1 && pixel_size != 2 && pixel_size != 4 && pixel_size != 8) {
+        return graphite::decode_error(graphite::error_code::unsupported_depth, reader.position(),
+                                      "Currently unsupported ppat depth: " + std::to_string(pixel_size));
+    }
+    if (pmap_data_size < 0 || m_pixmap.bounds().width() < 0 || m_pixmap.bounds().width() > m_pixmap.row_bytes() * (8 / pixel_size)) {
+        return graphite::decode_error(graphite::error_code::invalid_structure, reader.position(),
+                                      "Invalid pixmap bounds in ppat: " + std::to_string(m_id) + ", " + m_name);
+    }
+    if (m_pat_base_addr + pmap_data_size > reader.size()) {
+        return graphite::decode_error(graphite::error_code::truncated_data, reader.position(),
+                                      "Insufficient pixel data in ppat: " + std::to_string(m_id) + ", " + m_name);
+    }
     auto pmap_data = reader.read_bytes(pmap_data_size);
 
     reader.set_position(m_pixmap.pm_table());
     m_clut = qd::clut(reader);
 
-    // Now that all information has been extracted from the resource, proceed and attempt to render it.
-    m_surface = std::make_shared<graphite::qd::surface>(m_pixmap.bounds().width(), m_pixmap.bounds().height());
+    // Keep the indices of the pattern as they are. Colors are only expanded once the surface is requested.
+    m_indexed = m_pixmap.build_indexed_surface(std::vector<uint8_t>(pmap_data.begin(), pmap_data.end()),
+                                               std::make_shared<qd::clut>(m_clut));
+    return {};
+}
+
+auto graphite::qd::ppat::read_pixmap(graphite::data::reader& reader) -> graphite::decode_error
+{
+    m_pat_type = reader.read_short();
+    if (m_pat_type != 1) {
+        return graphite::decode_error(graphite::error_code::unsupported_format, reader.position(),
+                                      "Currently unsupported ppat configuration: pat_type=" + std::to_string(m_pat_type));
+    }
 
-    m_pixmap.build_surface(m_surface, std::vector<uint8_t>(pmap_data.begin(), pmap_data.end()), m_clut, m_pixmap.bounds());
+    m_pmap_base_addr = reader.read_long();
+    m_pat_base_addr = reader.read_long();
+    if (m_pmap_base_addr + qd::pixmap::length > reader.size()) {
+        return graphite::decode_error(graphite::error_code::invalid_structure, reader.position(),
+                                      "Invalid pixmap offset in ppat: " + std::to_string(m_id) + ", " + m_name);
+    }
+
+    reader.set_position(m_pmap_base_addr);
+    m_pixmap = graphite::qd::pixmap(reader.read_data(qd::pixmap::length));
+    return {};
 }
 
 // MARK: - Encoder
@@ -73,43 +145,16 @@ auto graphite::qd::ppat::data() -> std::shared_ptr<graphite::data::data>
 {
     auto data = std::make_shared<graphite::data::data>();
     auto writer = graphite::data::writer(data);
-    auto width = m_surface->size().width();
-    auto height = m_surface->size().height();
-
-    // TODO: This is a brute force method of bringing down the color depth/number of colors required,
-    // for a ppat image. It doesn't optimise for image quality at all, and should be replaced at somepoint.
-    std::vector<uint16_t> color_values;
-    uint8_t pass = 0;
-    do {
-        if (pass++ > 0) {
-            for (auto y = 0; y < height; ++y) {
-                for (auto x = 0; x < width; ++x) {
-                    auto color = m_surface->at(x, y);
-                    m_surface->set(x, y, qd::color(
-                            color.red_component() & ~(1 << pass),
-                            color.green_component() & ~(1 << pass),
-                            color.blue_component() & ~(1 << pass),
-                            color.alpha_component()
-                    ));
-                }
-            }
-        }
-
-        // Rebuild the Color Table for the surface. To do this we want to create an empty table, and populate it.
-        m_clut = qd::clut();
-        color_values.clear();
-        for (auto y = 0; y < height; ++y) {
-            for (auto x = 0; x < width; ++x) {
-                auto color = m_surface->at(x, y);
-                color_values.emplace_back(m_clut.set(color));
-            }
-        }
-    } while(m_clut.size() > 256);
+    auto surface = this->surface().lock();
 
+    // Reduce the surface to at most 256 colors, leaving the surface itself untouched.
+    auto quantized = qd::quantizer::quantize(*surface);
+    m_clut = std::move(quantized.clut);
+    const auto& color_values = quantized.indices;
 
     // Determine what component configuration we need.
     m_pixmap = qd::pixmap();
-    m_pixmap.set_bounds(qd::rect(point::zero(), m_surface->size()));
+    m_pixmap.set_bounds(qd::rect(point::zero(), surface->size()));
     std::shared_ptr<graphite::data::data> pmap_data;
 
     pmap_data = m_pixmap.build_pixel_data(color_values, m_clut.size());
@@ -7,9 +7,12 @@
 
 #include <string>
 #include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/internal/indexed_surface.hpp"
 #include "libGraphite/quickdraw/geometry.hpp"
 #include "libGraphite/quickdraw/pixmap.hpp"
+#include "libGraphite/quickdraw/image_info.hpp"
 #include "libGraphite/quickdraw/clut.hpp"
+#include "libGraphite/result.hpp"
 
 namespace graphite::qd {
 
@@ -23,9 +26,13 @@ namespace graphite::qd {
         uint32_t m_pat_base_addr {};
         qd::pixmap m_pixmap;
         std::shared_ptr<qd::surface> m_surface;
+        std::shared_ptr<qd::indexed_surface> m_indexed;
         qd::clut m_clut;
 
-        auto parse(data::reader& reader) -> void;
+        ppat(int64_t id, std::string name);
+
+        auto parse(data::reader& reader) -> graphite::decode_error;
+        auto read_pixmap(data::reader& reader) -> graphite::decode_error;
 
     public:
         explicit ppat(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "");
@@ -33,7 +40,24 @@ namespace graphite::qd {
 
         static auto load_resource(int64_t id) -> std::shared_ptr<ppat>;
 
+        /**
+         * Parse ppat data without throwing. On failure the result describes the reason and the offset within the
+         * data at which decoding stopped.
+         */
+        static auto try_parse(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "") -> graphite::result<std::shared_ptr<ppat>>;
+
+        /**
+         * Read the pixel map of ppat data, reporting its bounds and depth without decoding any pixels.
+         */
+        static auto probe(std::shared_ptr<graphite::data::data> data) -> graphite::result<qd::image_info>;
+
         [[nodiscard]] auto surface() const -> std::weak_ptr<graphite::qd::surface>;
+
+        /**
+         * Returns the palette indices of a decoded pattern, or null if it was constructed from a surface. The colors
+         * of a decoded pattern are only expanded once `surface` is first called.
+         */
+        [[nodiscard]] auto indexed_surface() const -> std::weak_ptr<qd::indexed_surface>;
         auto data() -> std::shared_ptr<graphite::data::data>;
     };
 
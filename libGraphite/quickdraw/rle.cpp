@@ -4,19 +4,133 @@
 
 #include <cmath>
 #include <algorithm>
+#include <list>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <stdexcept>
+#include <unordered_map>
 #include "libGraphite/quickdraw/rle.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
 #include "libGraphite/rsrc/manager.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 static const auto rle_grid_width = 6;
 
+/**
+ * The minimum number of pixels across all frames for which decoding or encoding frames in parallel is worthwhile.
+ */
+static const std::size_t parallel_frame_threshold = 64 * 1024;
+
+/**
+ * Returns the pool that frames should be processed on, or null if they should be processed sequentially.
+ */
+static auto frame_pool(bool parallel, graphite::concurrency::thread_pool *pool, int frame_count, const graphite::qd::size& frame_size) -> graphite::concurrency::thread_pool *
+{
+    if (!parallel || frame_count < 2) {
+        return nullptr;
+    }
+    auto pixels = static_cast<std::size_t>(frame_count) * frame_size.width() * frame_size.height();
+    if (pixels < parallel_frame_threshold) {
+        return nullptr;
+    }
+    if (!pool) {
+        pool = &graphite::concurrency::thread_pool::shared_pool();
+    }
+    return pool->concurrency() > 1 ? pool : nullptr;
+}
+
+/**
+ * The state of a lazily decoded sprite: the location of each frame within the data, and the frames decoded so far.
+ */
+struct graphite::qd::rle::lazy_frames
+{
+    std::shared_ptr<graphite::data::data> data;
+    std::vector<uint64_t> offsets;
+    std::size_t budget { 0 };
+    std::mutex lock;
+    std::vector<std::shared_ptr<graphite::qd::surface>> cache;
+    std::list<int> recent;
+    std::size_t cached_bytes { 0 };
+    bool built { false };
+};
+
+/**
+ * The destination of a decoded frame: either a view of 16-bit color pixels, or a cell of an 8-bit indexed surface.
+ */
+struct graphite::qd::rle::frame_target
+{
+    qd::surface_view pixels;
+    qd::indexed_surface *indexed { nullptr };
+    qd::rect cell { qd::rect::zero() };
+
+    [[nodiscard]] auto height() const -> int
+    {
+        return indexed ? cell.height() : pixels.size().height();
+    }
+};
+
+/**
+ * Scratch storage for encoding the rows of a frame, along with the palette indices chosen for colors when encoding
+ * an 8-bit sprite from colors.
+ */
+struct graphite::qd::rle::row_buffer
+{
+    std::vector<qd::color> pixels;
+    std::vector<uint16_t> values;
+    std::vector<uint8_t> opaque;
+    std::unordered_map<uint32_t, uint8_t> matches;
+
+    explicit row_buffer(int width)
+        : pixels(width, qd::color::clear()), values(width), opaque(width)
+    {
+    }
+};
+
+/**
+ * Returns the index of the entry of the palette that most closely matches a color, remembering the result.
+ */
+static auto palette_index(const graphite::qd::clut& palette, const graphite::qd::color& color, std::unordered_map<uint32_t, uint8_t>& matches) -> uint8_t
+{
+    auto key = (static_cast<uint32_t>(color.red_component()) << 16) | (color.green_component() << 8) | color.blue_component();
+    auto it = matches.find(key);
+    if (it != matches.end()) {
+        return it->second;
+    }
+
+    uint8_t best = 0;
+    auto best_distance = std::numeric_limits<int>::max();
+    auto size = std::min(palette.size(), 256);
+    for (auto i = 0; i < size && best_distance > 0; ++i) {
+        auto entry = palette.at(i);
+        auto dr = static_cast<int>(entry.red_component()) - color.red_component();
+        auto dg = static_cast<int>(entry.green_component()) - color.green_component();
+        auto db = static_cast<int>(entry.blue_component()) - color.blue_component();
+        auto distance = dr * dr + dg * dg + db * db;
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = static_cast<uint8_t>(i);
+        }
+    }
+    matches.emplace(key, best);
+    return best;
+}
+
 // MARK: - Constructor
 
-graphite::qd::rle::rle(std::shared_ptr<data::data> data, int64_t id, std::string name)
-    : m_id(id), m_name(std::move(name))
+graphite::qd::rle::rle(std::shared_ptr<data::data> data, int64_t id, std::string name, rle_decode_options options)
+    : m_id(id), m_name(std::move(name)), m_options(options)
 {
     auto reader = data::reader(std::move(data));
-    parse(reader);
+    if (auto error = parse(reader)) {
+        error.raise();
+    }
+}
+
+graphite::qd::rle::rle(int64_t id, std::string name, rle_decode_options options)
+    : m_id(id), m_name(std::move(name)), m_options(options)
+{
+
 }
 
 graphite::qd::rle::rle(qd::size frame_size, uint16_t frame_count)
@@ -33,24 +147,83 @@ graphite::qd::rle::rle(qd::size frame_size, uint16_t frame_count)
                                               m_grid_size.height() * m_frame_size.height());
 }
 
+graphite::qd::rle::rle(qd::size frame_size, uint16_t frame_count, uint16_t palette_id, std::shared_ptr<qd::clut> palette)
+    : m_id(0), m_name("RLE"), m_palette(std::move(palette)), m_frame_size(frame_size), m_frame_count(frame_count), m_bpp(8),
+      m_palette_id(palette_id)
+{
+    auto grid_width = std::min(rle_grid_width, static_cast<int>(m_frame_count));
+    m_grid_size = qd::size(static_cast<int16_t>(grid_width),
+                           static_cast<int16_t>(std::ceil(m_frame_count / static_cast<double>(grid_width))));
+    m_indexed = make_indexed_surface();
+}
+
 auto graphite::qd::rle::load_resource(int64_t id) -> std::shared_ptr<graphite::qd::rle>
 {
+    GRAPHITE_TRACE_SCOPE("qd::rle::load_resource");
     if (auto rle_res = graphite::rsrc::manager::shared_manager().find("rlëD", id).lock()) {
         return std::make_shared<graphite::qd::rle>(rle_res->data());
     }
     return nullptr;
 }
 
+auto graphite::qd::rle::try_parse(std::shared_ptr<data::data> data, int64_t id, std::string name, rle_decode_options options) -> graphite::result<std::shared_ptr<rle>>
+{
+    auto sprite = std::shared_ptr<graphite::qd::rle>(new graphite::qd::rle(id, std::move(name), options));
+    auto reader = data::reader(std::move(data));
+    if (auto error = graphite::guarded_decode(reader, [&] { return sprite->parse(reader); })) {
+        return error;
+    }
+    return sprite;
+}
+
+auto graphite::qd::rle::probe(std::shared_ptr<data::data> data) -> graphite::result<qd::image_info>
+{
+    GRAPHITE_TRACE_SCOPE("qd::rle::probe");
+    qd::image_info info;
+    auto reader = data::reader(std::move(data));
+    auto error = graphite::guarded_decode(reader, [&] {
+        info.frame = qd::rect(qd::point::zero(), qd::size::read(reader, qd::size::pict));
+        info.depth = reader.read_signed_short();
+        reader.move(2);
+        info.frame_count = reader.read_short();
+        return graphite::decode_error();
+    });
+    if (error) {
+        return error;
+    }
+    return info;
+}
+
 // MARK: - Accessors
 
 auto graphite::qd::rle::surface() const -> std::weak_ptr<graphite::qd::surface>
 {
-    return m_surface;
+    return build_surface();
+}
+
+auto graphite::qd::rle::indexed_surface() const -> std::weak_ptr<qd::indexed_surface>
+{
+    decode_frames();
+    return m_indexed;
+}
+
+auto graphite::qd::rle::palette() const -> std::shared_ptr<qd::clut>
+{
+    return m_palette;
+}
+
+auto graphite::qd::rle::depth() const -> int
+{
+    return m_bpp;
 }
 
 auto graphite::qd::rle::frames() const -> std::vector<graphite::qd::rect>
 {
-    return m_frames;
+    std::vector<qd::rect> frames;
+    for (auto frame = 0; frame < m_frame_count; ++frame) {
+        frames.emplace_back(frame_rect(frame));
+    }
+    return frames;
 }
 
 auto graphite::qd::rle::frame_count() const -> int
@@ -58,49 +231,94 @@ auto graphite::qd::rle::frame_count() const -> int
     return static_cast<int>(m_frame_count);
 }
 
+auto graphite::qd::rle::cached_frame_bytes() const -> std::size_t
+{
+    if (!m_lazy) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(m_lazy->lock);
+    return m_lazy->cached_bytes;
+}
+
 auto graphite::qd::rle::frame_rect(int frame) const -> graphite::qd::rect
 {
+    if (!m_frames.empty()) {
+        return m_frames[frame];
+    }
     return qd::rect((frame % rle_grid_width) * m_frame_size.width(), (frame / rle_grid_width) * m_frame_size.height(),
                     m_frame_size.width(), m_frame_size.height());
 }
 
-auto graphite::qd::rle::frame_surface(int frame) const -> std::shared_ptr<qd::surface>
+auto graphite::qd::rle::frame_offset(int frame) const -> graphite::qd::point
 {
-    auto surface = std::make_shared<qd::surface>(m_frame_size.width(), m_frame_size.height());
-    auto src_rect = frame_rect(frame);
+    if (!m_frame_offsets.empty()) {
+        return m_frame_offsets[frame];
+    }
+    return qd::point::zero();
+}
 
-    // Extract the frame area of the origin surface
-    for (auto x = 0; x < src_rect.width(); x++) {
-        for (auto y = 0; y < src_rect.height(); y++) {
-            surface->set(x, y, m_surface->at(x + src_rect.x(), y + src_rect.y()));
-        }
+auto graphite::qd::rle::frame_surface(int frame) const -> std::shared_ptr<qd::surface>
+{
+    if (frame < 0 || frame >= m_frame_count) {
+        throw std::runtime_error("Invalid frame " + std::to_string(frame) + ", expected 0 to " + std::to_string(m_frame_count - 1));
+    }
+    // Frames of a lazily decoded sprite are copied out of the cache, so that drawing into the returned surface
+    // leaves the cached frame untouched.
+    if (auto cached = decode_frame(frame)) {
+        return std::make_shared<qd::surface>(*cached);
     }
 
+    // Frames of an 8-bit sprite are expanded directly from their indices, unless the sprite surface has already
+    // been expanded. The transparent margins trimmed from a frame packed into an atlas are restored.
+    decode_frames();
+    auto source = frame_rect(frame);
+    auto surface = std::make_shared<qd::surface>(m_frame_size.width(), m_frame_size.height());
+    if (auto pixels = expanded_surface()) {
+        surface->copy_rect(*pixels, source, frame_offset(frame));
+    }
+    else {
+        m_indexed->expand(source, surface->view(qd::rect(frame_offset(frame), source.size())));
+    }
     return surface;
 }
 
+auto graphite::qd::rle::frame_view(int frame) const -> qd::surface_view
+{
+    if (frame < 0 || frame >= m_frame_count) {
+        throw std::runtime_error("Invalid frame " + std::to_string(frame) + ", expected 0 to " + std::to_string(m_frame_count - 1));
+    }
+    return build_surface()->view(frame_rect(frame));
+}
+
 auto graphite::qd::rle::write_frame(int frame, const std::shared_ptr<qd::surface>& surface) -> void
 {
-    auto dst_rect = frame_rect(frame);
-    auto src_size = surface->size();
+    write_frame(frame, surface->view());
+}
+
+auto graphite::qd::rle::write_frame(int frame, const qd::surface_view& surface) -> void
+{
+    if (!m_frames.empty()) {
+        throw std::runtime_error("Unable to write frame " + std::to_string(frame) + " of a sprite packed into an atlas");
+    }
 
+    auto src_size = surface.size();
     if (src_size.width() != m_frame_size.width() || src_size.height() != m_frame_size.height()) {
         throw std::runtime_error("Incorrect frame dimensions " + std::to_string(src_size.width()) + "x" + std::to_string(src_size.height()) +
                                  ", expected " + std::to_string(m_frame_size.width()) + "x" + std::to_string(m_frame_size.height()));
     }
 
-    // Copy from the source surface into the destination frame
-    for (auto x = 0; x < dst_rect.width(); x++) {
-        for (auto y = 0; y < dst_rect.height(); y++) {
-            m_surface->set(x + dst_rect.x(), y + dst_rect.y(), surface->at(x, y));
-        }
-    }
+    // Copy from the source surface into the destination frame. Any frames of a lazily decoded sprite are decoded
+    // first, so that the sprite surface is complete.
+    frame_view(frame).copy_rect(surface, qd::rect(qd::point(0, 0), src_size), qd::point(0, 0));
 }
 
 // MARK: - Parsing
 
-auto graphite::qd::rle::parse(data::reader &reader) -> void
+auto graphite::qd::rle::parse(data::reader &reader) -> graphite::decode_error
 {
+    GRAPHITE_TRACE_SCOPE("qd::rle::decode");
+    GRAPHITE_TRACE_BYTES(reader.size());
+    
     // Read the header of the RLE information. This will tell us what we need to do in order to
     // actually decode the frames.
     m_frame_size = qd::size::read(reader, qd::size::pict);
@@ -109,9 +327,23 @@ auto graphite::qd::rle::parse(data::reader &reader) -> void
     m_frame_count = reader.read_short();
     reader.move(6);
 
-    // Ensure that the RLE has a BPP of 16. This is the only format that we support currently.
-    if (m_bpp != 16) {
-        throw std::runtime_error("Incorrect color depth for rlëD resource: " + std::to_string(m_id) + ", " + m_name);
+    // Ensure that the RLE has a BPP of 8 or 16. An 8-bit sprite holds indices into the color table identified by
+    // its palette id.
+    if (m_bpp != 16 && m_bpp != 8) {
+        return graphite::decode_error(graphite::error_code::unsupported_depth, reader.position(),
+                                      "Incorrect color depth for rlëD resource: " + std::to_string(m_id) + ", " + m_name);
+    }
+    if (m_bpp == 8) {
+        m_palette = m_options.palette ? m_options.palette : qd::clut::load_resource(m_palette_id);
+        if (!m_palette) {
+            return graphite::decode_error(graphite::error_code::missing_resource, reader.position(),
+                                          "Missing color table for rlëD resource: " + std::to_string(m_id) + ", " + m_name);
+        }
+    }
+
+    if (m_frame_count == 0 || m_frame_size.width() < 0 || m_frame_size.height() < 0) {
+        return graphite::decode_error(graphite::error_code::invalid_header, reader.position(),
+                                      "Invalid frame layout for rlëD resource: " + std::to_string(m_id) + ", " + m_name);
     }
 
     // Determine what the grid will be. We need to round up to the next whole number and have blank tiles
@@ -120,20 +352,99 @@ auto graphite::qd::rle::parse(data::reader &reader) -> void
     m_grid_size = qd::size(static_cast<int16_t>(grid_width),
                            static_cast<int16_t>(std::ceil(m_frame_count / static_cast<double>(grid_width))));
 
-    // Create the surface in which all frames will be drawn to, and other working variables required to parse and decode
-    // the RLE data correctly.
-    m_surface = std::make_shared<qd::surface>(m_grid_size.width() * m_frame_size.width(),
-                                              m_grid_size.height() * m_frame_size.height());
+    // When decoding lazily, in parallel or into an atlas, first locate each frame and measure its opaque pixels.
+    // The trimmed frames of an atlas can then be packed before any are decoded. A lazy sprite stops here, and
+    // decodes frames as they are requested.
+    auto pool = frame_pool(m_options.parallel, m_options.pool, m_frame_count, m_frame_size);
+    if (m_options.lazy || m_options.atlas || pool) {
+        std::vector<uint64_t> offsets;
+        std::vector<qd::rect> bounds(m_frame_count, qd::rect::zero());
+        while (!reader.eof() && offsets.size() < m_frame_count) {
+            auto frame = offsets.size();
+            offsets.push_back(reader.position());
+            if (auto error = read_frame(reader, nullptr, qd::point::zero(), &bounds[frame])) {
+                return error;
+            }
+        }
+
+        if (m_options.atlas) {
+            pack_frames(bounds);
+        }
 
+        if (m_options.lazy) {
+            m_lazy = std::make_shared<lazy_frames>();
+            m_lazy->data = reader.get();
+            m_lazy->offsets = std::move(offsets);
+            m_lazy->budget = m_options.cache_budget;
+            m_lazy->cache.resize(m_frame_count);
+            return {};
+        }
+
+        // Once located, frames are independent and are decoded into their cells of the grid or atlas in parallel.
+        if (m_bpp == 8) {
+            m_indexed = make_indexed_surface();
+        }
+        else {
+            m_surface = make_surface();
+        }
+        return read_frames(reader.get(), offsets, m_surface.get(), m_indexed.get());
+    }
+
+    // Create the surface in which all frames will be drawn to, and decode each frame into its cell of the grid.
+    if (m_bpp == 8) {
+        m_indexed = make_indexed_surface();
+    }
+    else {
+        m_surface = make_surface();
+    }
+    for (auto frame = 0; frame < m_frame_count && !reader.eof(); ++frame) {
+        auto target = frame_target_for(frame, m_surface.get(), m_indexed.get());
+        if (auto error = read_frame(reader, &target)) {
+            return error;
+        }
+    }
+
+    // Finished decoding rlëD data.
+    return {};
+}
+
+auto graphite::qd::rle::read_frame(data::reader &reader, const frame_target *target, const qd::point& origin, qd::rect *bounds) const -> graphite::decode_error
+{
+    // Read the opcodes of a single frame, up to and including the eof opcode that terminates it. Without a
+    // destination the opcodes are only validated and skipped, allowing frames to be located. The destination
+    // holds the part of the frame starting at the origin, which must contain every opaque pixel of the frame.
     rle::opcode opcode = eof;
     uint64_t position = 0;
     uint32_t row_start = 0;
     int32_t current_line = -1;
-    uint64_t current_offset = 0;
+    int32_t x = 0;
     int32_t count = 0;
-    uint16_t pixel = 0;
-    int32_t current_frame = 0;
-    uint32_t pixel_run = 0;
+    qd::color *line = nullptr;
+    uint8_t *index_line = nullptr;
+    int32_t index_y = 0;
+    auto width = static_cast<int32_t>(m_frame_size.width());
+    auto left = static_cast<int32_t>(origin.x());
+    int32_t min_x = width, min_y = -1, max_x = 0, max_y = 0;
+
+    auto claim_pixels = [&] (int32_t pixel_count) -> graphite::decode_error {
+        if (current_line < 0 || x + pixel_count > width) {
+            return graphite::decode_error(graphite::error_code::invalid_structure, reader.position(),
+                                          "Pixel data exceeds the bounds of rlëD resource: " + std::to_string(m_id) + ", " + m_name);
+        }
+        if (pixel_count > 0) {
+            min_x = std::min(min_x, x);
+            max_x = std::max(max_x, x + pixel_count);
+            min_y = (min_y < 0) ? current_line : min_y;
+            max_y = current_line + 1;
+        }
+        return {};
+    };
+
+    auto measure = [&] {
+        if (bounds) {
+            *bounds = (min_y < 0) ? qd::rect::zero() : qd::rect(min_x, min_y, max_x - min_x, max_y - min_y);
+        }
+    };
 
     while (!reader.eof()) {
         if ((row_start != 0) && ((position - row_start) & 0x03)) {
@@ -149,32 +460,72 @@ auto graphite::qd::rle::parse(data::reader &reader) -> void
             case rle::opcode::eof: {
                 // Check that we're not erroneously encountering an EOF.
                 if (current_line > static_cast<int32_t>(m_frame_size.height() - 1)) {
-                    throw std::runtime_error("Incorrect number of scanlines in rlëD resource: " + std::to_string(m_id) + ", " + m_name);
+                    return graphite::decode_error(graphite::error_code::invalid_structure, reader.position(),
+                                                  "Incorrect number of scanlines in rlëD resource: " + std::to_string(m_id) + ", " + m_name);
                 }
-
-                // Have we finished decoding the last frame in the data?
-                if (++current_frame >= m_frame_count) {
-                    goto COMPLETED_LAST_FRAME;
-                }
-
-                // Prepare for the next frame.
-                current_line = -1;
-                break;
+                measure();
+                return {};
             }
 
             case rle::opcode::line_start: {
-                current_offset = surface_offset(current_frame, ++current_line);
+                if (current_line + 1 >= m_frame_size.height()) {
+                    return graphite::decode_error(graphite::error_code::invalid_structure, reader.position(),
+                                                  "Incorrect number of scanlines in rlëD resource: " + std::to_string(m_id) + ", " + m_name);
+                }
+                ++current_line;
+                auto view_line = current_line - origin.y();
+                line = nullptr;
+                index_line = nullptr;
+                if (target && view_line >= 0 && view_line < target->height()) {
+                    if (target->indexed) {
+                        index_y = target->cell.y() + view_line;
+                        index_line = target->indexed->row(index_y) + target->cell.x();
+                    }
+                    else {
+                        line = target->pixels.row(view_line);
+                    }
+                }
+                x = 0;
                 row_start = static_cast<int32_t>(reader.position());
                 break;
             }
 
             case rle::opcode::pixel_data: {
-                for (auto i = 0; i < count; i += 2) {
-                    pixel = reader.read_short();
-                    write_pixel(pixel, 0xff, current_offset);
-                    ++current_offset;
+                if (m_bpp == 8) {
+                    // Copy the run of palette indices directly into the line, and mark them as opaque.
+                    if (auto error = claim_pixels(count)) {
+                        return error;
+                    }
+                    if (index_line) {
+                        auto indices = reader.read_bytes(count);
+                        std::copy(indices.begin(), indices.end(), index_line + (x - left));
+                        target->indexed->set_opaque(target->cell.x() + x - left, index_y, count);
+                    }
+                    else {
+                        reader.move(count);
+                    }
+                    x += count;
+
+                    if (count & 0x03) {
+                        reader.move(4 - (count & 0x03));
+                    }
+                    break;
                 }
 
+                // Convert the whole run of big endian rgb555 values directly into the line.
+                auto pixel_count = (count + 1) >> 1;
+                if (auto error = claim_pixels(pixel_count)) {
+                    return error;
+                }
+                if (line) {
+                    auto pixels = reader.read_bytes(static_cast<int64_t>(pixel_count) * 2);
+                    qd::pixel_conversion::rgb555_to_color(reinterpret_cast<const uint8_t *>(pixels.data()), line + (x - left), pixel_count);
+                }
+                else {
+                    reader.move(static_cast<int64_t>(pixel_count) * 2);
+                }
+                x += pixel_count;
+
                 if (count & 0x03) {
                     reader.move(4 - (count & 0x03));
                 }
@@ -183,59 +534,310 @@ auto graphite::qd::rle::parse(data::reader &reader) -> void
             }
 
             case rle::opcode::pixel_run: {
-                pixel_run = reader.read_long();
-                for (auto i = 0; i < count; i += 4) {
-                    write_pixel_variant1(pixel_run, 0xff, current_offset);
-                    ++current_offset;
-
-                    if (i + 2 < count) {
-                        write_pixel_variant2(pixel_run, 0xff, current_offset);
-                        ++current_offset;
+                // Runs cycle through the colors of the run value: two 16-bit colors, or four 8-bit indices.
+                auto pixel_run = reader.read_long();
+                if (m_bpp == 8) {
+                    if (auto error = claim_pixels(count)) {
+                        return error;
+                    }
+                    if (index_line) {
+                        for (auto i = 0; i < count; ++i) {
+                            index_line[x - left + i] = static_cast<uint8_t>(pixel_run >> (24 - ((i & 3) << 3)));
+                        }
+                        target->indexed->set_opaque(target->cell.x() + x - left, index_y, count);
+                    }
+                    x += count;
+                    break;
+                }
+                auto pixel_count = ((count + 3) >> 2) + ((count + 1) >> 2);
+                if (auto error = claim_pixels(pixel_count)) {
+                    return error;
+                }
+                if (line) {
+                    qd::color colors[2] = {
+                        qd::color(static_cast<uint16_t>(pixel_run >> 16)),
+                        qd::color(static_cast<uint16_t>(pixel_run & 0x0000FFFF))
+                    };
+                    for (auto i = 0; i < pixel_count; ++i) {
+                        line[x - left + i] = colors[i & 1];
                     }
                 }
+                x += pixel_count;
                 break;
             }
 
             case rle::opcode::transparent_run: {
-                current_offset += count >> 1;
+                x += (m_bpp == 8) ? count : (count >> 1);
                 break;
             }
         }
     }
 
-    COMPLETED_LAST_FRAME:
-    // Finished decoding rlëD data.
-    return;
+    measure();
+    return {};
+}
+
+auto graphite::qd::rle::read_frames(const std::shared_ptr<data::data>& data, const std::vector<uint64_t>& offsets, qd::surface *surface, qd::indexed_surface *indexed) const -> graphite::decode_error
+{
+    // Each frame is read independently, and the error of the earliest failing frame is reported so that the
+    // outcome matches a sequential decode.
+    auto pool = frame_pool(m_options.parallel, m_options.pool, static_cast<int>(offsets.size()), m_frame_size);
+    std::vector<graphite::decode_error> errors(offsets.size());
+    std::mutex copy_lock;
+    auto decode_range = [&] (std::size_t begin, std::size_t end) {
+        for (auto frame = begin; frame < end; ++frame) {
+            data::reader reader(data, offsets[frame]);
+            auto target = frame_target_for(static_cast<int>(frame), surface, indexed);
+            auto origin = frame_offset(static_cast<int>(frame));
+
+            // The mask of an indexed surface packs 8 pixels into each byte, which neighbouring cells may share. In
+            // parallel each 8-bit frame is decoded into a surface of its own, and then copied into its cell.
+            std::unique_ptr<qd::indexed_surface> scratch;
+            if (pool && indexed) {
+                scratch = std::make_unique<qd::indexed_surface>(target.cell.width(), target.cell.height(), m_palette, true);
+                target.indexed = scratch.get();
+                target.cell = qd::rect(qd::point::zero(), target.cell.size());
+            }
+
+            errors[frame] = graphite::guarded_decode(reader, [&] { return read_frame(reader, &target, origin); });
+            if (scratch) {
+                std::lock_guard<std::mutex> lock(copy_lock);
+                indexed->copy_rect(*scratch, target.cell, frame_rect(static_cast<int>(frame)).origin());
+            }
+        }
+    };
+
+    if (pool) {
+        pool->parallel_for(offsets.size(), 1, decode_range);
+    }
+    else {
+        decode_range(0, offsets.size());
+    }
+
+    for (auto& error : errors) {
+        if (error) {
+            return error;
+        }
+    }
+    return {};
+}
+
+auto graphite::qd::rle::frame_target_for(int frame, qd::surface *surface, qd::indexed_surface *indexed) const -> frame_target
+{
+    frame_target target;
+    if (indexed) {
+        target.indexed = indexed;
+        target.cell = frame_rect(frame);
+    }
+    else {
+        target.pixels = surface->view(frame_rect(frame));
+    }
+    return target;
 }
 
-auto graphite::qd::rle::surface_offset(int32_t frame, int32_t line) const -> uint64_t
+auto graphite::qd::rle::decode_frame(int frame) const -> std::shared_ptr<qd::surface>
 {
-    qd::point fo(frame % rle_grid_width, frame / rle_grid_width);
-    qd::point p(fo.x() * m_frame_size.width(), (fo.y() * m_frame_size.height()) + line);
-    return static_cast<uint64_t>(p.y() * m_surface->size().width() + p.x());
+    if (!m_lazy) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lazy->lock);
+    if (m_lazy->built) {
+        return nullptr;
+    }
+
+    // Move the frame to the front of the recently used list, decoding it if it is not cached.
+    auto& cached = m_lazy->cache[frame];
+    m_lazy->recent.remove(frame);
+    m_lazy->recent.push_front(frame);
+    if (cached) {
+        return cached;
+    }
+
+    GRAPHITE_TRACE_SCOPE("qd::rle::decode_frame");
+    cached = std::make_shared<qd::surface>(m_frame_size.width(), m_frame_size.height());
+    if (static_cast<std::size_t>(frame) < m_lazy->offsets.size()) {
+        // The indices of an 8-bit frame are only held until the frame has been expanded into the cache.
+        std::shared_ptr<qd::indexed_surface> indexed;
+        frame_target target;
+        if (m_bpp == 8) {
+            indexed = std::make_shared<qd::indexed_surface>(m_frame_size.width(), m_frame_size.height(), m_palette, true);
+            target.indexed = indexed.get();
+            target.cell = qd::rect(qd::point::zero(), m_frame_size);
+        }
+        else {
+            target.pixels = cached->view();
+        }
+
+        data::reader reader(m_lazy->data, m_lazy->offsets[frame]);
+        auto error = graphite::guarded_decode(reader, [&] { return read_frame(reader, &target); });
+        if (error) {
+            cached = nullptr;
+            m_lazy->recent.pop_front();
+            error.raise();
+        }
+        if (indexed) {
+            indexed->expand(target.cell, cached->view());
+        }
+    }
+    auto surface = cached;
+    m_lazy->cached_bytes += surface->decoded_bytes();
+
+    // Release the least recently used frames until the cache fits within its budget, always keeping the
+    // requested frame.
+    while (m_lazy->budget > 0 && m_lazy->cached_bytes > m_lazy->budget && m_lazy->recent.size() > 1) {
+        auto& evicted = m_lazy->cache[m_lazy->recent.back()];
+        m_lazy->cached_bytes -= evicted->decoded_bytes();
+        evicted = nullptr;
+        m_lazy->recent.pop_back();
+    }
+    return surface;
 }
 
-auto graphite::qd::rle::write_pixel(uint16_t pixel, uint8_t mask, uint64_t offset) -> void
+auto graphite::qd::rle::pack_frames(const std::vector<qd::rect>& bounds) -> void
 {
-    m_surface->set(static_cast<int>(offset), qd::color(pixel));
+    GRAPHITE_TRACE_SCOPE("qd::rle::pack_frames");
+
+    // Pack the trimmed frames onto shelves, tallest first, so that frames of a similar height share a shelf.
+    std::vector<std::size_t> order(bounds.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&] (std::size_t lhs, std::size_t rhs) {
+        if (bounds[lhs].height() != bounds[rhs].height()) {
+            return bounds[lhs].height() > bounds[rhs].height();
+        }
+        return bounds[lhs].width() > bounds[rhs].width();
+    });
+
+    double area = 0;
+    int widest = 0;
+    for (const auto& rect : bounds) {
+        area += static_cast<double>(rect.width()) * rect.height();
+        widest = std::max(widest, static_cast<int>(rect.width()));
+    }
+
+    // Try a range of atlas widths from that of a square upwards, along with whole multiples of the widest frame
+    // as a grid would use, and keep whichever packing has the least area.
+    std::vector<int> widths;
+    for (auto step = 0; step <= 8; ++step) {
+        widths.emplace_back(std::max(widest, static_cast<int>(std::ceil(std::sqrt(area) * (1.0 + step * 0.125)))));
+    }
+    for (auto columns = 1; columns <= rle_grid_width; ++columns) {
+        widths.emplace_back(widest * columns);
+    }
+
+    std::vector<qd::point> positions(bounds.size(), qd::point::zero());
+    std::vector<qd::point> best_positions;
+    auto best_area = std::numeric_limits<int64_t>::max();
+    for (auto width : widths) {
+        auto x = 0, y = 0, shelf_height = 0, used_width = 0;
+        for (auto frame : order) {
+            const auto& rect = bounds[frame];
+            if (rect.width() == 0 || rect.height() == 0) {
+                continue;
+            }
+            if (x + rect.width() > width) {
+                y += shelf_height;
+                x = 0;
+                shelf_height = 0;
+            }
+            positions[frame] = qd::point(static_cast<int16_t>(x), static_cast<int16_t>(y));
+            x += rect.width();
+            used_width = std::max(used_width, x);
+            shelf_height = std::max(shelf_height, static_cast<int>(rect.height()));
+        }
+
+        auto height = y + shelf_height;
+        if (static_cast<int64_t>(used_width) * height < best_area) {
+            best_area = static_cast<int64_t>(used_width) * height;
+            best_positions = positions;
+            m_atlas_size = qd::size(static_cast<int16_t>(used_width), static_cast<int16_t>(height));
+        }
+    }
+
+    m_frames.clear();
+    m_frame_offsets.clear();
+    for (std::size_t frame = 0; frame < bounds.size(); ++frame) {
+        m_frames.emplace_back(best_positions[frame], bounds[frame].size());
+        m_frame_offsets.emplace_back(bounds[frame].origin());
+    }
 }
 
-auto graphite::qd::rle::write_pixel_variant1(uint32_t pixel, uint8_t mask, uint64_t offset) -> void
+auto graphite::qd::rle::make_surface() const -> std::shared_ptr<qd::surface>
 {
-    auto rgb555 = static_cast<uint16_t>(pixel >> 16);
-    m_surface->set(static_cast<int>(offset), qd::color(rgb555));
+    if (!m_frames.empty()) {
+        return std::make_shared<qd::surface>(m_atlas_size.width(), m_atlas_size.height());
+    }
+    return std::make_shared<qd::surface>(m_grid_size.width() * m_frame_size.width(),
+                                         m_grid_size.height() * m_frame_size.height());
 }
 
-auto graphite::qd::rle::write_pixel_variant2(uint32_t pixel, uint8_t mask, uint64_t offset) -> void
+auto graphite::qd::rle::make_indexed_surface() const -> std::shared_ptr<qd::indexed_surface>
 {
-    auto rgb555 = static_cast<uint16_t>(pixel & 0x0000FFFF);
-    m_surface->set(static_cast<int>(offset), qd::color(rgb555));
+    if (!m_frames.empty()) {
+        return std::make_shared<qd::indexed_surface>(m_atlas_size.width(), m_atlas_size.height(), m_palette, true);
+    }
+    return std::make_shared<qd::indexed_surface>(m_grid_size.width() * m_frame_size.width(),
+                                                 m_grid_size.height() * m_frame_size.height(), m_palette, true);
+}
+
+auto graphite::qd::rle::decode_frames() const -> void
+{
+    if (!m_lazy) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lazy->lock);
+    if (m_lazy->built) {
+        return;
+    }
+
+    // Decode every frame into the sprite surface, or the indexed surface of an 8-bit sprite. The surface then
+    // replaces the frame cache.
+    GRAPHITE_TRACE_SCOPE("qd::rle::decode_frames");
+    std::shared_ptr<qd::surface> surface;
+    std::shared_ptr<qd::indexed_surface> indexed;
+    if (m_bpp == 8) {
+        indexed = make_indexed_surface();
+    }
+    else {
+        surface = make_surface();
+    }
+    if (auto error = read_frames(m_lazy->data, m_lazy->offsets, surface.get(), indexed.get())) {
+        error.raise();
+    }
+
+    m_surface = std::move(surface);
+    m_indexed = std::move(indexed);
+    m_lazy->cache.clear();
+    m_lazy->recent.clear();
+    m_lazy->cached_bytes = 0;
+    m_lazy->built = true;
+}
+
+auto graphite::qd::rle::build_surface() const -> std::shared_ptr<qd::surface>
+{
+    // The colors of an 8-bit sprite are only expanded from its indices once the sprite surface is requested.
+    decode_frames();
+    return m_indexed ? m_indexed->expanded() : m_surface;
+}
+
+auto graphite::qd::rle::expanded_surface() const -> std::shared_ptr<qd::surface>
+{
+    if (m_indexed) {
+        return m_indexed->is_expanded() ? m_indexed->expanded() : nullptr;
+    }
+    return m_surface;
 }
 
 // MARK: - Encoder / Writing
 
-auto graphite::qd::rle::encode(graphite::data::writer& writer) -> void
+auto graphite::qd::rle::encode(graphite::data::writer& writer, const rle_encode_options& options) -> void
 {
+    // An 8-bit sprite is encoded from its indices, unless it has been expanded to colors that may since have
+    // been modified, in which case colors are matched to the nearest entries of its color table.
+    decode_frames();
+    auto source = expanded_surface();
+
     // Write out the header
     m_frame_size.write(writer, qd::size::pict);
     writer.write_short(m_bpp);
@@ -247,118 +849,189 @@ auto graphite::qd::rle::encode(graphite::data::writer& writer) -> void
     writer.write_short(0);
     writer.write_short(0);
 
-    const auto advance = 2; // we only support 16 bits per pixel
+    // Write out the RLE frames. Each frame is a self contained opcode stream, so in parallel they are encoded into
+    // separate buffers and then joined in order.
+    if (auto pool = frame_pool(options.parallel, options.pool, m_frame_count, m_frame_size)) {
+        std::vector<std::shared_ptr<graphite::data::data>> frames(m_frame_count);
+        pool->parallel_for(frames.size(), 1, [&] (std::size_t begin, std::size_t end) {
+            row_buffer rows(m_frame_size.width());
+            for (auto f = begin; f < end; ++f) {
+                frames[f] = std::make_shared<graphite::data::data>();
+                graphite::data::writer frame_writer(frames[f]);
+                encode_frame(static_cast<int>(f), frame_writer, source.get(), rows);
+            }
+        });
+        for (const auto& frame : frames) {
+            writer.write_data(frame);
+        }
+        return;
+    }
 
-    // Write out the RLE frames
+    row_buffer rows(m_frame_size.width());
     for (auto f = 0; f < m_frame_count; f++) {
-        auto frame = frame_rect(f);
-        auto line_count = 0;
+        encode_frame(f, writer, source.get(), rows);
+    }
+}
 
-        for (auto y = 0; y < frame.height(); y++) {
-            line_count++;
-            auto line_start_pos = writer.position();
+auto graphite::qd::rle::encode_frame(int f, graphite::data::writer& writer, const qd::surface *pixels, row_buffer& rows) const -> void
+{
+    const auto advance = m_bpp / 8;
 
-            opcode run_state = line_start;
-            auto run_start_pos = line_start_pos + 4;
-            auto run_count = 0;
+    auto source = frame_rect(f);
+    auto offset = frame_offset(f);
+    auto frame = qd::rect(qd::point::zero(), m_frame_size);
+    auto trimmed = source.width() != frame.width() || source.height() != frame.height();
+    auto line_count = 0;
 
-            for (auto x = 0; x < frame.width(); x++) {
-                qd::color pixel = m_surface->at(frame.x() + x, frame.y() + y);
+    for (auto y = 0; y < frame.height(); y++) {
+        line_count++;
 
-                if (pixel.alpha_component() == 0) {
-                    if (run_state == line_start) {
-                        // Start of a transparent run
-                        run_state = transparent_run;
-                        run_count = advance;
-                    }
-                    else if (run_state == transparent_run) {
-                        // Continue transparent run
-                        run_count += advance;
-                    }
-                    else {
-                        // End of pixel run, start of transparent run
-                        auto run_end_pos = writer.position();
-                        writer.set_position(run_start_pos);
-                        writer.write_long((pixel_data << 24) | (run_count & 0x00FFFFFF));
-                        writer.set_position(run_end_pos);
-
-                        // Pad to nearest 4-byte boundary
-                        if (run_count & 3) {
-                            writer.move(4 - (run_count & 3));
-                        }
+        // Rows of a trimmed frame are expanded back to the full frame width, with transparent margins.
+        auto source_y = y - offset.y();
+        auto in_source = source_y >= 0 && source_y < source.height();
+        if (pixels) {
+            const qd::color *row = nullptr;
+            if (trimmed) {
+                std::fill(rows.pixels.begin(), rows.pixels.end(), qd::color::clear());
+                if (in_source) {
+                    auto source_row = pixels->row(source.y() + source_y) + source.x();
+                    std::copy(source_row, source_row + source.width(), rows.pixels.begin() + offset.x());
+                }
+                row = rows.pixels.data();
+            }
+            else {
+                row = pixels->row(source.y() + y) + source.x();
+            }
 
-                        // Start transparent run
-                        run_state = transparent_run;
-                        run_count = advance;
-                    }
+            if (m_bpp == 8) {
+                for (auto x = 0; x < frame.width(); ++x) {
+                    rows.values[x] = palette_index(*m_palette, row[x], rows.matches);
+                }
+            }
+            else {
+                qd::pixel_conversion::color_to_rgb555(row, rows.values.data(), frame.width());
+            }
+            for (auto x = 0; x < frame.width(); ++x) {
+                rows.opaque[x] = row[x].alpha_component() != 0;
+            }
+        }
+        else {
+            std::fill(rows.values.begin(), rows.values.end(), 0);
+            std::fill(rows.opaque.begin(), rows.opaque.end(), 0);
+            if (in_source) {
+                auto indices = m_indexed->row(source.y() + source_y) + source.x();
+                for (auto x = 0; x < source.width(); ++x) {
+                    rows.values[offset.x() + x] = indices[x];
+                    rows.opaque[offset.x() + x] = m_indexed->opaque(source.x() + x, source.y() + source_y);
+                }
+            }
+        }
+
+        auto line_start_pos = writer.position();
+
+        opcode run_state = line_start;
+        auto run_start_pos = line_start_pos + 4;
+        auto run_count = 0;
+
+        for (auto x = 0; x < frame.width(); x++) {
+            if (!rows.opaque[x]) {
+                if (run_state == line_start) {
+                    // Start of a transparent run
+                    run_state = transparent_run;
+                    run_count = advance;
+                }
+                else if (run_state == transparent_run) {
+                    // Continue transparent run
+                    run_count += advance;
                 }
                 else {
-                    if (line_count != 0) {
-                        // First pixel data for this line, write the line start
-                        // Doing this only on demand allows us to omit trailing blank lines in the frame
-                        for (auto i = 0; i < line_count; ++i) {
-                            writer.write_long(line_start << 24);
-                        }
-                        line_count = 0;
-                    }
-                    if (run_state == line_start) {
-                        // Start of a pixel run
-                        run_start_pos = writer.position();
-                        writer.write_long(0); // opcode placeholder
-                        run_state = pixel_data;
-                        run_count = advance;
-                    }
-                    else if (run_state == transparent_run) {
-                        // End of transparent run, start of pixel run
-                        writer.write_long((transparent_run << 24) | (run_count & 0x00FFFFFF));
-
-                        // Start pixel run
-                        run_start_pos = writer.position();
-                        writer.write_long(0); // opcode placeholder
-                        run_state = pixel_data;
-                        run_count = advance;
-                    }
-                    else {
-                        // Continue pixel run
-                        run_count += advance;
+                    // End of pixel run, start of transparent run
+                    auto run_end_pos = writer.position();
+                    writer.set_position(run_start_pos);
+                    writer.write_long((pixel_data << 24) | (run_count & 0x00FFFFFF));
+                    writer.set_position(run_end_pos);
+
+                    // Pad to nearest 4-byte boundary
+                    if (run_count & 3) {
+                        writer.move(4 - (run_count & 3));
                     }
 
-                    // Write the pixel
-                    writer.write_short(pixel.rgb555());
+                    // Start transparent run
+                    run_state = transparent_run;
+                    run_count = advance;
                 }
             }
+            else {
+                if (line_count != 0) {
+                    // First pixel data for this line, write the line start
+                    // Doing this only on demand allows us to omit trailing blank lines in the frame
+                    for (auto i = 0; i < line_count; ++i) {
+                        writer.write_long(line_start << 24);
+                    }
+                    line_count = 0;
+                }
+                if (run_state == line_start) {
+                    // Start of a pixel run
+                    run_start_pos = writer.position();
+                    writer.write_long(0); // opcode placeholder
+                    run_state = pixel_data;
+                    run_count = advance;
+                }
+                else if (run_state == transparent_run) {
+                    // End of transparent run, start of pixel run
+                    writer.write_long((transparent_run << 24) | (run_count & 0x00FFFFFF));
 
-            // Terminate the current opcode
-            if (run_state == pixel_data) {
-                auto run_end_pos = writer.position();
-                writer.set_position(run_start_pos);
-                writer.write_long((pixel_data << 24) | (run_count & 0x00FFFFFF));
-                writer.set_position(run_end_pos);
+                    // Start pixel run
+                    run_start_pos = writer.position();
+                    writer.write_long(0); // opcode placeholder
+                    run_state = pixel_data;
+                    run_count = advance;
+                }
+                else {
+                    // Continue pixel run
+                    run_count += advance;
+                }
 
-                // Pad to nearest 4-byte boundary
-                if (run_count & 3) {
-                    writer.move(4 - (run_count & 3));
+                // Write the pixel
+                if (m_bpp == 8) {
+                    writer.write_byte(static_cast<uint8_t>(rows.values[x]));
+                }
+                else {
+                    writer.write_short(rows.values[x]);
                 }
             }
+        }
 
-            // Write out the opcode and size at the start of the line
-            if (run_state != line_start) {
-                auto line_end_pos = writer.position();
-                writer.set_position(line_start_pos);
-                writer.write_long((line_start << 24) | ((line_end_pos - line_start_pos - 4) & 0x00FFFFFF));
-                writer.set_position(line_end_pos);
+        // Terminate the current opcode
+        if (run_state == pixel_data) {
+            auto run_end_pos = writer.position();
+            writer.set_position(run_start_pos);
+            writer.write_long((pixel_data << 24) | (run_count & 0x00FFFFFF));
+            writer.set_position(run_end_pos);
+
+            // Pad to nearest 4-byte boundary
+            if (run_count & 3) {
+                writer.move(4 - (run_count & 3));
             }
         }
 
-        // Mark end-of-frame
-        writer.write_long(eof << 24);
+        // Write out the opcode and size at the start of the line
+        if (run_state != line_start) {
+            auto line_end_pos = writer.position();
+            writer.set_position(line_start_pos);
+            writer.write_long((line_start << 24) | ((line_end_pos - line_start_pos - 4) & 0x00FFFFFF));
+            writer.set_position(line_end_pos);
+        }
     }
+
+    // Mark end-of-frame
+    writer.write_long(eof << 24);
 }
 
-auto graphite::qd::rle::data() -> std::shared_ptr<graphite::data::data>
+auto graphite::qd::rle::data(const rle_encode_options& options) -> std::shared_ptr<graphite::data::data>
 {
     auto data = std::make_shared<graphite::data::data>();
     graphite::data::writer writer(data);
-    encode(writer);
+    encode(writer, options);
     return data;
 }
@@ -7,13 +7,83 @@
 
 #include <memory>
 #include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/internal/indexed_surface.hpp"
+#include "libGraphite/quickdraw/clut.hpp"
 #include "libGraphite/quickdraw/geometry.hpp"
+#include "libGraphite/quickdraw/image_info.hpp"
+#include "libGraphite/result.hpp"
+#include "libGraphite/concurrency/thread_pool.hpp"
 
 namespace graphite::qd {
 
+    /**
+     * Options that control how a rlëD sprite is decoded.
+     */
+    struct rle_decode_options
+    {
+    public:
+        /**
+         * Defer decoding each frame until it is first requested. Construction only scans the data to locate each
+         * frame, and `frame_surface` then decodes frames individually. The full sprite surface is only built if
+         * it is requested.
+         */
+        bool lazy { false };
+
+        /**
+         * The maximum number of bytes of decoded frames to keep cached when decoding lazily. The least recently
+         * used frames are released once the budget is exceeded. Zero places no limit on the cache.
+         */
+        std::size_t cache_budget { 0 };
+
+        /**
+         * Decode frames in parallel once they have been located. The decoded sprite is identical to a sequential
+         * decode.
+         */
+        bool parallel { false };
+
+        /**
+         * The thread pool to decode on when decoding in parallel. The shared pool is used when this is null.
+         */
+        graphite::concurrency::thread_pool *pool { nullptr };
+
+        /**
+         * Trim each frame to the bounding box of its opaque pixels, and pack the trimmed frames into a compact atlas
+         * rather than laying them out on a grid at full frame size. `frame_rect` then reports where each trimmed
+         * frame lies within the atlas, and `frame_offset` where it lies within the full frame.
+         */
+        bool atlas { false };
+
+        /**
+         * The color table of an 8-bit sprite. When null, the table is loaded using the palette id of the sprite.
+         */
+        std::shared_ptr<qd::clut> palette;
+    };
+
+    /**
+     * Options that control how a rlëD sprite is encoded.
+     */
+    struct rle_encode_options
+    {
+    public:
+        /**
+         * Encode frames in parallel into separate buffers, which are then joined. The encoded data is identical
+         * to a sequential encode.
+         */
+        bool parallel { false };
+
+        /**
+         * The thread pool to encode on when encoding in parallel. The shared pool is used when this is null.
+         */
+        graphite::concurrency::thread_pool *pool { nullptr };
+    };
+
     class rle
     {
     private:
+        struct lazy_frames;
+        struct frame_target;
+        struct row_buffer;
+
         enum opcode : uint8_t
         {
             eof = 0x00,
@@ -26,36 +96,114 @@ namespace graphite::qd {
         int64_t m_id {};
         std::string m_name;
         std::vector<qd::rect> m_frames;
-        std::shared_ptr<qd::surface> m_surface;
+        mutable std::shared_ptr<qd::surface> m_surface;
+        mutable std::shared_ptr<qd::indexed_surface> m_indexed;
+        std::shared_ptr<qd::clut> m_palette;
         qd::size m_frame_size;
         qd::size m_grid_size;
+        qd::size m_atlas_size;
+        std::vector<qd::point> m_frame_offsets;
         uint16_t m_frame_count {};
         uint16_t m_bpp {};
         uint16_t m_palette_id {};
+        rle_decode_options m_options;
+        std::shared_ptr<lazy_frames> m_lazy;
+
+        rle(int64_t id, std::string name, rle_decode_options options);
 
-        auto parse(data::reader &reader) -> void;
-        [[nodiscard]] auto surface_offset(int32_t frame, int32_t line) const -> uint64_t;
-        auto write_pixel(uint16_t pixel, uint8_t mask, uint64_t offset) -> void;
-        auto write_pixel_variant1(uint32_t pixel, uint8_t mask, uint64_t offset) -> void;
-        auto write_pixel_variant2(uint32_t pixel, uint8_t mask, uint64_t offset) -> void;
+        auto parse(data::reader &reader) -> graphite::decode_error;
+        auto read_frame(data::reader &reader, const frame_target *target, const qd::point& origin = qd::point::zero(), qd::rect *bounds = nullptr) const -> graphite::decode_error;
+        auto read_frames(const std::shared_ptr<data::data>& data, const std::vector<uint64_t>& offsets, qd::surface *surface, qd::indexed_surface *indexed) const -> graphite::decode_error;
+        auto frame_target_for(int frame, qd::surface *surface, qd::indexed_surface *indexed) const -> frame_target;
+        auto decode_frame(int frame) const -> std::shared_ptr<qd::surface>;
+        auto pack_frames(const std::vector<qd::rect>& bounds) -> void;
+        auto make_surface() const -> std::shared_ptr<qd::surface>;
+        auto make_indexed_surface() const -> std::shared_ptr<qd::indexed_surface>;
+        auto decode_frames() const -> void;
+        auto build_surface() const -> std::shared_ptr<qd::surface>;
+        auto expanded_surface() const -> std::shared_ptr<qd::surface>;
 
-        auto encode(graphite::data::writer& writer) -> void;
+        auto encode(graphite::data::writer& writer, const rle_encode_options& options) -> void;
+        auto encode_frame(int frame, graphite::data::writer& writer, const qd::surface *source, row_buffer& rows) const -> void;
 
     public:
-        explicit rle(std::shared_ptr<data::data> data, int64_t id = 0, std::string name = "");
+        explicit rle(std::shared_ptr<data::data> data, int64_t id = 0, std::string name = "", rle_decode_options options = {});
         rle(qd::size frame_size, uint16_t frame_count);
 
+        /**
+         * Construct a new 8-bit sprite, whose frames are stored as indices into the specified color table.
+         * @param frame_size    The size of each frame.
+         * @param frame_count   The number of frames.
+         * @param palette_id    The id of the `clut` resource recorded in the sprite.
+         * @param palette       The color table that frames are stored against.
+         */
+        rle(qd::size frame_size, uint16_t frame_count, uint16_t palette_id, std::shared_ptr<qd::clut> palette);
+
         static auto load_resource(int64_t id) -> std::shared_ptr<rle>;
 
+        /**
+         * Parse rlëD data without throwing. On failure the result describes the reason and the offset within the
+         * data at which decoding stopped.
+         */
+        static auto try_parse(std::shared_ptr<data::data> data, int64_t id = 0, std::string name = "", rle_decode_options options = {}) -> graphite::result<std::shared_ptr<rle>>;
+
+        /**
+         * Read the header of rlëD data, reporting the frame size, depth and frame count without decoding any frames.
+         */
+        static auto probe(std::shared_ptr<data::data> data) -> graphite::result<qd::image_info>;
+
         [[nodiscard]] auto surface() const -> std::weak_ptr<qd::surface>;
+
+        /**
+         * Returns the palette indices of every frame of an 8-bit sprite, or null for a 16-bit sprite. Frames
+         * occupy the same rects as in `surface`, which for an 8-bit sprite is only expanded to colors when it is
+         * first requested. Once expanded, changes made through `surface` or `write_frame` are not reflected in
+         * the indices.
+         */
+        [[nodiscard]] auto indexed_surface() const -> std::weak_ptr<qd::indexed_surface>;
+
+        /**
+         * Returns the color table of an 8-bit sprite, or null for a 16-bit sprite.
+         */
+        [[nodiscard]] auto palette() const -> std::shared_ptr<qd::clut>;
+
+        /**
+         * Returns the number of bits per pixel of the sprite.
+         */
+        [[nodiscard]] auto depth() const -> int;
         [[nodiscard]] auto frames() const -> std::vector<qd::rect>;
 
         [[nodiscard]] auto frame_count() const -> int;
+
+        /**
+         * Returns the number of bytes held by frames cached by a lazily decoded sprite.
+         */
+        [[nodiscard]] auto cached_frame_bytes() const -> std::size_t;
+
         [[nodiscard]] auto frame_rect(int frame) const -> qd::rect;
+
+        /**
+         * Returns the position within the full frame of the pixels held by `frame_rect`. This is only non-zero for
+         * frames of a sprite packed into an atlas, which are trimmed to their opaque pixels.
+         */
+        [[nodiscard]] auto frame_offset(int frame) const -> qd::point;
+
+        /**
+         * Returns a new surface holding a copy of the specified frame, which the caller is free to modify.
+         */
         [[nodiscard]] auto frame_surface(int frame) const -> std::shared_ptr<qd::surface>;
+
+        /**
+         * Returns a view of the specified frame within the sprite surface, without copying it. The view is valid
+         * for as long as this sprite, and writes through the view modify the frame. The view of a frame packed into
+         * an atlas covers only its trimmed pixels.
+         */
+        [[nodiscard]] auto frame_view(int frame) const -> qd::surface_view;
+
         auto write_frame(int frame, const std::shared_ptr<qd::surface>& surface) -> void;
+        auto write_frame(int frame, const qd::surface_view& surface) -> void;
 
-        auto data() -> std::shared_ptr<graphite::data::data>;
+        auto data(const rle_encode_options& options = {}) -> std::shared_ptr<graphite::data::data>;
     };
 
 }
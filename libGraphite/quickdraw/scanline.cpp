@@ -0,0 +1,51 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "libGraphite/quickdraw/scanline.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
+
+// MARK: - Pixel Formats
+
+auto graphite::qd::bytes_per_pixel(enum pixel_format format) -> std::size_t
+{
+    switch (format) {
+        case pixel_format::rgb565:
+        case pixel_format::rgb555:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+auto graphite::qd::convert_pixels(const qd::color *src, uint8_t *dst, std::size_t count, enum pixel_format format) -> void
+{
+    pixel_conversion::color_to_format(src, dst, count, format);
+}
+
+// MARK: - Pixel Buffers
+
+auto graphite::qd::pixel_buffer::can_hold(int image_width, int image_height) const -> bool
+{
+    if (image_width <= 0 || image_height <= 0) {
+        return true;
+    }
+    return data && width >= image_width && height >= image_height && stride >= image_width * bytes_per_pixel(format);
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_QUICKDRAW_SCANLINE_HPP)
+#define GRAPHITE_QUICKDRAW_SCANLINE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include "libGraphite/quickdraw/internal/color.hpp"
+
+namespace graphite::qd {
+
+    /**
+     * The layouts that decoded pixels can be delivered in.
+     */
+    enum class pixel_format : uint8_t
+    {
+        rgba8888,                   // Bytes in the order red, green, blue, alpha. This is the layout of `qd::color`.
+        bgra8888,                   // Bytes in the order blue, green, red, alpha.
+        rgba8888_premultiplied,     // As rgba8888, with the color components multiplied by alpha.
+        bgra8888_premultiplied,     // As bgra8888, with the color components multiplied by alpha.
+        rgb565,                     // 16-bit values in native byte order, with 5 bits of red and blue and 6 of green.
+        rgb555,                     // 16-bit values in native byte order, with 5 bits per component. The top bit is zero.
+    };
+
+    /**
+     * Returns the number of bytes occupied by a single pixel in the specified format.
+     */
+    auto bytes_per_pixel(enum pixel_format format) -> std::size_t;
+
+    /**
+     * Convert a run of colors into the specified pixel format.
+     * @param src       The colors to convert.
+     * @param dst       The destination, which must have room for `count` pixels of the specified format.
+     * @param count     The number of pixels to convert.
+     * @param format    The pixel format to convert to.
+     */
+    auto convert_pixels(const qd::color *src, uint8_t *dst, std::size_t count, enum pixel_format format) -> void;
+
+    /**
+     * The `graphite::qd::pixel_buffer` structure describes externally owned memory that decoded pixels can be
+     * written into directly, such as texture staging memory.
+     */
+    struct pixel_buffer
+    {
+    public:
+        uint8_t *data { nullptr };
+
+        /**
+         * The number of bytes from the start of one row to the start of the next.
+         */
+        std::size_t stride { 0 };
+
+        int width { 0 };
+        int height { 0 };
+        enum pixel_format format { pixel_format::rgba8888 };
+
+        /**
+         * Returns true if the buffer is large enough to hold an image of the specified dimensions.
+         */
+        [[nodiscard]] auto can_hold(int image_width, int image_height) const -> bool;
+
+        /**
+         * Returns a pointer to the first byte of the specified row.
+         */
+        [[nodiscard]] auto row(int y) const -> uint8_t *
+        {
+            return data + static_cast<std::size_t>(y) * stride;
+        }
+    };
+
+    /**
+     * The `graphite::qd::scanline` structure is a single decoded row of an image, delivered to a
+     * `scanline_callback` by the streaming decoders.
+     */
+    struct scanline
+    {
+    public:
+        int y { 0 };
+        int width { 0 };
+        enum pixel_format format { pixel_format::rgba8888 };
+
+        /**
+         * The pixels of the row. These are only valid for the duration of the callback.
+         */
+        const uint8_t *pixels { nullptr };
+    };
+
+    /**
+     * Receives each row of a streamed image, in order from top to bottom.
+     */
+    typedef std::function<void(const qd::scanline&)> scanline_callback;
+
+}
+
+#endif //GRAPHITE_QUICKDRAW_SCANLINE_HPP
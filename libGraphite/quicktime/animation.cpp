@@ -2,7 +2,10 @@
 // Created by Tom Hancocks on 26/03/2021.
 //
 
+#include <algorithm>
 #include "libGraphite/quicktime/animation.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 static inline auto read_bytes(graphite::data::reader& reader, std::size_t size) -> std::vector<uint8_t>
 {
@@ -10,15 +13,25 @@ static inline auto read_bytes(graphite::data::reader& reader, std::size_t size)
     return std::vector<uint8_t>(bytes.begin(), bytes.end());
 }
 
-auto graphite::qt::animation::decode(const qt::imagedesc& imagedesc, data::reader& reader) -> qd::surface
+static auto read_rows(const graphite::qt::imagedesc& imagedesc, graphite::data::reader& reader, graphite::qd::scanline_emitter& rows) -> graphite::decode_error
 {
+    GRAPHITE_TRACE_SCOPE("qt::animation::decode");
+    GRAPHITE_TRACE_BYTES(imagedesc.data_size());
+    
     auto depth = imagedesc.depth();
     if (depth < 8) {
         // Depths 1, 2, 4 currently unsupported
-        throw std::runtime_error("Unsupported rle bit depth: " + std::to_string(depth));
+        return graphite::decode_error(graphite::error_code::unsupported_depth, reader.position(),
+                                      "Unsupported rle bit depth: " + std::to_string(depth));
     }
     auto clut = imagedesc.clut();
-    auto surface = qd::surface(imagedesc.width(), imagedesc.height());
+    if (depth == 8 && !clut) {
+        return graphite::decode_error(graphite::error_code::missing_resource, reader.position(),
+                                      "Missing color table for 8-bit rle image.");
+    }
+    auto width = imagedesc.width();
+    auto height = imagedesc.height();
+    rows.begin(width, height);
     auto chunk_size = reader.read_long();
     auto header = reader.read_short();
     auto y = 0;
@@ -26,6 +39,30 @@ auto graphite::qt::animation::decode(const qt::imagedesc& imagedesc, data::reade
         y = reader.read_short();
         reader.move(6);
     }
+
+    // Lines are only ever visited from top to bottom, so each line is complete once the decoder moves past it.
+    // Pixels beyond either edge of the line are ignored.
+    graphite::qd::color *pixels = nullptr;
+    auto set = [&] (int x, graphite::qd::color color) {
+        if (x >= 0 && x < width) {
+            pixels[x] = color;
+        }
+    };
+    auto start_line = [&] (int line) {
+        rows.advance_to(line);
+        if (line < height) {
+            pixels = rows.pixels();
+        }
+    };
+    // Literal runs are converted in bulk, clipped to the line in the same way.
+    auto set_literal = [&] (int x, int count, const uint8_t *raw, int value_size, void (*convert)(const uint8_t *, graphite::qd::color *, std::size_t)) {
+        auto first = std::max(x, 0);
+        auto last = std::min(x + count, static_cast<int>(width));
+        if (first < last) {
+            convert(raw + (first - x) * value_size, pixels + first, last - first);
+        }
+    };
+    start_line(y);
     
     int8_t skip;
     int8_t code;
@@ -33,6 +70,10 @@ auto graphite::qt::animation::decode(const qt::imagedesc& imagedesc, data::reade
     while ((skip = reader.read_byte())) {
         x += skip-1;
         while (true) {
+            if (y >= imagedesc.height()) {
+                return graphite::decode_error(graphite::error_code::invalid_structure, reader.position(),
+                                              "QuickTime rle data extends beyond the image bounds.");
+            }
             code = reader.read_signed_byte();
             if (code == 0) {
                 // No op
@@ -41,7 +82,7 @@ auto graphite::qt::animation::decode(const qt::imagedesc& imagedesc, data::reade
             else if (code == -1) {
                 // Next line
                 x = 0;
-                y++;
+                start_line(++y);
                 break;
             }
             else if (code > 0) {
@@ -51,37 +92,26 @@ auto graphite::qt::animation::decode(const qt::imagedesc& imagedesc, data::reade
                         auto raw = read_bytes(reader, 4 * code);
                         for (auto i = 0; i < 4 * code; ++i) {
                             auto color = clut->get(raw[i]);
-                            surface.set(x++, y, color);
+                            set(x++, color);
                         }
                         break;
                     }
                     case 16: {
                         auto raw = read_bytes(reader, 2 * code);
-                        for (auto i = 0; i < code; ++i) {
-                            auto color = qd::color((raw[i * 2] << 8) | (raw[i * 2 + 1]));
-                            surface.set(x++, y, color);
-                        }
+                        set_literal(x, code, raw.data(), 2, graphite::qd::pixel_conversion::rgb555_to_color);
+                        x += code;
                         break;
                     }
                     case 24: {
                         auto raw = read_bytes(reader, 3 * code);
-                        for (auto i = 0; i < code; ++i) {
-                            auto color = qd::color(raw[i * 3],
-                                                   raw[i * 3 + 1],
-                                                   raw[i * 3 + 2]);
-                            surface.set(x++, y, color);
-                        }
+                        set_literal(x, code, raw.data(), 3, graphite::qd::pixel_conversion::rgb_to_color);
+                        x += code;
                         break;
                     }
                     case 32: {
                         auto raw = read_bytes(reader, 4 * code);
-                        for (auto i = 0; i < code; ++i) {
-                            auto color = qd::color(raw[i * 4 + 1],
-                                                   raw[i * 4 + 2],
-                                                   raw[i * 4 + 3],
-                                                   raw[i * 4]);
-                            surface.set(x++, y, color);
-                        }
+                        set_literal(x, code, raw.data(), 4, graphite::qd::pixel_conversion::argb_to_color);
+                        x += code;
                         break;
                     }
                 }
@@ -93,30 +123,30 @@ auto graphite::qt::animation::decode(const qt::imagedesc& imagedesc, data::reade
                         auto raw = read_bytes(reader, 4);
                         for (auto i = 0; i < 4 * -code; ++i) {
                             auto color = clut->get(raw[i % 4]);
-                            surface.set(x++, y, color);
+                            set(x++, color);
                         }
                         break;
                     }
                     case 16: {
-                        auto color = qd::color(reader.read_short());
+                        auto color = graphite::qd::color(reader.read_short());
                         for (auto i = 0; i < -code; ++i) {
-                            surface.set(x++, y, color);
+                            set(x++, color);
                         }
                         break;
                     }
                     case 24: {
                         auto raw = read_bytes(reader, 3);
-                        auto color = qd::color(raw[0], raw[1], raw[2]);
+                        auto color = graphite::qd::color(raw[0], raw[1], raw[2]);
                         for (auto i = 0; i < -code; ++i) {
-                            surface.set(x++, y, color);
+                            set(x++, color);
                         }
                         break;
                     }
                     case 32: {
                         auto raw = read_bytes(reader, 4);
-                        auto color = qd::color(raw[1], raw[2], raw[3], raw[0]);
+                        auto color = graphite::qd::color(raw[1], raw[2], raw[3], raw[0]);
                         for (auto i = 0; i < -code; ++i) {
-                            surface.set(x++, y, color);
+                            set(x++, color);
                         }
                         break;
                     }
@@ -124,5 +154,31 @@ auto graphite::qt::animation::decode(const qt::imagedesc& imagedesc, data::reade
             }
         }
     }
-    return surface;
+    rows.finish();
+    return {};
+}
+
+auto graphite::qt::animation::try_decode(const qt::imagedesc& imagedesc, data::reader& reader) -> graphite::result<qd::surface>
+{
+    qd::scanline_emitter rows;
+    if (auto error = decode_rows(imagedesc, reader, rows)) {
+        return error;
+    }
+    return std::move(*rows.surface());
+}
+
+auto graphite::qt::animation::stream(const qt::imagedesc& imagedesc, data::reader& reader, qd::pixel_format format, const qd::scanline_callback& callback) -> graphite::decode_error
+{
+    qd::scanline_emitter rows(format, callback);
+    return decode_rows(imagedesc, reader, rows);
+}
+
+auto graphite::qt::animation::decode_rows(const qt::imagedesc& imagedesc, data::reader& reader, qd::scanline_emitter& rows) -> graphite::decode_error
+{
+    return graphite::guarded_decode(reader, [&] { return read_rows(imagedesc, reader, rows); });
+}
+
+auto graphite::qt::animation::decode(const qt::imagedesc& imagedesc, data::reader& reader) -> qd::surface
+{
+    return try_decode(imagedesc, reader).value();
 }
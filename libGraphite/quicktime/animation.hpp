@@ -7,8 +7,11 @@
 
 #include <memory>
 #include "libGraphite/data/reader.hpp"
+#include "libGraphite/result.hpp"
 #include "libGraphite/quicktime/imagedesc.hpp"
 #include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/scanline.hpp"
+#include "libGraphite/quickdraw/internal/scanline_emitter.hpp"
 
 namespace graphite::qt {
 
@@ -16,6 +19,23 @@ namespace graphite::qt {
     {
     public:
         static auto decode(const qt::imagedesc& imagedesc, data::reader& reader) -> qd::surface;
+
+        /**
+         * Decode 'rle ' image data described by the image description without throwing. On failure the result
+         * describes the reason and the offset within the reader at which decoding stopped.
+         */
+        static auto try_decode(const qt::imagedesc& imagedesc, data::reader& reader) -> graphite::result<qd::surface>;
+
+        /**
+         * Decode 'rle ' image data one row at a time, delivering each row to the callback in the requested pixel
+         * format. Only a single row of the image is held in memory.
+         */
+        static auto stream(const qt::imagedesc& imagedesc, data::reader& reader, qd::pixel_format format, const qd::scanline_callback& callback) -> graphite::decode_error;
+
+        /**
+         * Decode 'rle ' image data without throwing, writing each row of the image through the specified emitter.
+         */
+        static auto decode_rows(const qt::imagedesc& imagedesc, data::reader& reader, qd::scanline_emitter& rows) -> graphite::decode_error;
     };
 
 }
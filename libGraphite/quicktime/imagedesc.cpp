@@ -7,16 +7,69 @@
 #include "libGraphite/quicktime/animation.hpp"
 #include "libGraphite/quicktime/planar.hpp"
 #include "libGraphite/quicktime/raw.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Constructors
 
 graphite::qt::imagedesc::imagedesc(data::reader& reader)
 {
-    // http://mirror.informatimago.com/next/developer.apple.com/documentation/QuickTime/INMAC/QT/iqImageCompMgr.17.htm
+    if (auto error = parse(reader)) {
+        error.raise();
+    }
+}
+
+auto graphite::qt::imagedesc::try_parse(data::reader& reader) -> graphite::result<imagedesc>
+{
+    imagedesc desc;
+    if (auto error = graphite::guarded_decode(reader, [&] { return desc.parse(reader); })) {
+        return error;
+    }
+    return desc;
+}
+
+// MARK: - Parsing
+
+auto graphite::qt::imagedesc::parse(data::reader& reader) -> graphite::decode_error
+{
+    GRAPHITE_TRACE_SCOPE("qt::imagedesc::decode");
+
+    if (auto error = read_header(reader)) {
+        return error;
+    }
+    GRAPHITE_TRACE_BYTES(m_length + std::max(m_data_size, 0));
+
+    return read_image_data(reader);
+}
+
+auto graphite::qt::imagedesc::read_header(data::reader& reader) -> graphite::decode_error
+{
     auto start = reader.position();
+    if (auto error = read_description(reader)) {
+        return error;
+    }
+
+    auto clut = reader.read_signed_short();
+    if (clut == 0) {
+        m_clut = std::make_shared<qd::clut>(qd::clut(reader));
+    } else if (clut > 0) {
+        m_clut = qd::clut::load_resource(clut);
+        if (m_clut == nullptr) {
+            return graphite::decode_error(graphite::error_code::missing_resource, reader.position(),
+                                          "Color table not found: clut " + std::to_string(clut));
+        }
+    }
+
+    // Record the number remaining bytes of the image description before the data start
+    m_data_offset = m_length - static_cast<int32_t>(reader.position() - start);
+    return {};
+}
+
+auto graphite::qt::imagedesc::read_description(data::reader& reader) -> graphite::decode_error
+{
+    // http://mirror.informatimago.com/next/developer.apple.com/documentation/QuickTime/INMAC/QT/iqImageCompMgr.17.htm
     m_length = reader.read_signed_long();
     if (m_length < 86) {
-        throw std::runtime_error("Invalid QuickTime image description.");
+        return graphite::decode_error(graphite::error_code::invalid_header, reader.position(), "Invalid QuickTime image description.");
     }
     m_compressor = reader.read_long();
     reader.move(8);
@@ -31,20 +84,70 @@ graphite::qt::imagedesc::imagedesc(data::reader& reader)
     if (m_depth > 32) {
         m_depth -= 32; // grayscale
     }
-    auto clut = reader.read_signed_short();
-    if (clut == 0) {
-        m_clut = std::make_shared<qd::clut>(qd::clut(reader));
-    } else if (clut > 0) {
-        m_clut = qd::clut::load_resource(clut);
-        if (m_clut == nullptr) {
-            throw std::runtime_error("Color table not found: clut " + std::to_string(clut));
-        }
+    return {};
+}
+
+auto graphite::qt::imagedesc::probe(data::reader& reader) -> graphite::result<qd::image_info>
+{
+    GRAPHITE_TRACE_SCOPE("qt::imagedesc::probe");
+
+    imagedesc desc;
+    auto start = reader.position();
+    if (auto error = graphite::guarded_decode(reader, [&] { return desc.read_description(reader); })) {
+        return error;
     }
 
-    // Record the number remaining bytes of the image description before the data start
-    m_data_offset = m_length - static_cast<int32_t>(reader.position() - start);
+    // Step over the color table and image data without reading them.
+    reader.set_position(start + desc.m_length + std::max(desc.m_data_size, 0));
+
+    qd::image_info info;
+    info.frame = qd::rect(0, 0, desc.m_width, desc.m_height);
+    info.depth = desc.m_depth;
+    info.compressor = desc.m_compressor;
+    return info;
+}
+
+auto graphite::qt::imagedesc::stream(data::reader& reader, qd::pixel_format format, const qd::scanline_callback& callback) -> graphite::decode_error
+{
+    qd::scanline_emitter rows(format, callback);
+    return decode_rows(reader, rows);
+}
+
+auto graphite::qt::imagedesc::decode_into(data::reader& reader, const qd::pixel_buffer& buffer) -> graphite::decode_error
+{
+    qd::scanline_emitter rows(buffer);
+    return decode_rows(reader, rows);
+}
 
-    read_image_data(reader);
+auto graphite::qt::imagedesc::decode_rows(data::reader& reader, qd::scanline_emitter& rows) -> graphite::decode_error
+{
+    GRAPHITE_TRACE_SCOPE("qt::imagedesc::decode_rows");
+
+    imagedesc desc;
+    if (auto error = graphite::guarded_decode(reader, [&] { return desc.read_header(reader); })) {
+        return error;
+    }
+
+    switch (desc.m_compressor) {
+        case 'rle ': {
+            return qt::animation::decode_rows(desc, reader, rows);
+        }
+        case '8BPS': {
+            return qt::planar::decode_rows(desc, reader, rows);
+        }
+        case 'raw ': {
+            return qt::raw::decode_rows(desc, reader, rows);
+        }
+        case 'qdrw': {
+            if (desc.m_data_size < 0 || reader.position() + desc.m_data_size > reader.size()) {
+                return graphite::decode_error(graphite::error_code::truncated_data, reader.position(), "QuickDraw picture data is truncated.");
+            }
+            return qd::pict::decode_rows(reader.read_data(desc.m_data_size), rows);
+        }
+        default: {
+            return desc.read_image_data(reader);
+        }
+    }
 }
 
 // MARK: - Accessors
@@ -96,29 +199,61 @@ auto graphite::qt::imagedesc::clut() const -> std::shared_ptr<qd::clut>
 
 auto graphite::qt::imagedesc::surface() const -> std::shared_ptr<qd::surface>
 {
-    return m_surface;
+    return m_indexed ? m_indexed->expanded() : m_surface;
+}
+
+auto graphite::qt::imagedesc::indexed_surface() const -> std::shared_ptr<qd::indexed_surface>
+{
+    return m_indexed;
 }
 
 // MARK: - Decoding
 
-auto graphite::qt::imagedesc::read_image_data(data::reader &reader) -> void {
+auto graphite::qt::imagedesc::read_image_data(data::reader &reader) -> graphite::decode_error {
     switch (m_compressor) {
         case 'rle ': {
-            m_surface = std::make_shared<graphite::qd::surface>(qt::animation::decode(*this, reader));
-            break;
+            auto surface = qt::animation::try_decode(*this, reader);
+            if (!surface) {
+                return surface.error();
+            }
+            m_surface = std::make_shared<graphite::qd::surface>(std::move(surface.value()));
+            return {};
         }
         case '8BPS': {
-            m_surface = std::make_shared<graphite::qd::surface>(qt::planar::decode(*this, reader));
-            break;
+            // Monochrome and 8-bit planar images keep their indices until their colors are requested.
+            if (m_depth == 1 || m_depth == 8) {
+                auto indexed = qt::planar::try_decode_indexed(*this, reader);
+                if (!indexed) {
+                    return indexed.error();
+                }
+                m_indexed = indexed.value();
+                return {};
+            }
+            auto surface = qt::planar::try_decode(*this, reader);
+            if (!surface) {
+                return surface.error();
+            }
+            m_surface = std::make_shared<graphite::qd::surface>(std::move(surface.value()));
+            return {};
         }
         case 'raw ': {
-            m_surface = std::make_shared<graphite::qd::surface>(qt::raw::decode(*this, reader));
-            break;
+            auto indexed = qt::raw::try_decode_indexed(*this, reader);
+            if (!indexed) {
+                return indexed.error();
+            }
+            m_indexed = indexed.value();
+            return {};
         }
         case 'qdrw': {
-            auto pict = qd::pict(reader.read_data(m_data_size));
-            m_surface = pict.image_surface().lock();
-            break;
+            if (m_data_size < 0 || reader.position() + m_data_size > reader.size()) {
+                return graphite::decode_error(graphite::error_code::truncated_data, reader.position(), "QuickDraw picture data is truncated.");
+            }
+            auto pict = qd::pict::try_parse(reader.read_data(m_data_size));
+            if (!pict) {
+                return pict.error();
+            }
+            m_surface = pict.value()->image_surface().lock();
+            return {};
         }
         default: {
             std::string comp;
@@ -126,7 +261,8 @@ auto graphite::qt::imagedesc::read_image_data(data::reader &reader) -> void {
             comp.push_back(m_compressor >> 16);
             comp.push_back(m_compressor >> 8);
             comp.push_back(m_compressor);
-            throw std::runtime_error("Unsupported QuickTime compressor '" + comp + "' (offset " + std::to_string(reader.position() + m_data_offset) + ")");
+            return graphite::decode_error(graphite::error_code::unsupported_format, reader.position() + m_data_offset,
+                                          "Unsupported QuickTime compressor '" + comp + "' (offset " + std::to_string(reader.position() + m_data_offset) + ")");
         }
     }
 }
@@ -7,8 +7,13 @@
 
 #include <memory>
 #include "libGraphite/data/reader.hpp"
+#include "libGraphite/result.hpp"
 #include "libGraphite/quickdraw/clut.hpp"
+#include "libGraphite/quickdraw/image_info.hpp"
+#include "libGraphite/quickdraw/scanline.hpp"
+#include "libGraphite/quickdraw/internal/scanline_emitter.hpp"
 #include "libGraphite/quickdraw/internal/surface.hpp"
+#include "libGraphite/quickdraw/internal/indexed_surface.hpp"
 
 namespace graphite::qt {
 
@@ -25,11 +30,46 @@ namespace graphite::qt {
         int32_t m_data_offset { 0 };
         std::shared_ptr<qd::clut> m_clut { nullptr };
         std::shared_ptr<qd::surface> m_surface { nullptr };
+        std::shared_ptr<qd::indexed_surface> m_indexed { nullptr };
 
-        auto read_image_data(data::reader& reader) -> void;
+        imagedesc() = default;
+
+        auto parse(data::reader& reader) -> graphite::decode_error;
+        auto read_header(data::reader& reader) -> graphite::decode_error;
+        auto read_description(data::reader& reader) -> graphite::decode_error;
+        auto read_image_data(data::reader& reader) -> graphite::decode_error;
     public:
         explicit imagedesc(data::reader& reader);
 
+        /**
+         * Parse an image description, and the image data that follows it, without throwing.
+         */
+        static auto try_parse(data::reader& reader) -> graphite::result<imagedesc>;
+
+        /**
+         * Read an image description without decoding the image data that follows it. The reader is left
+         * positioned after the image data.
+         */
+        static auto probe(data::reader& reader) -> graphite::result<qd::image_info>;
+
+        /**
+         * Decode an image description and its image data one row at a time, delivering each row to the callback
+         * in the requested pixel format. Exceptions thrown by the callback are reported as decode errors.
+         */
+        static auto stream(data::reader& reader, qd::pixel_format format, const qd::scanline_callback& callback) -> graphite::decode_error;
+
+        /**
+         * Decode an image description and its image data directly into a caller provided pixel buffer, which must
+         * be large enough to hold the image. Use `probe` to determine the size of the image beforehand.
+         */
+        static auto decode_into(data::reader& reader, const qd::pixel_buffer& buffer) -> graphite::decode_error;
+
+        /**
+         * Decode an image description and its image data without throwing, writing each row of the image through
+         * the specified emitter.
+         */
+        static auto decode_rows(data::reader& reader, qd::scanline_emitter& rows) -> graphite::decode_error;
+
         [[nodiscard]] auto length() const -> int32_t;
         [[nodiscard]] auto compressor() const -> uint32_t;
         [[nodiscard]] auto version() const -> uint32_t;
@@ -40,6 +80,12 @@ namespace graphite::qt {
         [[nodiscard]] auto data_offset() const -> int32_t;
         [[nodiscard]] auto clut() const -> std::shared_ptr<qd::clut>;
         [[nodiscard]] auto surface() const -> std::shared_ptr<qd::surface>;
+
+        /**
+         * Returns the palette indices of an indexed 'raw ' or '8BPS' image, or null for any other image. The
+         * colors of such an image are only expanded once `surface` is first called.
+         */
+        [[nodiscard]] auto indexed_surface() const -> std::shared_ptr<qd::indexed_surface>;
     };
 
 }
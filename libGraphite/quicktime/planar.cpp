@@ -2,8 +2,11 @@
 // Created by Tom Hancocks on 5/02/2022.
 //
 
+#include <algorithm>
 #include "libGraphite/quicktime/planar.hpp"
 #include "libGraphite/quickdraw/internal/packbits.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 static inline auto read_bytes(graphite::data::reader& reader, std::size_t size) -> std::vector<uint8_t>
 {
@@ -11,11 +14,15 @@ static inline auto read_bytes(graphite::data::reader& reader, std::size_t size)
     return std::vector<uint8_t>(bytes.begin(), bytes.end());
 }
 
-auto graphite::qt::planar::decode(const qt::imagedesc& imagedesc, data::reader& reader) -> qd::surface
+static auto read_rows(const graphite::qt::imagedesc& imagedesc, graphite::data::reader& reader, graphite::qd::scanline_emitter& rows) -> graphite::decode_error
 {
+    GRAPHITE_TRACE_SCOPE("qt::planar::decode");
+    GRAPHITE_TRACE_BYTES(imagedesc.data_size());
+    
     auto depth = imagedesc.depth();
     if (depth != 1 && depth != 8 && depth != 24 && depth != 32) {
-        throw std::runtime_error("Unsupported planar bit depth: " + std::to_string(depth));
+        return graphite::decode_error(graphite::error_code::unsupported_depth, reader.position(),
+                                      "Unsupported planar bit depth: " + std::to_string(depth));
     }
 
     // Parse the remaining atoms to determine the channel count
@@ -36,59 +43,158 @@ auto graphite::qt::planar::decode(const qt::imagedesc& imagedesc, data::reader&
 
     auto width = imagedesc.width();
     auto height = imagedesc.height();
-    auto data_size = imagedesc.data_size();
     auto row_bytes = (width * depth + 7) / 8; // +7 to ensure result is rounded up
-    auto surface = qd::surface(width, height);
+    if (width < 0 || height < 0) {
+        return graphite::decode_error(graphite::error_code::invalid_header, reader.position(),
+                                      "Invalid planar image dimensions.");
+    }
+    auto clut = imagedesc.clut();
+    if (depth == 8 && !clut) {
+        return graphite::decode_error(graphite::error_code::missing_resource, reader.position(),
+                                      "Missing color table for 8-bit planar image.");
+    }
 
-    std::vector<uint8_t> raw;
+    // Each plane holds `height` rows. Monochrome images store whole rows of bits, otherwise each plane holds a
+    // single byte per pixel, with the red, green and blue planes following one another.
+    auto plane_count = (depth == 24 || depth == 32) ? 3 : 1;
+    if (rows.indexed() && rows.depth() != depth) {
+        return graphite::decode_error(graphite::error_code::unsupported_depth, reader.position(),
+                                      "Unable to decode planar image of depth " + std::to_string(depth) + " as indexed.");
+    }
+    std::size_t plane_row_bytes = depth == 1 ? row_bytes : width;
+
+    // Locate the data of every plane row, so that the rows of the image can be decoded in turn.
+    std::vector<uint64_t> row_offsets;
+    std::vector<uint16_t> pack_counts;
+    uint64_t data_end = 0;
     if (imagedesc.version() == 0) {
-        raw = read_bytes(reader, row_bytes * height);
+        // Unpacked rows are contiguous, and the planes follow one another.
+        auto start = reader.position();
+        data_end = start + row_bytes * height;
+        if (start + plane_row_bytes * height * plane_count > data_end || data_end > reader.size()) {
+            return graphite::decode_error(graphite::error_code::truncated_data, reader.position(),
+                                          "Insufficient planar image data.");
+        }
+        for (auto i = 0; i < height * plane_count; ++i) {
+            row_offsets.push_back(start + i * plane_row_bytes);
+        }
     } else {
         // Packbits - all counts are stored first
-        std::vector<uint16_t> pack_counts(height * channel_count);
+        pack_counts.resize(height * channel_count);
         for (auto i=0; i < pack_counts.size(); ++i) {
             pack_counts[i] = reader.read_short();
         }
-        raw.reserve(row_bytes * height);
+        if (pack_counts.size() < static_cast<std::size_t>(height * plane_count)) {
+            return graphite::decode_error(graphite::error_code::truncated_data, reader.position(),
+                                          "Insufficient planar image data.");
+        }
+        auto offset = reader.position();
         for (auto count : pack_counts) {
-            std::vector<uint8_t> pack = read_bytes(reader, count);
-            qd::packbits::decode(raw, pack, 1);
+            row_offsets.push_back(offset);
+            offset += count;
         }
+        data_end = offset;
     }
 
-    if (depth == 1) {
-        // Monochrome
-        for (auto y = 0; y < height; ++y) {
-            for (auto offset = 0; offset < row_bytes; ++offset) {
-                auto byte = raw[y * row_bytes + offset];
-                for (auto i = 0; i < 8; ++i) {
-                    auto v = byte & (1 << (7 - i));
-                    surface.set(offset * 8 + i, y, v ? qd::color::black() : qd::color::white());
-                }
-            }
+    // Read a single plane row, unpacking it if necessary.
+    std::vector<uint8_t> plane_rows[3];
+    auto read_plane_row = [&] (int plane, int y) -> bool {
+        auto index = plane * height + y;
+        auto& row = plane_rows[plane];
+        reader.set_position(row_offsets[index]);
+        if (pack_counts.empty()) {
+            row = read_bytes(reader, plane_row_bytes);
         }
-    }
-    else if (depth == 8) {
-        // 8-bit indexed
-        auto clut = imagedesc.clut();
-        for (auto y=0; y < height; ++y) {
-            for (auto x=0; x < width; ++x) {
-                surface.set(x, y, clut->get(raw[y * width + x]));
-            }
+        else {
+            row.clear();
+            graphite::qd::packbits::decode(row, read_bytes(reader, pack_counts[index]), 1);
         }
+        return row.size() >= plane_row_bytes;
+    };
+
+    // Monochrome and 8-bit images are expanded through a table of the colors of every possible byte.
+    std::vector<graphite::qd::color> table;
+    if (!rows.indexed() && depth == 1) {
+        const graphite::qd::color monochrome[] = { graphite::qd::color::white(), graphite::qd::color::black() };
+        table = graphite::qd::pixel_conversion::index_table(monochrome, 2, depth);
+    }
+    else if (!rows.indexed() && depth == 8) {
+        table = graphite::qd::indexed_surface::expansion_table(clut, depth);
     }
-    else if (depth == 24 || depth == 32) {
-        // Planar RGB
-        auto plane_size = width * height;
-        for (auto y=0; y < height; ++y) {
-            for (auto x=0; x < width; ++x) {
-                auto color = qd::color(raw[y * width + x],
-                                       raw[y * width + x + plane_size],
-                                       raw[y * width + x + plane_size * 2]);
-                surface.set(x, y, color);
+
+    rows.begin(width, height);
+    for (auto y = 0; y < height; ++y, rows.advance()) {
+        for (auto plane = 0; plane < plane_count; ++plane) {
+            if (!read_plane_row(plane, y)) {
+                return graphite::decode_error(graphite::error_code::truncated_data, reader.position(),
+                                              "Insufficient planar image data.");
             }
         }
+
+        // When building an indexed surface, monochrome bits and 8-bit indices are kept as they are.
+        if (rows.indexed()) {
+            auto count = std::min(plane_rows[0].size(), static_cast<std::size_t>(rows.indexed_surface()->row_bytes()));
+            std::copy_n(plane_rows[0].begin(), count, rows.indices());
+            continue;
+        }
+
+        auto pixels = rows.pixels();
+        if (depth == 1 || depth == 8) {
+            // Monochrome and 8-bit indexed
+            graphite::qd::pixel_conversion::indices_to_color(plane_rows[0].data(), 0, depth, table, pixels, width);
+        }
+        else {
+            // Planar RGB
+            graphite::qd::pixel_conversion::planar_to_color(plane_rows[0].data(), plane_rows[1].data(), plane_rows[2].data(), pixels, width);
+        }
     }
 
-    return surface;
+    reader.set_position(data_end);
+    return {};
+}
+
+auto graphite::qt::planar::try_decode(const qt::imagedesc& imagedesc, data::reader& reader) -> graphite::result<qd::surface>
+{
+    qd::scanline_emitter rows;
+    if (auto error = decode_rows(imagedesc, reader, rows)) {
+        return error;
+    }
+    return std::move(*rows.surface());
+}
+
+auto graphite::qt::planar::try_decode_indexed(const qt::imagedesc& imagedesc, data::reader& reader) -> graphite::result<std::shared_ptr<qd::indexed_surface>>
+{
+    auto depth = imagedesc.depth();
+    auto palette = imagedesc.clut();
+    if (depth == 1) {
+        palette = std::make_shared<qd::clut>();
+        palette->set(qd::color::white());
+        palette->set(qd::color::black());
+    }
+    else if (depth != 8) {
+        return graphite::decode_error(graphite::error_code::unsupported_depth, reader.position(),
+                                      "Unable to decode planar image of depth " + std::to_string(depth) + " as indexed.");
+    }
+
+    qd::scanline_emitter rows(palette, depth);
+    if (auto error = decode_rows(imagedesc, reader, rows)) {
+        return error;
+    }
+    return rows.indexed_surface();
+}
+
+auto graphite::qt::planar::stream(const qt::imagedesc& imagedesc, data::reader& reader, qd::pixel_format format, const qd::scanline_callback& callback) -> graphite::decode_error
+{
+    qd::scanline_emitter rows(format, callback);
+    return decode_rows(imagedesc, reader, rows);
+}
+
+auto graphite::qt::planar::decode_rows(const qt::imagedesc& imagedesc, data::reader& reader, qd::scanline_emitter& rows) -> graphite::decode_error
+{
+    return graphite::guarded_decode(reader, [&] { return read_rows(imagedesc, reader, rows); });
+}
+
+auto graphite::qt::planar::decode(const qt::imagedesc& imagedesc, data::reader& reader) -> qd::surface
+{
+    return try_decode(imagedesc, reader).value();
 }
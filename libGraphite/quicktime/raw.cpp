@@ -2,8 +2,11 @@
 // Created by Tom Hancocks on 5/02/2022.
 //
 
+#include <algorithm>
 #include "libGraphite/quicktime/raw.hpp"
 #include "libGraphite/quickdraw/pixmap.hpp"
+#include "libGraphite/quickdraw/internal/pixel_conversion.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 static inline auto read_bytes(graphite::data::reader& reader, std::size_t size) -> std::vector<uint8_t>
 {
@@ -11,42 +14,90 @@ static inline auto read_bytes(graphite::data::reader& reader, std::size_t size)
     return std::vector<uint8_t>(bytes.begin(), bytes.end());
 }
 
-auto graphite::qt::raw::decode(const qt::imagedesc& imagedesc, data::reader& reader) -> qd::surface
+static auto read_rows(const graphite::qt::imagedesc& imagedesc, graphite::data::reader& reader, graphite::qd::scanline_emitter& rows) -> graphite::decode_error
 {
+    GRAPHITE_TRACE_SCOPE("qt::raw::decode");
+    GRAPHITE_TRACE_BYTES(imagedesc.data_size());
+    
     auto depth = imagedesc.depth();
-    if (depth > 8) {
-        throw std::runtime_error("Unsupported raw bit depth: " + std::to_string(depth));
+    if (depth != 1 && depth != 2 && depth != 4 && depth != 8) {
+        return graphite::decode_error(graphite::error_code::unsupported_depth, reader.position(),
+                                      "Unsupported raw bit depth: " + std::to_string(depth));
     }
     auto width = imagedesc.width();
     auto height = imagedesc.height();
     auto clut = imagedesc.clut();
-    auto surface = qd::surface(width, height);
-    
+    if (!clut) {
+        return graphite::decode_error(graphite::error_code::missing_resource, reader.position(),
+                                      "Missing color table for raw image.");
+    }
+    if (width < 0 || height <= 0) {
+        return graphite::decode_error(graphite::error_code::invalid_header, reader.position(),
+                                      "Invalid raw image dimensions.");
+    }
+    rows.begin(width, height);
+    auto table = rows.indexed() ? std::vector<graphite::qd::color>() : graphite::qd::indexed_surface::expansion_table(clut, depth);
+
+    // When building an indexed surface, the packed rows of indices are kept as they are.
     if (depth == 8) {
-        for (auto y = 0; y < height; ++y) {
+        for (auto y = 0; y < height; ++y, rows.advance()) {
             auto raw = read_bytes(reader, width);
-            for (auto x = 0; x < width; ++x) {
-                surface.set(x, y, clut->get(raw[x]));
+            if (rows.indexed()) {
+                std::copy(raw.begin(), raw.end(), rows.indices());
+                continue;
             }
+            graphite::qd::pixel_conversion::indices_to_color(raw.data(), 0, depth, table, rows.pixels(), raw.size());
         }
     }
     else {
         auto pixels_per_byte = 8 / depth;
-        auto mask = (1 << depth) - 1;
         auto row_bytes = imagedesc.data_size() / height;
 
-        for (auto y = 0; y < height; ++y) {
-            auto x = 0;
+        for (auto y = 0; y < height; ++y, rows.advance()) {
             auto raw = read_bytes(reader, row_bytes);
-            for (auto byte : raw) {
-                for (auto i = 1; i <= pixels_per_byte; ++i) {
-                    auto byte_offset = 8 - (i * depth);
-                    auto v = (byte >> byte_offset) & mask;
-                    surface.set(x++, y, clut->get(v));
-                }
+            if (rows.indexed()) {
+                auto count = std::min(raw.size(), static_cast<std::size_t>(rows.indexed_surface()->row_bytes()));
+                std::copy_n(raw.begin(), count, rows.indices());
+                continue;
             }
+            auto count = std::min(raw.size() * pixels_per_byte, static_cast<std::size_t>(width));
+            graphite::qd::pixel_conversion::indices_to_color(raw.data(), 0, depth, table, rows.pixels(), count);
         }
     }
     
-    return surface;
+    return {};
+}
+
+auto graphite::qt::raw::try_decode(const qt::imagedesc& imagedesc, data::reader& reader) -> graphite::result<qd::surface>
+{
+    qd::scanline_emitter rows;
+    if (auto error = decode_rows(imagedesc, reader, rows)) {
+        return error;
+    }
+    return std::move(*rows.surface());
+}
+
+auto graphite::qt::raw::try_decode_indexed(const qt::imagedesc& imagedesc, data::reader& reader) -> graphite::result<std::shared_ptr<qd::indexed_surface>>
+{
+    qd::scanline_emitter rows(imagedesc.clut(), imagedesc.depth());
+    if (auto error = decode_rows(imagedesc, reader, rows)) {
+        return error;
+    }
+    return rows.indexed_surface();
+}
+
+auto graphite::qt::raw::stream(const qt::imagedesc& imagedesc, data::reader& reader, qd::pixel_format format, const qd::scanline_callback& callback) -> graphite::decode_error
+{
+    qd::scanline_emitter rows(format, callback);
+    return decode_rows(imagedesc, reader, rows);
+}
+
+auto graphite::qt::raw::decode_rows(const qt::imagedesc& imagedesc, data::reader& reader, qd::scanline_emitter& rows) -> graphite::decode_error
+{
+    return graphite::guarded_decode(reader, [&] { return read_rows(imagedesc, reader, rows); });
+}
+
+auto graphite::qt::raw::decode(const qt::imagedesc& imagedesc, data::reader& reader) -> qd::surface
+{
+    return try_decode(imagedesc, reader).value();
 }
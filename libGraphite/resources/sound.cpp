@@ -5,8 +5,10 @@
 #include "libGraphite/resources/sound.hpp"
 #include "libGraphite/rsrc/manager.hpp"
 #include "libGraphite/data/reader.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 #include <algorithm>
 #include <stdexcept>
+#include <utility>
 
 // MARK: - IMA4 Decoding
 
@@ -56,23 +58,56 @@ graphite::resources::sound::sound(std::shared_ptr<data::data> data, int64_t id,
 {
     // Setup a reader for the snd data, and then parse it.
     data::reader snd_reader(std::move(data));
-    parse(snd_reader);
+    if (auto error = parse(snd_reader)) {
+        error.raise();
+    }
+}
+
+graphite::resources::sound::sound(int64_t id, std::string name)
+    : m_ref_count(0), m_name(std::move(name)), m_id(id)
+{
+
 }
 
 graphite::resources::sound::sound(uint32_t sample_rate, uint8_t sample_bits, std::vector<std::vector<uint32_t>> sample_data)
-    : m_ref_count(0), m_name("Sound"), m_id(0), m_sample_rate_int(sample_rate), m_sample_rate_frac(0), m_sample_bits(sample_bits), m_sample_data(std::move(sample_data))
+    : m_ref_count(0), m_name("Sound"), m_id(0), m_sample_rate_int(sample_rate), m_sample_rate_frac(0), m_sample_bits(sample_bits)
+{
+    // Each channel is released once it has been copied into tracked storage, so that only one channel is held
+    // twice at a time.
+    m_sample_data.reserve(sample_data.size());
+    for (auto& channel : sample_data) {
+        m_sample_data.emplace_back(channel.begin(), channel.end());
+        std::vector<uint32_t>().swap(channel);
+    }
+
+}
+
+graphite::resources::sound::sound(uint32_t sample_rate, uint8_t sample_bits, std::vector<sample_buffer> sample_data)
+    : m_ref_count(0), m_name("Sound"), m_id(0), m_sample_rate_int(sample_rate), m_sample_rate_frac(0), m_sample_bits(sample_bits),
+      m_sample_data(std::move(sample_data))
 {
 
 }
 
 auto graphite::resources::sound::load_resource(int64_t id) -> std::shared_ptr<graphite::resources::sound>
 {
+    GRAPHITE_TRACE_SCOPE("resources::sound::load_resource");
     if (auto snd_res = graphite::rsrc::manager::shared_manager().find("snd ", id).lock()) {
         return std::make_shared<resources::sound>(snd_res->data(), id, snd_res->name());
     }
     return nullptr;
 }
 
+auto graphite::resources::sound::try_parse(std::shared_ptr<data::data> data, int64_t id, std::string name) -> graphite::result<std::shared_ptr<sound>>
+{
+    auto snd = std::shared_ptr<resources::sound>(new resources::sound(id, std::move(name)));
+    data::reader snd_reader(std::move(data));
+    if (auto error = graphite::guarded_decode(snd_reader, [&] { return snd->parse(snd_reader); })) {
+        return error;
+    }
+    return snd;
+}
+
 // MARK: - Accessors
 
 auto graphite::resources::sound::sample_bits() const -> uint8_t
@@ -87,7 +122,21 @@ auto graphite::resources::sound::sample_rate() const -> uint32_t
 
 auto graphite::resources::sound::samples() -> std::vector<std::vector<uint32_t>>
 {
-    return m_sample_data;
+    std::vector<std::vector<uint32_t>> samples;
+    samples.reserve(m_sample_data.size());
+    for (const auto& channel : m_sample_data) {
+        samples.emplace_back(channel.begin(), channel.end());
+    }
+    return samples;
+}
+
+auto graphite::resources::sound::decoded_bytes() const -> std::size_t
+{
+    std::size_t bytes = 0;
+    for (const auto& channel : m_sample_data) {
+        bytes += channel.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
 }
 
 auto graphite::resources::sound::data() -> std::shared_ptr<graphite::data::data>
@@ -100,8 +149,21 @@ auto graphite::resources::sound::data() -> std::shared_ptr<graphite::data::data>
 
 // MARK: - Parsing/Reading
 
-auto graphite::resources::sound::parse(graphite::data::reader& snd_reader) -> void
+static inline auto incompatible(const graphite::data::reader& snd_reader, const std::string& message) -> graphite::decode_error
+{
+    return graphite::decode_error(graphite::error_code::unsupported_format, snd_reader.position(), message);
+}
+
+static inline auto has_bytes(const graphite::data::reader& snd_reader, uint64_t count) -> bool
 {
+    return snd_reader.position() <= snd_reader.size() && count <= snd_reader.size() - snd_reader.position();
+}
+
+auto graphite::resources::sound::parse(graphite::data::reader& snd_reader) -> graphite::decode_error
+{
+    GRAPHITE_TRACE_SCOPE("resources::sound::decode");
+    GRAPHITE_TRACE_BYTES(snd_reader.size());
+    
     // Save the position because our buffer commands reference data by offset from the record start
     auto reader_pos = snd_reader.position();
 
@@ -112,14 +174,14 @@ auto graphite::resources::sound::parse(graphite::data::reader& snd_reader) -> vo
         // We only support sampled sounds; validate the format 1 sound type now
         auto num_data_formats = snd_reader.read_short();
         if (num_data_formats != 1) {
-            throw std::runtime_error("Encountered an incompatble snd format: " + std::to_string(num_data_formats) +
-                                     " formats, 1 expected, " + m_name);
+            return incompatible(snd_reader, "Encountered an incompatble snd format: " + std::to_string(num_data_formats) +
+                                            " formats, 1 expected, " + m_name);
         }
 
         auto data_format_id = snd_reader.read_short();
         if (data_format_id != sampledSynth) {
-            throw std::runtime_error("Encountered an incompatble snd format: format " + std::to_string(data_format_id) +
-                                     ", 5 expected, " + m_name);
+            return incompatible(snd_reader, "Encountered an incompatble snd format: format " + std::to_string(data_format_id) +
+                                            ", 5 expected, " + m_name);
         }
 
         channel_init_option = snd_reader.read_long();
@@ -128,22 +190,26 @@ auto graphite::resources::sound::parse(graphite::data::reader& snd_reader) -> vo
         m_ref_count = snd_reader.read_short();
     }
     else {
-        throw std::runtime_error("Encountered an incompatble snd format: " + std::to_string(snd_format) + ", " + m_name);
+        return graphite::decode_error(graphite::error_code::invalid_header, snd_reader.position(),
+                                      "Encountered an incompatble snd format: " + std::to_string(snd_format) + ", " + m_name);
     }
 
     // Read command array
     auto num_commands = snd_reader.read_short();
     std::vector<command_record> commands;
     for (auto i = 0; i < num_commands; i++) {
+        // The fields must be read in sequence; function argument evaluation order is unspecified.
         auto cmd = snd_reader.read_short();
-        commands.emplace_back(static_cast<command>(cmd & 0x7FFF), snd_reader.read_short(), snd_reader.read_long(), cmd & 0x8000);
+        auto param1 = snd_reader.read_short();
+        auto param2 = snd_reader.read_long();
+        commands.emplace_back(static_cast<command>(cmd & 0x7FFF), param1, param2, cmd & 0x8000);
     }
 
     // We only support sounds with a single buffer command -- validate that now
     if (commands.size() != 1 || commands[0].cmd != buffer) {
-        throw std::runtime_error("Encountered an incompatble snd format: " + std::to_string(commands.size()) +
-                                " commands, first command " + std::to_string(static_cast<unsigned int>(commands[0].cmd)) +
-                                ", " + m_name);
+        return incompatible(snd_reader, "Encountered an incompatble snd format: " + std::to_string(commands.size()) +
+                                        " commands, first command " + (commands.empty() ? std::string("none") : std::to_string(static_cast<unsigned int>(commands[0].cmd))) +
+                                        ", " + m_name);
     }
 
     // Move the reader to the buffer command's data offset
@@ -172,8 +238,15 @@ auto graphite::resources::sound::parse(graphite::data::reader& snd_reader) -> vo
         snd_reader.move(14);
 
         m_sample_bits = ext_header.sample_size;
+        if (ext_header.sample_size != 8 && ext_header.sample_size != 16) {
+            return graphite::decode_error(graphite::error_code::unsupported_depth, snd_reader.position(),
+                                          "Encountered an unsupported snd sample size: " + std::to_string(ext_header.sample_size) + ", " + m_name);
+        }
+        if (!has_bytes(snd_reader, static_cast<uint64_t>(ext_header.num_frames) * std_header.length * (ext_header.sample_size / 8))) {
+            return graphite::decode_error(graphite::error_code::truncated_data, snd_reader.position(), "Insufficient snd sample data, " + m_name);
+        }
         // Resize the data vector to fit the channel/frame count
-        m_sample_data.resize(std_header.length, std::vector<uint32_t>(ext_header.num_frames));
+        m_sample_data.resize(std_header.length, sample_buffer(ext_header.num_frames));
 
         // Raw sound data follows, channels interleaved
         for (auto f = 0; f < ext_header.num_frames; f++) {
@@ -198,14 +271,17 @@ auto graphite::resources::sound::parse(graphite::data::reader& snd_reader) -> vo
 
         // We only support fixed ima4 compression
         if (cmp_header.compression_id != fixedCompression || cmp_header.format != 0x696D6134) {
-            throw std::runtime_error("Encountered an incompatble snd format: " + std::to_string(cmp_header.compression_id) +
-                                     " compression ID, format " + std::to_string(cmp_header.format) +
-                                     ", expecting fixed ima4 compression, " + m_name);
+            return incompatible(snd_reader, "Encountered an incompatble snd format: " + std::to_string(cmp_header.compression_id) +
+                                            " compression ID, format " + std::to_string(cmp_header.format) +
+                                            ", expecting fixed ima4 compression, " + m_name);
+        }
+        if (!has_bytes(snd_reader, static_cast<uint64_t>(cmp_header.num_frames) * std_header.length * 34)) {
+            return graphite::decode_error(graphite::error_code::truncated_data, snd_reader.position(), "Insufficient snd sample data, " + m_name);
         }
 
         m_sample_bits = 16;
          // Resize the data vector to fit the channel count; sample count is frame count * 64
-        m_sample_data.resize(std_header.length, std::vector<uint32_t>(cmp_header.num_frames * 64));
+        m_sample_data.resize(std_header.length, sample_buffer(cmp_header.num_frames * 64));
 
         // Iterate over frames and expand into samples
         for (auto f = 0; f < cmp_header.num_frames; f++) {
@@ -234,14 +310,18 @@ auto graphite::resources::sound::parse(graphite::data::reader& snd_reader) -> vo
     }
     else {
         m_sample_bits = 8;
+        if (!has_bytes(snd_reader, std_header.length)) {
+            return graphite::decode_error(graphite::error_code::truncated_data, snd_reader.position(), "Insufficient snd sample data, " + m_name);
+        }
         // Resize the data vector to fit the channel/frame count
-        m_sample_data.resize(1, std::vector<uint32_t>(std_header.length));
+        m_sample_data.resize(1, sample_buffer(std_header.length));
 
         // Raw 8-bit mono sound data follows
         for (auto f = 0; f < std_header.length; f++) {
             m_sample_data[0][f] = snd_reader.read_byte();
         }
     }
+    return {};
 }
 
 // MARK: - Encoder / Writing
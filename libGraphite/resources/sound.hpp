@@ -11,6 +11,8 @@
 #include "libGraphite/data/data.hpp"
 #include "libGraphite/data/reader.hpp"
 #include "libGraphite/data/writer.hpp"
+#include "libGraphite/result.hpp"
+#include "libGraphite/memory/allocator.hpp"
 
 namespace graphite::resources {
 
@@ -144,6 +146,13 @@ namespace graphite::resources {
             uint16_t sample_size;       // The size of the sample before it was compressed.
         };
 
+    public:
+        /**
+         * The storage of the samples of a single channel, which is accounted for as sound memory.
+         */
+        typedef std::vector<uint32_t, memory::allocator<uint32_t, memory::category::sound>> sample_buffer;
+
+    private:
         // Basic resource information
         int16_t m_id {};
         std::string m_name;
@@ -153,21 +162,40 @@ namespace graphite::resources {
         uint32_t m_sample_rate_int {};
         uint16_t m_sample_rate_frac {};
         uint8_t m_sample_bits {};
-        std::vector<std::vector<uint32_t>> m_sample_data;
+        std::vector<sample_buffer> m_sample_data;
+
+        sound(int64_t id, std::string name);
 
-        auto parse(graphite::data::reader& snd_reader) -> void;
+        auto parse(graphite::data::reader& snd_reader) -> graphite::decode_error;
         auto encode(graphite::data::writer& snd_writer) -> void;
 
     public:
         explicit sound(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "");
         sound(uint32_t sample_rate, uint8_t sample_bits, std::vector<std::vector<uint32_t>> sample_data);
 
+        /**
+         * Construct a new sound from the samples of each channel, taking ownership of the samples without copying
+         * them.
+         */
+        sound(uint32_t sample_rate, uint8_t sample_bits, std::vector<sample_buffer> sample_data);
+
         static auto load_resource(int64_t id) -> std::shared_ptr<sound>;
 
+        /**
+         * Parse snd data without throwing. On failure the result describes the reason and the offset within the
+         * data at which decoding stopped.
+         */
+        static auto try_parse(std::shared_ptr<graphite::data::data> data, int64_t id = 0, std::string name = "") -> graphite::result<std::shared_ptr<sound>>;
+
         [[nodiscard]] auto sample_bits() const -> uint8_t;
         [[nodiscard]] auto sample_rate() const -> uint32_t;
         auto samples() -> std::vector<std::vector<uint32_t>>;
 
+        /**
+         * Returns the number of bytes of memory held by the decoded samples of the sound.
+         */
+        [[nodiscard]] auto decoded_bytes() const -> std::size_t;
+
         auto data() -> std::shared_ptr<graphite::data::data>;
     };
 
@@ -5,6 +5,7 @@
 #include "libGraphite/resources/string.hpp"
 #include "libGraphite/rsrc/manager.hpp"
 #include "libGraphite/data/reader.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Constructor
 
@@ -16,6 +17,7 @@ graphite::resources::string::string(std::string str, std::shared_ptr<data::data>
 
 auto graphite::resources::string::load_resource(int64_t id) -> std::shared_ptr<graphite::resources::string>
 {
+    GRAPHITE_TRACE_SCOPE("resources::string::load_resource");
     if (auto str_res = graphite::rsrc::manager::shared_manager().find("STR ", id).lock()) {
         auto reader = graphite::data::reader(str_res->data());
         auto str = reader.read_pstr();
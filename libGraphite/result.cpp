@@ -0,0 +1,75 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "libGraphite/result.hpp"
+
+
+auto graphite::error_code_name(enum graphite::error_code code) -> const char *
+{
+    switch (code) {
+        case error_code::none:                  return "none";
+        case error_code::truncated_data:        return "truncated data";
+        case error_code::invalid_header:        return "invalid header";
+        case error_code::invalid_structure:     return "invalid structure";
+        case error_code::unsupported_format:    return "unsupported format";
+        case error_code::unsupported_opcode:    return "unsupported opcode";
+        case error_code::unsupported_depth:     return "unsupported depth";
+        case error_code::missing_resource:      return "missing resource";
+        case error_code::io_error:              return "i/o error";
+    }
+    return "unknown";
+}
+
+// MARK: - Decode Error
+
+graphite::decode_error::decode_error(enum graphite::error_code code, uint64_t offset, std::string message)
+    : code(code), offset(offset), message(std::move(message))
+{
+
+}
+
+graphite::decode_error::operator bool() const
+{
+    return code != error_code::none;
+}
+
+auto graphite::decode_error::raise() const -> void
+{
+    throw graphite::decode_exception(*this);
+}
+
+// MARK: - Decode Exception
+
+graphite::decode_exception::decode_exception(const graphite::decode_error& error)
+    : std::runtime_error(error.message), m_code(error.code), m_offset(error.offset)
+{
+
+}
+
+auto graphite::decode_exception::code() const -> enum graphite::error_code
+{
+    return m_code;
+}
+
+auto graphite::decode_exception::offset() const -> uint64_t
+{
+    return m_offset;
+}
@@ -0,0 +1,171 @@
+// Copyright (c) 2020 Tom Hancocks
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#if !defined(GRAPHITE_RESULT_HPP)
+#define GRAPHITE_RESULT_HPP
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "libGraphite/data/reader.hpp"
+
+namespace graphite {
+
+    /**
+     * Structured reasons for which a decoder may reject its input.
+     */
+    enum class error_code : uint16_t
+    {
+        none = 0,
+        truncated_data,         // The input ended before the decoder expected it to.
+        invalid_header,         // A magic number, version or header field is not valid.
+        invalid_structure,      // An offset, length or count within the input is inconsistent.
+        unsupported_format,     // The input uses a variant of the format that is not implemented.
+        unsupported_opcode,     // The input contains an opcode that is not understood.
+        unsupported_depth,      // The input uses a color depth or sample size that is not implemented.
+        missing_resource,       // A resource referenced by the input could not be found.
+        io_error,               // The input could not be read from disk.
+    };
+
+    /**
+     * Returns a short human readable name for the specified error code.
+     */
+    auto error_code_name(enum error_code code) -> const char *;
+
+    /**
+     * The `graphite::decode_error` structure describes why, and where, a decoder rejected its input.
+     * A default constructed error represents success.
+     */
+    struct decode_error
+    {
+    public:
+        enum error_code code { error_code::none };
+        uint64_t offset { 0 };
+        std::string message;
+
+        decode_error() = default;
+        decode_error(enum error_code code, uint64_t offset, std::string message);
+
+        /**
+         * Reports if the receiver represents a failure.
+         */
+        explicit operator bool() const;
+
+        /**
+         * Throw the receiver as a `graphite::decode_exception`.
+         */
+        [[noreturn]] auto raise() const -> void;
+    };
+
+    /**
+     * The exception thrown by the throwing decoder APIs. This derives from `std::runtime_error` so that
+     * existing callers continue to work, but carries the structured error code and offset as well.
+     */
+    class decode_exception : public std::runtime_error
+    {
+    private:
+        enum error_code m_code;
+        uint64_t m_offset;
+
+    public:
+        explicit decode_exception(const decode_error& error);
+
+        [[nodiscard]] auto code() const -> enum error_code;
+        [[nodiscard]] auto offset() const -> uint64_t;
+    };
+
+    /**
+     * The `graphite::result` class holds either the value produced by a non-throwing decoder, or
+     * the error that caused it to fail.
+     */
+    template<typename T>
+    class result
+    {
+    private:
+        std::optional<T> m_value;
+        decode_error m_error;
+
+    public:
+        result(T value) : m_value(std::move(value)) {}
+        result(decode_error error) : m_error(std::move(error)) {}
+
+        /**
+         * Reports if the receiver holds a value.
+         */
+        explicit operator bool() const { return m_value.has_value(); }
+        [[nodiscard]] auto has_value() const -> bool { return m_value.has_value(); }
+
+        /**
+         * Returns the value held by the receiver, throwing the error if there is no value.
+         */
+        auto value() -> T&
+        {
+            if (!m_value.has_value()) {
+                m_error.raise();
+            }
+            return *m_value;
+        }
+
+        /**
+         * Returns the error held by the receiver. This will be `error_code::none` if there is a value.
+         */
+        [[nodiscard]] auto error() const -> const decode_error& { return m_error; }
+    };
+
+    /**
+     * Run the decode core `fn` against `reader`, with the reader set not to throw when reading beyond the end of
+     * its data. Input that the reader runs out of is reported as `error_code::truncated_data` at the position of
+     * the first short read. The core itself reports the other failures it detects by returning an error, and any
+     * exception still raised by a helper beneath the core is converted into a `graphite::decode_error`.
+     */
+    template<typename F>
+    auto guarded_decode(data::reader& reader, F&& fn) -> decode_error
+    {
+        auto throws = reader.throws();
+        auto was_truncated = reader.truncated();
+        reader.set_throws(false);
+
+        decode_error error;
+        try {
+            error = fn();
+        }
+        catch (const decode_exception& e) {
+            error = decode_error(e.code(), e.offset(), e.what());
+        }
+        catch (const std::out_of_range& e) {
+            error = decode_error(error_code::truncated_data, reader.position(), e.what());
+        }
+        catch (const std::exception& e) {
+            error = decode_error(error_code::invalid_structure, reader.position(), e.what());
+        }
+        reader.set_throws(throws);
+
+        if (!was_truncated && reader.truncated()) {
+            return decode_error(error_code::truncated_data, reader.truncated_position(), "Unexpected end of data.");
+        }
+        return error;
+    }
+
+}
+
+#endif //GRAPHITE_RESULT_HPP
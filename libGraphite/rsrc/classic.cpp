@@ -22,12 +22,17 @@
 #include <stdexcept>
 #include "libGraphite/hints.hpp"
 #include "libGraphite/rsrc/classic.hpp"
+#include "libGraphite/result.hpp"
 #include "libGraphite/encoding/macroman/macroman.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Parsing / Reading
 
-auto graphite::rsrc::classic::parse(const std::shared_ptr<graphite::data::reader>& reader) -> std::vector<std::shared_ptr<graphite::rsrc::type>>
+static auto parse_types(const std::shared_ptr<graphite::data::reader>& reader, std::vector<std::shared_ptr<graphite::rsrc::type>>& types) -> graphite::decode_error
 {
+    GRAPHITE_TRACE_SCOPE("rsrc::classic::parse");
+    GRAPHITE_TRACE_BYTES(reader->size());
+    
 	// 1. Resource File preamble, 
 	auto data_offset = reader->read_long();
 	auto map_offset = reader->read_long();
@@ -39,16 +44,16 @@ auto graphite::rsrc::classic::parse(const std::shared_ptr<graphite::data::reader
 	// at the start of the resource map, and we can check the lengths provided equal the
 	// size of the file.
     if (data_offset == 0 || map_offset == 0 || map_length == 0) {
-        throw std::runtime_error("[Classic Resource File] Invalid Preamble.");
+        return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Classic Resource File] Invalid Preamble.");
     }
 
 	auto rsrc_size = data_offset + data_length + map_length;
 	if (map_offset != data_offset + data_length) {
-		throw std::runtime_error("[Classic Resource File] ResourceMap starts at the unexpected location.");
+		return graphite::decode_error(graphite::error_code::invalid_structure, reader->position(), "[Classic Resource File] ResourceMap starts at the unexpected location.");
 	}
 
 	if (rsrc_size > reader->size()) {
-		throw std::runtime_error("[Classic Resource File] ResourceFile has unexpected length.");
+		return graphite::decode_error(graphite::error_code::truncated_data, reader->position(), "[Classic Resource File] ResourceFile has unexpected length.");
 	}
 
 	// Now move to the start of the resource map, and verify the contents of the preamble.
@@ -62,19 +67,19 @@ auto graphite::rsrc::classic::parse(const std::shared_ptr<graphite::data::reader
     // Ignore second preamble if all zero, as this can happen sometimes.
     if (data_offset2 != 0 || map_offset2 != 0 || data_length2 != 0 || map_length2 != 0) {
         if (data_offset2 != data_offset) {
-            throw std::runtime_error("[Classic Resource File] Second Preamble 'data_offset' mismatch.");
+            return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Classic Resource File] Second Preamble 'data_offset' mismatch.");
         }
 
         if (map_offset2 != map_offset) {
-            throw std::runtime_error("[Classic Resource File] Second Preamble 'map_offset' mismatch.");
+            return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Classic Resource File] Second Preamble 'map_offset' mismatch.");
         }
 
         if (data_length2 != data_length) {
-            throw std::runtime_error("[Classic Resource File] Second Preamble 'data_length' mismatch.");
+            return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Classic Resource File] Second Preamble 'data_length' mismatch.");
         }
 
         if (map_length2 != map_length) {
-            throw std::runtime_error("[Classic Resource File] Second Preamble 'map_length' mismatch.");
+            return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Classic Resource File] Second Preamble 'map_length' mismatch.");
         }
     }
 
@@ -96,7 +101,6 @@ auto graphite::rsrc::classic::parse(const std::shared_ptr<graphite::data::reader
 	// 3. Parse the list of Resource Types.
 	reader->set_position(map_offset + type_list_offset);
 	auto type_count = static_cast<uint16_t>(reader->read_short() + 1);
-	std::vector<std::shared_ptr<graphite::rsrc::type>> types;
 
 	for (auto type_idx = 0; type_idx < type_count; ++type_idx) {
 		auto code = reader->read_cstr(4);
@@ -129,6 +133,9 @@ auto graphite::rsrc::classic::parse(const std::shared_ptr<graphite::data::reader
 			reader->save_position();
 			reader->set_position(data_offset + resource_data_offset);
 			auto data_size = reader->read_long();
+			if (reader->position() + data_size > reader->size()) {
+				return graphite::decode_error(graphite::error_code::truncated_data, reader->position(), "[Classic Resource File] Resource data extends beyond the end of the file.");
+			}
 			auto slice = reader->read_data(data_size);
 			reader->restore_position();
 
@@ -143,6 +150,24 @@ auto graphite::rsrc::classic::parse(const std::shared_ptr<graphite::data::reader
 		types.push_back(type);
 	}
 
+	return {};
+}
+
+auto graphite::rsrc::classic::parse(const std::shared_ptr<graphite::data::reader>& reader) -> std::vector<std::shared_ptr<graphite::rsrc::type>>
+{
+	std::vector<std::shared_ptr<graphite::rsrc::type>> types;
+	if (auto error = parse_types(reader, types)) {
+		error.raise();
+	}
+	return types;
+}
+
+auto graphite::rsrc::classic::try_parse(const std::shared_ptr<graphite::data::reader>& reader) -> graphite::result<std::vector<std::shared_ptr<graphite::rsrc::type>>>
+{
+	std::vector<std::shared_ptr<graphite::rsrc::type>> types;
+	if (auto error = graphite::guarded_decode(*reader, [&] { return parse_types(reader, types); })) {
+		return error;
+	}
 	return types;
 }
 
@@ -24,6 +24,7 @@
 #include "libGraphite/rsrc/file.hpp"
 #include "libGraphite/data/reader.hpp"
 #include "libGraphite/data/writer.hpp"
+#include "libGraphite/result.hpp"
 
 #if !defined(GRAPHITE_RSRC_CLASSIC)
 #define GRAPHITE_RSRC_CLASSIC
@@ -36,6 +37,13 @@ namespace graphite::rsrc::classic {
      */
     auto parse(const std::shared_ptr<graphite::data::reader>& reader) -> std::vector<std::shared_ptr<graphite::rsrc::type>>;
 
+    /**
+     * Parse the specified/provided data object that represents a resource file
+     * into a list of resource types, reporting malformed input through the result
+     * rather than by throwing.
+     */
+    auto try_parse(const std::shared_ptr<graphite::data::reader>& reader) -> graphite::result<std::vector<std::shared_ptr<graphite::rsrc::type>>>;
+
     /**
      * Build a data object that represents a resource file from the provided list
      * of resource types.
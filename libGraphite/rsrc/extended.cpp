@@ -22,12 +22,17 @@
 #include <stdexcept>
 #include "libGraphite/hints.hpp"
 #include "libGraphite/rsrc/extended.hpp"
+#include "libGraphite/result.hpp"
 #include "libGraphite/encoding/macroman/macroman.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Parsing / Reading
 
-auto graphite::rsrc::extended::parse(const std::shared_ptr<graphite::data::reader>& reader) -> std::vector<std::shared_ptr<graphite::rsrc::type>>
+static auto parse_types(const std::shared_ptr<graphite::data::reader>& reader, std::vector<std::shared_ptr<graphite::rsrc::type>>& types) -> graphite::decode_error
 {
+    GRAPHITE_TRACE_SCOPE("rsrc::extended::parse");
+    GRAPHITE_TRACE_BYTES(reader->size());
+    
 	// 1. Resource File preamble, 
     GRAPHITE_UNUSED auto version = reader->read_quad();
 	auto data_offset = reader->read_quad();
@@ -41,30 +46,30 @@ auto graphite::rsrc::extended::parse(const std::shared_ptr<graphite::data::reade
 	// size of the file.
 	auto rsrc_size = data_offset + data_length + map_length;
 	if (map_offset != data_offset + data_length) {
-		throw std::runtime_error("[Extended Resource File] ResourceMap starts at the unexpected location.");
+		return graphite::decode_error(graphite::error_code::invalid_structure, reader->position(), "[Extended Resource File] ResourceMap starts at the unexpected location.");
 	}
 
 	if (rsrc_size != reader->size()) {
-		throw std::runtime_error("[Extended Resource File] ResourceFile has unexpected length.");
+		return graphite::decode_error(graphite::error_code::truncated_data, reader->position(), "[Extended Resource File] ResourceFile has unexpected length.");
 	}
 
 	// Now move to the start of the resource map, and verify the contents of the preamble.
 	reader->set_position(map_offset);
 
 	if (reader->read_quad() != data_offset) {
-		throw std::runtime_error("[Extended Resource File] Second Preamble 'data_offset' mismatch.");
+		return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Extended Resource File] Second Preamble 'data_offset' mismatch.");
 	}
 
 	if (reader->read_quad() != map_offset) {
-		throw std::runtime_error("[Extended Resource File] Second Preamble 'map_offset' mismatch.");
+		return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Extended Resource File] Second Preamble 'map_offset' mismatch.");
 	}
 
 	if (reader->read_quad() != data_length) {
-		throw std::runtime_error("[Extended Resource File] Second Preamble 'data_length' mismatch.");
+		return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Extended Resource File] Second Preamble 'data_length' mismatch.");
 	}
 
 	if (reader->read_quad() != map_length) {
-		throw std::runtime_error("[Extended Resource File] Second Preamble 'map_length' mismatch.");
+		return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Extended Resource File] Second Preamble 'map_length' mismatch.");
 	}
 
 	// 2. Now that the preamble is parsed and verified, parse the contents
@@ -86,7 +91,6 @@ auto graphite::rsrc::extended::parse(const std::shared_ptr<graphite::data::reade
 	// 3. Parse the list of Resource Types.
 	reader->set_position(map_offset + type_list_offset);
 	auto type_count = static_cast<uint64_t>(reader->read_quad() + 1);
-	std::vector<std::shared_ptr<graphite::rsrc::type>> types;
 
 	for (auto type_idx = 0; type_idx < type_count; ++type_idx) {
 		auto code = reader->read_cstr(4);
@@ -132,6 +136,9 @@ auto graphite::rsrc::extended::parse(const std::shared_ptr<graphite::data::reade
 			reader->save_position();
 			reader->set_position(data_offset + resource_data_offset);
 			auto data_size = reader->read_quad();
+			if (reader->position() + data_size > reader->size()) {
+				return graphite::decode_error(graphite::error_code::truncated_data, reader->position(), "[Extended Resource File] Resource data extends beyond the end of the file.");
+			}
 			auto slice = reader->read_data(data_size);
 			reader->restore_position();
 
@@ -146,6 +153,24 @@ auto graphite::rsrc::extended::parse(const std::shared_ptr<graphite::data::reade
 		types.push_back(type);
 	}
 
+	return {};
+}
+
+auto graphite::rsrc::extended::parse(const std::shared_ptr<graphite::data::reader>& reader) -> std::vector<std::shared_ptr<graphite::rsrc::type>>
+{
+	std::vector<std::shared_ptr<graphite::rsrc::type>> types;
+	if (auto error = parse_types(reader, types)) {
+		error.raise();
+	}
+	return types;
+}
+
+auto graphite::rsrc::extended::try_parse(const std::shared_ptr<graphite::data::reader>& reader) -> graphite::result<std::vector<std::shared_ptr<graphite::rsrc::type>>>
+{
+	std::vector<std::shared_ptr<graphite::rsrc::type>> types;
+	if (auto error = graphite::guarded_decode(*reader, [&] { return parse_types(reader, types); })) {
+		return error;
+	}
 	return types;
 }
 
@@ -18,12 +18,14 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <set>
 #include <stdexcept>
 #include "libGraphite/rsrc/file.hpp"
 #include "libGraphite/data/reader.hpp"
 #include "libGraphite/rsrc/classic.hpp"
 #include "libGraphite/rsrc/extended.hpp"
 #include "libGraphite/rsrc/rez.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Construct
 
@@ -40,6 +42,31 @@ auto graphite::rsrc::file::type_count() const -> std::size_t
 	return m_types.size();
 }
 
+auto graphite::rsrc::file::resident_bytes() const -> std::size_t
+{
+	// Resources read from the file are slices of the file image, so count each underlying buffer only once.
+	std::set<const std::vector<char> *> buffers;
+	std::size_t bytes = 0;
+	if (m_data) {
+		auto buffer = m_data->get();
+		buffers.insert(buffer.get());
+		bytes += buffer->capacity();
+	}
+	for (const auto& type : m_types) {
+		for (const auto& resource : type->resources()) {
+			auto data = resource->data();
+			if (!data) {
+				continue;
+			}
+			auto buffer = data->get();
+			if (buffer && buffers.insert(buffer.get()).second) {
+				bytes += buffer->capacity();
+			}
+		}
+	}
+	return bytes;
+}
+
 auto graphite::rsrc::file::types() const -> std::vector<std::shared_ptr<type>>
 {
     return m_types;
@@ -80,23 +107,31 @@ auto graphite::rsrc::file::path() const -> std::string
 
 // MARK: - File Reading
 
+static auto detect_format(graphite::data::reader& reader) -> graphite::rsrc::file::format
+{
+    if (reader.read_quad(0, graphite::data::reader::mode::peek) == 1) {
+		return graphite::rsrc::file::format::extended;
+	}
+    else if (reader.read_long(0, graphite::data::reader::mode::peek) == 'BRGR') {
+        return graphite::rsrc::file::format::rez;
+    }
+    else {
+		return graphite::rsrc::file::format::classic;
+	}
+}
+
 auto graphite::rsrc::file::read(const std::string& path) -> void
 {
+	GRAPHITE_TRACE_SCOPE("rsrc::file::read");
+
 	// Load the file data and prepare to parse the contents of the resource
 	// file. We also need to keep hold of the actual internal data.
 	auto reader = std::make_shared<graphite::data::reader>(path);
 	m_data = reader->get();
+	GRAPHITE_TRACE_BYTES(reader->size());
 
 	// 1. Determine the file format and validity.
-    if (reader->read_quad(0, graphite::data::reader::mode::peek) == 1) {
-		m_format = graphite::rsrc::file::format::extended;
-	}
-    else if (reader->read_long(0, graphite::data::reader::mode::peek) == 'BRGR') {
-        m_format = graphite::rsrc::file::format::rez;
-    }
-    else {
-		m_format = graphite::rsrc::file::format::classic;
-	}
+	m_format = detect_format(*reader);
 
 	// 2. Launch the appropriate parser for the current format of the file.
 	switch (m_format) {
@@ -119,6 +154,47 @@ auto graphite::rsrc::file::read(const std::string& path) -> void
 	}
 }
 
+auto graphite::rsrc::file::try_read(const std::string& path) -> graphite::decode_error
+{
+	GRAPHITE_TRACE_SCOPE("rsrc::file::read");
+
+	std::shared_ptr<graphite::data::reader> reader;
+	try {
+		reader = std::make_shared<graphite::data::reader>(path);
+	}
+	catch (const std::exception& e) {
+		return graphite::decode_error(graphite::error_code::io_error, 0, e.what());
+	}
+
+	// Files that are too short to even hold a preamble are rejected before the format is sniffed.
+	if (reader->size() < sizeof(uint64_t)) {
+		return graphite::decode_error(graphite::error_code::truncated_data, 0, "Resource File is too short to contain a preamble.");
+	}
+	auto format = detect_format(*reader);
+	GRAPHITE_TRACE_BYTES(reader->size());
+
+	auto types = [&] {
+		switch (format) {
+			case graphite::rsrc::file::format::extended:
+				return graphite::rsrc::extended::try_parse(reader);
+			case graphite::rsrc::file::format::rez:
+				return graphite::rsrc::rez::try_parse(reader);
+			default:
+				return graphite::rsrc::classic::try_parse(reader);
+		}
+	}();
+
+	// The receiver is only updated once the whole file has been parsed, so a failed read leaves it untouched.
+	if (!types) {
+		return types.error();
+	}
+	m_path = path;
+	m_data = reader->get();
+	m_format = format;
+	m_types = std::move(types.value());
+	return {};
+}
+
 // MARK: - File Writing
 
 auto graphite::rsrc::file::write(const std::string& path, enum graphite::rsrc::file::format fmt) -> void
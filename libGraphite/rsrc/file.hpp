@@ -24,6 +24,7 @@
 #include <map>
 #include "libGraphite/data/data.hpp"
 #include "libGraphite/rsrc/type.hpp"
+#include "libGraphite/result.hpp"
 
 #if !defined(GRAPHITE_RSRC_FILE)
 #define GRAPHITE_RSRC_FILE
@@ -81,6 +82,15 @@ namespace graphite::rsrc {
          */
         auto read(const std::string& path) -> void;
 
+        /**
+         * Read and parse the contents of the resource file at the specified location,
+         * reporting a missing or malformed file through the returned error rather than
+         * by throwing. On success the receiver takes on the path and contents of the file.
+         * Warning: This will destroy all existing information in the resource file, but only
+         * if the file is read successfully.
+         */
+        auto try_read(const std::string& path) -> graphite::decode_error;
+
         /**
          * Write the contents of the the resource file to disk. If no location is specified,
          * then it will use the original read path (if it exists).
@@ -101,6 +111,12 @@ namespace graphite::rsrc {
          * Returns the number of types contained in the resource file.
          */
         [[nodiscard]] auto type_count() const -> std::size_t;
+
+        /**
+         * Returns the number of bytes of memory held by the file. This includes the image of the file that was
+         * read from disk, and the data of any resources added since that do not reference it.
+         */
+        [[nodiscard]] auto resident_bytes() const -> std::size_t;
         
         /**
          * Returns the list of all types contained in the resource file.
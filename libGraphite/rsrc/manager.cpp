@@ -22,6 +22,8 @@
 #include <iterator>
 #include "libGraphite/rsrc/manager.hpp"
 #include "libGraphite/rsrc/file.hpp"
+#include "libGraphite/memory/allocator.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Singleton
 
@@ -55,16 +57,38 @@ auto graphite::rsrc::manager::unload_file(const std::string &path) -> void
     m_files = updated_files;
 }
 
+// MARK: - Memory Accounting
+
+auto graphite::rsrc::manager::memory_report::total_bytes() const -> std::size_t
+{
+    return resident_bytes + decoded_surface_bytes + decoded_sound_bytes;
+}
+
+auto graphite::rsrc::manager::memory_usage() const -> memory_report
+{
+    memory_report report;
+    report.file_count = m_files.size();
+    for (const auto& file : m_files) {
+        report.resident_bytes += file->resident_bytes();
+    }
+    report.decoded_surface_bytes = memory::category_usage(memory::category::surface).current_bytes;
+    report.decoded_sound_bytes = memory::category_usage(memory::category::sound).current_bytes;
+    return report;
+}
+
 // MARK: - Resource Look Up
 
 auto graphite::rsrc::manager::find(const std::string& type, const int64_t& id, const std::map<std::string, std::string>& attributes) const -> std::weak_ptr<graphite::rsrc::resource>
 {
+    GRAPHITE_TRACE_SCOPE("rsrc::manager::find");
     for (auto i = m_files.rbegin(); i != m_files.rend(); ++i) {
         auto res = (*i)->find(type, id, attributes);
         if (!res.expired()) {
+            GRAPHITE_TRACE_HIT("rsrc::manager::find");
             return res;
         }
     }
+    GRAPHITE_TRACE_MISS("rsrc::manager::find");
     return std::weak_ptr<graphite::rsrc::resource>();
 }
 
@@ -80,6 +104,7 @@ auto graphite::rsrc::manager::get_type(const std::string &type, const std::map<s
 auto graphite::rsrc::manager::find(const std::string &type, const std::string &name_prefix,
                                  const std::map<std::string, std::string> &attributes) -> std::vector<std::shared_ptr<resource>>
 {
+    GRAPHITE_TRACE_SCOPE("rsrc::manager::find_prefix");
     std::vector<std::shared_ptr<resource>> v;
     for (auto i = m_files.rbegin(); i != m_files.rend(); ++i) {
         auto resources = (*i)->find(type, name_prefix, attributes);
@@ -39,6 +39,21 @@ namespace graphite::rsrc {
      */
     class manager
     {
+    public:
+        /**
+         * A summary of the memory being used by resources and the data decoded from them.
+         */
+        struct memory_report
+        {
+        public:
+            std::size_t file_count { 0 };
+            std::size_t resident_bytes { 0 };           // Raw resource data held by the managed files.
+            std::size_t decoded_surface_bytes { 0 };    // Pixels of all live surfaces.
+            std::size_t decoded_sound_bytes { 0 };      // Samples of all live sounds.
+
+            [[nodiscard]] auto total_bytes() const -> std::size_t;
+        };
+
     private:
         std::vector<std::shared_ptr<file>> m_files;
         manager() = default;
@@ -73,6 +88,12 @@ namespace graphite::rsrc {
          */
         [[nodiscard]] auto files() const -> std::vector<std::shared_ptr<file>>;
 
+        /**
+         * Report the memory held by the managed files, along with the memory held by all surfaces and sounds
+         * that are currently alive.
+         */
+        [[nodiscard]] auto memory_usage() const -> memory_report;
+
         /**
          * Attempt to get the resource of the specified type and id.
          */
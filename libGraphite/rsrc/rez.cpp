@@ -20,19 +20,24 @@
 
 #include <iostream>
 #include "libGraphite/rsrc/rez.hpp"
+#include "libGraphite/result.hpp"
 #include "libGraphite/encoding/macroman/macroman.hpp"
+#include "libGraphite/diagnostics/instrumentation.hpp"
 
 // MARK: - Parsing / Reading
 
-auto graphite::rsrc::rez::parse(const std::shared_ptr<graphite::data::reader>& reader) -> std::vector<std::shared_ptr<graphite::rsrc::type>>
+static auto parse_types(const std::shared_ptr<graphite::data::reader>& reader, std::vector<std::shared_ptr<graphite::rsrc::type>>& types) -> graphite::decode_error
 {
+    GRAPHITE_TRACE_SCOPE("rsrc::rez::parse");
+    GRAPHITE_TRACE_BYTES(reader->size());
+    
     // Read the preamble
-    if (reader->read_long() != rez_signature) {
-        throw std::runtime_error("[Rez File] Preamble 'signature' mismatch.");
+    if (reader->read_long() != graphite::rsrc::rez::rez_signature) {
+        return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Rez File] Preamble 'signature' mismatch.");
     }
     reader->get()->set_byte_order(graphite::data::byte_order::lsb);
-    if (reader->read_long() != rez_version) {
-        throw std::runtime_error("[Rez File] Preamble 'version' mismatch.");
+    if (reader->read_long() != graphite::rsrc::rez::rez_version) {
+        return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Rez File] Preamble 'version' mismatch.");
     }
     auto header_length = reader->read_long();
     
@@ -40,9 +45,9 @@ auto graphite::rsrc::rez::parse(const std::shared_ptr<graphite::data::reader>& r
     reader->move(4); // Unknown value
     auto first_index = reader->read_long();
     auto count = reader->read_long();
-    uint32_t expected_header_length = 12 + (count * resource_offset_length) + static_cast<uint32_t>(map_name.size()+1);
+    uint32_t expected_header_length = 12 + (count * graphite::rsrc::rez::resource_offset_length) + static_cast<uint32_t>(graphite::rsrc::rez::map_name.size()+1);
     if (header_length != expected_header_length) {
-        throw std::runtime_error("[Rez File] Preamble 'header_length' mismatch.");
+        return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Rez File] Preamble 'header_length' mismatch.");
     }
     
     // Record the offsets
@@ -53,19 +58,21 @@ auto graphite::rsrc::rez::parse(const std::shared_ptr<graphite::data::reader>& r
         sizes.push_back(static_cast<uint64_t>(reader->read_long()));
         reader->move(4); // Unknown value
     }
-    if (reader->read_cstr() != map_name) {
-        throw std::runtime_error("[Rez File] Header 'map_name' mismatch.");
+    if (reader->read_cstr() != graphite::rsrc::rez::map_name) {
+        return graphite::decode_error(graphite::error_code::invalid_header, reader->position(), "[Rez File] Header 'map_name' mismatch.");
     }
     
     // Read the resource map header
     reader->get()->set_byte_order(graphite::data::byte_order::msb);
+    if (offsets.empty()) {
+        return graphite::decode_error(graphite::error_code::invalid_structure, reader->position(), "[Rez File] Header is missing the resource map entry.");
+    }
     auto map_offset = offsets.back();
     reader->set_position(map_offset);
     reader->move(4); // Unknown value
     auto type_count = reader->read_long();
     
     // Read the types
-    std::vector<std::shared_ptr<graphite::rsrc::type>> types;
     for (auto type_idx = 0; type_idx < type_count; type_idx++) {
         auto code = reader->read_cstr(4);
         auto type_offset = static_cast<int64_t>(reader->read_long());
@@ -80,7 +87,7 @@ auto graphite::rsrc::rez::parse(const std::shared_ptr<graphite::data::reader>& r
             auto index = reader->read_long();
             auto code = reader->read_cstr(4);
             if (code != type->code()) {
-                throw std::runtime_error("[Rez File] Resource 'type' mismatch.");
+                return graphite::decode_error(graphite::error_code::invalid_structure, reader->position(), "[Rez File] Resource 'type' mismatch.");
             }
             auto id = static_cast<int64_t>(reader->read_signed_short());
             // The name is padded to 256 bytes - note the end position before reading the cstr
@@ -88,6 +95,12 @@ auto graphite::rsrc::rez::parse(const std::shared_ptr<graphite::data::reader>& r
             auto name = reader->read_cstr();
             
             // Read the resource's data
+            if (index < first_index || index - first_index >= offsets.size()) {
+                return graphite::decode_error(graphite::error_code::invalid_structure, reader->position(), "[Rez File] Resource 'index' out of range.");
+            }
+            if (offsets[index-first_index] + sizes[index-first_index] > reader->size()) {
+                return graphite::decode_error(graphite::error_code::truncated_data, reader->position(), "[Rez File] Resource data extends beyond the end of the file.");
+            }
             reader->set_position(offsets[index-first_index]);
             auto slice = reader->read_data(sizes[index-first_index]);
             reader->set_position(nextOffset);
@@ -100,6 +113,24 @@ auto graphite::rsrc::rez::parse(const std::shared_ptr<graphite::data::reader>& r
         types.push_back(type);
     }
     
+    return {};
+}
+
+auto graphite::rsrc::rez::parse(const std::shared_ptr<graphite::data::reader>& reader) -> std::vector<std::shared_ptr<graphite::rsrc::type>>
+{
+    std::vector<std::shared_ptr<graphite::rsrc::type>> types;
+    if (auto error = parse_types(reader, types)) {
+        error.raise();
+    }
+    return types;
+}
+
+auto graphite::rsrc::rez::try_parse(const std::shared_ptr<graphite::data::reader>& reader) -> graphite::result<std::vector<std::shared_ptr<graphite::rsrc::type>>>
+{
+    std::vector<std::shared_ptr<graphite::rsrc::type>> types;
+    if (auto error = graphite::guarded_decode(*reader, [&] { return parse_types(reader, types); })) {
+        return error;
+    }
     return types;
 }
 
@@ -119,12 +150,12 @@ auto graphite::rsrc::rez::write(const std::string& path, const std::vector<std::
     uint32_t entry_count = resource_count + 1;
 
     // Calculate header length - this is from the end of the preamble to the start of the resource data
-    uint32_t header_length = 12 + (entry_count * resource_offset_length) + static_cast<uint32_t>(map_name.size()+1);
+    uint32_t header_length = 12 + (entry_count * graphite::rsrc::rez::resource_offset_length) + static_cast<uint32_t>(graphite::rsrc::rez::map_name.size()+1);
 
     // Write the preamble
-    writer->write_long(rez_signature);
+    writer->write_long(graphite::rsrc::rez::rez_signature);
     writer->data()->set_byte_order(graphite::data::byte_order::lsb);
-    writer->write_long(rez_version);
+    writer->write_long(graphite::rsrc::rez::rez_version);
     writer->write_long(header_length);
 
     // Calculate the offset to the first resource data
@@ -154,10 +185,10 @@ auto graphite::rsrc::rez::write(const std::string& path, const std::vector<std::
     // Write the offset and size of the resource map
     writer->write_long(resource_offset);
     writer->write_long(map_length);
-    writer->write_long(12 + (entry_count * resource_offset_length)); // Unknown value
+    writer->write_long(12 + (entry_count * graphite::rsrc::rez::resource_offset_length)); // Unknown value
 
     // Write the name of the resource map
-    writer->write_cstr(map_name);
+    writer->write_cstr(graphite::rsrc::rez::map_name);
 
     // Write each resource
     for (const auto& type : types) {
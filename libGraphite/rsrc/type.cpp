@@ -61,6 +61,17 @@ auto graphite::rsrc::type::count() const -> std::size_t
 	return m_resources.size();
 }
 
+auto graphite::rsrc::type::resident_bytes() const -> std::size_t
+{
+	std::size_t bytes = 0;
+	for (const auto& resource : m_resources) {
+		if (auto data = resource->data()) {
+			bytes += data->size();
+		}
+	}
+	return bytes;
+}
+
 auto graphite::rsrc::type::add_resource(const std::shared_ptr<graphite::rsrc::resource>& resource) -> void
 {
     // Search for an existing instance of this resource (same id)
@@ -66,6 +66,11 @@ namespace graphite::rsrc {
     	 */
     	[[nodiscard]] auto count() const -> std::size_t;
 
+    	/**
+    	 * Returns the number of bytes of resource data held by the resources of this type.
+    	 */
+    	[[nodiscard]] auto resident_bytes() const -> std::size_t;
+
     	/**
     	 * Add a new resource to the receiver.
     	 */